@@ -0,0 +1,414 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "latticeNetworkBuilder.h"
+#include "operations/pnmOperation.h"
+#include "network/iterator.h"
+#include "misc/userInput.h"
+#include "misc/counterRandom.h"
+#include "misc/scopedtimer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <memory>
+
+namespace PNM
+{
+
+namespace
+{
+
+int64_t find(std::atomic<int64_t> *labels, int64_t x)
+{
+    //path halving, as in hkClustering
+    while (true)
+    {
+        int64_t parent = labels[x].load();
+        if (parent == x)
+            return x;
+        int64_t grandParent = labels[parent].load();
+        if (parent != grandParent)
+            labels[x].compare_exchange_weak(parent, grandParent);
+        x = grandParent;
+    }
+}
+
+void unite(std::atomic<int64_t> *labels, int64_t x, int64_t y)
+{
+    while (true)
+    {
+        x = find(labels, x);
+        y = find(labels, y);
+        if (x == y)
+            return;
+        if (x < y)
+            std::swap(x, y);
+        int64_t root = x;
+        if (labels[x].compare_exchange_strong(root, y))
+            return;
+    }
+}
+
+} // namespace
+
+void latticeNetworkBuilder::make()
+{
+    MEASURE_FUNCTION();
+    initiateNetworkProperties();
+    generateLattice();
+    closeLatticePores();
+    keepSpanningCluster();
+    createElements();
+    assignLatticeRadii();
+    assignLengths();
+    distortLattice();
+    assignShapeFactors();
+    assignShapeFactorConstants();
+    assignVolumes();
+    assignWettabilities();
+    calculateProperties();
+}
+
+void latticeNetworkBuilder::generateLattice()
+{
+    std::cout << "Generating lattice..." << std::endl;
+
+    int64_t Nx = userInput::get().Nx;
+    int64_t Ny = userInput::get().Ny;
+    int64_t Nz = userInput::get().Nz;
+
+    latticeNodes = Nx * Ny * Nz;
+    latticePores = 3 * Nx * Ny * Nz + Ny * Nz + Nx * Nz + Nx * Ny;
+    latticeActive.assign(latticeNodes + latticePores, 1);
+
+    //Throats at both sides in y and z are closed, as in regularNetworkBuilder
+    int64_t firstY = (Nx + 1) * Ny * Nz;
+    int64_t firstZ = firstY + Nx * (Ny + 1) * Nz;
+
+#pragma omp parallel for
+    for (int64_t p = firstY; p < latticePores; ++p)
+    {
+        bool side;
+        if (p < firstZ)
+        {
+            int64_t j = (p - firstY) / Nz % (Ny + 1);
+            side = j == 0 || j == Ny;
+        }
+        else
+        {
+            int64_t k = (p - firstZ) % (Nz + 1);
+            side = k == 0 || k == Nz;
+        }
+        if (side)
+            latticeActive[latticeNodes + p] = 0;
+    }
+
+    signalProgress(20);
+}
+
+void latticeNetworkBuilder::closeLatticePores()
+{
+    double coordinationNumber = userInput::get().coordinationNumber;
+    if (!(coordinationNumber < 6 || (coordinationNumber < 4 && network->is2D)))
+        return;
+
+    std::cout << "Setting coordination number..." << std::endl;
+
+    int64_t Nx = userInput::get().Nx;
+    int64_t Ny = userInput::get().Ny;
+    int64_t Nz = userInput::get().Nz;
+
+    double totalEnabledPores = latticePores - 2 * Nx * Ny - 2 * Nx * Nz;
+    int64_t closedPoresNumber = network->is2D ? int64_t(totalEnabledPores * (1 - coordinationNumber / 4.0)) : int64_t(totalEnabledPores * (1 - coordinationNumber / 6.0));
+
+    //The closed throats are the enabled, non inlet/outlet, ones with the smallest random keys
+    std::vector<int64_t> candidates;
+    candidates.reserve(latticePores);
+    for (int64_t p = 0; p < latticePores; ++p)
+    {
+        bool boundary = p < (Nx + 1) * Ny * Nz && (p / (Ny * Nz) == 0 || p / (Ny * Nz) == Nx);
+        if (latticeActive[latticeNodes + p] && !boundary)
+            candidates.push_back(p);
+    }
+
+    std::vector<std::pair<double, int64_t>> keys(candidates.size());
+    counterRandom gen(userInput::get().seed, randomStream::latticeClosure);
+#pragma omp parallel for
+    for (int64_t i = 0; i < int64_t(candidates.size()); ++i)
+        keys[i] = {gen.uniform_real(candidates[i]), candidates[i]};
+
+    closedPoresNumber = std::max<int64_t>(0, std::min<int64_t>(closedPoresNumber, keys.size()));
+    std::nth_element(keys.begin(), keys.begin() + closedPoresNumber, keys.end());
+
+#pragma omp parallel for
+    for (int64_t i = 0; i < closedPoresNumber; ++i)
+        latticeActive[latticeNodes + keys[i].second] = 0;
+}
+
+void latticeNetworkBuilder::keepSpanningCluster()
+{
+    std::cout << "Cleaning up..." << std::endl;
+
+    int64_t Nx = userInput::get().Nx;
+    int64_t Ny = userInput::get().Ny;
+    int64_t Nz = userInput::get().Nz;
+    int64_t totalElements = latticeNodes + latticePores;
+
+    std::unique_ptr<std::atomic<int64_t>[]> labels(new std::atomic<int64_t>[totalElements]);
+#pragma omp parallel for
+    for (int64_t i = 0; i < totalElements; ++i)
+        labels[i].store(i);
+
+#pragma omp parallel for
+    for (int64_t p = 0; p < latticePores; ++p)
+    {
+        if (!latticeActive[latticeNodes + p])
+            continue;
+        int64_t nodeIn, nodeOut;
+        getPoreNodes(p, nodeIn, nodeOut);
+        if (nodeIn != -1)
+            unite(labels.get(), latticeNodes + p, nodeIn);
+        if (nodeOut != -1)
+            unite(labels.get(), latticeNodes + p, nodeOut);
+    }
+
+    //Clusters reached by both an inlet and an outlet throat (x throats at i = 0 and i = Nx)
+    std::vector<char> inletRoots(totalElements, 0), outletRoots(totalElements, 0);
+    int64_t planePores = Ny * Nz;
+    for (int64_t p = 0; p < planePores; ++p)
+    {
+        if (latticeActive[latticeNodes + p])
+            inletRoots[find(labels.get(), latticeNodes + p)] = 1;
+        int64_t q = Nx * planePores + p;
+        if (latticeActive[latticeNodes + q])
+            outletRoots[find(labels.get(), latticeNodes + q)] = 1;
+    }
+
+#pragma omp parallel for
+    for (int64_t i = 0; i < totalElements; ++i)
+    {
+        int64_t root = find(labels.get(), i);
+        if (latticeActive[i] && !(inletRoots[root] && outletRoots[root]))
+            latticeActive[i] = 0;
+    }
+
+    //Created elements, in the lattice order
+    newNodeIndex.assign(latticeNodes, -1);
+    nodeLatticeIndex.clear();
+    for (int64_t n = 0; n < latticeNodes; ++n)
+        if (latticeActive[n])
+        {
+            newNodeIndex[n] = nodeLatticeIndex.size();
+            nodeLatticeIndex.push_back(n);
+        }
+
+    poreLatticeIndex.clear();
+    for (int64_t p = 0; p < latticePores; ++p)
+        if (latticeActive[latticeNodes + p])
+            poreLatticeIndex.push_back(p);
+
+    signalProgress(40);
+}
+
+void latticeNetworkBuilder::createElements()
+{
+    std::cout << "Creating elements..." << std::endl;
+
+    int64_t Ny = userInput::get().Ny;
+    int64_t Nz = userInput::get().Nz;
+    int Nx = userInput::get().Nx;
+    double length = userInput::get().length;
+
+    network->totalNodes = nodeLatticeIndex.size();
+    network->totalPores = poreLatticeIndex.size();
+    network->tableOfNodes.resize(network->totalNodes);
+    network->tableOfPores.resize(network->totalPores);
+
+#pragma omp parallel for
+    for (int i = 0; i < network->totalNodes; ++i)
+    {
+        int64_t n = nodeLatticeIndex[i];
+        int x = n / (Ny * Nz), y = n / Nz % Ny, z = n % Nz;
+        auto newNode = network->createElement<node>(x, y, z);
+        newNode->setXCoordinate(x * length);
+        newNode->setYCoordinate(y * length);
+        newNode->setZCoordinate(z * length);
+        newNode->setId(i + 1);
+        newNode->setInlet(x == 0);
+        newNode->setOutlet(x == Nx - 1);
+        network->tableOfNodes[i] = newNode;
+    }
+
+    std::vector<std::vector<int>> nodePores(network->totalNodes);
+#pragma omp parallel for
+    for (int i = 0; i < network->totalPores; ++i)
+    {
+        int64_t nodeIn, nodeOut;
+        getPoreNodes(poreLatticeIndex[i], nodeIn, nodeOut);
+        node *in = nodeIn == -1 ? 0 : network->getNode(newNodeIndex[nodeIn]);
+        node *out = nodeOut == -1 ? 0 : network->getNode(newNodeIndex[nodeOut]);
+
+        auto newPore = network->createElement<pore>(in, out);
+        newPore->setId(i + 1);
+        newPore->setInlet(out == 0);
+        newPore->setOutlet(in == 0);
+
+        std::vector<element *> neighboors;
+        if (in)
+            neighboors.push_back(in);
+        if (out)
+            neighboors.push_back(out);
+        newPore->setNeighboors(neighboors);
+        network->tableOfPores[i] = newPore;
+    }
+
+    //Nodes neighboors, in the pores order, from the six lattice throats around each node
+    int64_t firstY = (Nx + 1) * Ny * Nz;
+    int64_t firstZ = firstY + Nx * (Ny + 1) * Nz;
+#pragma omp parallel for
+    for (int i = 0; i < network->totalNodes; ++i)
+    {
+        int64_t n = nodeLatticeIndex[i];
+        int64_t x = n / (Ny * Nz), y = n / Nz % Ny, z = n % Nz;
+        int64_t candidates[6] = {x * Ny * Nz + y * Nz + z, (x + 1) * Ny * Nz + y * Nz + z,
+                                 firstY + x * (Ny + 1) * Nz + y * Nz + z, firstY + x * (Ny + 1) * Nz + (y + 1) * Nz + z,
+                                 firstZ + x * Ny * (Nz + 1) + y * (Nz + 1) + z, firstZ + x * Ny * (Nz + 1) + y * (Nz + 1) + z + 1};
+
+        std::vector<element *> &neighboors = network->getNode(i)->getNeighboors();
+        for (int64_t p : candidates)
+            if (latticeActive[latticeNodes + p])
+            {
+                auto position = std::lower_bound(poreLatticeIndex.begin(), poreLatticeIndex.end(), p);
+                neighboors.push_back(network->getPore(position - poreLatticeIndex.begin()));
+            }
+    }
+
+    for (pore *p : pnmRange<pore>(network))
+    {
+        if (p->getInlet())
+            network->inletPores.push_back(p);
+        if (p->getOutlet())
+            network->outletPores.push_back(p);
+    }
+
+    signalProgress(60);
+}
+
+void latticeNetworkBuilder::assignLatticeRadii()
+{
+    std::cout << "Setting radii..." << std::endl;
+
+    counterRandom gen(userInput::get().seed, randomStream::poreRadius);
+    auto radiusDistribution = userInput::get().poreSizeDistribution;
+    double minRadius = userInput::get().minRadius;
+    double maxRadius = userInput::get().maxRadius;
+
+#pragma omp parallel for
+    for (int i = 0; i < network->totalPores; ++i)
+    {
+        int64_t index = poreLatticeIndex[i];
+        pore *p = network->getPore(i);
+        if (radiusDistribution == psd::uniform)
+            p->setRadius(gen.uniform_real(index, 0, minRadius, maxRadius));
+        if (radiusDistribution == psd::rayleigh)
+            p->setRadius(gen.rayleigh(index, 0, minRadius, maxRadius, userInput::get().rayleighParameter));
+        if (radiusDistribution == psd::triangular)
+            p->setRadius(gen.triangular(index, 0, minRadius, maxRadius, userInput::get().triangularParameter));
+        if (radiusDistribution == psd::truncatedNormal)
+            p->setRadius(gen.normal(index, 0, minRadius, maxRadius, userInput::get().normalMuParameter, userInput::get().normalSigmaParameter));
+    }
+
+#pragma omp parallel for
+    for (int i = 0; i < network->totalNodes; ++i)
+    {
+        node *n = network->getNode(i);
+        double maxRadius(0), averageRadius(0);
+        for (element *p : n->getNeighboors())
+        {
+            maxRadius = std::max(maxRadius, p->getRadius());
+            averageRadius += p->getRadius();
+        }
+        averageRadius = userInput::get().aspectRatio * averageRadius / n->getNeighboors().size();
+        n->setRadius(std::max(maxRadius, averageRadius));
+    }
+}
+
+void latticeNetworkBuilder::distortLattice()
+{
+    if (userInput::get().degreeOfDistortion <= 0)
+        return;
+
+    std::cout << "Distorting network..." << std::endl;
+
+    counterRandom gen(userInput::get().seed, randomStream::nodeDistortion);
+    double amplitude = userInput::get().length * userInput::get().degreeOfDistortion;
+
+#pragma omp parallel for
+    for (int i = 0; i < network->totalNodes; ++i)
+    {
+        int64_t index = nodeLatticeIndex[i];
+        node *n = network->getNode(i);
+        n->setXCoordinate(n->getXCoordinate() + amplitude * (-1 + 2 * gen.uniform_real(index, 0)));
+        n->setYCoordinate(n->getYCoordinate() + amplitude * (-1 + 2 * gen.uniform_real(index, 1)));
+        if (!network->is2D)
+            n->setZCoordinate(n->getZCoordinate() + amplitude * (-1 + 2 * gen.uniform_real(index, 2)));
+    }
+
+#pragma omp parallel for
+    for (int i = 0; i < network->totalPores; ++i)
+    {
+        pore *p = network->getPore(i);
+        node *in = p->getNodeIn(), *out = p->getNodeOut();
+        if (in == 0 || out == 0)
+            continue;
+        double length = std::sqrt(std::pow(in->getXCoordinate() - out->getXCoordinate(), 2) + std::pow(in->getYCoordinate() - out->getYCoordinate(), 2) + std::pow(in->getZCoordinate() - out->getZCoordinate(), 2));
+        p->setFullLength(length);
+        double newlength = length - in->getRadius() - out->getRadius();
+        p->setLength(newlength > 0 ? newlength : length / 2);
+    }
+}
+
+void latticeNetworkBuilder::getPoreNodes(int64_t p, int64_t &nodeIn, int64_t &nodeOut) const
+{
+    //Lattice throats are ordered as in regularNetworkBuilder::createPores
+    int64_t Nx = userInput::get().Nx;
+    int64_t Ny = userInput::get().Ny;
+    int64_t Nz = userInput::get().Nz;
+    int64_t firstY = (Nx + 1) * Ny * Nz;
+    int64_t firstZ = firstY + Nx * (Ny + 1) * Nz;
+
+    int64_t i, j, k, di(0), dj(0), dk(0);
+    if (p < firstY)
+    {
+        i = p / (Ny * Nz), j = p / Nz % Ny, k = p % Nz;
+        di = 1;
+    }
+    else if (p < firstZ)
+    {
+        p -= firstY;
+        i = p / ((Ny + 1) * Nz), j = p / Nz % (Ny + 1), k = p % Nz;
+        dj = 1;
+    }
+    else
+    {
+        p -= firstZ;
+        i = p / (Ny * (Nz + 1)), j = p / (Nz + 1) % Ny, k = p % (Nz + 1);
+        dk = 1;
+    }
+
+    auto latticeNode = [&](int64_t x, int64_t y, int64_t z) -> int64_t {
+        if (x < 0 || x >= Nx || y < 0 || y >= Ny || z < 0 || z >= Nz)
+            return -1;
+        return x * Ny * Nz + y * Nz + z;
+    };
+    nodeIn = latticeNode(i, j, k);
+    nodeOut = latticeNode(i - di, j - dj, k - dk);
+}
+
+} // namespace PNM
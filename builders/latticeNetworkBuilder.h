@@ -0,0 +1,54 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef LATTICENETWORKBUILDER_H
+#define LATTICENETWORKBUILDER_H
+
+#include "regularNetworkBuilder.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace PNM
+{
+
+// Regular network generated for large lattices: the lattice topology (closed throats, spanning cluster) is worked out
+// in parallel on flat arrays indexed by lattice position, then only the kept elements are created, in parallel.
+// The random draws are counter-based, keyed by the lattice positions: the network only depends on the seed, not on
+// the number of threads. It differs from the network regularNetworkBuilder makes with the same seed.
+class latticeNetworkBuilder : public regularNetworkBuilder
+{
+    Q_OBJECT
+  public:
+    latticeNetworkBuilder() {}
+    virtual ~latticeNetworkBuilder() {}
+    latticeNetworkBuilder(const latticeNetworkBuilder &) = delete;
+    latticeNetworkBuilder(latticeNetworkBuilder &&) = delete;
+    auto operator=(const latticeNetworkBuilder &) -> latticeNetworkBuilder & = delete;
+    auto operator=(latticeNetworkBuilder &&) -> latticeNetworkBuilder & = delete;
+    virtual void make() override;
+
+  protected:
+    void generateLattice();
+    void closeLatticePores();
+    void keepSpanningCluster();
+    void createElements();
+    void assignLatticeRadii();
+    void distortLattice();
+    void getPoreNodes(int64_t, int64_t &, int64_t &) const;
+
+    int64_t latticeNodes;
+    int64_t latticePores;
+    std::vector<char> latticeActive;       // lattice nodes then lattice pores
+    std::vector<int> newNodeIndex;         // index of the created node, -1 if the lattice node is removed
+    std::vector<int64_t> nodeLatticeIndex; // lattice position of each created node
+    std::vector<int64_t> poreLatticeIndex; // lattice position of each created pore
+};
+
+} // namespace PNM
+
+#endif // LATTICENETWORKBUILDER_H
@@ -0,0 +1,551 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "networkCache.h"
+#include "network/networkmodel.h"
+#include "network/iterator.h"
+
+#include <libs/boost/property_tree/ptree.hpp>
+#include <libs/boost/property_tree/ini_parser.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+namespace PNM
+{
+
+namespace
+{
+
+const char magic[4] = {'N', 'U', 'M', 'B'};
+const uint32_t version = 4;
+const char stateMagic[4] = {'N', 'U', 'M', 'D'};
+const uint32_t stateVersion = 2;
+
+struct fnvHash
+{
+    uint64_t value = 14695981039346656037ULL;
+
+    void mix(const char *data, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            value ^= static_cast<unsigned char>(data[i]);
+            value *= 1099511628211ULL;
+        }
+    }
+
+    void mix(const std::string &text)
+    {
+        mix(text.c_str(), text.size() + 1);
+    }
+};
+
+class byteWriter
+{
+  public:
+    template <typename T>
+    void put(const T &value)
+    {
+        const char *bytes = reinterpret_cast<const char *>(&value);
+        data.insert(data.end(), bytes, bytes + sizeof(T));
+    }
+
+    void putFlag(bool value)
+    {
+        put<unsigned char>(value ? 1 : 0);
+    }
+
+    std::vector<char> data;
+};
+
+class byteReader
+{
+  public:
+    byteReader(const std::vector<char> &data) : position(data.data()), end(data.data() + data.size()), valid(true) {}
+
+    template <typename T>
+    T take()
+    {
+        T value = T();
+        if (end - position < std::ptrdiff_t(sizeof(T)))
+        {
+            valid = false;
+            return value;
+        }
+        std::memcpy(&value, position, sizeof(T));
+        position += sizeof(T);
+        return value;
+    }
+
+    bool takeFlag()
+    {
+        return take<unsigned char>() != 0;
+    }
+
+    const char *position;
+    const char *end;
+    bool valid;
+};
+
+void writeElement(byteWriter &out, element *e)
+{
+    out.put<int>(e->getId());
+    out.put<double>(e->getRadius());
+    out.put<double>(e->getLength());
+    out.put<double>(e->getVolume());
+    out.put<double>(e->getShapeFactor());
+    out.put<double>(e->getShapeFactorConstant());
+    out.put<double>(e->getEntryPressureCoefficient());
+    out.put<double>(e->getEntryPressure());
+    out.put<double>(e->getConductivity());
+    out.put<double>(e->getCapillaryPressure());
+    out.put<double>(e->getTheta());
+    out.put<double>(e->getOriginalTheta());
+    out.put<double>(e->getViscosity());
+    out.put<double>(e->getConcentration());
+    out.put<double>(e->getOilFraction());
+    out.put<double>(e->getWaterFraction());
+    out.put<double>(e->getFlow());
+    out.put<int>(int(e->getWettabilityFlag()));
+    out.put<int>(int(e->getPhaseFlag()));
+    out.putFlag(e->getActive());
+    out.putFlag(e->getInlet());
+    out.putFlag(e->getOutlet());
+}
+
+void readElement(byteReader &in, element *e)
+{
+    e->setId(in.take<int>());
+    e->setRadius(in.take<double>());
+    e->setLength(in.take<double>());
+    e->setVolume(in.take<double>());
+    e->setShapeFactor(in.take<double>());
+    e->setShapeFactorConstant(in.take<double>());
+    e->setEntryPressureCoefficient(in.take<double>());
+    e->setEntryPressure(in.take<double>());
+    e->setConductivity(in.take<double>());
+    e->setCapillaryPressure(in.take<double>());
+    e->setTheta(in.take<double>());
+    e->setOriginalTheta(in.take<double>());
+    e->setViscosity(in.take<double>());
+    e->setConcentration(in.take<double>());
+    e->setOilFraction(in.take<double>());
+    e->setWaterFraction(in.take<double>());
+    e->setFlow(in.take<double>());
+    e->setWettabilityFlag(static_cast<wettability>(in.take<int>()));
+    e->setPhaseFlag(static_cast<phase>(in.take<int>()));
+    e->setActive(in.takeFlag());
+    e->setInlet(in.takeFlag());
+    e->setOutlet(in.takeFlag());
+}
+
+void writeState(byteWriter &out, element *e)
+{
+    out.put<int>(int(e->getPhaseFlag()));
+    out.put<int>(int(e->getWettabilityFlag()));
+    out.put<double>(e->getTheta());
+    out.put<double>(e->getEntryPressure());
+    out.put<double>(e->getOilFraction());
+    out.put<double>(e->getWaterFraction());
+    out.put<double>(e->getConcentration());
+    out.put<double>(e->getEffectiveVolume());
+    out.put<double>(e->getWaterFilmVolume());
+    out.put<double>(e->getWaterFilmConductivity());
+    out.put<double>(e->getOilFilmVolume());
+    out.put<double>(e->getOilFilmConductivity());
+    out.put<double>(e->getBeta1());
+    out.put<double>(e->getBeta2());
+    out.put<double>(e->getBeta3());
+    out.put<double>(e->getFilmAreaCoefficient());
+    out.putFlag(e->getOilConductor());
+    out.putFlag(e->getWaterConductor());
+    out.putFlag(e->getWaterCornerActivated());
+    out.putFlag(e->getOilLayerActivated());
+    out.putFlag(e->getOilCanFlowViaFilm());
+    out.putFlag(e->getWaterCanFlowViaFilm());
+}
+
+void readState(byteReader &in, element *e)
+{
+    e->setPhaseFlag(static_cast<phase>(in.take<int>()));
+    e->setWettabilityFlag(static_cast<wettability>(in.take<int>()));
+    e->setTheta(in.take<double>());
+    e->setEntryPressure(in.take<double>());
+    e->setOilFraction(in.take<double>());
+    e->setWaterFraction(in.take<double>());
+    e->setConcentration(in.take<double>());
+    e->setEffectiveVolume(in.take<double>());
+    e->setWaterFilmVolume(in.take<double>());
+    e->setWaterFilmConductivity(in.take<double>());
+    e->setOilFilmVolume(in.take<double>());
+    e->setOilFilmConductivity(in.take<double>());
+    e->setBeta1(in.take<double>());
+    e->setBeta2(in.take<double>());
+    e->setBeta3(in.take<double>());
+    e->setFilmAreaCoefficient(in.take<double>());
+    e->setOilConductor(in.takeFlag());
+    e->setWaterConductor(in.takeFlag());
+    e->setWaterCornerActivated(in.takeFlag());
+    e->setOilLayerActivated(in.takeFlag());
+    e->setOilCanFlowViaFilm(in.takeFlag());
+    e->setWaterCanFlowViaFilm(in.takeFlag());
+}
+
+//Written aside under a name unique to the writing thread then renamed, so that readers and concurrent writers never see a torn file
+void writeFile(const std::string &path, const std::vector<char> &data)
+{
+    std::string temporaryPath = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream file(temporaryPath.c_str(), std::ios::binary);
+        file.write(data.data(), data.size());
+        if (!file)
+        {
+            std::cout << "ERROR: Cache could not be written to " << temporaryPath << std::endl;
+            std::remove(temporaryPath.c_str());
+            return;
+        }
+    }
+
+    std::remove(path.c_str());
+    std::rename(temporaryPath.c_str(), path.c_str());
+}
+
+} // namespace
+
+uint64_t networkCache::getChecksum(const std::vector<std::string> &sourceFiles)
+{
+    fnvHash hash;
+    hash.mix(std::string(magic, 4) + std::to_string(version));
+
+    //Network generation settings, as written in the parameters file
+    boost::property_tree::ptree pt;
+    boost::property_tree::ini_parser::read_ini("Input_Data/Parameters.txt", pt);
+    for (auto &section : pt)
+    {
+        if (section.first.compare(0, 17, "NetworkGeneration") != 0 && section.first != "FluidInjection_Misc")
+            continue;
+        for (auto &key : section.second)
+            hash.mix(section.first + "." + key.first + "=" + key.second.data());
+    }
+
+    //Source files contents
+    std::vector<char> buffer(1 << 20);
+    for (const std::string &path : sourceFiles)
+    {
+        hash.mix(path);
+        std::ifstream file(path.c_str(), std::ios::binary);
+        while (file)
+        {
+            file.read(buffer.data(), buffer.size());
+            hash.mix(buffer.data(), file.gcount());
+        }
+    }
+
+    return hash.value;
+}
+
+void networkCache::save(const std::string &path, std::shared_ptr<networkModel> network, uint64_t checksum)
+{
+    writeFile(path, serialize(network, checksum));
+}
+
+std::shared_ptr<networkModel> networkCache::load(const std::string &path, uint64_t checksum)
+{
+    std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+    if (!file)
+        return nullptr;
+
+    std::vector<char> data(file.tellg());
+    file.seekg(0);
+    if (!file.read(data.data(), data.size()))
+        return nullptr;
+
+    return deserialize(data, checksum);
+}
+
+std::vector<char> networkCache::serialize(std::shared_ptr<networkModel> network, uint64_t checksum)
+{
+    if (!network->arrays.matches(*network))
+        network->arrays.build(*network);
+
+    byteWriter out;
+    out.data.insert(out.data.end(), magic, magic + 4);
+    out.put<uint32_t>(version);
+    out.put<uint64_t>(checksum);
+
+    out.put<int>(network->totalNodes);
+    out.put<int>(network->totalPores);
+    out.put<int>(network->maxConnectionNumber);
+    out.put<double>(network->xEdgeLength);
+    out.put<double>(network->yEdgeLength);
+    out.put<double>(network->zEdgeLength);
+    out.put<double>(network->totalPoresVolume);
+    out.put<double>(network->totalNodesVolume);
+    out.put<double>(network->totalNetworkVolume);
+    out.put<double>(network->inletPoresArea);
+    out.put<double>(network->absolutePermeability);
+    out.put<double>(network->porosity);
+    out.put<double>(network->normalisedFlow);
+    out.putFlag(network->is2D);
+    for (auto &row : network->permeabilityTensor)
+        for (double value : row)
+            out.put<double>(value);
+
+    for (node *n : pnmRange<node>(network))
+    {
+        out.put<int>(n->getIndexX());
+        out.put<int>(n->getIndexY());
+        out.put<int>(n->getIndexZ());
+        out.put<double>(n->getXCoordinate());
+        out.put<double>(n->getYCoordinate());
+        out.put<double>(n->getZCoordinate());
+        out.put<int>(n->getConnectionNumber());
+        out.put<double>(n->getPressure());
+        out.put<int>(n->getRank());
+        writeElement(out, n);
+    }
+
+    for (pore *p : pnmRange<pore>(network))
+    {
+        out.put<int>(p->getNodeIn() ? p->getNodeIn()->getIndex() : -1);
+        out.put<int>(p->getNodeOut() ? p->getNodeOut()->getIndex() : -1);
+        out.put<double>(p->getFullLength());
+        writeElement(out, p);
+    }
+
+    //Neighboors, as elements indices (nodes first then pores)
+    for (element *e : pnmRange<element>(network))
+    {
+        out.put<int>(e->getNeighboors().size());
+        for (element *neighboor : e->getNeighboors())
+            out.put<int>(neighboor->getIndex());
+    }
+
+    out.put<int>(network->inletPores.size());
+    for (pore *p : network->inletPores)
+        out.put<int>(p->getIndex() - network->totalNodes);
+    out.put<int>(network->outletPores.size());
+    for (pore *p : network->outletPores)
+        out.put<int>(p->getIndex() - network->totalNodes);
+
+    //Ids before renumbering, if any
+    for (const std::vector<int> *ids : {&network->originalNodesIds, &network->originalPoresIds})
+    {
+        out.put<int>(ids->size());
+        for (int id : *ids)
+            out.put<int>(id);
+    }
+
+    return out.data;
+}
+
+std::shared_ptr<networkModel> networkCache::deserialize(const std::vector<char> &data, uint64_t checksum)
+{
+    if (data.size() < 4 || std::memcmp(data.data(), magic, 4) != 0)
+        return nullptr;
+
+    byteReader in(data);
+    in.position += 4;
+    if (in.take<uint32_t>() != version || in.take<uint64_t>() != checksum)
+        return nullptr;
+
+    auto network = std::make_shared<networkModel>();
+    network->totalNodes = in.take<int>();
+    network->totalPores = in.take<int>();
+    network->maxConnectionNumber = in.take<int>();
+    network->xEdgeLength = in.take<double>();
+    network->yEdgeLength = in.take<double>();
+    network->zEdgeLength = in.take<double>();
+    network->totalPoresVolume = in.take<double>();
+    network->totalNodesVolume = in.take<double>();
+    network->totalNetworkVolume = in.take<double>();
+    network->inletPoresArea = in.take<double>();
+    network->absolutePermeability = in.take<double>();
+    network->porosity = in.take<double>();
+    network->normalisedFlow = in.take<double>();
+    network->is2D = in.takeFlag();
+    for (auto &row : network->permeabilityTensor)
+        for (double &value : row)
+            value = in.take<double>();
+
+    if (!in.valid || network->totalNodes < 0 || network->totalPores < 0)
+        return nullptr;
+
+    int totalElements = network->totalNodes + network->totalPores;
+    auto toIndex = [&in](int index, int first, int last) -> int {
+        if (index < first || index >= last)
+            in.valid = false;
+        return in.valid ? index : first;
+    };
+
+    network->tableOfNodes.reserve(network->totalNodes);
+    for (int i = 0; i < network->totalNodes && in.valid; ++i)
+    {
+        int x = in.take<int>();
+        int y = in.take<int>();
+        int z = in.take<int>();
+        auto n = network->createElement<node>(x, y, z);
+        n->setXCoordinate(in.take<double>());
+        n->setYCoordinate(in.take<double>());
+        n->setZCoordinate(in.take<double>());
+        n->setConnectionNumber(in.take<int>());
+        n->setPressure(in.take<double>());
+        n->setRank(in.take<int>());
+        readElement(in, n.get());
+        network->tableOfNodes.push_back(n);
+    }
+
+    auto getNode = [&](int index) -> node * {
+        return index == -1 ? 0 : network->tableOfNodes[toIndex(index, 0, network->totalNodes)].get();
+    };
+
+    network->tableOfPores.reserve(network->totalPores);
+    for (int i = 0; i < network->totalPores && in.valid; ++i)
+    {
+        node *nodeIn = getNode(in.take<int>());
+        node *nodeOut = getNode(in.take<int>());
+        auto p = network->createElement<pore>(nodeIn, nodeOut);
+        p->setFullLength(in.take<double>());
+        readElement(in, p.get());
+        network->tableOfPores.push_back(p);
+    }
+
+    if (!in.valid)
+        return nullptr;
+
+    auto getElement = [&](int index) -> element * {
+        index = toIndex(index, 0, totalElements);
+        if (index < network->totalNodes)
+            return network->tableOfNodes[index].get();
+        return network->tableOfPores[index - network->totalNodes].get();
+    };
+
+    for (element *e : pnmRange<element>(network))
+    {
+        int neighboorsNumber = toIndex(in.take<int>(), 0, totalElements + 1);
+        std::vector<element *> &neighboors = e->getNeighboors();
+        neighboors.reserve(neighboorsNumber);
+        for (int i = 0; i < neighboorsNumber && in.valid; ++i)
+            neighboors.push_back(getElement(in.take<int>()));
+        if (!in.valid)
+            return nullptr;
+    }
+
+    for (std::vector<pore *> *boundary : {&network->inletPores, &network->outletPores})
+    {
+        int poresNumber = toIndex(in.take<int>(), 0, network->totalPores + 1);
+        for (int i = 0; i < poresNumber && in.valid; ++i)
+            boundary->push_back(network->tableOfPores[toIndex(in.take<int>(), 0, network->totalPores)].get());
+    }
+
+    for (std::vector<int> *ids : {&network->originalNodesIds, &network->originalPoresIds})
+    {
+        int size = ids == &network->originalNodesIds ? network->totalNodes : network->totalPores;
+        int idsNumber = in.take<int>();
+        if (idsNumber != 0 && idsNumber != size)
+            return nullptr;
+        for (int i = 0; i < idsNumber && in.valid; ++i)
+            ids->push_back(in.take<int>());
+    }
+
+    if (!in.valid || in.position != in.end)
+        return nullptr;
+
+    return network;
+}
+
+uint64_t networkCache::getStateChecksum(std::shared_ptr<networkModel> network, const std::vector<double> &parameters)
+{
+    fnvHash hash;
+    hash.mix(std::string(stateMagic, 4) + std::to_string(stateVersion));
+
+    std::vector<char> snapshot = serialize(network);
+    hash.mix(snapshot.data(), snapshot.size());
+    hash.mix(reinterpret_cast<const char *>(parameters.data()), parameters.size() * sizeof(double));
+
+    return hash.value;
+}
+
+void networkCache::saveState(const std::string &path, std::shared_ptr<networkModel> network, uint64_t checksum)
+{
+    writeFile(path, serializeState(network, checksum));
+}
+
+bool networkCache::loadState(const std::string &path, std::shared_ptr<networkModel> network, uint64_t checksum)
+{
+    std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+
+    std::vector<char> data(file.tellg());
+    file.seekg(0);
+    if (!file.read(data.data(), data.size()))
+        return false;
+
+    return deserializeState(data, network, checksum);
+}
+
+std::vector<char> networkCache::serializeState(std::shared_ptr<networkModel> network, uint64_t checksum)
+{
+    byteWriter out;
+    out.data.insert(out.data.end(), stateMagic, stateMagic + 4);
+    out.put<uint32_t>(stateVersion);
+    out.put<uint64_t>(checksum);
+    out.put<int>(network->totalNodes);
+    out.put<int>(network->totalPores);
+    for (element *e : pnmRange<element>(network))
+        writeState(out, e);
+
+    //Pores terminal flags
+    for (pore *p : pnmRange<pore>(network))
+    {
+        out.putFlag(p->getNodeInOil());
+        out.putFlag(p->getNodeOutOil());
+        out.putFlag(p->getNodeInWater());
+        out.putFlag(p->getNodeOutWater());
+    }
+
+    return out.data;
+}
+
+bool networkCache::deserializeState(const std::vector<char> &data, std::shared_ptr<networkModel> network, uint64_t checksum)
+{
+    if (data.size() < 4 || std::memcmp(data.data(), stateMagic, 4) != 0)
+        return false;
+
+    byteReader in(data);
+    in.position += 4;
+    if (in.take<uint32_t>() != stateVersion || in.take<uint64_t>() != checksum)
+        return false;
+    if (in.take<int>() != network->totalNodes || in.take<int>() != network->totalPores)
+        return false;
+
+    //The whole record is checked before the elements are touched
+    size_t stateSize = 2 * sizeof(int) + 14 * sizeof(double) + 6;
+    if (size_t(in.end - in.position) != stateSize * (network->totalNodes + network->totalPores) + 4 * network->totalPores)
+        return false;
+
+    for (element *e : pnmRange<element>(network))
+        readState(in, e);
+
+    for (pore *p : pnmRange<pore>(network))
+    {
+        p->setNodeInOil(in.takeFlag());
+        p->setNodeOutOil(in.takeFlag());
+        p->setNodeInWater(in.takeFlag());
+        p->setNodeOutWater(in.takeFlag());
+    }
+
+    return in.valid;
+}
+
+} // namespace PNM
@@ -0,0 +1,48 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef NETWORKCACHE_H
+#define NETWORKCACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace PNM
+{
+
+struct networkModel;
+
+// Binary snapshot (.numb) of a built network: the network properties and permeability tensor, the nodes and pores
+// attributes in the tables order, the neighboors as CSR lists, the inlet/outlet pores and the ids before renumbering.
+// A snapshot is only loaded if its checksum, computed from the network generation settings and the source files
+// contents, matches the current one.
+class networkCache
+{
+  public:
+    static uint64_t getChecksum(const std::vector<std::string> &sourceFiles);
+    static void save(const std::string &path, std::shared_ptr<networkModel>, uint64_t checksum);
+    static std::shared_ptr<networkModel> load(const std::string &path, uint64_t checksum);
+
+    // In-memory snapshots, used to copy a built network
+    static std::vector<char> serialize(std::shared_ptr<networkModel>, uint64_t checksum = 0);
+    static std::shared_ptr<networkModel> deserialize(const std::vector<char> &, uint64_t checksum = 0);
+
+    // Fluid states (.numd) of a network: phases, wettabilities, fractions, conductors and films of each element, with the
+    // corners half angles and films stability, and the pores terminal flags. The drainage cache computes their checksum
+    // from the network snapshot and the given parameters.
+    static uint64_t getStateChecksum(std::shared_ptr<networkModel>, const std::vector<double> &parameters);
+    static void saveState(const std::string &path, std::shared_ptr<networkModel>, uint64_t checksum);
+    static bool loadState(const std::string &path, std::shared_ptr<networkModel>, uint64_t checksum);
+    static std::vector<char> serializeState(std::shared_ptr<networkModel>, uint64_t checksum = 0);
+    static bool deserializeState(const std::vector<char> &, std::shared_ptr<networkModel>, uint64_t checksum = 0);
+};
+
+} // namespace PNM
+
+#endif // NETWORKCACHE_H
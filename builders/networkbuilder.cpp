@@ -7,19 +7,29 @@
 
 #include "networkbuilder.h"
 #include "regularNetworkBuilder.h"
+#include "latticeNetworkBuilder.h"
 #include "statoilNetworkBuilder.h"
 #include "numscalNetworkBuilder.h"
+#include "networkCache.h"
+#include "network/networkmodel.h"
 #include "operations/pnmOperation.h"
 #include "misc/userInput.h"
 #include "misc/tools.h"
+#include "misc/scopedtimer.h"
+#include "misc/memoryFootprint.h"
 
 #include <iostream>
 
 namespace PNM
 {
 
+const std::string networkBuilder::cachePath = "numSCAL_Networks/network.numb";
+
 std::shared_ptr<networkBuilder> networkBuilder::createBuilder()
 {
+    if (userInput::get().networkRegular && userInput::get().parallelLattice)
+        return std::make_shared<latticeNetworkBuilder>();
+
     if (userInput::get().networkRegular)
         return std::make_shared<regularNetworkBuilder>();
 
@@ -34,15 +44,24 @@ std::shared_ptr<networkBuilder> networkBuilder::createBuilder()
 
 std::shared_ptr<networkModel> networkBuilder::build()
 {
+    MEASURE_FUNCTION();
     std::cout << "########## Building network ##########" << std::endl;
 
     //Create necessary folders
     initialise();
 
+    //Refuse the networks which would not fit in memory before allocating them
+    int nodes(0), pores(0);
+    bool is2D(false);
+    if (userInput::get().memoryPreflight && estimateSize(nodes, pores, is2D))
+        memoryFootprint::checkBeforeBuild(nodes, pores, is2D);
+
     //Make the network : a virtual function to be redefined in each subclass
-    make();
+    loadedFromCache = userInput::get().networkCache && loadCache();
+    if (!loadedFromCache)
+        make();
 
-    //Output properties
+    //Renumber, cache and output properties
     finalise();
 
     std::cout << "########## Network Built ##########\n"
@@ -63,13 +82,60 @@ void networkBuilder::initialise()
 
 void networkBuilder::finalise()
 {
-    pnmOperation::get(network).exportToNumcalFormat();
+    //The cached network was renumbered and its numSCAL files exported when it was built
+    if (!loadedFromCache)
+    {
+        pnmOperation::get(network).reorderElements();
+        if (userInput::get().networkCache)
+            saveCache();
+        pnmOperation::get(network).exportToNumcalFormat();
+    }
+
+    //The sub-volume is carved out of the full network, which stays the cached and exported one
+    network->nodesIndex.build(*network);
+    if (userInput::get().subVolume)
+        pnmOperation::get(network).extractSubVolume(userInput::get().subVolumeMin, userInput::get().subVolumeMax);
+    memoryFootprint::recordNetwork(*network);
     emit finished();
 }
 
+std::vector<std::string> networkBuilder::getSourceFiles() const
+{
+    return {};
+}
+
+bool networkBuilder::estimateSize(int &, int &, bool &) const
+{
+    return false;
+}
+
+bool networkBuilder::loadCache()
+{
+    auto cachedNetwork = networkCache::load(cachePath, networkCache::getChecksum(getSourceFiles()));
+    if (!cachedNetwork)
+        return false;
+
+    std::cout << "Network loaded from " << cachePath << std::endl;
+    network = cachedNetwork;
+    signalProgress(100);
+    return true;
+}
+
+void networkBuilder::saveCache()
+{
+    networkCache::save(cachePath, network, networkCache::getChecksum(getSourceFiles()));
+}
+
+void networkBuilder::setProgressCallback(const progressCallback &callback, int intervalMilliseconds)
+{
+    reporter.setCallback(callback, intervalMilliseconds);
+}
+
 void networkBuilder::signalProgress(int _progress)
 {
     progress = _progress;
+    if (reporter.isDue())
+        reporter.report(getNotification(), progress);
     emit notifyGUI();
 }
 
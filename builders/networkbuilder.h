@@ -8,8 +8,11 @@
 #ifndef NETWORKBUILDER_H
 #define NETWORKBUILDER_H
 
+#include "misc/progressReporter.h"
+
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <QObject>
 
@@ -28,24 +31,33 @@ class networkBuilder : public QObject
     virtual std::string getNotification() = 0;
     virtual int getProgress();
     std::shared_ptr<networkModel> getNetwork() const;
+    void setProgressCallback(const progressCallback &, int intervalMilliseconds = 1000);
 
   signals:
     void notifyGUI();
     void finished();
 
   protected:
-    networkBuilder(QObject *parent = 0) : QObject(parent) {}
+    networkBuilder(QObject *parent = 0) : QObject(parent), loadedFromCache(false) {}
     networkBuilder(const networkBuilder &) = delete;
     networkBuilder(networkBuilder &&) = delete;
     auto operator=(const networkBuilder &) -> networkBuilder & = delete;
     auto operator=(networkBuilder &&) -> networkBuilder & = delete;
     virtual void make() = 0;
+    virtual std::vector<std::string> getSourceFiles() const;
+    virtual bool estimateSize(int &nodes, int &pores, bool &is2D) const; // counts known before the network is made
     void initialise();
     void finalise();
     void signalProgress(int);
+    bool loadCache();
+    void saveCache();
+
+    static const std::string cachePath;
 
     std::shared_ptr<networkModel> network;
     int progress;
+    bool loadedFromCache; // the network was read from the binary cache instead of being made
+    progressReporter reporter; // throttled progress callback, used without the GUI
 };
 
 } // namespace PNM
@@ -11,17 +11,226 @@
 #include "misc/userInput.h"
 #include "misc/maths.h"
 
-#include "libs/csvParser/csv.h"
+#include <QFile>
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 
 namespace PNM
 {
 
+namespace
+{
+
+// Memory-mapped CSV table: the rows are located in one memchr pass, then the requested columns are parsed in parallel
+// straight from the mapping. Numbers are read with the digits accumulation of the csvParser library, so that imported
+// networks are unchanged.
+class csvTable
+{
+  public:
+    csvTable(const std::string &path) : path(path), file(path.c_str()), data(0), size(0)
+    {
+        if (!file.open(QFile::ReadOnly))
+            throw std::runtime_error("Can not open file: " + path + "\n");
+
+        size = file.size();
+        data = size > 0 ? reinterpret_cast<const char *>(file.map(0, size)) : 0;
+        if (size > 0 && !data)
+            throw std::runtime_error("Can not map file: " + path + "\n");
+
+        locateRows();
+    }
+
+    ~csvTable()
+    {
+        if (data)
+            file.unmap(reinterpret_cast<unsigned char *>(const_cast<char *>(data)));
+        file.close();
+    }
+
+    int getRowsNumber() const
+    {
+        return rowStarts.size();
+    }
+
+    // Fills values (row major, one value per requested column); missing columns keep their default value
+    void read(const std::vector<std::string> &columnsNames, const std::vector<double> &defaults, std::vector<double> &values) const
+    {
+        int columns = columnsNames.size();
+        std::vector<int> fieldIndices(columns, -1);
+        for (int j = 0; j < columns; ++j)
+            for (unsigned k = 0; k < header.size(); ++k)
+                if (header[k] == columnsNames[j])
+                    fieldIndices[j] = k;
+
+        int rows = getRowsNumber();
+        values.resize(size_t(rows) * columns);
+        int badRow(rows);
+
+#pragma omp parallel reduction(min : badRow)
+        {
+            std::vector<const char *> fields, fieldEnds;
+
+#pragma omp for
+            for (int i = 0; i < rows; ++i)
+            {
+                fields.clear();
+                fieldEnds.clear();
+                splitRow(rowStarts[i], rowEnds[i], fields, fieldEnds);
+
+                for (int j = 0; j < columns; ++j)
+                {
+                    double &value = values[size_t(i) * columns + j];
+                    int k = fieldIndices[j];
+                    if (k == -1)
+                        value = defaults[j];
+                    else if (k >= int(fields.size()) || !parseNumber(fields[k], fieldEnds[k], value))
+                        badRow = std::min(badRow, i);
+                }
+            }
+        }
+
+        if (badRow != rows)
+            throw std::runtime_error("Invalid value in " + path + " at line " + std::to_string(badRow + 2) + "\n");
+    }
+
+  protected:
+    void locateRows()
+    {
+        const char *end = data + size;
+        const char *line = data;
+        bool headerLine(true);
+        while (line < end)
+        {
+            const char *lineEnd = static_cast<const char *>(std::memchr(line, '\n', end - line));
+            if (!lineEnd)
+                lineEnd = end;
+
+            const char *contentEnd = lineEnd;
+            while (contentEnd > line && (contentEnd[-1] == '\r' || contentEnd[-1] == ' ' || contentEnd[-1] == '\t'))
+                --contentEnd;
+
+            if (headerLine)
+            {
+                std::vector<const char *> fields, fieldEnds;
+                splitRow(line, contentEnd, fields, fieldEnds);
+                for (unsigned k = 0; k < fields.size(); ++k)
+                    header.push_back(std::string(fields[k], fieldEnds[k]));
+                headerLine = false;
+            }
+            else if (contentEnd > line)
+            {
+                rowStarts.push_back(line);
+                rowEnds.push_back(contentEnd);
+            }
+
+            line = lineEnd + 1;
+        }
+    }
+
+    static void splitRow(const char *begin, const char *end, std::vector<const char *> &fields, std::vector<const char *> &fieldEnds)
+    {
+        const char *field = begin;
+        while (true)
+        {
+            const char *fieldEnd = static_cast<const char *>(std::memchr(field, ',', end - field));
+            if (!fieldEnd)
+                fieldEnd = end;
+
+            const char *first = field, *last = fieldEnd;
+            while (first < last && (*first == ' ' || *first == '\t'))
+                ++first;
+            while (last > first && (last[-1] == ' ' || last[-1] == '\t'))
+                --last;
+            fields.push_back(first);
+            fieldEnds.push_back(last);
+
+            if (fieldEnd == end)
+                break;
+            field = fieldEnd + 1;
+        }
+    }
+
+    static bool parseNumber(const char *c, const char *end, double &x)
+    {
+        bool negative(false);
+        if (c < end && (*c == '-' || *c == '+'))
+            negative = *c++ == '-';
+
+        x = 0;
+        while (c < end && '0' <= *c && *c <= '9')
+        {
+            x *= 10;
+            x += *c++ - '0';
+        }
+
+        if (c < end && *c == '.')
+        {
+            ++c;
+            double position = 1;
+            while (c < end && '0' <= *c && *c <= '9')
+            {
+                position /= 10;
+                x += (*c++ - '0') * position;
+            }
+        }
+
+        if (c < end && (*c == 'e' || *c == 'E'))
+        {
+            ++c;
+            bool negativeExponent(false);
+            if (c < end && (*c == '-' || *c == '+'))
+                negativeExponent = *c++ == '-';
+
+            int e(0);
+            if (c == end)
+                return false;
+            while (c < end && '0' <= *c && *c <= '9')
+                e = std::min(10 * e + (*c++ - '0'), 100000);
+
+            if (e != 0)
+            {
+                double base = negativeExponent ? 0.1 : 10;
+                while (e != 1)
+                {
+                    if ((e & 1) == 0)
+                    {
+                        base = base * base;
+                        e >>= 1;
+                    }
+                    else
+                    {
+                        x *= base;
+                        --e;
+                    }
+                }
+                x *= base;
+            }
+        }
+
+        if (negative)
+            x = -x;
+
+        return c == end;
+    }
+
+    std::string path;
+    QFile file;
+    const char *data;
+    long long size;
+    std::vector<std::string> header;
+    std::vector<const char *> rowStarts;
+    std::vector<const char *> rowEnds;
+};
+
+} // namespace
+
 void numscalNetworkBuilder::make()
 {
     initiateNetworkProperties();
@@ -56,36 +265,63 @@ void numscalNetworkBuilder::initiateNetworkProperties()
     network->maxConnectionNumber = 0;
 }
 
+std::vector<std::string> numscalNetworkBuilder::getSourceFiles() const
+{
+    std::string prefix = userInput::get().extractedNetworkFolderPath + userInput::get().rockPrefix;
+    return {prefix + "_nodes.num", prefix + "_throats.num"};
+}
+
+bool numscalNetworkBuilder::estimateSize(int &nodes, int &pores, bool &is2D) const
+{
+    //One line per element after the header
+    auto countRows = [](const std::string &path) {
+        std::ifstream file(path.c_str(), std::ios::binary);
+        if (!file)
+            return -1;
+        int lines(0);
+        std::vector<char> buffer(1 << 20);
+        while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0)
+            lines += std::count(buffer.data(), buffer.data() + file.gcount(), '\n');
+        return std::max(0, lines - 1);
+    };
+
+    std::vector<std::string> paths = getSourceFiles();
+    nodes = countRows(paths[0]);
+    pores = countRows(paths[1]);
+    is2D = false;
+    return nodes >= 0 && pores >= 0;
+}
+
 void numscalNetworkBuilder::importNodes()
 {
     std::string filePath = userInput::get().extractedNetworkFolderPath + userInput::get().rockPrefix + "_nodes.num";
 
     std::cout << "Importing data from " << filePath << "..." << std::endl;
 
-    double x, y, z, radius, length(-1), shapeFactor(0.03), id(0);
     network->totalNodes = 0;
     network->xEdgeLength = 0;
     network->yEdgeLength = 0;
     network->zEdgeLength = 0;
 
-    io::CSVReader<6> in(filePath);
-    in.read_header(io::ignore_missing_column, "x(um)", "y(um)", "z(um)", "radius(um)", "length(um)", "shapeFactor");
-    while (in.read_row(x, y, z, radius, length, shapeFactor))
-    {
+    std::vector<double> values;
+    csvTable table(filePath);
+    table.read({"x(um)", "y(um)", "z(um)", "radius(um)", "length(um)", "shapeFactor"}, {0, 0, 0, 0, -1, 0.03}, values);
 
-        x *= 1e-6;
-        y *= 1e-6;
-        z *= 1e-6;
-        radius *= 1e-6;
-        length *= 1e-6;
+    network->tableOfNodes.reserve(table.getRowsNumber());
+    for (int i = 0; i < table.getRowsNumber(); ++i)
+    {
+        const double *row = &values[6 * i];
+        double x = row[0] * 1e-6;
+        double y = row[1] * 1e-6;
+        double z = row[2] * 1e-6;
 
-        auto n = std::make_shared<node>(x, y, z);
+        auto n = network->createElement<node>(x, y, z);
         network->tableOfNodes.push_back(n);
 
-        n->setRadius(radius);
-        n->setLength(length);
-        n->setShapeFactor(shapeFactor);
-        n->setId(++id);
+        n->setRadius(row[3] * 1e-6);
+        n->setLength(row[4] * 1e-6);
+        n->setShapeFactor(row[5]);
+        n->setId(i + 1);
 
         network->totalNodes++;
 
@@ -106,28 +342,29 @@ void numscalNetworkBuilder::importPores()
 
     std::cout << "Importing data from " << filePath << "..." << std::endl;
 
-    int nodeInId, nodeOutId;
-    double radius, length(-1), shapeFactor(0.03);
     network->totalPores = 0;
 
-    io::CSVReader<5> in(filePath);
-    in.read_header(io::ignore_missing_column, "nodeIn(id)", "nodeOut(id)", "radius(um)", "length(um)", "shapeFactor");
-    while (in.read_row(nodeInId, nodeOutId, radius, length, shapeFactor))
-    {
+    std::vector<double> values;
+    csvTable table(filePath);
+    table.read({"nodeIn(id)", "nodeOut(id)", "radius(um)", "length(um)", "shapeFactor"}, {0, 0, 0, -1, 0.03}, values);
 
-        radius *= 1e-6;
-        length *= 1e-6;
+    //Ids out of the nodes table are boundaries, as with getNode
+    auto getNode = [this](double id) -> node * {
+        return id >= 1 && id <= network->totalNodes ? network->tableOfNodes[int(id) - 1].get() : 0;
+    };
 
-        auto nodeIn = nodeInId == 0 ? 0 : network->getNode(nodeInId - 1);
-        auto nodeOut = nodeOutId == 0 ? 0 : network->getNode(nodeOutId - 1);
+    network->tableOfPores.reserve(table.getRowsNumber());
+    for (int i = 0; i < table.getRowsNumber(); ++i)
+    {
+        const double *row = &values[5 * i];
 
-        auto p = std::make_shared<pore>(nodeIn, nodeOut);
+        auto p = network->createElement<pore>(getNode(row[0]), getNode(row[1]));
 
         network->tableOfPores.push_back(p);
 
-        p->setRadius(radius);
-        p->setLength(length);
-        p->setShapeFactor(shapeFactor);
+        p->setRadius(row[2] * 1e-6);
+        p->setLength(row[3] * 1e-6);
+        p->setShapeFactor(row[4]);
 
         if (p->getNodeOut() == 0)
         {
@@ -28,6 +28,8 @@ class numscalNetworkBuilder : public regularNetworkBuilder
 
   protected:
     void initiateNetworkProperties() override;
+    std::vector<std::string> getSourceFiles() const override;
+    bool estimateSize(int &nodes, int &pores, bool &is2D) const override;
     void importNodes();
     void importPores();
     void assignMissingValues();
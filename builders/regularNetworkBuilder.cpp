@@ -13,7 +13,7 @@
 #include "network/cluster.h"
 #include "misc/userInput.h"
 #include "misc/tools.h"
-#include "misc/randomGenerator.h"
+#include "misc/counterRandom.h"
 #include "misc/maths.h"
 
 #include <vector>
@@ -45,6 +45,18 @@ void regularNetworkBuilder::make()
     calculateProperties();
 }
 
+bool regularNetworkBuilder::estimateSize(int &nodes, int &pores, bool &is2D) const
+{
+    int Nx = userInput::get().Nx;
+    int Ny = userInput::get().Ny;
+    int Nz = userInput::get().Nz;
+
+    nodes = Nx * Ny * Nz;
+    pores = 3 * Nx * Ny * Nz + Ny * Nz + Nx * Nz + Nx * Ny;
+    is2D = Nz == 1;
+    return true;
+}
+
 std::string regularNetworkBuilder::getNotification()
 {
     std::ostringstream ss;
@@ -94,7 +106,7 @@ void regularNetworkBuilder::createNodes()
         for (int j = 0; j < Ny; ++j)
             for (int k = 0; k < Nz; ++k)
             {
-                network->tableOfNodes.push_back(std::shared_ptr<node>(new node(i, j, k)));
+                network->tableOfNodes.push_back(network->createElement<node>(i, j, k));
             }
 
     for (node *n : pnmRange<node>(network))
@@ -117,15 +129,15 @@ void regularNetworkBuilder::createPores()
     for (int i = 0; i < Nx + 1; ++i)
         for (int j = 0; j < Ny; ++j)
             for (int k = 0; k < Nz; ++k)
-                network->tableOfPores.push_back(std::shared_ptr<pore>(new pore(getNode(i, j, k), getNode(i - 1, j, k))));
+                network->tableOfPores.push_back(network->createElement<pore>(getNode(i, j, k), getNode(i - 1, j, k)));
     for (int i = 0; i < Nx; ++i)
         for (int j = 0; j < Ny + 1; ++j)
             for (int k = 0; k < Nz; ++k)
-                network->tableOfPores.push_back(std::shared_ptr<pore>(new pore(getNode(i, j, k), getNode(i, j - 1, k))));
+                network->tableOfPores.push_back(network->createElement<pore>(getNode(i, j, k), getNode(i, j - 1, k)));
     for (int i = 0; i < Nx; ++i)
         for (int j = 0; j < Ny; ++j)
             for (int k = 0; k < Nz + 1; ++k)
-                network->tableOfPores.push_back(std::shared_ptr<pore>(new pore(getNode(i, j, k), getNode(i, j, k - 1))));
+                network->tableOfPores.push_back(network->createElement<pore>(getNode(i, j, k), getNode(i, j, k - 1)));
 
     signalProgress(40);
 }
@@ -134,6 +146,26 @@ void regularNetworkBuilder::assignNeighboors()
 {
     std::cout << "Setting neighboors..." << std::endl;
 
+    //Count the connections first so that each neighboors list is allocated once; the nodes indices are only
+    //borrowed here, they are assigned for good with the network arrays
+    int index(0);
+    for (node *n : pnmRange<node>(network))
+        n->setIndex(index++);
+
+    std::vector<int> connections(index, 0);
+    for (pore *p : pnmRange<pore>(network))
+    {
+        if (p->getNodeIn() != 0)
+            ++connections[p->getNodeIn()->getIndex()];
+        if (p->getNodeOut() != 0)
+            ++connections[p->getNodeOut()->getIndex()];
+    }
+    for (node *n : pnmRange<node>(network))
+    {
+        n->getNeighboors().reserve(n->getNeighboors().size() + connections[n->getIndex()]);
+        n->setIndex(-1);
+    }
+
     for (pore *p : pnmRange<pore>(network))
     {
         if (p->getNodeIn() != 0)
@@ -223,19 +255,29 @@ void regularNetworkBuilder::applyCoordinationNumber()
 
         auto closedPoresNumber = (network->is2D ? int(totalEnabledPores * (1 - coordinationNumber / 4.0)) : int(totalEnabledPores * (1 - coordinationNumber / 6.0)));
 
-        auto shuffledPores = network->tableOfPores;
-        std::shuffle(shuffledPores.begin(), shuffledPores.end(), randomGenerator(userInput::get().seed).getGen());
-
-        while (closedPoresNumber > 0)
+        //The closed throats are the enabled, non inlet/outlet, ones with the smallest random keys, drawn from the pores
+        //indices as the lattice builder does: both close the same throats
+        std::vector<int> candidates;
+        candidates.reserve(network->totalPores);
+        for (int i = 0; i < network->totalPores; ++i)
         {
-            pore *p = shuffledPores.back().get();
-            shuffledPores.pop_back();
+            pore *p = network->tableOfPores[i].get();
             if (p->getActive() && !p->getInlet() && !p->getOutlet())
-            {
-                p->setActive(false);
-                --closedPoresNumber;
-            }
+                candidates.push_back(i);
         }
+
+        std::vector<std::pair<double, int>> keys(candidates.size());
+        counterRandom gen(userInput::get().seed, randomStream::latticeClosure);
+#pragma omp parallel for
+        for (int i = 0; i < int(candidates.size()); ++i)
+            keys[i] = {gen.uniform_real(candidates[i]), candidates[i]};
+
+        closedPoresNumber = std::max(0, std::min(closedPoresNumber, int(keys.size())));
+        std::nth_element(keys.begin(), keys.begin() + closedPoresNumber, keys.end());
+
+#pragma omp parallel for
+        for (int i = 0; i < closedPoresNumber; ++i)
+            network->tableOfPores[keys[i].second]->setActive(false);
     }
 }
 
@@ -243,58 +285,18 @@ void regularNetworkBuilder::cleanNetwork()
 {
     std::cout << "Cleaning up..." << std::endl;
 
-    hkClustering::get(network).clusterActiveElements();
+    hkClustering::get(network).clusterActiveElements(false);
 
-    for (element *e : pnmRange<element>(network))
+    pnmSpan<element> elements(*network);
+#pragma omp parallel for
+    for (int i = 0; i < int(elements.size()); ++i)
     {
+        element *e = elements[i];
         if (e->getActive() && !e->getClusterActive()->getSpanning())
             e->setActive(false);
-    };
-
-    // delete closed pores from inlet/ outlet containers
-    network->inletPores.erase(std::remove_if(network->inletPores.begin(), network->inletPores.end(), [this](pore *p) -> bool {
-                                  return !p->getActive();
-                              }),
-                              network->inletPores.end());
-    network->outletPores.erase(remove_if(network->outletPores.begin(), network->outletPores.end(), [this](pore *p) -> bool {
-                                   return !p->getActive();
-                               }),
-                               network->outletPores.end());
-
-    // delete closed elements from neighboor containers
-    for (element *e : pnmRange<element>(network))
-    {
-        std::vector<element *> &neighboors = e->getNeighboors();
-        neighboors.erase(remove_if(neighboors.begin(), neighboors.end(), [this](element *e) -> bool {
-                             return !e->getActive();
-                         }),
-                         neighboors.end());
     }
 
-    network->tableOfNodes.erase(remove_if(network->tableOfNodes.begin(), network->tableOfNodes.end(), [this](std::shared_ptr<node> n) -> bool {
-                                    return !n->getActive();
-                                }),
-                                network->tableOfNodes.end());
-
-    network->tableOfPores.erase(remove_if(network->tableOfPores.begin(), network->tableOfPores.end(), [this](std::shared_ptr<pore> p) -> bool {
-                                    return !p->getActive();
-                                }),
-                                network->tableOfPores.end());
-
-    network->totalPores = network->tableOfPores.size();
-    network->totalNodes = network->tableOfNodes.size();
-
-    int pid(0);
-    for (pore *p : pnmRange<pore>(network))
-    {
-        p->setId(++pid);
-    };
-
-    int nid(0);
-    for (node *n : pnmRange<node>(network))
-    {
-        n->setId(++nid);
-    };
+    network->removeInactiveElements();
 
     signalProgress(60);
 }
@@ -30,6 +30,7 @@ class regularNetworkBuilder : public networkBuilder
     virtual std::string getNotification() override;
 
   protected:
+    bool estimateSize(int &nodes, int &pores, bool &is2D) const override;
     virtual void initiateNetworkProperties();
     void createNodes();
     void createPores();
@@ -10,11 +10,20 @@
 #include "misc/userInput.h"
 #include "misc/maths.h"
 
+#include <QFile>
+
+#include <algorithm>
+#include <cctype>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <iostream>
+#include <locale>
 #include <sstream>
+#include <stdexcept>
 
 namespace PNM
 {
@@ -22,10 +31,7 @@ namespace PNM
 void statoilNetworkBuilder::make()
 {
     initiateNetworkProperties();
-    importNode1();
-    importNode2();
-    importLink1();
-    importLink2();
+    importFiles();
     assignNeighboors();
     cleanNetwork();
     assignShapeFactorConstants();
@@ -54,98 +60,392 @@ void statoilNetworkBuilder::initiateNetworkProperties()
     network->is2D = false;
 }
 
-void statoilNetworkBuilder::importNode1()
+std::vector<std::string> statoilNetworkBuilder::getSourceFiles() const
 {
-    std::string filePath = userInput::get().extractedNetworkFolderPath + userInput::get().rockPrefix + "_node1.dat";
+    std::string prefix = userInput::get().extractedNetworkFolderPath + userInput::get().rockPrefix;
+    return {prefix + "_node1.dat", prefix + "_node2.dat", prefix + "_link1.dat", prefix + "_link2.dat"};
+}
 
-    std::cout << "Importing data from " << filePath << "..." << std::endl;
+bool statoilNetworkBuilder::estimateSize(int &nodes, int &pores, bool &is2D) const
+{
+    //The node1 and link1 files start with the elements counts
+    std::vector<std::string> paths = getSourceFiles();
+    std::ifstream nodesFile(paths[0].c_str()), linksFile(paths[2].c_str());
+    is2D = false;
+    return bool(nodesFile >> nodes) && bool(linksFile >> pores);
+}
+
+// Contents of the four files, in the files order
+struct statoilNodes
+{
+    int count;
+    double xEdgeLength, yEdgeLength, zEdgeLength;
+    int maxConnectionNumber;
+    std::vector<double> coordinates; // x, y, z per node
+    std::vector<char> inlet, outlet;
+};
+
+struct statoilNodesProperties
+{
+    std::vector<double> values; // volume, radius, shape factor per node
+};
 
-    std::ifstream file(filePath.c_str());
+struct statoilLinks
+{
+    int count;
+    std::vector<int> nodes;      // node 1, node 2 per throat; 0 and -1 stand for the outlet and inlet
+    std::vector<double> values; // radius, shape factor, total length per throat
+};
 
-    file >> network->totalNodes >> network->xEdgeLength >> network->yEdgeLength >> network->zEdgeLength;
-    network->tableOfNodes.reserve(network->totalNodes);
+struct statoilLinksProperties
+{
+    std::vector<double> values; // throat length, volume per throat
+};
 
-    std::string dummy;
-    std::getline(file, dummy);
+namespace
+{
 
-    for (int i = 0; i < network->totalNodes; ++i)
+// Memory-mapped file of whitespace separated numbers. Doubles are parsed exactly when the digits fit the double
+// precision (the common case for the extracted networks), and by the C++ streams otherwise, so that imported
+// networks are unchanged.
+class tokenFile
+{
+  public:
+    tokenFile(const std::string &path) : path(path), file(path.c_str()), data(0), position(0), end(0), valid(true)
     {
-        int id;
-        double x, y, z;
-        int numberOfNeighboors;
-        bool isInlet, isOutlet;
+        if (!file.open(QFile::ReadOnly))
+            throw std::runtime_error("Can not open file: " + path + "\n");
+
+        long long size = file.size();
+        data = size > 0 ? reinterpret_cast<const char *>(file.map(0, size)) : 0;
+        if (size > 0 && !data)
+            throw std::runtime_error("Can not map file: " + path + "\n");
+        position = data;
+        end = data + size;
+    }
 
-        file >> id >> x >> y >> z >> numberOfNeighboors;
+    ~tokenFile()
+    {
+        if (data)
+            file.unmap(reinterpret_cast<unsigned char *>(const_cast<char *>(data)));
+        file.close();
+    }
 
-        network->tableOfNodes.push_back(std::make_shared<node>(x, y, z));
+    bool atEnd()
+    {
+        skipSpaces();
+        return position == end;
+    }
 
-        if (numberOfNeighboors > network->maxConnectionNumber)
-            network->maxConnectionNumber = numberOfNeighboors;
+    void skipLine()
+    {
+        const char *lineEnd = static_cast<const char *>(std::memchr(position, '\n', end - position));
+        position = lineEnd ? lineEnd + 1 : end;
+    }
+
+    void skip(int tokens)
+    {
+        const char *first, *last;
+        for (int i = 0; i < tokens; ++i)
+            nextToken(first, last);
+    }
 
-        for (int j = 0; j < numberOfNeighboors; ++j)
+    int takeInt()
+    {
+        const char *first, *last;
+        if (!nextToken(first, last))
+            return 0;
+
+        const char *c = first;
+        bool negative(false);
+        if (c < last && (*c == '-' || *c == '+'))
+            negative = *c++ == '-';
+        if (c == last)
+            valid = false;
+
+        long long value(0);
+        while (c < last && '0' <= *c && *c <= '9' && value < (1LL << 32))
+            value = 10 * value + (*c++ - '0');
+        if (c != last)
+            valid = false;
+        return int(negative ? -value : value);
+    }
+
+    double takeDouble()
+    {
+        const char *first, *last;
+        if (!nextToken(first, last))
+            return 0;
+
+        double value;
+        if (!parseExactly(first, last, value))
         {
-            file >> dummy;
+            std::istringstream stream(std::string(first, last));
+            stream.imbue(std::locale::classic());
+            if (!(stream >> value) || stream.peek() != std::char_traits<char>::eof())
+                valid = false;
         }
+        return value;
+    }
 
-        file >> isInlet >> isOutlet;
-        node *n = network->tableOfNodes[i].get();
-        n->setInlet(isInlet);
-        n->setOutlet(isOutlet);
+    void check() const
+    {
+        if (!valid)
+            throw std::runtime_error("Invalid or missing values in " + path + "\n");
+    }
+
+  protected:
+    void skipSpaces()
+    {
+        while (position < end && std::isspace(static_cast<unsigned char>(*position)))
+            ++position;
+    }
+
+    bool nextToken(const char *&first, const char *&last)
+    {
+        skipSpaces();
+        first = position;
+        while (position < end && !std::isspace(static_cast<unsigned char>(*position)))
+            ++position;
+        last = position;
+        if (first == last)
+            valid = false;
+        return first != last;
+    }
 
-        for (int j = 0; j < numberOfNeighboors; ++j)
+    // Mantissas below 2^53 scaled by at most 10^22 are exactly representable operands: a single multiplication
+    // or division then gives the correctly rounded value, as strtod would
+    static bool parseExactly(const char *c, const char *last, double &x)
+    {
+        static const double powersOf10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        const uint64_t maxMantissa = uint64_t(1) << 53;
+
+        bool negative(false);
+        if (c < last && (*c == '-' || *c == '+'))
+            negative = *c++ == '-';
+
+        uint64_t mantissa(0);
+        int exponent(0), digits(0);
+        for (; c < last && '0' <= *c && *c <= '9'; ++c, ++digits)
+            if ((mantissa = 10 * mantissa + (*c - '0')) >= maxMantissa)
+                return false;
+        if (c < last && *c == '.')
+            for (++c; c < last && '0' <= *c && *c <= '9'; ++c, ++digits, --exponent)
+                if ((mantissa = 10 * mantissa + (*c - '0')) >= maxMantissa)
+                    return false;
+        if (digits == 0)
+            return false;
+
+        if (c < last && (*c == 'e' || *c == 'E'))
         {
-            file >> dummy;
+            ++c;
+            bool negativeExponent(false);
+            if (c < last && (*c == '-' || *c == '+'))
+                negativeExponent = *c++ == '-';
+            if (c == last)
+                return false;
+            int e(0);
+            while (c < last && '0' <= *c && *c <= '9' && e < 1000)
+                e = 10 * e + (*c++ - '0');
+            exponent += negativeExponent ? -e : e;
         }
+
+        if (c != last || exponent < -22 || exponent > 22)
+            return false;
+
+        x = exponent >= 0 ? double(mantissa) * powersOf10[exponent] : double(mantissa) / powersOf10[-exponent];
+        if (negative)
+            x = -x;
+        return true;
     }
-    signalProgress(10);
+
+    std::string path;
+    QFile file;
+    const char *data;
+    const char *position;
+    const char *end;
+    bool valid;
+};
+
+void parseNode1(const std::string &path, statoilNodes &nodes)
+{
+    tokenFile file(path);
+    nodes.count = file.takeInt();
+    nodes.xEdgeLength = file.takeDouble();
+    nodes.yEdgeLength = file.takeDouble();
+    nodes.zEdgeLength = file.takeDouble();
+    file.skipLine();
+    file.check();
+
+    nodes.maxConnectionNumber = 0;
+    nodes.coordinates.resize(3 * size_t(std::max(nodes.count, 0)));
+    nodes.inlet.resize(std::max(nodes.count, 0));
+    nodes.outlet.resize(std::max(nodes.count, 0));
+
+    //id, x, y, z, neighboors number, the neighboor nodes, inlet and outlet flags, the neighboor throats
+    for (int i = 0; i < nodes.count; ++i)
+    {
+        file.skip(1);
+        for (int k = 0; k < 3; ++k)
+            nodes.coordinates[3 * i + k] = file.takeDouble();
+        int numberOfNeighboors = file.takeInt();
+        nodes.maxConnectionNumber = std::max(nodes.maxConnectionNumber, numberOfNeighboors);
+        file.skip(numberOfNeighboors);
+        nodes.inlet[i] = file.takeInt() != 0;
+        nodes.outlet[i] = file.takeInt() != 0;
+        file.skip(numberOfNeighboors);
+    }
+    file.check();
 }
 
-void statoilNetworkBuilder::importNode2()
+void parseNode2(const std::string &path, statoilNodesProperties &properties)
 {
-    std::string filePath = userInput::get().extractedNetworkFolderPath + userInput::get().rockPrefix + "_node2.dat";
+    //id, volume, radius, shape factor, clay volume
+    tokenFile file(path);
+    while (!file.atEnd())
+    {
+        file.skip(1);
+        for (int k = 0; k < 3; ++k)
+            properties.values.push_back(file.takeDouble());
+        file.skip(1);
+    }
+    file.check();
+}
 
-    std::cout << "Importing data from " << filePath << "..." << std::endl;
+void parseLink1(const std::string &path, statoilLinks &links)
+{
+    tokenFile file(path);
+    links.count = file.takeInt();
+    file.skipLine();
+    file.check();
 
-    std::ifstream file(filePath.c_str());
+    links.nodes.resize(2 * size_t(std::max(links.count, 0)));
+    links.values.resize(3 * size_t(std::max(links.count, 0)));
 
-    for (node *n : pnmRange<node>(network))
+    //id, node 1, node 2, radius, shape factor, total length
+    for (int i = 0; i < links.count; ++i)
     {
-        int id;
-        double volume, radius, shapeFactor;
-        std::string dummy;
+        file.skip(1);
+        links.nodes[2 * i] = file.takeInt();
+        links.nodes[2 * i + 1] = file.takeInt();
+        for (int k = 0; k < 3; ++k)
+            links.values[3 * i + k] = file.takeDouble();
+    }
+    file.check();
+}
 
-        file >> id >> volume >> radius >> shapeFactor >> dummy;
+void parseLink2(const std::string &path, statoilLinksProperties &properties)
+{
+    //id, node 1, node 2, node 1 length, node 2 length, throat length, volume, clay volume
+    tokenFile file(path);
+    while (!file.atEnd())
+    {
+        file.skip(5);
+        properties.values.push_back(file.takeDouble());
+        properties.values.push_back(file.takeDouble());
+        file.skip(1);
+    }
+    file.check();
+}
 
-        n->setVolume(volume);
-        n->setEffectiveVolume(volume);
-        n->setRadius(radius);
-        n->setShapeFactor(shapeFactor);
-        n->setLength(volume / std::pow(radius, 2) * (4 * shapeFactor));
+} // namespace
+
+void statoilNetworkBuilder::importFiles()
+{
+    std::vector<std::string> paths = getSourceFiles();
+    for (const std::string &path : paths)
+        std::cout << "Importing data from " << path << "..." << std::endl;
+
+    //The four files are parsed concurrently
+    statoilNodes nodes;
+    statoilNodesProperties nodesProperties;
+    statoilLinks links;
+    statoilLinksProperties linksProperties;
+
+    auto node2 = std::async(std::launch::async, parseNode2, paths[1], std::ref(nodesProperties));
+    auto link1 = std::async(std::launch::async, parseLink1, paths[2], std::ref(links));
+    auto link2 = std::async(std::launch::async, parseLink2, paths[3], std::ref(linksProperties));
+    std::exception_ptr error;
+    try
+    {
+        parseNode1(paths[0], nodes);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
     }
+    for (std::future<void> *parser : {&node2, &link1, &link2})
+    {
+        try
+        {
+            parser->get();
+        }
+        catch (...)
+        {
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+    if (error)
+        std::rethrow_exception(error);
+
+    if (nodesProperties.values.size() < 3 * size_t(nodes.count))
+        throw std::runtime_error("Missing nodes in " + paths[1] + "\n");
+    if (linksProperties.values.size() < 2 * size_t(links.count))
+        throw std::runtime_error("Missing throats in " + paths[3] + "\n");
 
     signalProgress(20);
+
+    importNodes(nodes, nodesProperties);
+    importLinks(links, linksProperties);
+
+    signalProgress(40);
 }
 
-void statoilNetworkBuilder::importLink1()
+void statoilNetworkBuilder::importNodes(const statoilNodes &nodes, const statoilNodesProperties &properties)
 {
-    std::string filePath = userInput::get().extractedNetworkFolderPath + userInput::get().rockPrefix + "_link1.dat";
-
-    std::cout << "Importing data from " << filePath << "..." << std::endl;
+    network->totalNodes = nodes.count;
+    network->xEdgeLength = nodes.xEdgeLength;
+    network->yEdgeLength = nodes.yEdgeLength;
+    network->zEdgeLength = nodes.zEdgeLength;
+    network->maxConnectionNumber = std::max(network->maxConnectionNumber, nodes.maxConnectionNumber);
+    network->tableOfNodes.resize(nodes.count);
+
+    //The elements are created in the files order so that they stay contiguous in the arena
+    for (int i = 0; i < nodes.count; ++i)
+    {
+        const double *coordinates = &nodes.coordinates[3 * i];
+        network->tableOfNodes[i] = network->createElement<node>(coordinates[0], coordinates[1], coordinates[2]);
+    }
 
-    std::ifstream file(filePath.c_str());
+#pragma omp parallel for
+    for (int i = 0; i < nodes.count; ++i)
+    {
+        node *n = network->tableOfNodes[i].get();
+        n->setInlet(nodes.inlet[i]);
+        n->setOutlet(nodes.outlet[i]);
 
-    file >> network->totalPores;
-    network->tableOfPores.reserve(network->totalPores);
+        double volume = properties.values[3 * i];
+        double radius = properties.values[3 * i + 1];
+        double shapeFactor = properties.values[3 * i + 2];
+        n->setVolume(volume);
+        n->setEffectiveVolume(volume);
+        n->setRadius(radius);
+        n->setShapeFactor(shapeFactor);
+        n->setLength(volume / std::pow(radius, 2) * (4 * shapeFactor));
+    }
+}
 
-    std::string dummy;
-    getline(file, dummy);
+void statoilNetworkBuilder::importLinks(const statoilLinks &links, const statoilLinksProperties &properties)
+{
+    network->totalPores = links.count;
+    network->tableOfPores.resize(links.count);
 
-    for (int i = 0; i < network->totalPores; ++i)
+    for (int i = 0; i < links.count; ++i)
     {
-        int id, nodeIndex1, nodeIndex2;
-        double radius, shapeFactor, poreLength;
-
-        file >> id >> nodeIndex1 >> nodeIndex2 >> radius >> shapeFactor >> poreLength;
+        int nodeIndex1 = links.nodes[2 * i];
+        int nodeIndex2 = links.nodes[2 * i + 1];
 
         node *nodeIn = 0;
         node *nodeOut = 0;
@@ -165,13 +465,20 @@ void statoilNetworkBuilder::importLink1()
             nodeIn = network->getNode(nodeIndex2 - 1);
         }
 
-        network->tableOfPores.push_back(std::make_shared<pore>(nodeIn, nodeOut));
+        network->tableOfPores[i] = network->createElement<pore>(nodeIn, nodeOut);
+    }
 
+#pragma omp parallel for
+    for (int i = 0; i < links.count; ++i)
+    {
         pore *p = network->tableOfPores[i].get();
 
-        p->setRadius(radius);
-        p->setShapeFactor(shapeFactor);
-        p->setLength(poreLength);
+        //the total length of the first file is replaced by the throat length of the second one
+        p->setRadius(links.values[3 * i]);
+        p->setShapeFactor(links.values[3 * i + 1]);
+        p->setLength(properties.values[2 * i]);
+        p->setVolume(properties.values[2 * i + 1]);
+        p->setEffectiveVolume(properties.values[2 * i + 1]);
 
         if (p->getNodeIn() != 0 && p->getNodeOut() != 0)
         {
@@ -179,41 +486,17 @@ void statoilNetworkBuilder::importLink1()
             p->setFullLength(length);
         }
 
-        if (p->getNodeOut() == 0)
-        {
-            p->setInlet(true);
-            network->inletPores.push_back(p);
-        }
-        if (p->getNodeIn() == 0)
-        {
-            p->setOutlet(true);
-            network->outletPores.push_back(p);
-        }
+        p->setInlet(p->getNodeOut() == 0);
+        p->setOutlet(p->getNodeIn() == 0);
     }
-    signalProgress(30);
-}
-
-void statoilNetworkBuilder::importLink2()
-{
-    std::string filePath = userInput::get().extractedNetworkFolderPath + userInput::get().rockPrefix + "_link2.dat";
-
-    std::cout << "Importing data from " << filePath << "..." << std::endl;
-
-    std::ifstream file(filePath.c_str());
 
     for (pore *p : pnmRange<pore>(network))
     {
-        double throatLength, volume;
-        std::string dummy;
-
-        file >> dummy >> dummy >> dummy >> dummy >> dummy >> throatLength >> volume >> dummy;
-
-        p->setLength(throatLength);
-        p->setVolume(volume);
-        p->setEffectiveVolume(volume);
+        if (p->getInlet())
+            network->inletPores.push_back(p);
+        if (p->getOutlet())
+            network->outletPores.push_back(p);
     }
-
-    signalProgress(40);
 }
 
 } // namespace PNM
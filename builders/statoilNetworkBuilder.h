@@ -13,6 +13,11 @@
 namespace PNM
 {
 
+struct statoilNodes;
+struct statoilNodesProperties;
+struct statoilLinks;
+struct statoilLinksProperties;
+
 class statoilNetworkBuilder : public regularNetworkBuilder
 {
     Q_OBJECT
@@ -28,10 +33,12 @@ class statoilNetworkBuilder : public regularNetworkBuilder
 
   protected:
     void initiateNetworkProperties() override;
-    void importNode1();
-    void importNode2();
-    void importLink1();
-    void importLink2();
+    std::vector<std::string> getSourceFiles() const override;
+    bool estimateSize(int &nodes, int &pores, bool &is2D) const override;
+    // The node1, node2, link1 and link2 files are parsed concurrently, then the elements are created from the parsed arrays
+    void importFiles();
+    void importNodes(const statoilNodes &, const statoilNodesProperties &);
+    void importLinks(const statoilLinks &, const statoilLinksProperties &);
 };
 
 } // namespace PNM
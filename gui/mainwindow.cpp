@@ -10,11 +10,16 @@
 #include "builders/networkbuilder.h"
 #include "simulations/simulation.h"
 #include "misc/userInput.h"
+#include "misc/taskScheduler.h"
 
 #include "libs/boost/format.hpp"
 #include "qcustomplot.h"
+#include "plotSource.h"
+
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QTimer>
 
-#include <thread>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -32,6 +37,16 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent),
 
 MainWindow::~MainWindow()
 {
+    //Running jobs are interrupted and joined; their signals are dropped, which also releases a job blocked on a
+    //queued connection to this window
+    PNM::taskScheduler::get().cancelAll();
+    if (builder)
+        disconnect(builder.get(), nullptr, this, nullptr);
+    if (sim)
+        disconnect(sim.get(), nullptr, this, nullptr);
+    QCoreApplication::removePostedEvents(this);
+    PNM::taskScheduler::get().waitAll();
+
     delete ui;
     delete curvesWidget;
 }
@@ -45,7 +60,7 @@ void MainWindow::on_loadNetworkButton_clicked()
     exportNetworkDataFromGUI();
     importNetworkDataFromGUI();
 
-    std::thread([this]() {
+    PNM::taskScheduler::get().launch([this]() {
         builder = PNM::networkBuilder::createBuilder();
 
         connect(builder.get(), SIGNAL(notifyGUI()), this, SLOT(updateNetworkProgressBar()));
@@ -60,8 +75,12 @@ void MainWindow::on_loadNetworkButton_clicked()
             std::cout << "Not enough RAM to load the network.\nAborting.\n\n";
             updateGUIAfterNetworkFailure();
         }
-    })
-        .detach();
+        catch (const std::exception &e)
+        {
+            std::cout << e.what() << "Aborting.\n\n";
+            updateGUIAfterNetworkFailure();
+        }
+    });
 }
 
 void MainWindow::on_twoPhaseSimButton_clicked()
@@ -73,16 +92,14 @@ void MainWindow::on_twoPhaseSimButton_clicked()
     importSimulationDataFromGUI();
     updateGUIBeforeSimulation();
 
-    std::thread([this]() {
-        sim = PNM::simulation::createSimulation();
+    //The simulation publishes its progress, polled by progressTimer: it never waits for the GUI
+    sim = PNM::simulation::createSimulation();
+    sim->setNetwork(network);
+    connect(sim.get(), SIGNAL(finished()), this, SLOT(updateGUIAfterSimulation()));
 
-        sim->setNetwork(network);
-        connect(sim.get(), SIGNAL(notifyGUI()), this, SLOT(updateGUIDuringSimulation()), Qt::BlockingQueuedConnection);
-        connect(sim.get(), SIGNAL(finished()), this, SLOT(updateGUIAfterSimulation()));
-
-        sim->execute();
-    })
-        .detach();
+    std::shared_ptr<PNM::simulation> currentSimulation = sim;
+    PNM::taskScheduler::get().launch([currentSimulation]() { currentSimulation->execute(); },
+                                     [currentSimulation]() { currentSimulation->interrupt(); });
 }
 
 void MainWindow::on_renderNetworkButton_clicked()
@@ -94,16 +111,13 @@ void MainWindow::on_renderNetworkButton_clicked()
     importSimulationDataFromGUI();
     updateGUIBeforeRendering();
 
-    std::thread([this]() {
-        sim = PNM::simulation::createRenderer();
-
-        sim->setNetwork(network);
-        connect(sim.get(), SIGNAL(notifyGUI()), this, SLOT(updateGUIDuringRendering()), Qt::BlockingQueuedConnection);
-        connect(sim.get(), SIGNAL(finished()), this, SLOT(updateGUIAfterRendering()));
+    sim = PNM::simulation::createRenderer();
+    sim->setNetwork(network);
+    connect(sim.get(), SIGNAL(notifyGUI()), this, SLOT(updateGUIDuringRendering()), Qt::BlockingQueuedConnection);
+    connect(sim.get(), SIGNAL(finished()), this, SLOT(updateGUIAfterRendering()));
 
-        sim->execute();
-    })
-        .detach();
+    std::shared_ptr<PNM::simulation> renderer = sim;
+    PNM::taskScheduler::get().launch([renderer]() { renderer->execute(); }, [renderer]() { renderer->interrupt(); });
 }
 
 void MainWindow::exportNetworkDataFromGUI()
@@ -235,6 +249,8 @@ void MainWindow::exportSimulationDataFromGUI()
         solverChoice = 1;
     if (ui->bicstabRadioButton->isChecked())
         solverChoice = 2;
+    if (ui->pcgRadioButton->isChecked())
+        solverChoice = 3;
     settings.setValue("solverChoice", solverChoice);
     settings.endGroup();
 
@@ -284,6 +300,12 @@ void MainWindow::initialiseVariables()
     totalCurves = 0;
     currentlyBusy = false;
     networkBuilt = false;
+
+    progressTimer = std::make_shared<QTimer>();
+    connect(progressTimer.get(), SIGNAL(timeout()), this, SLOT(updateGUIDuringSimulation()));
+
+    plotTimer = std::make_shared<QTimer>();
+    connect(plotTimer.get(), SIGNAL(timeout()), this, SLOT(updatePlots()));
 }
 
 void MainWindow::updateGUIBeforeLoadingNetwork()
@@ -336,10 +358,15 @@ void MainWindow::updateGUIBeforeSimulation()
 
     ui->twoPhaseSimButton->setEnabled(false);
     ui->twoPhaseSimStopButton->setEnabled(true);
+
+    progressTimer->start(progressInterval);
 }
 
 void MainWindow::updateGUIAfterSimulation()
 {
+    progressTimer->stop();
+    updateGUIDuringSimulation();
+
     ui->widget->setSimulationRunnning(false);
 
     ui->simulationProgressBar->setVisible(false);
@@ -352,8 +379,10 @@ void MainWindow::updateGUIAfterSimulation()
 
 void MainWindow::updateGUIDuringSimulation()
 {
-    ui->simulationProgressBar->setValue(sim->getProgress());
-    ui->SimNotif->setText(QString::fromStdString(sim->getNotification()));
+    auto snapshot = sim->getProgressSnapshot();
+    ui->simulationProgressBar->setValue(snapshot->progress);
+    ui->SimNotif->setText(QString::fromStdString(snapshot->notification));
+    ui->widget->setPhasesVersion(snapshot->phasesVersion);
 }
 
 void MainWindow::updateGUIBeforeRendering()
@@ -364,6 +393,10 @@ void MainWindow::updateGUIBeforeRendering()
 
     imageIndex = 0;
 
+    //Frames are streamed to the encoder unless they are kept as images
+    if (!PNM::userInput::get().keepFrames && !ui->widget->startVideoCapture("Videos/video.mp4", PNM::userInput::get().rendererFPS))
+        std::cout << "ERROR: the video encoder could not be started" << std::endl;
+
     ui->renderingProgressBar->setVisible(true);
     ui->renderingProgressBar->setValue(0);
 
@@ -373,6 +406,7 @@ void MainWindow::updateGUIBeforeRendering()
 
 void MainWindow::updateGUIAfterRendering()
 {
+    ui->widget->finishVideoCapture();
     ui->widget->setSimulationRunnning(false);
 
     ui->renderingProgressBar->setVisible(false);
@@ -384,14 +418,24 @@ void MainWindow::updateGUIAfterRendering()
 
 void MainWindow::updateGUIDuringRendering()
 {
-    ui->renderingProgressBar->setValue(sim->getProgress());
-    ui->SimNotif->setText(QString::fromStdString(sim->getNotification()));
+    //Blocking: each loaded state is exported as a video frame
+    auto snapshot = sim->getProgressSnapshot();
+    ui->renderingProgressBar->setValue(snapshot->progress);
+    ui->SimNotif->setText(QString::fromStdString(snapshot->notification));
+    ui->widget->setPhasesVersion(snapshot->phasesVersion);
 
     exportNetworkToImage();
 }
 
 void MainWindow::exportNetworkToImage()
 {
+    if (!PNM::userInput::get().keepFrames)
+    {
+        ui->widget->requestVideoFrame();
+        ui->widget->updateGL();
+        return;
+    }
+
     ui->widget->updateGL();
 
     QImage image = ui->widget->grabFrameBuffer();
@@ -742,55 +786,67 @@ void MainWindow::on_pushButton_3_clicked()
     ui->plotWidget->rescaleAxes();
     ui->plotWidget->replot();
 
+    plotTimer->stop();
+    plottedFiles.clear();
     totalCurves = 0;
 }
 
 void MainWindow::on_plot_clicked()
 {
-    std::ifstream file(ui->fileToPlot->text().toStdString().c_str());
-
-    if (file && totalCurves < 14)
-    {
-        std::string header;
-        std::getline(file, header);
-
-        std::stringstream ss(header);
-        std::istream_iterator<std::string> begin(ss);
-        std::istream_iterator<std::string> end;
-        std::vector<std::string> vstrings(begin, end);
-
-        if (vstrings.size() <= 1)
-            return;
+    //The file is parsed on a worker thread; its curves are added by updatePlots once it is read
+    std::string path = ui->fileToPlot->text().toStdString();
+    if (!QFileInfo(path.c_str()).exists() || totalCurves >= 14)
+        return;
 
-        std::vector<QVector<double>> data;
-        std::vector<QString> dataHeaders;
-        data.resize(vstrings.size());
+    plottedFiles.push_back(plottedFile{std::make_shared<plotSource>(path), -1});
+    plottedFiles.back().source->update();
+    plotTimer->start(plotInterval);
+}
 
-        for (auto &header : vstrings)
-            dataHeaders.push_back(QString::fromStdString((header)));
+void MainWindow::updatePlots()
+{
+    bool changed(false);
+    for (plottedFile &plotted : plottedFiles)
+    {
+        if (!plotted.source->takeUpdate())
+        {
+            plotted.source->update();
+            continue;
+        }
 
-        double value;
-        while (file >> value)
+        const std::vector<std::string> &headers = plotted.source->getHeaders();
+        if (plotted.firstGraph == -1 && headers.size() > 1)
         {
-            data[0].push_back(value);
-            for (unsigned i = 1; i < vstrings.size(); ++i)
+            plotted.firstGraph = totalCurves;
+            for (unsigned i = 1; i < headers.size(); ++i)
             {
-                file >> value;
-                data[i].push_back(value);
+                QPen pen(QtColours[totalCurves % 14]);
+                pen.setWidth(2);
+                ui->plotWidget->addGraph();
+                ui->plotWidget->graph(totalCurves)->setPen(pen);
+                ui->plotWidget->graph(totalCurves)->setName(QString::fromStdString(headers[i]));
+                totalCurves++;
             }
         }
 
-        for (unsigned i = 1; i < vstrings.size(); ++i)
+        //Curves decimated to the plot width, in pixels
+        if (plotted.firstGraph != -1)
         {
-            QPen pen(QtColours[totalCurves]);
-            pen.setWidth(2);
-            ui->plotWidget->addGraph();
-            ui->plotWidget->graph(totalCurves)->setPen(pen);
-            ui->plotWidget->graph(totalCurves)->setName(dataHeaders[i]);
-            ui->plotWidget->graph(totalCurves)->setData(data[0], data[i]);
-            ui->plotWidget->rescaleAxes();
-            totalCurves++;
+            QVector<double> keys, values;
+            for (unsigned i = 1; i < headers.size(); ++i)
+            {
+                plotted.source->decimate(i, ui->plotWidget->axisRect()->width(), keys, values);
+                ui->plotWidget->graph(plotted.firstGraph + i - 1)->setData(keys, values);
+            }
+            changed = true;
         }
+
+        plotted.source->update();
+    }
+
+    if (changed)
+    {
+        ui->plotWidget->rescaleAxes();
         ui->plotWidget->replot();
     }
 }
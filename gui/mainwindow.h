@@ -10,6 +10,7 @@
 
 #include <QMainWindow>
 #include <memory>
+#include <vector>
 
 namespace Ui
 {
@@ -24,6 +25,8 @@ class simulation;
 } // namespace PNM
 
 class QCPPlotTitle;
+class QTimer;
+class plotSource;
 
 class MainWindow : public QMainWindow
 {
@@ -47,6 +50,17 @@ private:
   std::shared_ptr<PNM::networkModel> network;
   std::shared_ptr<PNM::networkBuilder> builder;
   std::shared_ptr<PNM::simulation> sim;
+  std::shared_ptr<QTimer> progressTimer; // polls the simulation progress
+  static const int progressInterval = 33; // ms
+  // plotted results files, followed while they grow; their curves start at firstGraph
+  struct plottedFile
+  {
+    std::shared_ptr<plotSource> source;
+    int firstGraph;
+  };
+  std::vector<plottedFile> plottedFiles;
+  std::shared_ptr<QTimer> plotTimer;
+  static const int plotInterval = 250; // ms
   int imageIndex;
   int totalCurves;
   bool currentlyBusy;
@@ -68,6 +82,7 @@ private slots:
   void updateGUIAfterRendering();
   void updateGUIDuringRendering();
   void exportNetworkToImage();
+  void updatePlots();
   void on_loadNetworkButton_clicked();
   void on_twoPhaseSimButton_clicked();
   void on_twoPhaseSimStopButton_clicked();
@@ -0,0 +1,181 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "plotSource.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QFileInfo>
+
+#include <cstring>
+#include <limits>
+
+namespace
+{
+
+void splitLine(const char *begin, const char *end, std::vector<const char *> &fields, std::vector<const char *> &fieldEnds)
+{
+    fields.clear();
+    fieldEnds.clear();
+    const char *c = begin;
+    while (true)
+    {
+        while (c < end && (*c == ' ' || *c == '\t' || *c == '\r'))
+            ++c;
+        if (c == end)
+            return;
+        fields.push_back(c);
+        while (c < end && *c != ' ' && *c != '\t' && *c != '\r')
+            ++c;
+        fieldEnds.push_back(c);
+    }
+}
+
+} // namespace
+
+plotSource::plotSource(const std::string &path) : path(path), parsedBytes(0)
+{
+}
+
+plotSource::~plotSource()
+{
+    if (pendingUpdate.valid())
+        pendingUpdate.wait();
+}
+
+void plotSource::update()
+{
+    //A single parse at a time, started only if the file changed size
+    if (pendingUpdate.valid())
+        return;
+
+    QFileInfo info(path.c_str());
+    if (!info.exists() || info.size() == parsedBytes)
+        return;
+
+    pendingUpdate = std::async(std::launch::async, &plotSource::parse, this);
+}
+
+bool plotSource::takeUpdate()
+{
+    if (!pendingUpdate.valid() || pendingUpdate.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return false;
+    return pendingUpdate.get();
+}
+
+const std::vector<std::string> &plotSource::getHeaders() const
+{
+    return headers;
+}
+
+void plotSource::decimate(unsigned column, int buckets, QVector<double> &keys, QVector<double> &values) const
+{
+    keys.clear();
+    values.clear();
+    if (column >= columns.size() || columns[0].empty())
+        return;
+
+    const std::vector<double> &x = columns[0], &y = columns[column];
+    int rows = x.size();
+    buckets = std::max(buckets, 1);
+
+    if (rows <= 2 * buckets)
+    {
+        keys.reserve(rows);
+        values.reserve(rows);
+        for (int i = 0; i < rows; ++i)
+        {
+            keys.push_back(x[i]);
+            values.push_back(y[i]);
+        }
+        return;
+    }
+
+    keys.reserve(2 * buckets);
+    values.reserve(2 * buckets);
+    for (int bucket = 0; bucket < buckets; ++bucket)
+    {
+        int first = int((long long)rows * bucket / buckets), last = int((long long)rows * (bucket + 1) / buckets);
+        int lowest(first), highest(first);
+        for (int i = first + 1; i < last; ++i)
+        {
+            if (y[i] < y[lowest])
+                lowest = i;
+            if (y[i] > y[highest])
+                highest = i;
+        }
+
+        //Both extremes, in the rows order
+        for (int i : {std::min(lowest, highest), std::max(lowest, highest)})
+        {
+            keys.push_back(x[i]);
+            values.push_back(y[i]);
+            if (lowest == highest)
+                break;
+        }
+    }
+}
+
+bool plotSource::parse()
+{
+    QFile file(path.c_str());
+    if (!file.open(QFile::ReadOnly))
+        return false;
+
+    //A shorter file was rewritten: it is parsed again from the start
+    long long size = file.size();
+    if (size < parsedBytes)
+    {
+        headers.clear();
+        columns.clear();
+        parsedBytes = 0;
+    }
+    if (size == parsedBytes)
+        return false;
+
+    const char *data = reinterpret_cast<const char *>(file.map(parsedBytes, size - parsedBytes));
+    if (!data)
+        return false;
+
+    //Only complete lines are parsed; a line being written is left for the next update
+    const char *end = data + (size - parsedBytes);
+    while (end > data && end[-1] != '\n')
+        --end;
+
+    std::vector<const char *> fields, fieldEnds;
+    bool appended(headers.empty());
+    const char *line = data;
+    while (line < end)
+    {
+        const char *lineEnd = static_cast<const char *>(std::memchr(line, '\n', end - line));
+        splitLine(line, lineEnd, fields, fieldEnds);
+
+        if (headers.empty())
+        {
+            for (unsigned k = 0; k < fields.size(); ++k)
+                headers.push_back(std::string(fields[k], fieldEnds[k]));
+            columns.resize(headers.size());
+        }
+        else if (fields.size() == headers.size())
+        {
+            //Numbers are read independently of the GUI locale; unreadable values are left as gaps
+            for (unsigned k = 0; k < fields.size(); ++k)
+            {
+                bool valid(false);
+                double value = QByteArray::fromRawData(fields[k], fieldEnds[k] - fields[k]).toDouble(&valid);
+                columns[k].push_back(valid ? value : std::numeric_limits<double>::quiet_NaN());
+            }
+            appended = true;
+        }
+
+        line = lineEnd + 1;
+    }
+
+    parsedBytes += end - data;
+    file.unmap(reinterpret_cast<unsigned char *>(const_cast<char *>(data)));
+    return appended;
+}
@@ -0,0 +1,47 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef PLOTSOURCE_H
+#define PLOTSOURCE_H
+
+#include <QVector>
+
+#include <future>
+#include <string>
+#include <vector>
+
+// Columns of a results file (a header line, then whitespace separated values), parsed from a memory mapping on a
+// worker thread. Each update only parses the complete lines appended since the previous one, so that the files of a
+// running simulation can be followed. The columns are only read once takeUpdate() has returned true.
+class plotSource
+{
+public:
+  plotSource(const std::string &path);
+  ~plotSource();
+  plotSource(const plotSource &) = delete;
+  plotSource(plotSource &&) = delete;
+  auto operator=(const plotSource &) -> plotSource & = delete;
+  auto operator=(plotSource &&) -> plotSource & = delete;
+
+  void update();
+  bool takeUpdate();
+
+  const std::vector<std::string> &getHeaders() const;
+  // Min/max decimation of a column against the first one: each bucket of consecutive rows keeps its extreme values
+  void decimate(unsigned column, int buckets, QVector<double> &keys, QVector<double> &values) const;
+
+protected:
+  bool parse();
+
+  std::string path;
+  std::vector<std::string> headers;
+  std::vector<std::vector<double>> columns;
+  long long parsedBytes;
+  std::future<bool> pendingUpdate;
+};
+
+#endif // PLOTSOURCE_H
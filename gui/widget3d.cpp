@@ -10,6 +10,9 @@
 #include "network/iterator.h"
 #include "misc/userInput.h"
 #include "misc/tools.h"
+#include "misc/videoEncoder.h"
+#include "misc/memoryFootprint.h"
+#include "misc/scopedtimer.h"
 
 #include <QApplication>
 #include <QMouseEvent>
@@ -17,9 +20,44 @@
 
 #include <libs/glm/glm.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 using namespace PNM;
 using namespace std;
 
+namespace
+{
+
+// Visibility flags of an element, packed in its dynamic data: the shaders hide the elements matching the hidden flags
+const int oilFlag = 1, waterFlag = 2, invalidFlag = 4, waterWetFlag = 8, oilWetFlag = 16;
+
+float getVisibilityFlags(element *e)
+{
+    int flags(0);
+    if (e->getPhaseFlag() == phase::oil || e->getPhaseFlag() == phase::temp)
+        flags |= oilFlag;
+    if (e->getPhaseFlag() == phase::water)
+        flags |= waterFlag;
+    if (e->getPhaseFlag() == phase::invalid)
+        flags |= invalidFlag;
+    if (e->getWettabilityFlag() == wettability::waterWet)
+        flags |= waterWetFlag;
+    if (e->getWettabilityFlag() == wettability::oilWet)
+        flags |= oilWetFlag;
+    return float(flags);
+}
+
+// Spatial chunks: about chunkSize elements each, up to maxChunksPerSide chunks along each axis
+const double chunkSize = 4096;
+const int maxChunksPerSide = 32;
+
+// Level of detail thresholds, on the projected radii (in pixels) of the largest elements of a chunk
+const float minimumSpherePixels = 0.5f;   // smaller spheres are skipped
+const float minimumCylinderPixels = 1.5f; // thinner cylinders are drawn as lines
+
+} // namespace
+
 widget3d::widget3d(QWidget *parent)
     : QGLWidget(QGLFormat(QGL::SampleBuffers), parent)
 {
@@ -28,6 +66,8 @@ widget3d::widget3d(QWidget *parent)
     networkBuilt = false;
     simulationRunnning = false;
     refreshRequested = false;
+    linesOutdated = true;
+    videoFrameRequested = false;
     buffersAllocated = false;
     poreBodies = true;
     poreLines = true;
@@ -48,6 +88,9 @@ widget3d::widget3d(QWidget *parent)
     tracerColor = glm::vec3(0.65f, 0.95f, 0.15f);
 
     sphereCount = cylinderCount = lineCount = 0;
+    viewportWidth = viewportHeight = 1;
+    captureWidth = captureHeight = capturedFrames = 0;
+    phasesVersion = 0;
 
     timer = std::make_shared<QTimer>();
     connect(timer.get(), SIGNAL(timeout()), this, SLOT(timerUpdate()));
@@ -103,13 +146,32 @@ void widget3d::allocateBufferOnGPU(GLuint buffer, const unsigned count, GLenum t
 }
 
 template <typename T>
-void widget3d::uploadDataToGPU(GLuint buffer, std::vector<T> h_data, const unsigned count, GLenum target)
+void widget3d::uploadDataToGPU(GLuint buffer, const std::vector<T> &h_data, const unsigned count, GLenum target)
 {
+    uploadDataToGPU(buffer, h_data, 0, count, target);
+}
+
+template <typename T>
+void widget3d::uploadDataToGPU(GLuint buffer, const std::vector<T> &h_data, const unsigned first, const unsigned last, GLenum target)
+{
+    if (first >= last)
+        return;
     glBindBuffer(target, buffer);
-    glBufferSubData(target, 0, count * sizeof(T), (const void *)&h_data[0]);
+    glBufferSubData(target, first * sizeof(T), (last - first) * sizeof(T), (const void *)&h_data[first]);
     glBindBuffer(target, 0);
 }
 
+template <typename T>
+void widget3d::updateValue(std::vector<T> &h_data, const unsigned index, const T value, unsigned &firstChanged, unsigned &lastChanged)
+{
+    //Grows the changed range of the buffer, which is the only part uploaded again
+    if (h_data[index] == value)
+        return;
+    h_data[index] = value;
+    firstChanged = std::min(firstChanged, index);
+    lastChanged = std::max(lastChanged, index + 1);
+}
+
 void widget3d::initialiseDataBuffers()
 {
     //spheres
@@ -118,13 +180,13 @@ void widget3d::initialiseDataBuffers()
     staticSphereBuffer.clear();
     staticSphereBuffer.resize(4 * sphereCount);
     dynamicSphereBuffer.clear();
-    dynamicSphereBuffer.resize(2 * sphereCount);
+    dynamicSphereBuffer.resize(3 * sphereCount);
     sphereIndicesBuffer.clear();
     sphereIndicesBuffer.resize(sphereCount);
 
     allocateBufferOnGPU<GLfloat>(staticSphereVBO, 4 * sphereCount, GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-    allocateBufferOnGPU<GLfloat>(dynamicSphereVBO, 2 * sphereCount, GL_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
-    allocateBufferOnGPU<GLint>(sphereIndicesVBO, sphereCount, GL_ELEMENT_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
+    allocateBufferOnGPU<GLfloat>(dynamicSphereVBO, 3 * sphereCount, GL_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
+    allocateBufferOnGPU<GLint>(sphereIndicesVBO, sphereCount, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
 
     //cylinders
 
@@ -137,33 +199,42 @@ void widget3d::initialiseDataBuffers()
     cylinderIndicesBuffer.resize(cylinderCount);
 
     allocateBufferOnGPU<GLfloat>(staticCylinderVBO, 8 * cylinderCount, GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-    allocateBufferOnGPU<GLfloat>(dynamicCylinderVBO, 2 * cylinderCount, GL_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
-    allocateBufferOnGPU<GLint>(cylinderIndicesVBO, cylinderCount, GL_ELEMENT_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
+    allocateBufferOnGPU<GLfloat>(dynamicCylinderVBO, 3 * cylinderCount, GL_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
+    allocateBufferOnGPU<GLint>(cylinderIndicesVBO, cylinderCount, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
 
     //lines
 
     int lineCount = network->totalPores;
     staticLineBuffer.clear();
-    staticLineBuffer.resize(2 * 3 * lineCount);
+    staticLineBuffer.resize(2 * 6 * lineCount);
     dynamicLineBuffer.clear();
-    dynamicLineBuffer.resize(2 * 2 * lineCount);
+    dynamicLineBuffer.resize(2 * 3 * lineCount);
     lineIndicesBuffer.clear();
     lineIndicesBuffer.resize(2 * lineCount);
 
-    allocateBufferOnGPU<GLfloat>(staticLineVBO, 2 * 3 * lineCount, GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-    allocateBufferOnGPU<GLfloat>(dynamicLineVBO, 2 * 2 * lineCount, GL_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
-    allocateBufferOnGPU<GLint>(lineIndicesVBO, 2 * lineCount, GL_ELEMENT_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
+    allocateBufferOnGPU<GLfloat>(staticLineVBO, 2 * 6 * lineCount, GL_ARRAY_BUFFER, GL_STATIC_DRAW);
+    allocateBufferOnGPU<GLfloat>(dynamicLineVBO, 2 * 3 * lineCount, GL_ARRAY_BUFFER, GL_DYNAMIC_DRAW);
+    allocateBufferOnGPU<GLint>(lineIndicesVBO, 2 * lineCount, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
 
-    // initialise buffers
+    // initialise buffers: the indices are static, the visibility filters being applied by the shaders
 
     bufferSphereStaticData();
-    bufferSphereDynamicData();
+    bufferSphereDynamicData(true);
 
     bufferCylinderStaticData();
-    bufferCylinderDynamicData();
+    bufferCylinderDynamicData(true);
 
     bufferLineStaticData();
-    bufferLineDynamicData();
+    bufferLineDynamicData(true);
+    linesOutdated = false;
+
+    buildRenderChunks();
+
+    //Host buffers, mirrored by the GPU buffers
+    size_t buffers = memoryFootprint::of(staticSphereBuffer) + memoryFootprint::of(dynamicSphereBuffer) + memoryFootprint::of(sphereIndicesBuffer) +
+                     memoryFootprint::of(staticCylinderBuffer) + memoryFootprint::of(dynamicCylinderBuffer) + memoryFootprint::of(cylinderIndicesBuffer) +
+                     memoryFootprint::of(staticLineBuffer) + memoryFootprint::of(dynamicLineBuffer) + memoryFootprint::of(lineIndicesBuffer);
+    PROFILE_COUNTER("memory.guiBuffers(MB)", memoryFootprint::toMB(buffers));
 
     buffersAllocated = true;
 }
@@ -187,41 +258,24 @@ void widget3d::bufferSphereStaticData()
     uploadDataToGPU(staticSphereVBO, staticSphereBuffer, 4 * network->totalNodes, GL_ARRAY_BUFFER);
 }
 
-void widget3d::bufferSphereDynamicData()
+void widget3d::bufferSphereDynamicData(bool wholeBuffer)
 {
     unsigned indexDynamic(0);
+    unsigned firstChanged(wholeBuffer ? 0 : dynamicSphereBuffer.size()), lastChanged(wholeBuffer ? dynamicSphereBuffer.size() : 0);
 
     for (node *p : pnmRange<node>(network))
     {
         // color data
         float colorKey = p->getPhaseFlag() == phase::oil || p->getPhaseFlag() == phase::temp ? 0 : 1;
-        dynamicSphereBuffer[indexDynamic] = colorKey;
-        dynamicSphereBuffer[indexDynamic + 1] = float(p->getConcentration());
+        updateValue(dynamicSphereBuffer, indexDynamic, colorKey, firstChanged, lastChanged);
+        updateValue(dynamicSphereBuffer, indexDynamic + 1, float(p->getConcentration()), firstChanged, lastChanged);
+        updateValue(dynamicSphereBuffer, indexDynamic + 2, getVisibilityFlags(p), firstChanged, lastChanged);
 
         // update indices
-        indexDynamic += 2;
+        indexDynamic += 3;
     }
 
-    uploadDataToGPU(dynamicSphereVBO, dynamicSphereBuffer, 2 * network->totalNodes, GL_ARRAY_BUFFER);
-}
-
-void widget3d::bufferSphereIndicesData()
-{
-    unsigned index(0);
-
-    for (node *p : pnmRange<node>(network))
-    {
-        if ((p->getPhaseFlag() == phase::invalid) || (p->getPhaseFlag() == phase::oil && !oilVisible) || (p->getPhaseFlag() == phase::temp && !oilVisible) || (p->getPhaseFlag() == phase::water && !waterVisible) || (p->getWettabilityFlag() == wettability::waterWet && !waterWetVisible) || (p->getWettabilityFlag() == wettability::oilWet && !oilWetVisible) || (cutX && p->getXCoordinate() > cutXValue * network->xEdgeLength) || (cutY && p->getYCoordinate() > cutYValue * network->yEdgeLength) || (cutZ && p->getZCoordinate() > cutZValue * network->zEdgeLength))
-            continue;
-
-        sphereIndicesBuffer[index++] = p->getId() - 1;
-    }
-
-    if (index != 0)
-    {
-        sphereCount = index;
-        uploadDataToGPU(sphereIndicesVBO, sphereIndicesBuffer, index, GL_ELEMENT_ARRAY_BUFFER);
-    }
+    uploadDataToGPU(dynamicSphereVBO, dynamicSphereBuffer, firstChanged, lastChanged, GL_ARRAY_BUFFER);
 }
 
 void widget3d::bufferCylinderStaticData()
@@ -261,47 +315,29 @@ void widget3d::bufferCylinderStaticData()
     uploadDataToGPU(staticCylinderVBO, staticCylinderBuffer, 8 * network->totalPores, GL_ARRAY_BUFFER);
 }
 
-void widget3d::bufferCylinderDynamicData()
+void widget3d::bufferCylinderDynamicData(bool wholeBuffer)
 {
     unsigned indexDynamic(0);
+    unsigned firstChanged(wholeBuffer ? 0 : dynamicCylinderBuffer.size()), lastChanged(wholeBuffer ? dynamicCylinderBuffer.size() : 0);
 
     for (pore *p : pnmRange<pore>(network))
     {
         if (p->getInlet() || p->getOutlet())
         {
-            indexDynamic += 2;
+            indexDynamic += 3;
             continue;
         }
 
         // color data
         float colorKey = p->getPhaseFlag() == phase::oil || p->getPhaseFlag() == phase::temp ? 0 : 1;
-        dynamicCylinderBuffer[indexDynamic] = colorKey;
-        dynamicCylinderBuffer[indexDynamic + 1] = p->getConcentration();
+        updateValue(dynamicCylinderBuffer, indexDynamic, colorKey, firstChanged, lastChanged);
+        updateValue(dynamicCylinderBuffer, indexDynamic + 1, float(p->getConcentration()), firstChanged, lastChanged);
+        updateValue(dynamicCylinderBuffer, indexDynamic + 2, getVisibilityFlags(p), firstChanged, lastChanged);
 
-        indexDynamic += 2;
+        indexDynamic += 3;
     }
 
-    uploadDataToGPU(dynamicCylinderVBO, dynamicCylinderBuffer, 2 * network->totalPores, GL_ARRAY_BUFFER);
-}
-
-void widget3d::bufferCylinderIndicesData()
-{
-    unsigned index(0);
-
-    for (pore *p : pnmRange<pore>(network))
-    {
-        if ((p->getInlet() || p->getOutlet()) || (p->getPhaseFlag() == phase::invalid) || (p->getPhaseFlag() == phase::oil && !oilVisible) || (p->getPhaseFlag() == phase::temp && !oilVisible) || (p->getPhaseFlag() == phase::water && !waterVisible) || (p->getWettabilityFlag() == wettability::waterWet && !waterWetVisible) || (p->getWettabilityFlag() == wettability::oilWet && !oilWetVisible) || (cutX && p->getNodeIn()->getXCoordinate() > cutXValue * network->xEdgeLength) || (cutY && p->getNodeIn()->getYCoordinate() > cutYValue * network->yEdgeLength) || (cutZ && p->getNodeIn()->getZCoordinate() > cutZValue * network->zEdgeLength))
-            continue;
-
-        cylinderIndicesBuffer[index] = p->getId() - 1;
-        index++;
-    }
-
-    if (index != 0)
-    {
-        cylinderCount = index;
-        uploadDataToGPU(cylinderIndicesVBO, cylinderIndicesBuffer, index, GL_ELEMENT_ARRAY_BUFFER);
-    }
+    uploadDataToGPU(dynamicCylinderVBO, dynamicCylinderBuffer, firstChanged, lastChanged, GL_ARRAY_BUFFER);
 }
 
 void widget3d::bufferLineStaticData()
@@ -312,7 +348,7 @@ void widget3d::bufferLineStaticData()
     {
         if (p->getInlet() || p->getOutlet())
         {
-            indexStatic += 6;
+            indexStatic += 12;
             continue;
         }
 
@@ -322,63 +358,225 @@ void widget3d::bufferLineStaticData()
         staticLineBuffer[indexStatic + 2] = (p->getNodeIn()->getZCoordinate()) / aspect; // vertex.z
 
         // node2
-        staticLineBuffer[indexStatic + 3] = (p->getNodeOut()->getXCoordinate()) / aspect; // vertex.x
-        staticLineBuffer[indexStatic + 4] = (p->getNodeOut()->getYCoordinate()) / aspect; // vertex.y
-        staticLineBuffer[indexStatic + 5] = (p->getNodeOut()->getZCoordinate()) / aspect; // vertex.z
+        staticLineBuffer[indexStatic + 6] = (p->getNodeOut()->getXCoordinate()) / aspect; // vertex.x
+        staticLineBuffer[indexStatic + 7] = (p->getNodeOut()->getYCoordinate()) / aspect; // vertex.y
+        staticLineBuffer[indexStatic + 8] = (p->getNodeOut()->getZCoordinate()) / aspect; // vertex.z
 
-        indexStatic += 6;
+        // throat center, compared to the cut planes
+        for (unsigned vertex : {indexStatic, indexStatic + 6})
+        {
+            staticLineBuffer[vertex + 3] = p->getXCoordinate() / aspect;
+            staticLineBuffer[vertex + 4] = p->getYCoordinate() / aspect;
+            staticLineBuffer[vertex + 5] = p->getZCoordinate() / aspect;
+        }
+
+        indexStatic += 12;
     }
 
-    uploadDataToGPU(staticLineVBO, staticLineBuffer, 2 * 3 * network->totalPores, GL_ARRAY_BUFFER);
+    uploadDataToGPU(staticLineVBO, staticLineBuffer, 2 * 6 * network->totalPores, GL_ARRAY_BUFFER);
 }
 
-void widget3d::bufferLineDynamicData()
+void widget3d::bufferLineDynamicData(bool wholeBuffer)
 {
     unsigned indexDynamic(0);
+    unsigned firstChanged(wholeBuffer ? 0 : dynamicLineBuffer.size()), lastChanged(wholeBuffer ? dynamicLineBuffer.size() : 0);
 
     for (pore *p : pnmRange<pore>(network))
     {
         if (p->getInlet() || p->getOutlet())
         {
-            indexDynamic += 4;
+            indexDynamic += 6;
             continue;
         }
 
         // color data
         float colorKey = p->getPhaseFlag() == phase::oil || p->getPhaseFlag() == phase::temp ? 0 : 1;
+        float flags = getVisibilityFlags(p);
 
-        // node1
-        dynamicLineBuffer[indexDynamic] = colorKey;
-        dynamicLineBuffer[indexDynamic + 1] = p->getConcentration();
-
-        // node2
-        dynamicLineBuffer[indexDynamic + 2] = colorKey;
-        dynamicLineBuffer[indexDynamic + 3] = p->getConcentration();
+        // node1 then node2
+        for (unsigned vertex : {indexDynamic, indexDynamic + 3})
+        {
+            updateValue(dynamicLineBuffer, vertex, colorKey, firstChanged, lastChanged);
+            updateValue(dynamicLineBuffer, vertex + 1, float(p->getConcentration()), firstChanged, lastChanged);
+            updateValue(dynamicLineBuffer, vertex + 2, flags, firstChanged, lastChanged);
+        }
 
-        indexDynamic += 4;
+        indexDynamic += 6;
     }
 
-    uploadDataToGPU(dynamicLineVBO, dynamicLineBuffer, 2 * 2 * network->totalPores, GL_ARRAY_BUFFER);
+    uploadDataToGPU(dynamicLineVBO, dynamicLineBuffer, firstChanged, lastChanged, GL_ARRAY_BUFFER);
 }
 
-void widget3d::bufferLinesIndicesData()
+void widget3d::buildRenderChunks()
 {
-    unsigned index(0);
+    //Uniform grid over the network box; nodes are assigned by position, pores by the middle of their nodes
+    int side = int(std::cbrt((network->totalNodes + network->totalPores) / chunkSize));
+    side = std::max(1, std::min(maxChunksPerSide, side));
+
+    glm::vec3 boxSize(float(network->xEdgeLength / aspect), float(network->yEdgeLength / aspect), float(network->zEdgeLength / aspect));
+    auto getChunk = [&](const glm::vec3 &position) {
+        int chunkIndex(0);
+        for (int axis = 2; axis >= 0; --axis)
+        {
+            int cell = boxSize[axis] > 0 ? int(position[axis] / boxSize[axis] * side) : 0;
+            chunkIndex = chunkIndex * side + std::max(0, std::min(side - 1, cell));
+        }
+        return chunkIndex;
+    };
+    auto getPosition = [this](node *n) {
+        return glm::vec3(float(n->getXCoordinate() / aspect), float(n->getYCoordinate() / aspect), float(n->getZCoordinate() / aspect));
+    };
+
+    renderChunk emptyChunk = {glm::vec3(1e30f), glm::vec3(-1e30f), 0, 0, 0, 0, 0, 0};
+    chunks.assign(side * side * side, emptyChunk);
+
+    std::vector<int> nodesChunk, poresChunk;
+    nodesChunk.reserve(network->totalNodes);
+    poresChunk.reserve(network->totalPores);
+
+    for (node *n : pnmRange<node>(network))
+    {
+        glm::vec3 position = getPosition(n);
+        float radius = float(n->getRadius() / aspect);
+        int chunkIndex = getChunk(position);
+        renderChunk &chunk = chunks[chunkIndex];
+        chunk.lowerCorner = glm::min(chunk.lowerCorner, position - radius);
+        chunk.upperCorner = glm::max(chunk.upperCorner, position + radius);
+        chunk.maxNodeRadius = std::max(chunk.maxNodeRadius, radius);
+        chunk.nodesCount++;
+        nodesChunk.push_back(chunkIndex);
+    }
 
     for (pore *p : pnmRange<pore>(network))
     {
-        if ((p->getInlet() || p->getOutlet()) || (p->getPhaseFlag() == phase::invalid) || (p->getPhaseFlag() == phase::oil && !oilVisible) || (p->getPhaseFlag() == phase::temp && !oilVisible) || (p->getPhaseFlag() == phase::water && !waterVisible) || (p->getWettabilityFlag() == wettability::waterWet && !waterWetVisible) || (p->getWettabilityFlag() == wettability::oilWet && !oilWetVisible) || (cutX && p->getXCoordinate() > cutXValue * network->xEdgeLength) || (cutY && p->getYCoordinate() > cutYValue * network->yEdgeLength) || (cutZ && p->getZCoordinate() > cutZValue * network->zEdgeLength))
+        if (p->getInlet() || p->getOutlet())
+        {
+            poresChunk.push_back(-1);
             continue;
+        }
+        glm::vec3 nodeIn = getPosition(p->getNodeIn()), nodeOut = getPosition(p->getNodeOut());
+        float radius = float(p->getRadius() / aspect);
+        int chunkIndex = getChunk(0.5f * (nodeIn + nodeOut));
+        renderChunk &chunk = chunks[chunkIndex];
+        chunk.lowerCorner = glm::min(chunk.lowerCorner, glm::min(nodeIn, nodeOut) - radius);
+        chunk.upperCorner = glm::max(chunk.upperCorner, glm::max(nodeIn, nodeOut) + radius);
+        chunk.maxPoreRadius = std::max(chunk.maxPoreRadius, radius);
+        chunk.poresCount++;
+        poresChunk.push_back(chunkIndex);
+    }
 
-        lineIndicesBuffer[index] = 2 * (p->getId() - 1);
-        lineIndicesBuffer[index + 1] = 2 * (p->getId() - 1) + 1;
-        index += 2;
+    //Index buffers sorted by chunk
+    std::vector<GLint> nextNode(chunks.size()), nextPore(chunks.size());
+    GLint firstNode(0), firstPore(0);
+    for (unsigned i = 0; i < chunks.size(); ++i)
+    {
+        chunks[i].firstNode = nextNode[i] = firstNode;
+        chunks[i].firstPore = nextPore[i] = firstPore;
+        firstNode += chunks[i].nodesCount;
+        firstPore += chunks[i].poresCount;
     }
 
-    if (index != 0)
+    for (unsigned i = 0; i < nodesChunk.size(); ++i)
+        sphereIndicesBuffer[nextNode[nodesChunk[i]]++] = i;
+
+    for (unsigned i = 0; i < poresChunk.size(); ++i)
     {
-        lineCount = index;
-        uploadDataToGPU(lineIndicesVBO, lineIndicesBuffer, index, GL_ELEMENT_ARRAY_BUFFER);
+        if (poresChunk[i] == -1)
+            continue;
+        GLint index = nextPore[poresChunk[i]]++;
+        cylinderIndicesBuffer[index] = i;
+        lineIndicesBuffer[2 * index] = 2 * i;
+        lineIndicesBuffer[2 * index + 1] = 2 * i + 1;
+    }
+
+    sphereCount = firstNode;
+    cylinderCount = firstPore;
+    lineCount = 2 * firstPore;
+
+    uploadDataToGPU(sphereIndicesVBO, sphereIndicesBuffer, sphereCount, GL_ELEMENT_ARRAY_BUFFER);
+    uploadDataToGPU(cylinderIndicesVBO, cylinderIndicesBuffer, cylinderCount, GL_ELEMENT_ARRAY_BUFFER);
+    uploadDataToGPU(lineIndicesVBO, lineIndicesBuffer, lineCount, GL_ELEMENT_ARRAY_BUFFER);
+}
+
+void widget3d::drawRanges::clear()
+{
+    counts.clear();
+    offsets.clear();
+}
+
+void widget3d::drawRanges::add(GLint first, GLsizei count)
+{
+    if (count == 0)
+        return;
+
+    //Contiguous ranges are merged
+    if (!counts.empty() && first == end)
+        counts.back() += count;
+    else
+    {
+        counts.push_back(count);
+        offsets.push_back((const GLvoid *)(first * sizeof(GLint)));
+    }
+    end = first + count;
+}
+
+void widget3d::updateDrawRanges()
+{
+    sphereRanges.clear();
+    cylinderRanges.clear();
+    lineRanges.clear();
+    lodLineRanges.clear();
+
+    //Frustum planes, extracted from the rows of the projection * view matrix
+    glm::mat4 networkView = getNetworkView();
+    glm::mat4 viewProjection = projection * networkView;
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i)
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    glm::vec4 planes[6] = {rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2]};
+
+    glm::vec3 eye = glm::vec3(inverse(networkView) * glm::vec4(0.0, 0.0, 0.0, 1.0));
+    glm::vec3 cutPlanes(cutX ? float(cutXValue * network->xEdgeLength / aspect) : 1e30f,
+                        cutY ? float(cutYValue * network->yEdgeLength / aspect) : 1e30f,
+                        cutZ ? float(cutZValue * network->zEdgeLength / aspect) : 1e30f);
+    float pixelsPerUnit = projection[1][1] * viewportHeight / 2;
+
+    for (const renderChunk &chunk : chunks)
+    {
+        if (chunk.nodesCount + chunk.poresCount == 0)
+            continue;
+
+        //Chunks entirely beyond a cut plane, or out of the frustum
+        if (glm::any(glm::greaterThan(chunk.lowerCorner, cutPlanes)))
+            continue;
+
+        bool outside(false);
+        for (const glm::vec4 &plane : planes)
+        {
+            glm::vec3 farthest(plane.x > 0 ? chunk.upperCorner.x : chunk.lowerCorner.x,
+                               plane.y > 0 ? chunk.upperCorner.y : chunk.lowerCorner.y,
+                               plane.z > 0 ? chunk.upperCorner.z : chunk.lowerCorner.z);
+            if (glm::dot(glm::vec3(plane), farthest) + plane.w < 0)
+            {
+                outside = true;
+                break;
+            }
+        }
+        if (outside)
+            continue;
+
+        //Projected radii of the largest elements, at the chunk point closest to the camera
+        float distance = glm::length(eye - glm::clamp(eye, chunk.lowerCorner, chunk.upperCorner));
+        float pixels = pixelsPerUnit / std::max(distance, 1e-6f);
+
+        if (chunk.maxNodeRadius * pixels >= minimumSpherePixels)
+            sphereRanges.add(chunk.firstNode, chunk.nodesCount);
+
+        lineRanges.add(2 * chunk.firstPore, 2 * chunk.poresCount);
+        if (chunk.maxPoreRadius * pixels >= minimumCylinderPixels)
+            cylinderRanges.add(chunk.firstPore, chunk.poresCount);
+        else
+            lodLineRanges.add(2 * chunk.firstPore, 2 * chunk.poresCount);
     }
 }
 
@@ -447,16 +645,22 @@ void widget3d::bufferAxesData()
     uploadDataToGPU(axesVBO, axesBuffer, 10 * 3, GL_ARRAY_BUFFER);
 }
 
+glm::mat4 widget3d::getNetworkView() const
+{
+    glm::mat4 networkView;
+    networkView = glm::translate(networkView, glm::vec3(0.0f, 0.0f, float(scale)));
+    networkView = glm::translate(networkView, glm::vec3(0.0f + xTran, 0.0f + yTran, -2.5f));
+    networkView = glm::rotate(networkView, float(xInitRot + xRot), glm::vec3(1.0f, 0.0f, 0.0f));
+    networkView = glm::rotate(networkView, float(yInitRot + yRot), glm::vec3(0.0f, 1.0f, 0.0f));
+    networkView = glm::rotate(networkView, 3.14f / 2.0f + float(zRot), glm::vec3(0.0f, 0.0f, 1.0f));
+    networkView = glm::translate(networkView, glm::vec3(float(xInitTran), float(yInitTran), float(zInitTran)));
+    return networkView;
+}
+
 void widget3d::loadShaderUniforms(Shader *shader)
 {
     // set view transformation
-    view = glm::mat4();
-    view = glm::translate(view, glm::vec3(0.0f, 0.0f, float(scale)));
-    view = glm::translate(view, glm::vec3(0.0f + xTran, 0.0f + yTran, -2.5f));
-    view = glm::rotate(view, float(xInitRot + xRot), glm::vec3(1.0f, 0.0f, 0.0f));
-    view = glm::rotate(view, float(yInitRot + yRot), glm::vec3(0.0f, 1.0f, 0.0f));
-    view = glm::rotate(view, 3.14f / 2.0f + float(zRot), glm::vec3(0.0f, 0.0f, 1.0f));
-    view = glm::translate(view, glm::vec3(float(xInitTran), float(yInitTran), float(zInitTran)));
+    view = getNetworkView();
 
     // pass transformation matrices to the shader
     shader->setMat4("projection", projection);
@@ -475,6 +679,27 @@ void widget3d::loadShaderUniforms(Shader *shader)
     shader->setVec3("oilColor", oilColor.x, oilColor.y, oilColor.z);
     shader->setVec3("waterColor", waterColor.x, waterColor.y, waterColor.z);
     shader->setVec3("tracerColor", tracerColor.x, tracerColor.y, tracerColor.z);
+
+    //Visibility filters: elements beyond a cut plane, or matching a hidden flag, are discarded by the shaders
+    const float noCut = 1e30f;
+    shader->setVec3("cutPlanes", cutX ? float(cutXValue * network->xEdgeLength / aspect) : noCut,
+                    cutY ? float(cutYValue * network->yEdgeLength / aspect) : noCut,
+                    cutZ ? float(cutZValue * network->zEdgeLength / aspect) : noCut);
+    shader->setInt("hiddenFlags", getHiddenFlags());
+}
+
+int widget3d::getHiddenFlags() const
+{
+    int flags(invalidFlag);
+    if (!oilVisible)
+        flags |= oilFlag;
+    if (!waterVisible)
+        flags |= waterFlag;
+    if (!waterWetVisible)
+        flags |= waterWetFlag;
+    if (!oilWetVisible)
+        flags |= oilWetFlag;
+    return flags;
 }
 
 void widget3d::loadShaderUniformsAxes(Shader *shader)
@@ -499,17 +724,20 @@ void widget3d::loadShaderUniformsAxes(Shader *shader)
     viewInv = inverse(view);
     shader->setVec4("eyePoint", viewInv * glm::vec4(0.0, 0.0, 0.0, 1.0));
     shader->setMat3("normalMatrix", glm::mat3(transpose(viewInv)));
+
+    //The axes are never filtered
+    shader->setVec3("cutPlanes", 1e30f, 1e30f, 1e30f);
+    shader->setInt("hiddenFlags", 0);
 }
 
 void widget3d::drawSpheres()
 {
     sphereShader->use();
     loadShaderUniforms(sphereShader.get());
-    if (simulationRunnning || refreshRequested)
+    if (refreshRequested)
         bufferSphereDynamicData();
-    bufferSphereIndicesData();
     glBindVertexArray(sphereVAO);
-    glDrawElements(GL_POINTS, sphereCount, GL_UNSIGNED_INT, 0);
+    glMultiDrawElements(GL_POINTS, sphereRanges.counts.data(), GL_UNSIGNED_INT, sphereRanges.offsets.data(), sphereRanges.counts.size());
     glBindVertexArray(0);
 }
 
@@ -517,23 +745,28 @@ void widget3d::drawCylinders()
 {
     cylinderShader->use();
     loadShaderUniforms(cylinderShader.get());
-    if (simulationRunnning || refreshRequested)
+    if (refreshRequested)
         bufferCylinderDynamicData();
-    bufferCylinderIndicesData();
     glBindVertexArray(cylinderVAO);
-    glDrawElements(GL_POINTS, cylinderCount, GL_UNSIGNED_INT, 0);
+    glMultiDrawElements(GL_POINTS, cylinderRanges.counts.data(), GL_UNSIGNED_INT, cylinderRanges.offsets.data(), cylinderRanges.counts.size());
     glBindVertexArray(0);
+
+    //Distant chunks are drawn as lines
+    if (!lodLineRanges.counts.empty())
+        drawLines(lodLineRanges);
 }
 
-void widget3d::drawLines()
+void widget3d::drawLines(const drawRanges &ranges)
 {
     lineShader->use();
     loadShaderUniforms(lineShader.get());
-    if (simulationRunnning || refreshRequested)
+    if (linesOutdated)
+    {
         bufferLineDynamicData();
-    bufferLinesIndicesData();
+        linesOutdated = false;
+    }
     glBindVertexArray(lineVAO);
-    glDrawElements(GL_LINES, lineCount, GL_UNSIGNED_INT, 0);
+    glMultiDrawElements(GL_LINES, ranges.counts.data(), GL_UNSIGNED_INT, ranges.offsets.data(), ranges.counts.size());
     glBindVertexArray(0);
 }
 
@@ -612,8 +845,8 @@ void widget3d::initializeGL()
     glEnableVertexAttribArray(1); //radius
 
     glBindBuffer(GL_ARRAY_BUFFER, dynamicSphereVBO);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * 4, 0);
-    glEnableVertexAttribArray(2); //color
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * 4, 0);
+    glEnableVertexAttribArray(2); //color and visibility flags
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereIndicesVBO);
 
@@ -638,8 +871,8 @@ void widget3d::initializeGL()
     glEnableVertexAttribArray(3); // radius
 
     glBindBuffer(GL_ARRAY_BUFFER, dynamicCylinderVBO);
-    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, 2 * 4, (GLvoid *)0);
-    glEnableVertexAttribArray(4); // color
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 3 * 4, (GLvoid *)0);
+    glEnableVertexAttribArray(4); // color and visibility flags
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cylinderIndicesVBO);
 
@@ -654,12 +887,14 @@ void widget3d::initializeGL()
     glBindVertexArray(lineVAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, staticLineVBO);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * 4, 0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * 4, 0);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 6 * 4, (GLvoid *)12);
     glEnableVertexAttribArray(0); // pos
+    glEnableVertexAttribArray(2); // throat center
 
     glBindBuffer(GL_ARRAY_BUFFER, dynamicLineVBO);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * 4, 0);
-    glEnableVertexAttribArray(1); // color
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * 4, 0);
+    glEnableVertexAttribArray(1); // color and visibility flags
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lineIndicesVBO);
 
@@ -693,6 +928,8 @@ void widget3d::resizeGL(int w, int h)
 {
     glViewport(0, 0, (GLsizei)w, (GLsizei)h);
     projection = glm::perspective(glm::radians(45.0f), (float)w / (float)h, 0.1f, 100.0f);
+    viewportWidth = std::max(w, 1);
+    viewportHeight = std::max(h, 1);
 }
 
 void widget3d::paintGL()
@@ -705,6 +942,12 @@ void widget3d::paintGL()
         if (!buffersAllocated)
             initialiseDataBuffers();
 
+        // the lines buffer is only refreshed when drawn
+        if (refreshRequested)
+            linesOutdated = true;
+
+        updateDrawRanges();
+
         // draw nodes
         if (nodeBodies)
             drawSpheres();
@@ -713,7 +956,7 @@ void widget3d::paintGL()
         if (poreBodies)
             drawCylinders();
         else if (poreLines)
-            drawLines();
+            drawLines(lineRanges);
 
         refreshRequested = false;
     }
@@ -721,13 +964,86 @@ void widget3d::paintGL()
     if (axes)
         drawAxes();
 
+    // read back before the buffers swap
+    if (videoFrameRequested)
+        captureVideoFrame();
+
     if (animation)
         yRot += 0.005;
 }
 
+bool widget3d::startVideoCapture(const std::string &path, int fps)
+{
+    finishVideoCapture();
+
+    if (!PNM::videoEncoder::get().open(path, viewportWidth, viewportHeight, fps))
+        return false;
+
+    captureWidth = viewportWidth;
+    captureHeight = viewportHeight;
+    capturedFrames = 0;
+
+    makeCurrent();
+    glGenBuffers(2, capturePBOs);
+    for (unsigned int buffer : capturePBOs)
+        allocateBufferOnGPU<GLubyte>(buffer, 4 * captureWidth * captureHeight, GL_PIXEL_PACK_BUFFER, GL_STREAM_READ);
+    return true;
+}
+
+void widget3d::requestVideoFrame()
+{
+    videoFrameRequested = PNM::videoEncoder::get().isOpen();
+}
+
+void widget3d::captureVideoFrame()
+{
+    //The frame is read into one buffer while the previous frame, whose transfer is complete, is encoded from the other
+    unsigned int current = capturePBOs[capturedFrames % 2], previous = capturePBOs[(capturedFrames + 1) % 2];
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, current);
+    glReadPixels(0, 0, captureWidth, captureHeight, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (capturedFrames > 0)
+        encodeCapturedFrame(previous);
+
+    capturedFrames++;
+    videoFrameRequested = false;
+}
+
+void widget3d::encodeCapturedFrame(unsigned int buffer)
+{
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    const GLubyte *pixels = (const GLubyte *)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    if (pixels)
+    {
+        PNM::videoEncoder::get().write(pixels);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void widget3d::finishVideoCapture()
+{
+    //The pixel buffers exist while the capture size is set
+    if (captureWidth == 0)
+        return;
+
+    makeCurrent();
+    if (capturedFrames > 0)
+        encodeCapturedFrame(capturePBOs[(capturedFrames + 1) % 2]);
+    glDeleteBuffers(2, capturePBOs);
+
+    PNM::videoEncoder::get().close();
+    captureWidth = captureHeight = capturedFrames = 0;
+    videoFrameRequested = false;
+}
+
 void widget3d::timerUpdate()
 {
-    updateGL();
+    //Frames without any change (phases, filters or animation) are skipped; user interactions repaint directly
+    if (refreshRequested || animation)
+        updateGL();
 }
 
 bool widget3d::getNetworkBuilt() const
@@ -742,6 +1058,7 @@ void widget3d::setNetworkBuilt(bool value)
     if (value)
     {
         buffersAllocated = false;
+        refreshRequested = true;
         sphereCount = cylinderCount = lineCount = 0;
     }
 }
@@ -751,6 +1068,15 @@ void widget3d::setSimulationRunnning(bool value)
     simulationRunnning = value;
 }
 
+void widget3d::setPhasesVersion(unsigned value)
+{
+    //The dynamic buffers are only uploaded again if the simulation changed the phases
+    if (value == phasesVersion)
+        return;
+    phasesVersion = value;
+    refreshRequested = true;
+}
+
 glm::vec3 &widget3d::getOilColor()
 {
     return oilColor;
@@ -828,7 +1154,6 @@ bool widget3d::getOilVisible() const
 
 void widget3d::setOilVisible(bool value)
 {
-    refreshRequested = true;
     oilVisible = value;
 }
 bool widget3d::getWaterVisible() const
@@ -838,7 +1163,6 @@ bool widget3d::getWaterVisible() const
 
 void widget3d::setWaterVisible(bool value)
 {
-    refreshRequested = true;
     waterVisible = value;
 }
 
@@ -849,7 +1173,6 @@ bool widget3d::getWaterWetVisible() const
 
 void widget3d::setWaterWetVisible(bool value)
 {
-    refreshRequested = true;
     waterWetVisible = value;
 }
 bool widget3d::getOilWetVisible() const
@@ -859,7 +1182,6 @@ bool widget3d::getOilWetVisible() const
 
 void widget3d::setOilWetVisible(bool value)
 {
-    refreshRequested = true;
     oilWetVisible = value;
 }
 double widget3d::getXRot() const
@@ -987,7 +1309,6 @@ bool widget3d::getCutX() const
 
 void widget3d::setCutX(bool value)
 {
-    refreshRequested = true;
     cutX = value;
 }
 bool widget3d::getCutY() const
@@ -997,7 +1318,6 @@ bool widget3d::getCutY() const
 
 void widget3d::setCutY(bool value)
 {
-    refreshRequested = true;
     cutY = value;
 }
 bool widget3d::getCutZ() const
@@ -1007,7 +1327,6 @@ bool widget3d::getCutZ() const
 
 void widget3d::setCutZ(bool value)
 {
-    refreshRequested = true;
     cutZ = value;
 }
 double widget3d::getCutXValue() const
@@ -1017,7 +1336,6 @@ double widget3d::getCutXValue() const
 
 void widget3d::setCutXValue(double value)
 {
-    refreshRequested = true;
     cutXValue = value;
 }
 double widget3d::getCutYValue() const
@@ -1027,7 +1345,6 @@ double widget3d::getCutYValue() const
 
 void widget3d::setCutYValue(double value)
 {
-    refreshRequested = true;
     cutYValue = value;
 }
 double widget3d::getCutZValue() const
@@ -1037,6 +1354,5 @@ double widget3d::getCutZValue() const
 
 void widget3d::setCutZValue(double value)
 {
-    refreshRequested = true;
     cutZValue = value;
 }
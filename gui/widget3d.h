@@ -11,6 +11,8 @@
 #include <QGLWidget>
 #include <libs/glm/glm.hpp>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace PNM
 {
@@ -129,33 +131,64 @@ public:
   void setTracerColor(const glm::vec3 &value);
 
   void setSimulationRunnning(bool value);
+  void setPhasesVersion(unsigned value);
+
+  // Video capture: frames are read back asynchronously into pixel buffers and streamed to the video encoder
+  bool startVideoCapture(const std::string &path, int fps);
+  void requestVideoFrame();
+  void finishVideoCapture();
 
 public slots:
   void timerUpdate();
 
 protected:
+  // Spatial chunk of the network: its elements are contiguous in the index buffers, and are culled or simplified together
+  struct renderChunk
+  {
+    glm::vec3 lowerCorner, upperCorner;
+    float maxNodeRadius, maxPoreRadius;
+    GLint firstNode, nodesCount, firstPore, poresCount;
+  };
+
+  // Index ranges submitted with a single glMultiDrawElements call
+  struct drawRanges
+  {
+    void clear();
+    void add(GLint first, GLsizei count);
+    std::vector<GLsizei> counts;
+    std::vector<const GLvoid *> offsets;
+    GLint end; // end of the last range
+  };
+
   template <typename T>
   void allocateBufferOnGPU(GLuint buffer, const unsigned count, GLenum target, GLenum access);
   template <typename T>
-  void uploadDataToGPU(GLuint buffer, std::vector<T> h_data, const unsigned count, GLenum target);
+  void uploadDataToGPU(GLuint buffer, const std::vector<T> &h_data, const unsigned count, GLenum target);
+  template <typename T>
+  void uploadDataToGPU(GLuint buffer, const std::vector<T> &h_data, const unsigned first, const unsigned last, GLenum target);
+  template <typename T>
+  void updateValue(std::vector<T> &h_data, const unsigned index, const T value, unsigned &firstChanged, unsigned &lastChanged);
   void initialiseDataBuffers();
-  void bufferCylinderDynamicData();
+  void bufferCylinderDynamicData(bool wholeBuffer = false);
   void bufferCylinderStaticData();
-  void bufferCylinderIndicesData();
-  void bufferLineDynamicData();
+  void bufferLineDynamicData(bool wholeBuffer = false);
   void bufferLineStaticData();
-  void bufferLinesIndicesData();
   void bufferSphereStaticData();
-  void bufferSphereDynamicData();
-  void bufferSphereIndicesData();
+  void bufferSphereDynamicData(bool wholeBuffer = false);
+  void buildRenderChunks();
+  void updateDrawRanges();
 
   void bufferAxesData();
+  glm::mat4 getNetworkView() const;
   void loadShaderUniforms(Shader *shader);
+  int getHiddenFlags() const;
   void loadShaderUniformsAxes(Shader *shader);
   void drawSpheres();
   void drawCylinders();
-  void drawLines();
+  void drawLines(const drawRanges &ranges);
   void drawAxes();
+  void captureVideoFrame();
+  void encodeCapturedFrame(unsigned int buffer);
   void mousePressEvent(QMouseEvent *event);
   void mouseMoveEvent(QMouseEvent *event);
   void wheelEvent(QWheelEvent *event);
@@ -169,8 +202,10 @@ protected:
       xInitTran, yInitTran, zInitTran,
       aspect,
       cutXValue, cutYValue, cutZValue;
-  int sphereCount, cylinderCount, lineCount;
-  bool networkBuilt, simulationRunnning, buffersAllocated, refreshRequested,
+  int sphereCount, cylinderCount, lineCount, viewportWidth, viewportHeight;
+  int captureWidth, captureHeight, capturedFrames;
+  unsigned phasesVersion; // version of the simulation phases last uploaded
+  bool networkBuilt, simulationRunnning, buffersAllocated, refreshRequested, linesOutdated, videoFrameRequested,
       axes, animation,
       poreBodies, nodeBodies, poreLines,
       oilVisible, waterVisible, waterWetVisible, oilWetVisible,
@@ -187,11 +222,15 @@ protected:
   std::vector<GLint> sphereIndicesBuffer,
       cylinderIndicesBuffer,
       lineIndicesBuffer;
+  //spatial chunks and the ranges drawn in the current frame
+  std::vector<renderChunk> chunks;
+  drawRanges sphereRanges, cylinderRanges, lineRanges, lodLineRanges;
   //shader attributes
   unsigned int dynamicSphereVBO, staticSphereVBO, sphereIndicesVBO, sphereVAO,
       dynamicCylinderVBO, staticCylinderVBO, cylinderIndicesVBO, cylinderVAO,
       dynamicLineVBO, staticLineVBO, lineIndicesVBO, lineVAO,
-      axesVBO, axesVAO;
+      axesVBO, axesVAO,
+      capturePBOs[2];
   // matrices
   glm::mat4 view, viewInv, projection;
   //shaders
@@ -7,9 +7,102 @@
 
 #include <QApplication>
 #include "gui/mainwindow.h"
+#include "builders/networkbuilder.h"
+#include "simulations/simulation.h"
+#include "simulations/benchmarkRunner.h"
+#include "simulations/sweepRunner.h"
+#include "misc/userInput.h"
+#include "misc/resultsStore.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+
+//Builds the network and runs the simulation set in Input_Data/Parameters.txt, without the GUI event loop
+int runBatch()
+{
+    auto printProgress = [](const std::string &notification, int progress) {
+        std::cout << "[" << progress << "%] " << notification << std::endl;
+    };
+
+    try
+    {
+        PNM::userInput::get().loadNetworkData();
+        PNM::userInput::get().loadSimulationData();
+
+        auto builder = PNM::networkBuilder::createBuilder();
+        builder->setProgressCallback(printProgress);
+        auto network = builder->build();
+        std::cout << builder->getNotification() << std::endl;
+
+        auto sim = PNM::simulation::createSimulation();
+        sim->setNetwork(network);
+        sim->setProgressCallback(printProgress);
+        sim->execute();
+        std::cout << sim->getNotification() << std::endl;
+    }
+    catch (const std::bad_alloc &)
+    {
+        std::cerr << "Not enough RAM to run the simulation.\nAborting.\n";
+        return 1;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace
 
 int main(int argc, char *argv[])
 {
+    //numSCAL --batch: runs the simulation of the parameters file without the GUI
+    if (argc > 1 && std::strcmp(argv[1], "--batch") == 0)
+        return runBatch();
+
+    //numSCAL --benchmark [file]: runs the benchmark scenarios, fails if they are slower than the baseline
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
+    {
+        PNM::benchmarkRunner runner;
+        if (argc > 2)
+            runner.load(argv[2]);
+        else
+            runner.load();
+        return runner.run() ? 0 : 1;
+    }
+
+    //numSCAL --sweep [file]: runs the sweep cases without the GUI
+    if (argc > 1 && std::strcmp(argv[1], "--sweep") == 0)
+    {
+        PNM::sweepRunner runner;
+        try
+        {
+            if (argc > 2)
+                runner.load(argv[2]);
+            else
+                runner.load();
+            return runner.run() == 0 ? 0 : 1;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    //numSCAL --export store [folder]: writes the series of a results store as text files, by default next to it
+    if (argc > 2 && std::strcmp(argv[1], "--export") == 0)
+    {
+        std::string store = argv[2];
+        std::string folder = argc > 3 ? argv[3] : store.substr(0, store.find_last_of('/') == std::string::npos ? 0 : store.find_last_of('/'));
+        return PNM::resultsStore::exportText(store, folder.empty() ? "." : folder) ? 0 : 1;
+    }
+
     QApplication a(argc, argv);
 
     MainWindow window;
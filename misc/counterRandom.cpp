@@ -0,0 +1,118 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "counterRandom.h"
+
+#include <cmath>
+
+counterRandom::counterRandom(int seed, randomStream stream)
+{
+  key[0] = uint32_t(seed);
+  key[1] = uint32_t(stream);
+}
+
+void counterRandom::generate(uint64_t index, uint32_t draw, uint32_t attempt, uint32_t out[4]) const
+{
+  const uint32_t multiplier0 = 0xD2511F53, multiplier1 = 0xCD9E8D57;
+  const uint32_t weyl0 = 0x9E3779B9, weyl1 = 0xBB67AE85;
+
+  uint32_t counter[4] = {uint32_t(index), uint32_t(index >> 32), draw, attempt};
+  uint32_t k0 = key[0], k1 = key[1];
+  for (int round = 0; round < 10; ++round)
+  {
+    uint64_t product0 = uint64_t(multiplier0) * counter[0];
+    uint64_t product1 = uint64_t(multiplier1) * counter[2];
+    uint32_t next[4] = {uint32_t(product1 >> 32) ^ counter[1] ^ k0, uint32_t(product1),
+                        uint32_t(product0 >> 32) ^ counter[3] ^ k1, uint32_t(product0)};
+    for (int i = 0; i < 4; ++i)
+      counter[i] = next[i];
+    k0 += weyl0;
+    k1 += weyl1;
+  }
+
+  for (int i = 0; i < 4; ++i)
+    out[i] = counter[i];
+}
+
+double counterRandom::toUnit(uint32_t high, uint32_t low)
+{
+  //53 random bits in [0, 1)
+  uint64_t bits = (uint64_t(high) << 32 | low) >> 11;
+  return bits * (1.0 / 9007199254740992.0);
+}
+
+double counterRandom::uniform_real(uint64_t index, uint32_t draw, double a, double b) const
+{
+  if (a == b || a > b)
+    return a;
+  uint32_t out[4];
+  generate(index, draw, 0, out);
+  return a + (b - a) * toUnit(out[0], out[1]);
+}
+
+int counterRandom::uniform_int(uint64_t index, uint32_t draw, int a, int b) const
+{
+  if (a >= b)
+    return a;
+  uint32_t out[4];
+  generate(index, draw, 0, out);
+  return a + int(toUnit(out[0], out[1]) * (double(b) - a + 1));
+}
+
+double counterRandom::rayleigh(uint64_t index, uint32_t draw, double min, double max, double ryParam) const
+{
+  if (min == max)
+    return min;
+  return min + std::sqrt(-std::pow(ryParam, 2) * std::log(1 - uniform_real(index, draw) * (1 - std::exp(-std::pow((max - min), 2) / std::pow(ryParam, 2)))));
+}
+
+double counterRandom::triangular(uint64_t index, uint32_t draw, double a, double b, double c) const
+{
+  if (a == b || c < a || c > b)
+    return a;
+
+  auto fc = (c - a) / (b - a);
+  auto u = uniform_real(index, draw);
+
+  if (u < fc)
+    return a + std::sqrt(u * (b - a) * (c - a));
+  else
+    return b - std::sqrt((1 - u) * (b - a) * (b - c));
+}
+
+double counterRandom::normal(uint64_t index, uint32_t draw, double min, double max, double mu, double sigma) const
+{
+  if (min == max || mu < min || mu > max)
+    return min;
+
+  //Box-Muller draws, rejected until one falls within [min, max]
+  for (uint32_t attempt = 0;; ++attempt)
+  {
+    uint32_t out[4];
+    generate(index, draw, attempt, out);
+    double u1 = 1 - toUnit(out[0], out[1]);
+    double u2 = toUnit(out[2], out[3]);
+    double radius = std::sqrt(-2 * std::log(u1));
+    double angle = 2 * 3.14159265358979323846 * u2;
+
+    double value = mu + sigma * radius * std::cos(angle);
+    if (value >= min && value <= max)
+      return value;
+    value = mu + sigma * radius * std::sin(angle);
+    if (value >= min && value <= max)
+      return value;
+  }
+}
+
+double counterRandom::weibull(uint64_t index, uint32_t draw, double min, double max, double alpha, double beta) const
+{
+  if (min == max)
+    return min;
+
+  auto u = uniform_real(index, draw);
+  return (max - min) * std::pow(-beta * std::log(u * (1 - std::exp(-1 / beta)) + std::exp(-1 / beta)), 1 / alpha) + min;
+}
@@ -0,0 +1,48 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef COUNTERRANDOM_H
+#define COUNTERRANDOM_H
+
+#include <cstdint>
+
+// Random quantities drawn by the network generation and initialisation; each one is an independent stream
+enum class randomStream : uint32_t
+{
+  latticeClosure,
+  poreRadius,
+  nodeDistortion,
+  contactAngle,
+  wettabilityOrder,
+  poreWettability,
+  initialWaterOrder,
+  initialWaterPhase
+};
+
+// Stateless counter-based generator (Philox4x32-10): a draw is a function of the seed, the stream, the element index
+// and the draw number only, so elements can be drawn in any order, in parallel, with the same results for any number
+// of threads.
+class counterRandom
+{
+public:
+  counterRandom(int seed, randomStream stream);
+  ~counterRandom() {}
+  double uniform_real(uint64_t index, uint32_t draw = 0, double a = 0, double b = 1) const;
+  int uniform_int(uint64_t index, uint32_t draw = 0, int a = 0, int b = 1) const;
+  double rayleigh(uint64_t index, uint32_t draw, double, double, double) const;
+  double triangular(uint64_t index, uint32_t draw, double, double, double) const;
+  double normal(uint64_t index, uint32_t draw, double, double, double, double) const;
+  double weibull(uint64_t index, uint32_t draw, double, double, double, double) const;
+
+private:
+  void generate(uint64_t index, uint32_t draw, uint32_t attempt, uint32_t out[4]) const;
+  static double toUnit(uint32_t high, uint32_t low);
+
+  uint32_t key[2];
+};
+
+#endif // COUNTERRANDOM_H
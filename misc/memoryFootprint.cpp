@@ -0,0 +1,150 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "memoryFootprint.h"
+#include "scopedtimer.h"
+#include "network/networkmodel.h"
+#include "network/node.h"
+#include "network/pore.h"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace PNM
+{
+
+void memoryFootprint::recordNetwork(const networkModel &network)
+{
+    size_t elements = network.elementsArena->getReservedBytes() + of(network.tableOfNodes) + of(network.tableOfPores);
+
+    size_t neighboors(0);
+    for (int i = 0; i < network.totalNodes; ++i)
+        neighboors += of(network.getNode(i)->getNeighboors());
+    for (int i = 0; i < network.totalPores; ++i)
+        neighboors += of(network.getPore(i)->getNeighboors());
+
+    const networkArrays &a = network.arrays;
+    size_t arrays = of(a.nodePoresOffset) + of(a.nodePores) + of(a.poreNodeIn) + of(a.poreNodeOut) + of(a.poreInlet) + of(a.poreOutlet) +
+                    of(a.nodeRadius) + of(a.nodeLength) + of(a.nodeConductivity) + of(a.nodeFlow) + of(a.nodePressure) +
+                    of(a.nodeConcentration) + of(a.nodePhase) + of(a.poreRadius) + of(a.poreLength) + of(a.poreVolume) +
+                    of(a.poreConductivity) + of(a.poreCapillaryPressure) + of(a.poreFlow) + of(a.poreConcentration) + of(a.porePhase) +
+                    of(a.poreActive) + of(a.nodeConductanceFactor) + of(a.poreConductanceFactor) + of(a.nodeViscosity) +
+                    of(a.poreViscosity) + of(a.poreThroatConductivity);
+
+    PROFILE_COUNTER("memory.elements(MB)", toMB(elements));
+    PROFILE_COUNTER("memory.neighboors(MB)", toMB(neighboors));
+    PROFILE_COUNTER("memory.networkArrays(MB)", toMB(arrays));
+    PROFILE_COUNTER("memory.nodesIndex(MB)", toMB(network.nodesIndex.getMemoryUsage()));
+}
+
+size_t memoryFootprint::estimatePeak(int nodes, int pores, bool is2D, solver solverChoice)
+{
+    //Elements with their reference counts and tables entries, neighboors, arrays, then clustering and simulation buffers
+    double perNode = sizeof(node) + 48 + 8 * (2.0 * pores / std::max(1, nodes)) + 96;
+    double perPore = sizeof(pore) + 48 + 16 + 128;
+    double perElement = 40 + 64;
+
+    double network = perNode * nodes + perPore * pores + perElement * (nodes + pores);
+    return size_t(network + estimateSolver(nodes, pores, is2D, solverChoice));
+}
+
+size_t memoryFootprint::estimateSolver(int nodes, int pores, bool is2D, solver solverChoice)
+{
+    double n = std::max(1, nodes);
+    double matrixNonZeros = n + 2.0 * pores;
+    double matrix = 12 * matrixNonZeros + 4 * n + 8 * 8 * n + 4 * (n + 2.0 * pores);
+
+    //Factor fill of a nested dissection like ordering: n^(4/3) in 3D, n log(n) in 2D
+    auto factorNonZeros = [is2D](double size) { return is2D ? 4 * size * std::log2(std::max(2.0, size)) : 5 * std::pow(size, 4.0 / 3.0); };
+
+    switch (solverChoice)
+    {
+    case solver::cholesky:
+        return size_t(matrix + 12 * factorNonZeros(n) + 24 * n);
+    case solver::mixedPrecision:
+        return size_t(matrix + 8 * matrixNonZeros + 8 * factorNonZeros(n) + 24 * n);
+    case solver::domainDecomposition:
+    {
+        double domains = std::max(1, userInput::get().solverDomains);
+        return size_t(matrix + 2 * 12 * matrixNonZeros + 12 * domains * factorNonZeros(n / domains) + 24 * n);
+    }
+    case solver::preconditionedConjugateGradient:
+        return size_t(matrix + 12 * (matrixNonZeros + 10 * n) + 8 * 8 * n);
+    case solver::conjugateGradient:
+    default:
+        return size_t(matrix + 6 * 8 * n);
+    }
+}
+
+size_t memoryFootprint::getAvailableMemory()
+{
+#ifdef _WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status))
+        return status.ullAvailPhys;
+    return 0;
+#else
+    //Memory available without swapping, page cache included
+    std::ifstream meminfo("/proc/meminfo");
+    std::string line;
+    while (std::getline(meminfo, line))
+        if (line.compare(0, 13, "MemAvailable:") == 0)
+        {
+            std::istringstream value(line.substr(13));
+            size_t kilobytes(0);
+            value >> kilobytes;
+            return kilobytes * 1024;
+        }
+
+    long pages = sysconf(_SC_AVPHYS_PAGES), pageSize = sysconf(_SC_PAGESIZE);
+    return pages > 0 && pageSize > 0 ? size_t(pages) * size_t(pageSize) : 0;
+#endif
+}
+
+void memoryFootprint::checkBeforeBuild(int nodes, int pores, bool is2D)
+{
+    size_t available = getAvailableMemory();
+    solver solverChoice = userInput::get().solverChoice;
+    size_t estimate = estimatePeak(nodes, pores, is2D, solverChoice);
+    PROFILE_COUNTER("memory.estimatedPeak(MB)", toMB(estimate));
+
+    std::cout << "Estimated memory: " << int(toMB(estimate)) << " MB / Available: " << int(toMB(available)) << " MB" << std::endl;
+    if (available == 0 || estimate <= available)
+        return;
+
+    //The iterative solvers need no full factorization
+    for (solver leaner : {solver::preconditionedConjugateGradient, solver::conjugateGradient})
+    {
+        if (leaner == solverChoice || estimateSolver(nodes, pores, is2D, leaner) >= estimateSolver(nodes, pores, is2D, solverChoice))
+            continue;
+        size_t leanerEstimate = estimatePeak(nodes, pores, is2D, leaner);
+        if (leanerEstimate <= available)
+        {
+            std::cout << "Not enough memory for the chosen solver: solverChoice " << int(leaner) << " used instead (estimated "
+                      << int(toMB(leanerEstimate)) << " MB)" << std::endl;
+            userInput::get().solverChoice = leaner;
+            return;
+        }
+    }
+
+    std::ostringstream message;
+    message << "Not enough memory: the network needs about " << int(toMB(estimate)) << " MB, " << int(toMB(available)) << " MB are available.\n";
+    throw std::runtime_error(message.str());
+}
+
+} // namespace PNM
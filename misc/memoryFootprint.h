@@ -0,0 +1,47 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef MEMORYFOOTPRINT_H
+#define MEMORYFOOTPRINT_H
+
+#include "misc/userInput.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace PNM
+{
+
+struct networkModel;
+
+// Memory accounting and pre-flight estimation.
+// - Subsystems record their footprint as "memory.*(MB)" profile counters (network elements, neighboors, arrays,
+//   clusters, solver matrices and factorizations, GUI buffers), whose maximum is their peak in the profile data.
+// - Before a network is built, its peak footprint is estimated from its nodes and pores counts and the chosen
+//   solver. When it exceeds the available memory, a solver without full factorization is used if it fits;
+//   otherwise the build is refused with a std::runtime_error, instead of running out of memory later.
+// The estimate uses the elements sizes and the usual fill of the factorizations: it is an order of magnitude,
+// meant to catch the jobs that cannot fit, not an exact prediction.
+class memoryFootprint
+{
+  public:
+    template <typename T>
+    static size_t of(const std::vector<T> &values) { return values.capacity() * sizeof(T); }
+    static double toMB(size_t bytes) { return bytes / 1048576.; }
+
+    static void recordNetwork(const networkModel &);
+    static size_t estimatePeak(int nodes, int pores, bool is2D, solver);
+    static size_t getAvailableMemory();
+    static void checkBeforeBuild(int nodes, int pores, bool is2D);
+
+  private:
+    static size_t estimateSolver(int nodes, int pores, bool is2D, solver);
+};
+
+} // namespace PNM
+
+#endif // MEMORYFOOTPRINT_H
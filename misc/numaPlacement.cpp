@@ -0,0 +1,130 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "numaPlacement.h"
+#include "userInput.h"
+
+#include <omp.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace PNM
+{
+
+namespace
+{
+//Below a few pages, the arrays are not worth a copy
+const size_t minimumBytes = 1 << 16;
+
+//Cores the process may run on, in their system order (the cores of a socket being usually numbered together)
+const std::vector<int> &getCores()
+{
+    static const std::vector<int> cores = [] {
+        std::vector<int> list;
+#ifdef _WIN32
+        DWORD_PTR processMask, systemMask;
+        if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+            for (int core = 0; core < int(8 * sizeof(DWORD_PTR)); ++core)
+                if (processMask & (DWORD_PTR(1) << core))
+                    list.push_back(core);
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            for (int core = 0; core < CPU_SETSIZE; ++core)
+                if (CPU_ISSET(core, &set))
+                    list.push_back(core);
+#endif
+        return list;
+    }();
+    return cores;
+}
+
+thread_local int pinnedTeam = 0;
+thread_local int pinnedFirstCore = 0;
+thread_local int teamFirstCore = 0;
+} // namespace
+
+bool numaPlacement::isEnabled()
+{
+    return userInput::get().numaAware;
+}
+
+int numaPlacement::getThreads()
+{
+    //Same count as the pressure solver gives Eigen, which the kernels loops use
+    if (!userInput::get().parallelSolver)
+        return 1;
+    return userInput::get().solverThreads > 0 ? userInput::get().solverThreads : omp_get_max_threads();
+}
+
+void numaPlacement::pinThreads()
+{
+    int threads = getThreads();
+    int first = teamFirstCore;
+    if (!isEnabled() || threads < 2 || (pinnedTeam == threads && pinnedFirstCore == first) || omp_in_parallel())
+        return;
+
+    //OpenMP runtimes keep the team threads between parallel regions of a same size
+#pragma omp parallel num_threads(threads)
+    pinCurrentThread(first + omp_get_thread_num());
+
+    pinnedTeam = threads;
+    pinnedFirstCore = first;
+}
+
+void numaPlacement::setTeamCores(int first)
+{
+    teamFirstCore = first;
+}
+
+void numaPlacement::pinCurrentThread(int slot)
+{
+    const std::vector<int> &cores = getCores();
+    if (!isEnabled() || cores.empty())
+        return;
+
+    int core = cores[slot % cores.size()];
+#ifdef _WIN32
+    SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core);
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+bool numaPlacement::shouldDistribute(size_t bytes)
+{
+    return isEnabled() && bytes >= minimumBytes && getThreads() > 1;
+}
+
+void numaPlacement::releasePages(void *address, size_t bytes)
+{
+    //Only the whole pages inside the range are released, the allocator bookkeeping around it being left untouched.
+    //Elsewhere, the pages stay where they were first written
+#ifdef __linux__
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t first = (reinterpret_cast<size_t>(address) + page - 1) / page * page;
+    size_t last = (reinterpret_cast<size_t>(address) + bytes) / page * page;
+    if (last > first)
+        madvise(reinterpret_cast<void *>(first), last - first, MADV_DONTNEED);
+#else
+    (void)address;
+    (void)bytes;
+#endif
+}
+
+} // namespace PNM
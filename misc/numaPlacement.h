@@ -0,0 +1,81 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef NUMAPLACEMENT_H
+#define NUMAPLACEMENT_H
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace PNM
+{
+
+// Memory placement of the parallel kernels data on multi-socket machines (numaAware option).
+// A memory page lives on the NUMA node of the thread that first writes it, which is the builder thread for every array
+// filled serially. With numaAware, the kernels threads are pinned to one core each, and the arrays they stream are
+// rewritten by their owner threads: in the static partition of the kernels loops, thread t owns the t-th contiguous
+// chunk of the nodes, pores or matrix rows. The loops using the partition have a static schedule and the solver threads.
+class numaPlacement
+{
+  public:
+    static bool isEnabled();
+    static int getThreads(); // threads of the kernels, as set by the pressure solver
+    static void pinThreads(); // OpenMP team of the calling thread, once per team size and first core
+    static void setTeamCores(int first); // teams running side by side (sweep cases) take the cores from first on
+    static void pinCurrentThread(int slot); // to the slot-th core of the process affinity
+
+    // Values kept, pages moved to their owner threads
+    template <typename T>
+    static void distribute(std::vector<T> &values) { distribute(values.data(), int(values.size())); }
+    template <typename T>
+    static void distribute(T *values, int size);
+    template <typename T>
+    static void distributeRows(T *values, const int *rowsOffset, int rows); // CSR storage, partitioned by rows
+
+  private:
+    static bool shouldDistribute(size_t bytes);
+    static void releasePages(void *, size_t bytes);
+};
+
+template <typename T>
+void numaPlacement::distribute(T *values, int size)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "distributed values are copied bytewise");
+    if (!shouldDistribute(size * sizeof(T)))
+        return;
+
+    //Released pages read as zeros until their first write, done here by the thread owning them
+    std::vector<T> copy(values, values + size);
+    releasePages(values, size * sizeof(T));
+    int threads = getThreads();
+
+#pragma omp parallel for schedule(static) num_threads(threads)
+    for (int i = 0; i < size; ++i)
+        values[i] = copy[i];
+}
+
+template <typename T>
+void numaPlacement::distributeRows(T *values, const int *rowsOffset, int rows)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "distributed values are copied bytewise");
+    if (rows == 0 || !shouldDistribute(rowsOffset[rows] * sizeof(T)))
+        return;
+
+    std::vector<T> copy(values, values + rowsOffset[rows]);
+    releasePages(values, rowsOffset[rows] * sizeof(T));
+    int threads = getThreads();
+
+#pragma omp parallel for schedule(static) num_threads(threads)
+    for (int row = 0; row < rows; ++row)
+        for (int k = rowsOffset[row]; k < rowsOffset[row + 1]; ++k)
+            values[k] = copy[k];
+}
+
+} // namespace PNM
+
+#endif // NUMAPLACEMENT_H
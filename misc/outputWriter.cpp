@@ -0,0 +1,201 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "outputWriter.h"
+#include "userInput.h"
+
+namespace PNM
+{
+
+outputWriter outputWriter::instance;
+
+outputWriter &outputWriter::get()
+{
+    return instance;
+}
+
+outputWriter::~outputWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    if (writerThread.joinable())
+        writerThread.join();
+}
+
+void outputWriter::createFile(const std::string &path, const std::string &header)
+{
+    push(job(jobType::createFile, path, header));
+}
+
+void outputWriter::appendLine(const std::string &path, const std::string &line)
+{
+    push(job(jobType::appendLine, path, line));
+}
+
+void outputWriter::createSeries(const std::string &path, const std::string &header)
+{
+    if (storeEnabled())
+        push(job(jobType::createSeries, path, header));
+    else
+        createFile(path, header);
+}
+
+void outputWriter::appendValues(const std::string &path, std::vector<double> values)
+{
+    job valuesJob(jobType::appendValues, path);
+    valuesJob.values = std::move(values);
+    push(std::move(valuesJob));
+}
+
+bool outputWriter::storeEnabled()
+{
+    return userInput::get().storeResults;
+}
+
+void outputWriter::writeNetworkState(const std::string &path, std::unique_ptr<networkState> state, bool binary, bool compressed)
+{
+    job stateJob(jobType::writeNetworkState, path);
+    stateJob.state = std::move(state);
+    stateJob.binary = binary;
+    stateJob.compressed = compressed;
+    push(std::move(stateJob));
+}
+
+void outputWriter::close()
+{
+    push(job(jobType::closeFiles, userInput::get().resultsFolder + "/"));
+
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [this] { return pendingJobs == 0; });
+}
+
+void outputWriter::push(job newJob)
+{
+    if (!userInput::get().asynchronousOutput)
+    {
+        //Waits for the jobs queued before the option changed, then writes from the calling thread
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobDone.wait(lock, [this] { return pendingJobs == 0; });
+        }
+        process(newJob);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!writerThread.joinable())
+        writerThread = std::thread(&outputWriter::drain, this);
+
+    jobDone.wait(lock, [this] { return jobs.size() < maxQueuedJobs; });
+    jobs.push_back(std::move(newJob));
+    pendingJobs++;
+    lock.unlock();
+    jobAvailable.notify_one();
+}
+
+void outputWriter::drain()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (jobs.empty())
+            return;
+
+        job currentJob = std::move(jobs.front());
+        jobs.pop_front();
+        lock.unlock();
+
+        process(currentJob);
+
+        lock.lock();
+        pendingJobs--;
+        jobDone.notify_all();
+    }
+}
+
+void outputWriter::process(job &currentJob)
+{
+    std::lock_guard<std::mutex> lock(processMutex);
+
+    switch (currentJob.type)
+    {
+    case jobType::createFile:
+    {
+        std::ofstream &file = files[currentJob.path];
+        if (file.is_open())
+            file.close();
+        file.open(currentJob.path.c_str());
+        file << currentJob.text;
+        break;
+    }
+    case jobType::appendLine:
+    {
+        std::ofstream &file = files[currentJob.path];
+        if (!file.is_open())
+            file.open(currentJob.path.c_str(), std::ofstream::app);
+        file << currentJob.text;
+        break;
+    }
+    case jobType::writeNetworkState:
+        if (currentJob.binary)
+            stateFiles[currentJob.path.substr(0, currentJob.path.find_last_of('/'))].write(currentJob.path, *currentJob.state, currentJob.compressed);
+        else
+            networkStateFile::writeText(currentJob.path, *currentJob.state);
+        break;
+    case jobType::createSeries:
+    {
+        std::vector<std::string> columns;
+        std::istringstream header(currentJob.text.substr(0, currentJob.text.find('\n')));
+        for (std::string column; std::getline(header, column, '\t');)
+            columns.push_back(column);
+        seriesIndices[currentJob.path] = getStore(currentJob.path).defineSeries(resultsStore::getSeriesName(currentJob.path), columns);
+        break;
+    }
+    case jobType::appendValues:
+    {
+        //A resumed simulation appends to the series it defined before
+        resultsStore &store = getStore(currentJob.path);
+        auto series = seriesIndices.find(currentJob.path);
+        if (series == seriesIndices.end())
+        {
+            int index = store.findSeries(resultsStore::getSeriesName(currentJob.path));
+            if (index == -1)
+            {
+                std::vector<std::string> columns;
+                for (size_t c = 0; c < currentJob.values.size(); ++c)
+                    columns.push_back("column" + std::to_string(c + 1));
+                index = store.defineSeries(resultsStore::getSeriesName(currentJob.path), columns);
+            }
+            series = seriesIndices.emplace(currentJob.path, index).first;
+        }
+        store.append(series->second, std::move(currentJob.values));
+        break;
+    }
+    case jobType::closeFiles:
+        eraseFolder(files, currentJob.path);
+        eraseFolder(stores, currentJob.path);
+        eraseFolder(seriesIndices, currentJob.path);
+        break;
+    }
+}
+
+resultsStore &outputWriter::getStore(const std::string &path)
+{
+    std::unique_ptr<resultsStore> &store = stores[resultsStore::getPath(path)];
+    if (!store)
+    {
+        store.reset(new resultsStore);
+        store->open(resultsStore::getPath(path));
+    }
+    return *store;
+}
+
+} // namespace PNM
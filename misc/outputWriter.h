@@ -0,0 +1,144 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef OUTPUTWRITER_H
+#define OUTPUTWRITER_H
+
+#include "operations/networkStateFile.h"
+#include "resultsStore.h"
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace PNM
+{
+
+// Results files and network state frames writer. Writes are queued, in order, to a background thread which keeps
+// the results files open; a full queue blocks the simulation until the disk catches up.
+// close() waits for the pending writes and closes the files of the caller's results folder (the other simulations of
+// a sweep keep theirs open): it is called before results folders are cleaned, at checkpoints and when a simulation
+// finishes. Without asynchronousOutput, the callers threads write in turn.
+// Series (createSeries, appendRecord) are numeric results files: with storeResults set, they are stored in the
+// results.numr store of their folder instead of text files, which resultsStore::exportText writes back.
+class outputWriter
+{
+  public:
+    static outputWriter &get();
+    void createFile(const std::string &path, const std::string &header);
+    void appendLine(const std::string &path, const std::string &line);
+    template <typename... T>
+    void appendRow(const std::string &path, const T &... values);
+    void createSeries(const std::string &path, const std::string &header);
+    template <typename... T>
+    void appendRecord(const std::string &path, const T &... values);
+    void writeNetworkState(const std::string &path, std::unique_ptr<networkState> state, bool binary, bool compressed);
+    void close();
+
+  protected:
+    outputWriter() : pendingJobs(0), stopping(false) {}
+    ~outputWriter();
+    outputWriter(const outputWriter &) = delete;
+    outputWriter(outputWriter &&) = delete;
+    auto operator=(const outputWriter &) -> outputWriter & = delete;
+    auto operator=(outputWriter &&) -> outputWriter & = delete;
+
+    enum class jobType
+    {
+        createFile,
+        appendLine,
+        writeNetworkState,
+        createSeries,
+        appendValues,
+        closeFiles
+    };
+
+    struct job
+    {
+        job(jobType jobType, std::string jobPath, std::string jobText = std::string())
+            : type(jobType), path(std::move(jobPath)), text(std::move(jobText)), binary(false), compressed(false)
+        {
+        }
+
+        jobType type;
+        std::string path;
+        std::string text;
+        std::unique_ptr<networkState> state;
+        bool binary;
+        bool compressed;
+        std::vector<double> values;
+    };
+
+    static bool storeEnabled();
+    void appendValues(const std::string &path, std::vector<double> values);
+    resultsStore &getStore(const std::string &path);
+    void push(job);
+    void process(job &);
+    void drain();
+
+    template <typename T, typename... Rest>
+    static void formatRow(std::ostringstream &row, const T &value, const Rest &... rest)
+    {
+        row << value << (sizeof...(Rest) ? "\t" : "\n");
+        formatRow(row, rest...);
+    }
+    static void formatRow(std::ostringstream &) {}
+
+    template <typename T>
+    static void eraseFolder(std::map<std::string, T> &byPath, const std::string &folder)
+    {
+        for (auto it = byPath.lower_bound(folder); it != byPath.end() && it->first.compare(0, folder.size(), folder) == 0;)
+            it = byPath.erase(it);
+    }
+
+    static outputWriter instance;
+    static const unsigned maxQueuedJobs = 256;
+
+    std::deque<job> jobs;
+    int pendingJobs; // queued jobs and the job being processed
+    bool stopping;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobDone;
+    std::thread writerThread;
+    std::mutex processMutex; // held by process(), run by the writer thread or by the callers threads
+
+    // only used by process()
+    std::map<std::string, std::ofstream> files;
+    std::map<std::string, networkStateFile> stateFiles; // binary frames writers by folder, each keeping its previous frame
+    std::map<std::string, std::unique_ptr<resultsStore>> stores; // by store path
+    std::map<std::string, int> seriesIndices;                    // series of each series path in its store
+};
+
+// Tab separated values line, formatted in the calling thread
+template <typename... T>
+void outputWriter::appendRow(const std::string &path, const T &... values)
+{
+    std::ostringstream row;
+    formatRow(row, values...);
+    appendLine(path, row.str());
+}
+
+template <typename... T>
+void outputWriter::appendRecord(const std::string &path, const T &... values)
+{
+    if (storeEnabled())
+        appendValues(path, {double(values)...});
+    else
+        appendRow(path, values...);
+}
+
+} // namespace PNM
+
+#endif // OUTPUTWRITER_H
@@ -0,0 +1,31 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "progressReporter.h"
+
+namespace PNM
+{
+
+void progressReporter::setCallback(const progressCallback &value, int intervalMilliseconds)
+{
+    callback = value;
+    interval = std::chrono::milliseconds(intervalMilliseconds);
+    lastReport = clockType::time_point();
+}
+
+bool progressReporter::isDue() const
+{
+    return callback && clockType::now() - lastReport >= interval;
+}
+
+void progressReporter::report(const std::string &notification, int progress)
+{
+    lastReport = clockType::now();
+    callback(notification, progress);
+}
+
+} // namespace PNM
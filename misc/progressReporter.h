@@ -0,0 +1,40 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef PROGRESSREPORTER_H
+#define PROGRESSREPORTER_H
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+namespace PNM
+{
+
+using progressCallback = std::function<void(const std::string &notification, int progress)>;
+
+// Forwards the progress of a builder or a simulation to a callback, at most once per interval, from the computing
+// thread. The callback is not synchronized with anything: it should return quickly.
+class progressReporter
+{
+  public:
+    using clockType = std::chrono::steady_clock;
+
+    progressReporter() : interval(1000) {}
+    void setCallback(const progressCallback &value, int intervalMilliseconds = 1000);
+    bool isDue() const;
+    void report(const std::string &notification, int progress);
+
+  private:
+    progressCallback callback;
+    std::chrono::milliseconds interval;
+    clockType::time_point lastReport;
+};
+
+} // namespace PNM
+
+#endif // PROGRESSREPORTER_H
@@ -0,0 +1,79 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef REPRODUCIBLESUM_H
+#define REPRODUCIBLESUM_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace PNM
+{
+
+// Running sum carrying the rounding error of its additions (Neumaier): the result is accurate to the last bits whatever
+// the magnitudes and signs of the terms, but it still depends on their order.
+struct compensatedSum
+{
+    void add(double term)
+    {
+        double next = sum + term;
+        compensation += std::abs(sum) >= std::abs(term) ? (sum - next) + term : (term - next) + sum;
+        sum = next;
+    }
+    double value() const { return sum + compensation; }
+
+    double sum = 0;
+    double compensation = 0;
+};
+
+// Reductions over [0, count) bitwise identical whatever the number of threads running them, for the quantities that
+// drive the simulations decisions (saturations, outlet flows, time steps). The terms are cut into fixed blocks of
+// reductionBlock terms, each summed in order with compensation, and the blocks sums are combined pairwise in a fixed
+// tree: only the blocks are shared between the OpenMP threads. term(i) is called concurrently and must not write.
+const int reductionBlock = 1024;
+
+template <typename F>
+double reproducibleSum(int count, F term)
+{
+    int blocks = (count + reductionBlock - 1) / reductionBlock;
+    std::vector<double> sums(blocks);
+
+#pragma omp parallel for if (blocks > 1)
+    for (int b = 0; b < blocks; ++b)
+    {
+        compensatedSum sum;
+        for (int i = b * reductionBlock; i < std::min(count, (b + 1) * reductionBlock); ++i)
+            sum.add(term(i));
+        sums[b] = sum.value();
+    }
+
+    //Pairwise tree over the blocks, by strides doubling from neighboor blocks
+    for (int stride = 1; stride < blocks; stride *= 2)
+        for (int b = 0; b + stride < blocks; b += 2 * stride)
+            sums[b] += sums[b + stride];
+    return blocks > 0 ? sums[0] : 0;
+}
+
+// Minimums are exact in any order; they are run over the same blocks
+template <typename F>
+double reproducibleMin(int count, F term, double identity)
+{
+    int blocks = (count + reductionBlock - 1) / reductionBlock;
+    std::vector<double> minimums(blocks, identity);
+
+#pragma omp parallel for if (blocks > 1)
+    for (int b = 0; b < blocks; ++b)
+        for (int i = b * reductionBlock; i < std::min(count, (b + 1) * reductionBlock); ++i)
+            minimums[b] = std::min(minimums[b], term(i));
+
+    return blocks > 0 ? *std::min_element(minimums.begin(), minimums.end()) : identity;
+}
+
+} // namespace PNM
+
+#endif // REPRODUCIBLESUM_H
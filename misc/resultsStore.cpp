@@ -0,0 +1,373 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "resultsStore.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+
+namespace PNM
+{
+
+namespace
+{
+
+const char magic[4] = {'N', 'U', 'M', 'R'};
+const uint32_t version = 1;
+const int64_t headerSize = 8;
+
+uint64_t checksum(const std::string &data)
+{
+    uint64_t value = 14695981039346656037ULL;
+    for (char byte : data)
+    {
+        value ^= static_cast<unsigned char>(byte);
+        value *= 1099511628211ULL;
+    }
+    return value;
+}
+
+template <typename T>
+void put(std::string &data, const T &value)
+{
+    data.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void putString(std::string &data, const std::string &text)
+{
+    put<uint32_t>(data, text.size());
+    data.append(text);
+}
+
+//Reads from a record payload, failing past its end
+class payloadReader
+{
+  public:
+    payloadReader(const std::string &value) : data(value), position(0) {}
+
+    template <typename T>
+    bool take(T &value)
+    {
+        if (position + sizeof(T) > data.size())
+            return false;
+        std::memcpy(&value, data.data() + position, sizeof(T));
+        position += sizeof(T);
+        return true;
+    }
+
+    bool takeString(std::string &text)
+    {
+        uint32_t length(0);
+        if (!take(length) || position + length > data.size())
+            return false;
+        text.assign(data.data() + position, length);
+        position += length;
+        return true;
+    }
+
+    size_t getPosition() const { return position; }
+
+  private:
+    const std::string &data;
+    size_t position;
+};
+
+template <typename T>
+bool take(std::ifstream &file, T &value)
+{
+    return bool(file.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+} // namespace
+
+bool resultsStore::open(const std::string &path)
+{
+    close();
+    filePath = path;
+    series.clear();
+
+    //An existing store is continued after its last complete record
+    int64_t validSize(0);
+    {
+        std::ifstream existing(path.c_str(), std::ios::binary);
+        if (existing && !scan(existing, series, validSize))
+        {
+            series.clear();
+            validSize = 0;
+        }
+    }
+
+    if (validSize == 0)
+    {
+        file.open(path.c_str(), std::ios::binary | std::ios::trunc);
+        file.write(magic, 4);
+        file.write(reinterpret_cast<const char *>(&version), sizeof(version));
+        validSize = headerSize;
+    }
+    else
+    {
+        QFile(path.c_str()).resize(validSize);
+        file.open(path.c_str(), std::ios::binary | std::ios::app);
+    }
+
+    fileSize = validSize;
+    buffers.assign(series.size(), std::vector<double>());
+    lastFlush = clockType::now();
+
+    if (!file)
+    {
+        std::cout << "ERROR: Results store " << path << " could not be opened" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void resultsStore::close()
+{
+    if (!file.is_open())
+        return;
+
+    flush();
+    file.close();
+}
+
+int resultsStore::defineSeries(const std::string &name, const std::vector<std::string> &columns)
+{
+    std::string payload;
+    put<uint32_t>(payload, series.size());
+    putString(payload, name);
+    put<uint32_t>(payload, columns.size());
+    for (const std::string &column : columns)
+        putString(payload, column);
+    writeRecord(seriesRecord, payload);
+
+    series.push_back(seriesEntry{name, columns, {}});
+    buffers.emplace_back();
+    return series.size() - 1;
+}
+
+int resultsStore::findSeries(const std::string &name) const
+{
+    for (int i = series.size() - 1; i >= 0; --i)
+        if (series[i].name == name)
+            return i;
+    return -1;
+}
+
+void resultsStore::append(int seriesIndex, std::vector<double> values)
+{
+    if (series[seriesIndex].columns.empty())
+        return;
+
+    std::vector<double> &buffer = buffers[seriesIndex];
+    values.resize(series[seriesIndex].columns.size(), std::numeric_limits<double>::quiet_NaN());
+    buffer.insert(buffer.end(), values.begin(), values.end());
+
+    if (buffer.size() >= rowsPerChunk * values.size())
+        writeChunk(seriesIndex);
+    if (clockType::now() - lastFlush >= std::chrono::seconds(1))
+        flush();
+}
+
+void resultsStore::flush()
+{
+    for (unsigned i = 0; i < series.size(); ++i)
+        if (!buffers[i].empty())
+            writeChunk(i);
+    file.flush();
+    lastFlush = clockType::now();
+}
+
+std::string resultsStore::getPath(const std::string &seriesPath)
+{
+    size_t separator = seriesPath.find_last_of('/');
+    return (separator == std::string::npos ? std::string(".") : seriesPath.substr(0, separator)) + "/results.numr";
+}
+
+std::string resultsStore::getSeriesName(const std::string &seriesPath)
+{
+    size_t separator = seriesPath.find_last_of('/');
+    return separator == std::string::npos ? seriesPath : seriesPath.substr(separator + 1);
+}
+
+std::vector<resultsStore::seriesEntry> resultsStore::readIndex(const std::string &path)
+{
+    std::vector<seriesEntry> index;
+    int64_t validSize(0);
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file || !scan(file, index, validSize))
+        index.clear();
+    return index;
+}
+
+std::vector<std::vector<double>> resultsStore::readRows(const std::string &path, const seriesEntry &entry, double minKey, double maxKey)
+{
+    std::vector<std::vector<double>> rows;
+    std::ifstream file(path.c_str(), std::ios::binary);
+    size_t columns = entry.columns.size();
+    if (!file || columns == 0)
+        return rows;
+
+    std::vector<double> values;
+    for (const chunkEntry &chunk : entry.chunks)
+    {
+        if (chunk.maxKey < minKey || chunk.minKey > maxKey)
+            continue;
+
+        values.resize(size_t(chunk.rows) * columns);
+        file.seekg(chunk.offset);
+        if (!file.read(reinterpret_cast<char *>(values.data()), values.size() * sizeof(double)))
+            break;
+
+        for (uint32_t r = 0; r < chunk.rows; ++r)
+        {
+            double key = values[r];
+            if (key < minKey || key > maxKey)
+                continue;
+            std::vector<double> row(columns);
+            for (size_t c = 0; c < columns; ++c)
+                row[c] = values[c * chunk.rows + r];
+            rows.push_back(std::move(row));
+        }
+    }
+    return rows;
+}
+
+bool resultsStore::exportText(const std::string &path, const std::string &folder)
+{
+    std::vector<seriesEntry> index = readIndex(path);
+    if (index.empty())
+        return false;
+
+    //Each series is written as the tab separated file it replaces, the last definition of a name winning
+    std::map<std::string, const seriesEntry *> lastDefinitions;
+    for (const seriesEntry &entry : index)
+        lastDefinitions[entry.name] = &entry;
+
+    double infinity = std::numeric_limits<double>::infinity();
+    for (auto &definition : lastDefinitions)
+    {
+        const seriesEntry &entry = *definition.second;
+        std::ofstream text((folder + "/" + entry.name).c_str());
+        for (size_t c = 0; c < entry.columns.size(); ++c)
+            text << entry.columns[c] << (c + 1 < entry.columns.size() ? "\t" : "\n");
+
+        for (const std::vector<double> &row : readRows(path, entry, -infinity, infinity))
+        {
+            std::ostringstream line;
+            for (size_t c = 0; c < row.size(); ++c)
+                line << row[c] << (c + 1 < row.size() ? "\t" : "\n");
+            text << line.str();
+        }
+
+        if (!text)
+            return false;
+        std::cout << "Exported " << folder + "/" + entry.name << std::endl;
+    }
+    return true;
+}
+
+bool resultsStore::scan(std::ifstream &file, std::vector<seriesEntry> &index, int64_t &validSize)
+{
+    char fileMagic[4];
+    uint32_t fileVersion(0);
+    if (!file.read(fileMagic, 4) || std::memcmp(fileMagic, magic, 4) != 0 || !take(file, fileVersion) || fileVersion != version)
+        return false;
+    validSize = headerSize;
+
+    //Records are read until the first incomplete or corrupted one
+    while (true)
+    {
+        uint32_t type(0), size(0);
+        uint64_t recordChecksum(0);
+        if (!take(file, type) || !take(file, size))
+            break;
+
+        int64_t payloadOffset = validSize + 2 * sizeof(uint32_t);
+        std::string payload(size, '\0');
+        if (!file.read(&payload[0], size) || !take(file, recordChecksum) || recordChecksum != checksum(payload))
+            break;
+
+        payloadReader reader(payload);
+        if (type == seriesRecord)
+        {
+            uint32_t identifier(0), columns(0);
+            seriesEntry entry;
+            if (!reader.take(identifier) || identifier != index.size() || !reader.takeString(entry.name) || !reader.take(columns))
+                break;
+            entry.columns.resize(columns);
+            bool complete(true);
+            for (std::string &column : entry.columns)
+                complete = complete && reader.takeString(column);
+            if (!complete)
+                break;
+            index.push_back(std::move(entry));
+        }
+        else if (type == chunkRecord)
+        {
+            uint32_t identifier(0);
+            chunkEntry chunk;
+            if (!reader.take(identifier) || identifier >= index.size() || !reader.take(chunk.rows) || !reader.take(chunk.minKey) ||
+                !reader.take(chunk.maxKey))
+                break;
+            chunk.offset = payloadOffset + reader.getPosition();
+            index[identifier].chunks.push_back(chunk);
+        }
+
+        validSize = payloadOffset + size + sizeof(uint64_t);
+    }
+
+    return true;
+}
+
+void resultsStore::writeRecord(recordType type, const std::string &payload)
+{
+    uint32_t size = payload.size();
+    uint64_t recordChecksum = checksum(payload);
+    file.write(reinterpret_cast<const char *>(&type), sizeof(uint32_t));
+    file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    file.write(payload.data(), size);
+    file.write(reinterpret_cast<const char *>(&recordChecksum), sizeof(recordChecksum));
+    fileSize += 2 * sizeof(uint32_t) + size + sizeof(uint64_t);
+}
+
+void resultsStore::writeChunk(int seriesIndex)
+{
+    std::vector<double> &buffer = buffers[seriesIndex];
+    size_t columns = series[seriesIndex].columns.size();
+    uint32_t rows = columns == 0 ? 0 : buffer.size() / columns;
+
+    double minKey = std::numeric_limits<double>::infinity(), maxKey = -minKey;
+    for (uint32_t r = 0; r < rows; ++r)
+    {
+        minKey = std::min(minKey, buffer[r * columns]);
+        maxKey = std::max(maxKey, buffer[r * columns]);
+    }
+
+    std::string payload;
+    payload.reserve(4 * sizeof(uint32_t) + 2 * sizeof(double) + buffer.size() * sizeof(double));
+    put<uint32_t>(payload, seriesIndex);
+    put<uint32_t>(payload, rows);
+    put<double>(payload, minKey);
+    put<double>(payload, maxKey);
+    for (size_t c = 0; c < columns; ++c)
+        for (uint32_t r = 0; r < rows; ++r)
+            put<double>(payload, buffer[r * columns + c]);
+
+    int64_t valuesOffset = fileSize + 2 * sizeof(uint32_t) + 2 * sizeof(uint32_t) + 2 * sizeof(double);
+    writeRecord(chunkRecord, payload);
+    series[seriesIndex].chunks.push_back(chunkEntry{valuesOffset, rows, minKey, maxKey});
+    buffer.clear();
+}
+
+} // namespace PNM
@@ -0,0 +1,87 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef RESULTSSTORE_H
+#define RESULTSSTORE_H
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace PNM
+{
+
+// Append-only columnar file of results series (.numr), one per simulation results folder, replacing its text files.
+// A series is a table of doubles whose first column is its key (injected PVs, Sw). Rows are buffered per series and
+// written as chunks, each stored column by column with the range of its keys, so that readers only load the chunks
+// of the keys they ask for. Every record (series definition or chunk) carries a checksum: a file cut by a crash
+// is read, and reopened for appending, up to its last complete record. The buffered rows are flushed every second
+// and when the store is closed.
+// A series defined again (a simulation restarted in the same folder) replaces the previous one with that name.
+class resultsStore
+{
+  public:
+    using clockType = std::chrono::steady_clock;
+
+    struct chunkEntry
+    {
+        int64_t offset; // position of the chunk values in the file
+        uint32_t rows;
+        double minKey;
+        double maxKey;
+    };
+
+    struct seriesEntry
+    {
+        std::string name;
+        std::vector<std::string> columns;
+        std::vector<chunkEntry> chunks;
+    };
+
+    resultsStore() {}
+    ~resultsStore() { close(); }
+    resultsStore(const resultsStore &) = delete;
+    auto operator=(const resultsStore &) -> resultsStore & = delete;
+    bool open(const std::string &path);
+    void close();
+    int defineSeries(const std::string &name, const std::vector<std::string> &columns);
+    int findSeries(const std::string &name) const;
+    void append(int series, std::vector<double> values);
+    void flush();
+
+    static std::string getPath(const std::string &seriesPath);
+    static std::string getSeriesName(const std::string &seriesPath);
+    static std::vector<seriesEntry> readIndex(const std::string &path);
+    static std::vector<std::vector<double>> readRows(const std::string &path, const seriesEntry &, double minKey, double maxKey);
+    static bool exportText(const std::string &path, const std::string &folder);
+
+  private:
+    enum recordType : uint32_t
+    {
+        seriesRecord = 1,
+        chunkRecord = 2
+    };
+
+    static bool scan(std::ifstream &, std::vector<seriesEntry> &, int64_t &validSize);
+    void writeRecord(recordType, const std::string &payload);
+    void writeChunk(int series);
+
+    static const unsigned rowsPerChunk = 4096;
+
+    std::string filePath;
+    std::ofstream file;
+    int64_t fileSize = 0;
+    std::vector<seriesEntry> series;          // by identifier, in the definitions order
+    std::vector<std::vector<double>> buffers; // rows not written yet of each series, row after row
+    clockType::time_point lastFlush;
+};
+
+} // namespace PNM
+
+#endif // RESULTSSTORE_H
@@ -7,4 +7,204 @@
 
 #include "scopedtimer.h"
 
-std::unordered_map<const char *, std::pair<double, int>> ScopedTimer::profile;
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+std::mutex ScopedTimer::registryMutex;
+std::vector<std::shared_ptr<ScopedTimer::threadProfile>> ScopedTimer::registry;
+std::atomic<bool> ScopedTimer::timeline(false);
+const ScopedTimer::ClockType::time_point ScopedTimer::origin = ScopedTimer::ClockType::now();
+
+ScopedTimer::ScopedTimer(const char *name)
+    : profile_(getThreadProfile()), start_{ClockType::now()}
+{
+  std::lock_guard<std::mutex> lock(profile_.mutex);
+  node_ = getChild(profile_, name);
+  profile_.current = node_;
+}
+
+ScopedTimer::~ScopedTimer()
+{
+  using namespace std::chrono;
+  auto stop = ClockType::now();
+  auto ns = duration_cast<nanoseconds>(stop - start_).count();
+
+  std::lock_guard<std::mutex> lock(profile_.mutex);
+  scopeNode &node = profile_.nodes[node_];
+  node.time += ns;
+  node.calls++;
+  profile_.current = node.parent;
+
+  if (timeline.load(std::memory_order_relaxed))
+    profile_.events.push_back(timelineEvent{node_, duration_cast<nanoseconds>(start_ - origin).count(), ns});
+}
+
+void ScopedTimer::addCounter(const char *name, double value)
+{
+  threadProfile &profile = getThreadProfile();
+  std::lock_guard<std::mutex> lock(profile.mutex);
+  auto inserted = profile.counters.insert({name, counter{0, value, 0}});
+  counter &c = inserted.first->second;
+  c.total += value;
+  c.maximum = std::max(c.maximum, value);
+  c.samples++;
+}
+
+void ScopedTimer::setTimeline(bool value)
+{
+  timeline = value;
+}
+
+ScopedTimer::threadProfile &ScopedTimer::getThreadProfile()
+{
+  thread_local std::shared_ptr<threadProfile> profile;
+  if (!profile)
+  {
+    profile = std::make_shared<threadProfile>();
+    profile->current = 0;
+    profile->nodes.push_back(scopeNode{"", -1, 0, 0, {}});
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    profile->threadIndex = registry.size();
+    registry.push_back(profile);
+  }
+  return *profile;
+}
+
+int ScopedTimer::getChild(threadProfile &profile, const char *name)
+{
+  //Scope names are usually literals: the pointers comparison spares most of the strings comparisons
+  for (int child : profile.nodes[profile.current].children)
+  {
+    const char *childName = profile.nodes[child].name;
+    if (childName == name || std::strcmp(childName, name) == 0)
+      return child;
+  }
+
+  int child = profile.nodes.size();
+  profile.nodes.push_back(scopeNode{name, profile.current, 0, 0, {}});
+  profile.nodes[profile.current].children.push_back(child);
+  return child;
+}
+
+void ScopedTimer::merge(std::map<std::string, std::pair<double, int>> &scopes, std::map<std::string, counter> &counters)
+{
+  //Merge the scopes of all the threads by their path; sorted paths list the children after their parent
+  std::lock_guard<std::mutex> registryLock(registryMutex);
+  for (auto &profile : registry)
+  {
+    std::lock_guard<std::mutex> lock(profile->mutex);
+
+    std::vector<std::string> nodePaths(profile->nodes.size());
+    for (unsigned i = 1; i < profile->nodes.size(); ++i)
+    {
+      const scopeNode &node = profile->nodes[i];
+      nodePaths[i] = node.parent == 0 ? node.name : nodePaths[node.parent] + "/" + node.name;
+      if (node.calls == 0)
+        continue;
+
+      auto &scope = scopes[nodePaths[i]];
+      scope.first += node.time;
+      scope.second += node.calls;
+    }
+
+    for (auto &it : profile->counters)
+    {
+      auto inserted = counters.insert({it.first, it.second});
+      if (inserted.second)
+        continue;
+      counter &c = inserted.first->second;
+      c.total += it.second.total;
+      c.maximum = std::max(c.maximum, it.second.maximum);
+      c.samples += it.second.samples;
+    }
+  }
+}
+
+std::map<std::string, std::pair<double, int>> ScopedTimer::getProfileData()
+{
+  std::map<std::string, std::pair<double, int>> scopes;
+  std::map<std::string, counter> counters;
+  merge(scopes, counters);
+  return scopes;
+}
+
+void ScopedTimer::reset()
+{
+  //The scopes trees are kept: running timers refer to their nodes
+  std::lock_guard<std::mutex> registryLock(registryMutex);
+  for (auto &profile : registry)
+  {
+    std::lock_guard<std::mutex> lock(profile->mutex);
+    for (scopeNode &node : profile->nodes)
+    {
+      node.time = 0;
+      node.calls = 0;
+    }
+    profile->counters.clear();
+    profile->events.clear();
+  }
+}
+
+void ScopedTimer::printProfileData()
+{
+  std::map<std::string, std::pair<double, int>> scopes;
+  std::map<std::string, counter> counters;
+  merge(scopes, counters);
+
+  std::ofstream profileData("Results/Profiling/profileData.txt");
+  profileData << "Function\tCalls\tT (ms)\tAvg. T per Call (ms)" << std::endl;
+  for (auto &it : scopes)
+  {
+    profileData << it.first;
+    profileData << "\t" << it.second.second;
+    profileData << "\t" << it.second.first / 1e6;
+    profileData << "\t" << (it.second.second ? it.second.first / it.second.second / 1e6 : 0);
+    profileData << std::endl;
+  }
+
+  if (!counters.empty())
+  {
+    profileData << std::endl
+                << "Counter\tSamples\tTotal\tAverage\tMax" << std::endl;
+    for (auto &it : counters)
+    {
+      profileData << it.first;
+      profileData << "\t" << it.second.samples;
+      profileData << "\t" << it.second.total;
+      profileData << "\t" << it.second.total / it.second.samples;
+      profileData << "\t" << it.second.maximum;
+      profileData << std::endl;
+    }
+  }
+
+  if (timeline)
+    writeTimeline();
+}
+
+void ScopedTimer::writeTimeline()
+{
+  std::ofstream trace("Results/Profiling/profileTrace.json");
+  trace << std::fixed << std::setprecision(3);
+  trace << "{\"traceEvents\":[";
+
+  bool first = true;
+  std::lock_guard<std::mutex> registryLock(registryMutex);
+  for (auto &profile : registry)
+  {
+    std::lock_guard<std::mutex> lock(profile->mutex);
+    for (const timelineEvent &event : profile->events)
+    {
+      trace << (first ? "\n" : ",\n");
+      trace << "{\"name\":\"" << profile->nodes[event.node].name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << profile->threadIndex
+            << ",\"ts\":" << event.start / 1e3 << ",\"dur\":" << event.duration / 1e3 << "}";
+      first = false;
+    }
+  }
+
+  trace << "\n]}" << std::endl;
+}
@@ -8,58 +8,98 @@
 #ifndef SCOPEDTIMER_H
 #define SCOPEDTIMER_H
 
+#include <atomic>
 #include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <unordered_map>
-#include <iostream>
-#include <fstream>
+#include <vector>
 
 #define MEASURE_FUNCTION() \
   ScopedTimer timer { __func__ }
 
+#define MEASURE_SCOPE(name) \
+  ScopedTimer timer { name }
+
+#define PROFILE_COUNTER(name, value) \
+  ScopedTimer::addCounter(name, value)
+
+// Nested scopes timer. Each thread records its own tree of scopes (a scope is identified by its name and by the
+// scopes enclosing it) and its counters; the threads records are merged when the profile is printed to
+// Results/Profiling/profileData.txt. When the timeline is enabled, every scope is also stored as an event and
+// exported to Results/Profiling/profileTrace.json (Chrome trace format).
 class ScopedTimer
 {
 
 public:
   using ClockType = std::chrono::steady_clock;
 
-  ScopedTimer(const char *func)
-      : function_{func}, start_{ClockType::now()}
-  {
-  }
+  ScopedTimer(const char *name);
+  ~ScopedTimer();
 
   ScopedTimer(const ScopedTimer &) = delete;
   ScopedTimer(ScopedTimer &&) = delete;
   auto operator=(const ScopedTimer &) -> ScopedTimer & = delete;
   auto operator=(ScopedTimer &&) -> ScopedTimer & = delete;
 
-  ~ScopedTimer()
+  // Samples of a named quantity (solver iterations, matrix size...), reported with their total, average and maximum
+  static void addCounter(const char *name, double value);
+  static void setTimeline(bool value);
+  static void printProfileData();
+
+  // Merged scopes, by path: total time (ns) and calls; reset() clears the recorded times, counters and events
+  static std::map<std::string, std::pair<double, int>> getProfileData();
+  static void reset();
+
+private:
+  struct scopeNode
+  {
+    const char *name;
+    int parent;
+    double time;
+    int calls;
+    std::vector<int> children;
+  };
+
+  struct timelineEvent
   {
-    using namespace std::chrono;
-    auto stop = ClockType::now();
-    auto duration = (stop - start_);
-    auto ns = duration_cast<nanoseconds>(duration).count();
-    profile[function_].first += ns;
-    profile[function_].second++;
-  }
-
-  static void printProfileData()
+    int node;
+    long long start;
+    long long duration;
+  };
+
+  struct counter
   {
-    std::ofstream profileData("Results/Profiling/profileData.txt");
-    profileData << "Function\tCalls\tT (ms)\tAvg. T per Call (ms)" << std::endl;
-    for(auto it : ScopedTimer::profile)
-    {
-       profileData << it.first;
-       profileData << "\t" << it.second.second;
-       profileData << "\t" << it.second.first/1e6;
-       profileData << "\t" << it.second.first/it.second.second/1e6;
-       profileData << std::endl;
-    }
-  }
+    double total;
+    double maximum;
+    int samples;
+  };
 
-private:
-  static std::unordered_map<const char *, std::pair<double, int>> profile;
-  const char *function_ = {};
-  const ClockType::time_point start_ = {};
+  struct threadProfile
+  {
+    std::mutex mutex; // only contended while the profile is printed
+    int threadIndex;
+    int current;
+    std::vector<scopeNode> nodes; // nodes[0] is the thread root
+    std::unordered_map<std::string, counter> counters;
+    std::vector<timelineEvent> events;
+  };
+
+  static threadProfile &getThreadProfile();
+  static int getChild(threadProfile &, const char *name);
+  static void merge(std::map<std::string, std::pair<double, int>> &scopes, std::map<std::string, counter> &counters);
+  static void writeTimeline();
+
+  static std::mutex registryMutex;
+  static std::vector<std::shared_ptr<threadProfile>> registry; // kept after the threads exit
+  static std::atomic<bool> timeline;
+  static const ClockType::time_point origin;
+
+  threadProfile &profile_;
+  int node_;
+  const ClockType::time_point start_;
 };
 
 #endif // SCOPEDTIMER_H
@@ -0,0 +1,216 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "taskScheduler.h"
+#include "userInput.h"
+#include "numaPlacement.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace PNM
+{
+
+namespace
+{
+thread_local int currentWorker = -1;
+}
+
+taskScheduler taskScheduler::instance;
+
+taskScheduler &taskScheduler::get()
+{
+    return instance;
+}
+
+taskScheduler::~taskScheduler()
+{
+    cancelAll();
+    waitAll();
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+void taskScheduler::launch(const std::function<void()> &jobFunction, const std::function<void()> &cancel)
+{
+    std::lock_guard<std::mutex> lock(jobsMutex);
+
+    //The finished jobs threads are joined before a new one is started
+    for (auto it = jobs.begin(); it != jobs.end();)
+    {
+        if (*it->finished)
+        {
+            it->thread.join();
+            it = jobs.erase(it);
+        }
+        else
+            ++it;
+    }
+
+    auto finished = std::make_shared<std::atomic<bool>>(false);
+    jobs.push_back(job{std::thread([jobFunction, finished]() {
+                           jobFunction();
+                           *finished = true;
+                       }),
+                       cancel, finished});
+}
+
+void taskScheduler::cancelAll()
+{
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    for (job &runningJob : jobs)
+        if (!*runningJob.finished && runningJob.cancel)
+            runningJob.cancel();
+}
+
+void taskScheduler::waitAll()
+{
+    std::vector<job> finishingJobs;
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        finishingJobs.swap(jobs);
+    }
+    for (job &finishingJob : finishingJobs)
+        finishingJob.thread.join();
+}
+
+void taskScheduler::parallelFor(int count, int maxWorkers, const std::function<void(int)> &task)
+{
+    //Each task takes the next index left, so that long iterations do not hold the others
+    std::atomic<int> next(0);
+    taskGroup group;
+    int tasks = std::min(count, std::max(1, maxWorkers));
+    for (int t = 0; t < tasks; ++t)
+        group.run([&]() {
+            for (int i = next++; i < count; i = next++)
+                task(i);
+        });
+    group.wait();
+}
+
+int taskScheduler::getWorkers()
+{
+    start();
+    return workers.size();
+}
+
+void taskScheduler::start()
+{
+    std::call_once(started, [this]() {
+        int threads = userInput::get().solverThreads > 0 ? userInput::get().solverThreads : std::max(1u, std::thread::hardware_concurrency());
+        for (int i = 0; i < threads; ++i)
+            queues.emplace_back(new workerQueue);
+        for (int i = 0; i < threads; ++i)
+            workers.emplace_back(&taskScheduler::work, this, i);
+    });
+}
+
+void taskScheduler::push(std::function<void()> task)
+{
+    start();
+
+    //Tasks spawned by a worker stay on its deque
+    int queue = currentWorker != -1 ? currentWorker : nextQueue++ % queues.size();
+    {
+        std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+        queues[queue]->tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queuedTasks++;
+    }
+    taskAvailable.notify_one();
+}
+
+bool taskScheduler::runQueuedTask()
+{
+    if (queuedTasks == 0)
+        return false;
+
+    std::function<void()> task;
+    int queuesNumber = queues.size();
+    int self = currentWorker;
+    if (self != -1)
+    {
+        std::lock_guard<std::mutex> lock(queues[self]->mutex);
+        if (!queues[self]->tasks.empty())
+        {
+            task = std::move(queues[self]->tasks.back());
+            queues[self]->tasks.pop_back();
+        }
+    }
+
+    for (int k = 1; !task && k <= queuesNumber; ++k)
+    {
+        int victim = ((self == -1 ? 0 : self) + k) % queuesNumber;
+        std::lock_guard<std::mutex> lock(queues[victim]->mutex);
+        if (!queues[victim]->tasks.empty())
+        {
+            task = std::move(queues[victim]->tasks.front());
+            queues[victim]->tasks.pop_front();
+        }
+    }
+
+    if (!task)
+        return false;
+
+    queuedTasks--;
+    task();
+    return true;
+}
+
+void taskScheduler::work(int index)
+{
+    currentWorker = index;
+    numaPlacement::pinCurrentThread(index);
+    while (true)
+    {
+        if (runQueuedTask())
+            continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        taskAvailable.wait(lock, [this] { return stopping || queuedTasks > 0; });
+        if (stopping && queuedTasks == 0)
+            return;
+    }
+}
+
+void taskScheduler::taskGroup::run(const std::function<void()> &task)
+{
+    pending++;
+    taskScheduler::get().push([this, task]() {
+        task();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0)
+            done.notify_all();
+    });
+}
+
+void taskScheduler::taskGroup::wait()
+{
+    //Queued tasks are run while waiting, those of this group or not
+    while (pending > 0)
+    {
+        if (taskScheduler::get().runQueuedTask())
+            continue;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait_for(lock, std::chrono::milliseconds(1), [this] { return pending == 0; });
+    }
+
+    //The last task releases the mutex once it has notified: the group can then be destroyed
+    std::lock_guard<std::mutex> lock(mutex);
+}
+
+} // namespace PNM
@@ -0,0 +1,100 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace PNM
+{
+
+// Threads of the application, owned in one place.
+// - Jobs (network builds, simulations, rendering) run on their own thread until they finish; they are joined, and
+//   cancelled through their cancel function (simulation::interrupt), when the application closes.
+// - Tasks run on a pool of workers, each with its own deque: a worker takes its newest task first and steals the
+//   oldest ones of the others when idle. A taskGroup waits for its tasks while running queued ones itself, so that
+//   nested groups do not starve the pool. The pool is started on first use with solverThreads workers (0: one per core).
+//   With numaAware, worker i is pinned to the i-th core.
+// The numerical loops and their reductions (reproducibleSum.h) are parallelised with OpenMP within the tasks and jobs.
+class taskScheduler
+{
+  public:
+    static taskScheduler &get();
+    void launch(const std::function<void()> &job, const std::function<void()> &cancel = nullptr);
+    void cancelAll();
+    void waitAll();
+    void parallelFor(int count, int maxWorkers, const std::function<void(int)> &task);
+    int getWorkers();
+
+    class taskGroup
+    {
+      public:
+        taskGroup() : pending(0) {}
+        ~taskGroup() { wait(); }
+        taskGroup(const taskGroup &) = delete;
+        auto operator=(const taskGroup &) -> taskGroup & = delete;
+        void run(const std::function<void()> &);
+        void wait();
+
+      protected:
+        std::atomic<int> pending;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+
+  protected:
+    taskScheduler() : queuedTasks(0), nextQueue(0), stopping(false) {}
+    ~taskScheduler();
+    taskScheduler(const taskScheduler &) = delete;
+    taskScheduler(taskScheduler &&) = delete;
+    auto operator=(const taskScheduler &) -> taskScheduler & = delete;
+    auto operator=(taskScheduler &&) -> taskScheduler & = delete;
+
+    struct job
+    {
+        std::thread thread;
+        std::function<void()> cancel;
+        std::shared_ptr<std::atomic<bool>> finished;
+    };
+
+    struct workerQueue
+    {
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+    };
+
+    void start();
+    void push(std::function<void()>);
+    bool runQueuedTask();
+    void work(int);
+
+    static taskScheduler instance;
+
+    std::vector<job> jobs;
+    std::mutex jobsMutex;
+
+    std::vector<std::unique_ptr<workerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::once_flag started;
+    std::atomic<int> queuedTasks;
+    std::atomic<unsigned> nextQueue;
+    bool stopping;
+    std::mutex sleepMutex;
+    std::condition_variable taskAvailable;
+};
+
+} // namespace PNM
+
+#endif // TASKSCHEDULER_H
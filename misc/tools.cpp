@@ -6,6 +6,8 @@
 /////////////////////////////////////////////////////////////////////////////
 
 #include "tools.h"
+#include "outputWriter.h"
+#include "videoEncoder.h"
 
 #include <QDir>
 
@@ -25,6 +27,8 @@ void createRequiredFolders()
 
 void initialiseFolder(std::string path)
 {
+    //Pending writes could otherwise land in the cleaned folder
+    PNM::outputWriter::get().close();
     createFolder(path);
     cleanFolder(path);
 }
@@ -52,12 +56,11 @@ void cleanVideosFolder()
 
 void renderVideo(int fps)
 {
+    //Encodes the PNG frames kept in the Videos folder; streamed captures are encoded while rendering
 #if defined(_WIN32)
-    // Windows
-    std::string command = "ffmpeg\\ffmpeg -framerate " + std::to_string(fps) + " -i Videos\\IMG%7d.png -y  Videos\\video.mp4 > nul 2>&1 2>&1";
-#elif defined(__unix__) || defined(__unix) || defined(unix) || (defined(__APPLE__) && defined(__MACH__))
-    // AIX, BSD, Cygwin, HP-UX, Linux, OSX, and Solaris
-    std::string command = "./ffmpeg/ffmpeg -framerate " + std::to_string(fps) + " -i Videos\\IMG%7d.png -y  Videos/video.mp4 > /dev/null 2>&1";
+    std::string command = PNM::videoEncoder::getExecutable() + " -framerate " + std::to_string(fps) + " -i Videos\\IMG%7d.png -y  Videos\\video.mp4 > nul 2>&1";
+#else
+    std::string command = PNM::videoEncoder::getExecutable() + " -framerate " + std::to_string(fps) + " -i Videos/IMG%7d.png -y  Videos/video.mp4 > /dev/null 2>&1";
 #endif
     system(command.c_str());
 }
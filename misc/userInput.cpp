@@ -7,6 +7,7 @@
 
 #include "userInput.h"
 #include "maths.h"
+#include "operations/simulationContext.h"
 
 #include <libs/boost/property_tree/ptree.hpp>
 #include <libs/boost/property_tree/ini_parser.hpp>
@@ -14,27 +15,29 @@
 namespace PNM
 {
 
-userInput::userInput()
+userInput::userInput() : resultsFolder("Results"), networkStateFolder("Network_State")
 {
 }
 
-userInput userInput::instance;
-
 userInput &userInput::get()
 {
-    return instance;
+    return simulationContext::current().parameters;
 }
 
-void userInput::loadNetworkData()
+void userInput::loadNetworkData(const parameterOverrides &overrides)
 {
     boost::property_tree::ptree pt;
     boost::property_tree::ini_parser::read_ini("Input_Data/Parameters.txt", pt);
+    for (auto &value : overrides)
+        pt.put(value.first, value.second);
 
     networkRegular = pt.get<bool>("NetworkGeneration_Source.networkRegular");
     networkStatoil = pt.get<bool>("NetworkGeneration_Source.networkStatoil");
     networkNumscal = pt.get<bool>("NetworkGeneration_Source.networkNumscal");
     extractedNetworkFolderPath = pt.get<std::string>("NetworkGeneration_Source.extractedNetworkPath");
     rockPrefix = pt.get<std::string>("NetworkGeneration_Source.rockPrefix");
+    networkCache = pt.get<bool>("NetworkGeneration_Source.networkCache", false);
+    networkOrdering = (elementsOrdering)pt.get<int>("NetworkGeneration_Source.networkOrdering", 0);
 
     Nx = pt.get<int>("NetworkGeneration_Geometry.Nx");
     Ny = pt.get<int>("NetworkGeneration_Geometry.Ny");
@@ -55,6 +58,15 @@ void userInput::loadNetworkData()
     aspectRatio = pt.get<double>("NetworkGeneration_Geometry.aspectRatio");
     length = pt.get<double>("NetworkGeneration_Geometry.length") * 1e-6;
     seed = pt.get<int>("NetworkGeneration_Geometry.seed");
+    parallelLattice = pt.get<bool>("NetworkGeneration_Geometry.parallelLattice", false);
+    counterBasedRandom = pt.get<bool>("NetworkGeneration_Geometry.counterBasedRandom", false);
+    subVolume = pt.get<bool>("NetworkGeneration_Geometry.subVolume", false);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        std::string suffix(1, "XYZ"[axis]);
+        subVolumeMin[axis] = pt.get<double>("NetworkGeneration_Geometry.subVolumeMin" + suffix, 0);
+        subVolumeMax[axis] = pt.get<double>("NetworkGeneration_Geometry.subVolumeMax" + suffix, 1);
+    }
 
     wettability = (networkWettability)pt.get<int>("NetworkGeneration_Wettability.wettabilityFlag");
     minWaterWetTheta = pt.get<double>("NetworkGeneration_Wettability.minWaterWetTheta") * (maths::pi() / 180.);
@@ -65,10 +77,12 @@ void userInput::loadNetworkData()
     shapeFactor = pt.get<double>("NetworkGeneration_Wettability.shapeFactor");
 }
 
-void userInput::loadSimulationData()
+void userInput::loadSimulationData(const parameterOverrides &overrides)
 {
     boost::property_tree::ptree pt;
     boost::property_tree::ini_parser::read_ini("Input_Data/Parameters.txt", pt);
+    for (auto &value : overrides)
+        pt.put(value.first, value.second);
 
     twoPhaseSS = pt.get<bool>("FluidInjection_Cycles.twoPhaseSS");
     drainageUSS = pt.get<bool>("FluidInjection_Cycles.drainageUSS");
@@ -82,6 +96,7 @@ void userInput::loadSimulationData()
 
     twoPhaseSimulationSteps = pt.get<int>("FluidInjection_SS.twoPhaseSimulationSteps");
     filmConductanceResistivity = pt.get<double>("FluidInjection_SS.filmConductanceResistivity");
+    reverseTrapping = pt.get<bool>("FluidInjection_SS.reverseTrapping", false);
     relativePermeabilitiesCalculation = pt.get<bool>("FluidInjection_SS.relativePermeabilitiesCalculation");
     extractDataSS = pt.get<bool>("FluidInjection_SS.extractDataSS");
 
@@ -90,7 +105,15 @@ void userInput::loadSimulationData()
     overrideByInjectedPVs = pt.get<bool>("FluidInjection_USS.overrideByInjectedPVs");
     injectedPVs = pt.get<double>("FluidInjection_USS.injectedPVs");
     tracerDiffusionCoef = pt.get<double>("FluidInjection_USS.tracerDiffusionCoef");
+    tracerSchemeChoice = (tracerScheme)pt.get<int>("FluidInjection_USS.tracerScheme", 0);
+    tracerTimeStepFactor = pt.get<double>("FluidInjection_USS.tracerTimeStepFactor", 1);
+    tracerRateLevels = pt.get<int>("FluidInjection_USS.tracerRateLevels", 6);
     extractDataUSS = pt.get<bool>("FluidInjection_USS.extractDataUSS");
+    maxFillingEventsPerStep = pt.get<int>("FluidInjection_USS.maxFillingEventsPerStep", 1);
+    fillingTimeTolerance = pt.get<double>("FluidInjection_USS.fillingTimeTolerance", 0);
+    maxTimeSteps = pt.get<int>("FluidInjection_USS.maxTimeSteps", 0);
+    convergenceTolerance = pt.get<double>("FluidInjection_USS.convergenceTolerance", 0);
+    convergenceIntervals = pt.get<int>("FluidInjection_USS.convergenceIntervals", 5);
 
     oilViscosity = pt.get<double>("FluidInjection_Fluids.oilViscosity") * 1e-3;
     waterViscosity = pt.get<double>("FluidInjection_Fluids.waterViscosity") * 1e-3;
@@ -100,12 +123,33 @@ void userInput::loadSimulationData()
     WGSurfaceTension = pt.get<double>("FluidInjection_Fluids.WGSurfaceTension") * 1e-3;
     initialWaterSaturation = pt.get<double>("FluidInjection_Fluids.initialWaterSaturation");
     waterDistribution = (swi)pt.get<int>("FluidInjection_Fluids.waterDistribution");
+    primaryDrainageCache = pt.get<bool>("FluidInjection_Fluids.primaryDrainageCache", false);
 
     solverChoice = (solver)pt.get<int>("FluidInjection_Misc.solverChoice");
+    memoryPreflight = pt.get<bool>("FluidInjection_Misc.memoryPreflight", true);
+    parallelSolver = pt.get<bool>("FluidInjection_Misc.parallelSolver", false);
+    solverThreads = pt.get<int>("FluidInjection_Misc.solverThreads", 0);
+    numaAware = pt.get<bool>("FluidInjection_Misc.numaAware", false);
+    solverDomains = pt.get<int>("FluidInjection_Misc.solverDomains", 8);
+    maxLowRankUpdates = pt.get<int>("FluidInjection_Misc.maxLowRankUpdates", 0);
+    concurrentRelativePermeabilities = pt.get<bool>("FluidInjection_Misc.concurrentRelativePermeabilities", false);
+    relativePermeabilityUpdates = pt.get<int>("FluidInjection_Misc.relativePermeabilityUpdates", 0);
+    cachedRelativePermeabilities = pt.get<bool>("FluidInjection_Misc.cachedRelativePermeabilities", false);
+    directionalPermeabilities = pt.get<bool>("FluidInjection_Misc.directionalPermeabilities", false);
+    reducedPressureSystem = pt.get<bool>("FluidInjection_Misc.reducedPressureSystem", false);
+    condensedPressureSystem = pt.get<bool>("FluidInjection_Misc.condensedPressureSystem", false);
 
     pathToNetworkStateFiles = pt.get<std::string>("FluidInjection_Postprocessing.pathToNetworkStateFiles");
     rendererFPS = pt.get<int>("FluidInjection_Postprocessing.rendererFPS");
     keepFrames = pt.get<bool>("FluidInjection_Postprocessing.keepFrames");
+    binaryNetworkStates = pt.get<bool>("FluidInjection_Postprocessing.binaryNetworkStates", false);
+    compressNetworkStates = pt.get<bool>("FluidInjection_Postprocessing.compressNetworkStates", true);
+    asynchronousOutput = pt.get<bool>("FluidInjection_Postprocessing.asynchronousOutput", true);
+    profileTimeline = pt.get<bool>("FluidInjection_Postprocessing.profileTimeline", false);
+    checkpointInterval = pt.get<double>("FluidInjection_Postprocessing.checkpointInterval", 0);
+    resumeSimulation = pt.get<bool>("FluidInjection_Postprocessing.resumeSimulation", false);
+    storeResults = pt.get<bool>("FluidInjection_Postprocessing.storeResults", false);
+    resultsEveryTimeStep = pt.get<bool>("FluidInjection_Postprocessing.resultsEveryTimeStep", false);
 }
 
 } // namespace PNM
@@ -9,6 +9,8 @@
 #define USERINPUT_H
 
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace PNM
 {
@@ -41,15 +43,36 @@ enum class swi
 enum class solver
 {
     cholesky = 1,
-    conjugateGradient = 2
+    conjugateGradient = 2,
+    preconditionedConjugateGradient = 3,
+    domainDecomposition = 4,
+    mixedPrecision = 5
 };
 
+enum class elementsOrdering
+{
+    none = 0,
+    reverseCuthillMcKee = 1,
+    morton = 2
+};
+
+enum class tracerScheme
+{
+    explicitEuler = 0,
+    implicitEuler = 1,
+    crankNicolson = 2,
+    multirateExplicit = 3
+};
+
+// "Section.key" values replacing those of the parameters file
+using parameterOverrides = std::vector<std::pair<std::string, std::string>>;
+
 class userInput
 {
   public:
     static userInput &get();
-    void loadNetworkData();
-    void loadSimulationData();
+    void loadNetworkData(const parameterOverrides & = parameterOverrides());
+    void loadSimulationData(const parameterOverrides & = parameterOverrides());
 
     //Network Data
     double minRadius;
@@ -78,12 +101,31 @@ class userInput
     int Nz;
     psd poreSizeDistribution;
     solver solverChoice;
+    bool parallelSolver;
+    int solverThreads;
+    bool numaAware; // kernels threads pinned to cores, and the arrays they stream placed on the memory of their owner threads
+    int solverDomains; // subdomains of the domain decomposition solver
+    bool memoryPreflight; // networks whose estimated footprint exceeds the available memory are refused, or solved with a leaner solver
+    int maxLowRankUpdates;
+    bool concurrentRelativePermeabilities; // oil and water relative permeability systems solved at the same time
+    bool cachedRelativePermeabilities; // relative permeabilities of an already evaluated phases configuration taken from the process cache
+    int relativePermeabilityUpdates; // > 0: oil and water systems kept between relative permeability evaluations, updated by up to this many pores before a refactorization
+    bool directionalPermeabilities; // permeability tensor and directional relative permeabilities, from linear pressure conditions on the six faces
+    bool reducedPressureSystem; // pressures solved over the nodes connected to the boundaries only, the others being set directly
+    bool condensedPressureSystem; // compacted system without its series chains and dead-end branches, whose pressures are interpolated back
     networkWettability wettability;
     bool networkRegular;
     bool networkStatoil;
     bool networkNumscal;
     std::string extractedNetworkFolderPath;
     std::string rockPrefix;
+    bool networkCache; // built networks are saved to, and loaded from, a binary snapshot
+    elementsOrdering networkOrdering; // renumbering of the built networks nodes and pores, for locality and less fill-in
+    bool parallelLattice; // regular networks generated in parallel from flat arrays, with counter-based random draws
+    bool counterBasedRandom; // radii, distortion, wettabilities and Swi drawn per element, in parallel
+    bool subVolume; // simulations run on the sub-network carved from the box below, the full network being cached
+    double subVolumeMin[3]; // lower corner of the box, as fractions of the network extents along x, y and z
+    double subVolumeMax[3]; // upper corner of the box, as fractions of the network extents along x, y and z
 
     //Simulation Data
 
@@ -103,6 +145,7 @@ class userInput
     bool extractDataSS;
     int twoPhaseSimulationSteps;
     double filmConductanceResistivity;
+    bool reverseTrapping; // primary drainage trapping labelled in one reverse union-find pass over the invasion order, instead of clustering each round
 
     //USS / Tracer
     double flowRate;
@@ -111,7 +154,15 @@ class userInput
     double injectedPVs;
     bool enhancedWaterConnectivity;
     double tracerDiffusionCoef;
+    tracerScheme tracerSchemeChoice; // tracer transport time integration
+    double tracerTimeStepFactor;     // implicit schemes: time step as a multiple of the explicit stability limit
+    int tracerRateLevels;            // multirate scheme: time step halvings allowed below the step of the slowest capillaries
     bool extractDataUSS;
+    int maxFillingEventsPerStep; // capillaries allowed to fill within one time step (1: a pressure solve per filling)
+    double fillingTimeTolerance; // relative excess over the shortest filling time allowed for the other fillings of the step
+    int maxTimeSteps;            // USS and tracer simulations stopped after this number of time steps (0: no limit)
+    double convergenceTolerance; // USS (Sw and Fw) and tracer (outlet concentration) runs stopped once their slopes per PV stay under it (0: never)
+    int convergenceIntervals;    // consecutive output intervals the slopes have to stay under the tolerance
     double oilViscosity;
     double waterViscosity;
     double gasViscosity;
@@ -120,6 +171,7 @@ class userInput
     double WGSurfaceTension;
     double initialWaterSaturation;
     swi waterDistribution;
+    bool primaryDrainageCache; // Swi after primary drainage: the drained fluid state is saved to, and loaded from, a binary file
 
     //Template
     ///////////////////////////////////
@@ -128,10 +180,22 @@ class userInput
     std::string pathToNetworkStateFiles;
     int rendererFPS;
     bool keepFrames;
+    bool binaryNetworkStates;   // network state frames written as .numsb files instead of .nums text files
+    bool compressNetworkStates; // binary frames stored as differences with the previous frame, without zero runs
+    bool asynchronousOutput;    // results files and network states written by a background thread
+    bool profileTimeline;       // profiled scopes also exported as a Chrome trace
+    double checkpointInterval;  // seconds between the checkpoints of the USS and tracer simulations, and SS checkpoints after each stage (0: none)
+    bool resumeSimulation;      // simulations resumed from their last checkpoint, appending to the existing results
+    bool storeResults;          // numeric results stored in a results.numr store per results folder instead of text files
+    bool resultsEveryTimeStep;  // USS results rows written at each time step instead of every 0.01 PV
+
+    //Output folders (not read from the parameters file)
+    std::string resultsFolder;
+    std::string networkStateFolder;
 
   private:
     userInput();
-    static userInput instance;
+    friend class simulationContext;
 };
 
 } // namespace PNM
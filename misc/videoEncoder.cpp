@@ -0,0 +1,85 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "videoEncoder.h"
+
+#if defined(_WIN32)
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace PNM
+{
+
+videoEncoder videoEncoder::instance;
+
+videoEncoder &videoEncoder::get()
+{
+    return instance;
+}
+
+videoEncoder::~videoEncoder()
+{
+    close();
+}
+
+std::string videoEncoder::getExecutable()
+{
+#if defined(_WIN32)
+    return "ffmpeg\\ffmpeg";
+#else
+    return "./ffmpeg/ffmpeg";
+#endif
+}
+
+bool videoEncoder::open(const std::string &path, int width, int height, int fps)
+{
+    close();
+
+#if defined(_WIN32)
+    std::string silent = " > nul 2>&1";
+    const char *mode = "wb";
+#else
+    std::string silent = " > /dev/null 2>&1";
+    const char *mode = "w";
+#endif
+
+    //Raw frames on the standard input, flipped to the top-down order of the video
+    std::string command = getExecutable() + " -f rawvideo -pix_fmt rgba -s " + std::to_string(width) + "x" + std::to_string(height) +
+                          " -framerate " + std::to_string(fps) + " -i - -vf vflip -y " + path + silent;
+
+    pipe = popen(command.c_str(), mode);
+    frameSize = pipe ? size_t(width) * height * 4 : 0;
+    return pipe != nullptr;
+}
+
+void videoEncoder::write(const unsigned char *rgba)
+{
+    if (!pipe)
+        return;
+
+    //A failed write means the encoder exited: the remaining frames are dropped
+    if (fwrite(rgba, 1, frameSize, pipe) != frameSize)
+        close();
+}
+
+void videoEncoder::close()
+{
+    if (!pipe)
+        return;
+
+    pclose(pipe);
+    pipe = nullptr;
+    frameSize = 0;
+}
+
+bool videoEncoder::isOpen() const
+{
+    return pipe != nullptr;
+}
+
+} // namespace PNM
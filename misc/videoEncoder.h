@@ -0,0 +1,44 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef VIDEOENCODER_H
+#define VIDEOENCODER_H
+
+#include <cstdio>
+#include <string>
+
+namespace PNM
+{
+
+// Video encoder fed with raw RGBA frames: the frames are streamed over a pipe to an ffmpeg process, which encodes
+// them as they arrive. Frames are expected bottom-up, as read back from OpenGL.
+class videoEncoder
+{
+  public:
+    static videoEncoder &get();
+    static std::string getExecutable();
+    bool open(const std::string &path, int width, int height, int fps);
+    void write(const unsigned char *rgba);
+    void close();
+    bool isOpen() const;
+
+  protected:
+    videoEncoder() : pipe(nullptr), frameSize(0) {}
+    ~videoEncoder();
+    videoEncoder(const videoEncoder &) = delete;
+    videoEncoder(videoEncoder &&) = delete;
+    auto operator=(const videoEncoder &) -> videoEncoder & = delete;
+    auto operator=(videoEncoder &&) -> videoEncoder & = delete;
+
+    static videoEncoder instance;
+    FILE *pipe;
+    size_t frameSize;
+};
+
+} // namespace PNM
+
+#endif // VIDEOENCODER_H
@@ -7,15 +7,67 @@
 
 #include "cluster.h"
 
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
 namespace PNM
 {
 
+cluster **cluster::registry[cluster::maxBlocks] = {};
+
+namespace
+{
+
+std::mutex registryMutex;
+std::vector<uint32_t> freeHandles;
+uint32_t nextHandle = 1; // handle 0 is kept for 'no cluster'
+
+} // namespace
+
 cluster::cluster(int pLabel)
 {
     id = pLabel;
     inlet = false;
     outlet = false;
     spanning = false;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (!freeHandles.empty())
+    {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    }
+    else
+    {
+        if ((nextHandle >> blockBits) >= maxBlocks)
+            throw std::invalid_argument("Too many clusters.\n");
+        cluster **&block = registry[nextHandle >> blockBits];
+        if (!block)
+            block = new cluster *[blockMask + 1]();
+        handle = nextHandle++;
+    }
+    registry[handle >> blockBits][handle & blockMask] = this;
+}
+
+cluster::~cluster()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry[handle >> blockBits][handle & blockMask] = nullptr;
+    freeHandles.push_back(handle);
+}
+
+cluster *clusterPool::acquire(int id)
+{
+    while (clusters.size() < unsigned(id))
+        clusters.emplace_back(int(clusters.size()) + 1);
+
+    cluster *c = &clusters[id - 1];
+    c->setId(id);
+    c->setInlet(false);
+    c->setOutlet(false);
+    c->setSpanning(false);
+    return c;
 }
 
 bool cluster::getInlet() const
@@ -8,6 +8,9 @@
 #ifndef CLUSTER_H
 #define CLUSTER_H
 
+#include <cstdint>
+#include <deque>
+
 namespace PNM
 {
 
@@ -15,7 +18,7 @@ class cluster
 {
 public:
   cluster(int);
-  ~cluster() {}
+  ~cluster();
   cluster(const cluster &) = delete;
   cluster(cluster &&) = delete;
   auto operator=(const cluster &) -> cluster & = delete;
@@ -33,11 +36,36 @@ public:
   bool getSpanning() const;
   void setSpanning(bool value);
 
+  // Elements refer to their clusters by 32 bits handles, 0 standing for no cluster; the handle of a destroyed
+  // cluster is recycled for the next one
+  static uint32_t getHandle(const cluster *c) { return c ? c->handle : 0; }
+  static cluster *fromHandle(uint32_t value) { return value ? registry[value >> blockBits][value & blockMask] : nullptr; }
+
 private:
+  static const unsigned blockBits = 16;
+  static const uint32_t blockMask = (1u << blockBits) - 1;
+  static const unsigned maxBlocks = 1u << 14;
+
+  // Clusters by handle, in blocks which are never moved so that lookups can run concurrently with the
+  // registrations (handles are only given out once their block exists)
+  static cluster **registry[maxBlocks];
+
   int id;        //cluster id
   bool inlet;    // flag on whether the cluster is connected to the inlet
   bool outlet;   // flag on whether the cluster is connected to the outlet
   bool spanning; // flag on whether the cluster is spanning
+  uint32_t handle; // position in the registry
+};
+
+// Clusters storage reused between clusterings: the cluster of id i is the entry i - 1 of the pool. Dropped clusters
+// keep their object (and handle) for the next clustering, which resets them when acquiring them again.
+class clusterPool
+{
+public:
+  cluster *acquire(int id);
+
+private:
+  std::deque<cluster> clusters; // stable addresses, in blocks
 };
 
 } // namespace PNM
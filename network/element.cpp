@@ -6,41 +6,31 @@
 /////////////////////////////////////////////////////////////////////////////
 
 #include "element.h"
-#include "cluster.h"
 
 namespace PNM
 {
 
 element::element()
 {
+    index = -1;
     radius = 0;
-    length = 0;
     theta = 0;
-    wettabilityFlag = wettability::oilWet;
-    phaseFlag = phase::oil;
+    entryPressure = 0;
+    flags = activeBit;
+    setWettabilityFlag(wettability::oilWet);
+    setPhaseFlag(phase::oil);
     volume = 0;
     capillaryPressure = 0;
     viscosity = 1;
     conductivity = 0;
     concentration = 0;
     flow = 0;
-    closed = false;
-    active = true;
-    inlet = false;
-    outlet = false;
 
-    clusterTemp = 0;
-    clusterOil = 0;
-    clusterWater = 0;
-    clusterOilWet = 0;
-    clusterWaterWet = 0;
+    geometry = nullptr;
+    clusters = nullptr;
 
     oilFraction = 1;
     waterFraction = 0;
-
-    beta1 = 0;
-    beta2 = 0;
-    beta3 = 0;
 }
 
 } // namespace PNM
@@ -8,6 +8,9 @@
 #ifndef ELEMENT_H
 #define ELEMENT_H
 
+#include "cluster.h"
+
+#include <cstdint>
 #include <vector>
 
 namespace PNM
@@ -32,7 +35,30 @@ enum class capillaryType
     poreBody
 };
 
-class cluster;
+// Geometry read when the element is set up and when its wettability changes, kept apart from the state the
+// simulations sweep over at every step
+struct elementGeometry
+{
+    double length = 0;                      // capillary length (SI)
+    double shapeFactor = 0;                 // capillary shape factor (dimensionless)
+    double shapeFactorConstant = 0;         // capillary shape factor constant (dimensionless)
+    double entryPressureCoefficient = 0;    // 1 + 2 * sqrt(pi * shapeFactor)
+    double beta1 = 0, beta2 = 0, beta3 = 0; // half angles in the capillary
+    double filmAreaCoefficient = 0;         // a mathematical coefficient used in the calculation of film area (Oren, 98)
+};
+
+// Clustering scratch: clusters handles (0 when unassigned), only touched by the clustering passes
+struct elementClusters
+{
+    int temp = 0;
+    uint32_t waterWet = 0;
+    uint32_t oilWet = 0;
+    uint32_t water = 0;
+    uint32_t oil = 0;
+    uint32_t waterFilm = 0;
+    uint32_t oilFilm = 0;
+    uint32_t active = 0;
+};
 
 class element
 {
@@ -47,34 +73,40 @@ class element
     int getId() const { return id; }
     void setId(int value) { id = value; }
 
-    capillaryType getType() const { return type; }
+    int getIndex() const { return index; }
+    void setIndex(int value) { index = value; }
+
+    capillaryType getType() const { return getFlag(poreBodyBit) ? capillaryType::poreBody : capillaryType::throat; }
 
-    bool getActive() const { return active; }
-    void setActive(bool value) { active = value; }
+    bool getActive() const { return getFlag(activeBit); }
+    void setActive(bool value) { setFlag(activeBit, value); }
 
-    bool getInlet() const { return inlet; }
-    void setInlet(bool value) { inlet = value; }
+    bool getInlet() const { return getFlag(inletBit); }
+    void setInlet(bool value) { setFlag(inletBit, value); }
 
-    bool getOutlet() const { return outlet; }
-    void setOutlet(bool value) { outlet = value; }
+    bool getOutlet() const { return getFlag(outletBit); }
+    void setOutlet(bool value) { setFlag(outletBit, value); }
 
     double getRadius() const { return radius; }
     void setRadius(double value) { radius = value; }
 
-    double getLength() const { return length; }
-    void setLength(double value) { length = value; }
+    double getLength() const { return geometry->length; }
+    void setLength(double value) { geometry->length = value; }
 
     double getVolume() const { return volume; }
     void setVolume(double value) { volume = value; }
 
-    double getShapeFactor() const { return shapeFactor; }
-    void setShapeFactor(double value) { shapeFactor = value; }
+    double getShapeFactor() const { return geometry->shapeFactor; }
+    void setShapeFactor(double value) { geometry->shapeFactor = value; }
+
+    double getShapeFactorConstant() const { return geometry->shapeFactorConstant; }
+    void setShapeFactorConstant(double value) { geometry->shapeFactorConstant = value; }
 
-    double getShapeFactorConstant() const { return shapeFactorConstant; }
-    void setShapeFactorConstant(double value) { shapeFactorConstant = value; }
+    double getEntryPressureCoefficient() const { return geometry->entryPressureCoefficient; }
+    void setEntryPressureCoefficient(double value) { geometry->entryPressureCoefficient = value; }
 
-    double getEntryPressureCoefficient() const { return entryPressureCoefficient; }
-    void setEntryPressureCoefficient(double value) { entryPressureCoefficient = value; }
+    double getEntryPressure() const { return entryPressure; }
+    void setEntryPressure(double value) { entryPressure = value; }
 
     double getConductivity() const { return conductivity; }
     void setConductivity(double value) { conductivity = value; }
@@ -88,11 +120,11 @@ class element
     double getOriginalTheta() const { return originalTheta; }
     void setOriginalTheta(double value) { originalTheta = value; }
 
-    wettability getWettabilityFlag() const { return wettabilityFlag; }
-    void setWettabilityFlag(wettability value) { wettabilityFlag = value; }
+    wettability getWettabilityFlag() const { return static_cast<wettability>(getField(wettabilityShift)); }
+    void setWettabilityFlag(wettability value) { setField(wettabilityShift, static_cast<uint32_t>(value)); }
 
-    phase getPhaseFlag() const { return phaseFlag; }
-    void setPhaseFlag(phase value) { phaseFlag = value; }
+    phase getPhaseFlag() const { return static_cast<phase>(getField(phaseShift)); }
+    void setPhaseFlag(phase value) { setField(phaseShift, static_cast<uint32_t>(value)); }
 
     double getConcentration() const { return concentration; }
     void setConcentration(double value) { concentration = value; }
@@ -106,11 +138,11 @@ class element
     double getWaterFraction() const { return waterFraction; }
     void setWaterFraction(double value) { waterFraction = value; }
 
-    bool getWaterTrapped() const { return waterTrapped; }
-    void setWaterTrapped(bool value) { waterTrapped = value; }
+    bool getWaterTrapped() const { return getFlag(waterTrappedBit); }
+    void setWaterTrapped(bool value) { setFlag(waterTrappedBit, value); }
 
-    bool getOilTrapped() const { return oilTrapped; }
-    void setOilTrapped(bool value) { oilTrapped = value; }
+    bool getOilTrapped() const { return getFlag(oilTrappedBit); }
+    void setOilTrapped(bool value) { setFlag(oilTrappedBit, value); }
 
     double getFlow() const { return flow; }
     void setFlow(double value) { flow = value; }
@@ -118,14 +150,14 @@ class element
     double getMassFlow() const { return massFlow; }
     void setMassFlow(double value) { massFlow = value; }
 
-    double getBeta1() const { return beta1; }
-    void setBeta1(double value) { beta1 = value; }
+    double getBeta1() const { return geometry->beta1; }
+    void setBeta1(double value) { geometry->beta1 = value; }
 
-    double getBeta2() const { return beta2; }
-    void setBeta2(double value) { beta2 = value; }
+    double getBeta2() const { return geometry->beta2; }
+    void setBeta2(double value) { geometry->beta2 = value; }
 
-    double getBeta3() const { return beta3; }
-    void setBeta3(double value) { beta3 = value; }
+    double getBeta3() const { return geometry->beta3; }
+    void setBeta3(double value) { geometry->beta3 = value; }
 
     double getEffectiveVolume() const { return effectiveVolume; }
     void setEffectiveVolume(double value) { effectiveVolume = value; }
@@ -136,26 +168,26 @@ class element
     double getWaterFilmVolume() const { return waterFilmVolume; }
     void setWaterFilmVolume(double value) { waterFilmVolume = value; }
 
-    double getFilmAreaCoefficient() const { return filmAreaCoefficient; }
-    void setFilmAreaCoefficient(double value) { filmAreaCoefficient = value; }
+    double getFilmAreaCoefficient() const { return geometry->filmAreaCoefficient; }
+    void setFilmAreaCoefficient(double value) { geometry->filmAreaCoefficient = value; }
 
-    bool getOilCanFlowViaFilm() const { return oilCanFlowViaFilm; }
-    void setOilCanFlowViaFilm(bool value) { oilCanFlowViaFilm = value; }
+    bool getOilCanFlowViaFilm() const { return getFlag(oilCanFlowViaFilmBit); }
+    void setOilCanFlowViaFilm(bool value) { setFlag(oilCanFlowViaFilmBit, value); }
 
-    bool getWaterCanFlowViaFilm() const { return waterCanFlowViaFilm; }
-    void setWaterCanFlowViaFilm(bool value) { waterCanFlowViaFilm = value; }
+    bool getWaterCanFlowViaFilm() const { return getFlag(waterCanFlowViaFilmBit); }
+    void setWaterCanFlowViaFilm(bool value) { setFlag(waterCanFlowViaFilmBit, value); }
 
-    bool getWaterCornerActivated() const { return waterCornerActivated; }
-    void setWaterCornerActivated(bool value) { waterCornerActivated = value; }
+    bool getWaterCornerActivated() const { return getFlag(waterCornerActivatedBit); }
+    void setWaterCornerActivated(bool value) { setFlag(waterCornerActivatedBit, value); }
 
-    bool getOilLayerActivated() const { return oilLayerActivated; }
-    void setOilLayerActivated(bool value) { oilLayerActivated = value; }
+    bool getOilLayerActivated() const { return getFlag(oilLayerActivatedBit); }
+    void setOilLayerActivated(bool value) { setFlag(oilLayerActivatedBit, value); }
 
-    bool getWaterConductor() const { return waterConductor; }
-    void setWaterConductor(bool value) { waterConductor = value; }
+    bool getWaterConductor() const { return getFlag(waterConductorBit); }
+    void setWaterConductor(bool value) { setFlag(waterConductorBit, value); }
 
-    bool getOilConductor() const { return oilConductor; }
-    void setOilConductor(bool value) { oilConductor = value; }
+    bool getOilConductor() const { return getFlag(oilConductorBit); }
+    void setOilConductor(bool value) { setFlag(oilConductorBit, value); }
 
     double getOilFilmConductivity() const { return oilFilmConductivity; }
     void setOilFilmConductivity(double value) { oilFilmConductivity = value; }
@@ -164,55 +196,77 @@ class element
     void setWaterFilmConductivity(double value) { waterFilmConductivity = value; }
 
     // clustering methods
-    int getClusterTemp() const { return clusterTemp; }
-    void setClusterTemp(int value) { clusterTemp = value; }
+    int getClusterTemp() const { return clusters->temp; }
+    void setClusterTemp(int value) { clusters->temp = value; }
 
-    cluster *getClusterActive() const { return clusterActive; }
-    void setClusterActive(cluster *value) { clusterActive = value; }
+    cluster *getClusterActive() const { return cluster::fromHandle(clusters->active); }
+    void setClusterActive(cluster *value) { clusters->active = cluster::getHandle(value); }
 
-    cluster *getClusterWaterWet() const { return clusterWaterWet; }
-    void setClusterWaterWet(cluster *value) { clusterWaterWet = value; }
+    cluster *getClusterWaterWet() const { return cluster::fromHandle(clusters->waterWet); }
+    void setClusterWaterWet(cluster *value) { clusters->waterWet = cluster::getHandle(value); }
 
-    cluster *getClusterOilWet() const { return clusterOilWet; }
-    void setClusterOilWet(cluster *value) { clusterOilWet = value; }
+    cluster *getClusterOilWet() const { return cluster::fromHandle(clusters->oilWet); }
+    void setClusterOilWet(cluster *value) { clusters->oilWet = cluster::getHandle(value); }
 
-    cluster *getClusterWater() const { return clusterWater; }
-    void setClusterWater(cluster *value) { clusterWater = value; }
+    cluster *getClusterWater() const { return cluster::fromHandle(clusters->water); }
+    void setClusterWater(cluster *value) { clusters->water = cluster::getHandle(value); }
 
-    cluster *getClusterOil() const { return clusterOil; }
-    void setClusterOil(cluster *value) { clusterOil = value; }
+    cluster *getClusterOil() const { return cluster::fromHandle(clusters->oil); }
+    void setClusterOil(cluster *value) { clusters->oil = cluster::getHandle(value); }
 
-    cluster *getClusterWaterConductor() const { return clusterWaterFilm; }
-    void setClusterWaterFilm(cluster *value) { clusterWaterFilm = value; }
+    cluster *getClusterWaterConductor() const { return cluster::fromHandle(clusters->waterFilm); }
+    void setClusterWaterFilm(cluster *value) { clusters->waterFilm = cluster::getHandle(value); }
 
-    cluster *getClusterOilConductor() const { return clusterOilFilm; }
-    void setClusterOilFilm(cluster *value) { clusterOilFilm = value; }
+    cluster *getClusterOilConductor() const { return cluster::fromHandle(clusters->oilFilm); }
+    void setClusterOilFilm(cluster *value) { clusters->oilFilm = cluster::getHandle(value); }
 
     std::vector<element *> &getNeighboors() { return neighboors; }
     void setNeighboors(const std::vector<element *> &value) { neighboors = value; }
 
+    // Storage of the geometry and of the clustering scratch, given by networkModel::createElement
+    void setColdAttributes(elementGeometry *geometryValue, elementClusters *clustersValue)
+    {
+        geometry = geometryValue;
+        clusters = clustersValue;
+    }
+
   protected:
-    capillaryType type; // type of the capillary element: pore (throat) or pore body (node)
+    // Flags and enums, packed in a single word; the enums take two bits each
+    enum flagBit : uint32_t
+    {
+        poreBodyBit = 1u << 0, // type of the capillary element: pore (throat) or pore body (node)
+        inletBit = 1u << 1,
+        outletBit = 1u << 2,
+        activeBit = 1u << 3,
+        waterTrappedBit = 1u << 4,
+        oilTrappedBit = 1u << 5,
+        oilCanFlowViaFilmBit = 1u << 6,
+        waterCanFlowViaFilmBit = 1u << 7,
+        oilLayerActivatedBit = 1u << 8,
+        waterCornerActivatedBit = 1u << 9,
+        oilConductorBit = 1u << 10,
+        waterConductorBit = 1u << 11,
+        firstDerivedBit = 1u << 12 // first bit left to the derived classes
+    };
+    static const unsigned wettabilityShift = 24, phaseShift = 26;
+
+    bool getFlag(uint32_t bit) const { return (flags & bit) != 0; }
+    void setFlag(uint32_t bit, bool value) { flags = value ? flags | bit : flags & ~bit; }
+    uint32_t getField(unsigned shift) const { return (flags >> shift) & 3u; }
+    void setField(unsigned shift, uint32_t value) { flags = (flags & ~(3u << shift)) | ((value & 3u) << shift); }
 
     //Basic attributes
     int id;                          // capillary relative ID: from 1 to totalPores (if pore); from 1 to totalNodes (if node)
+    int index;                       // position in pnmRange<element>, nodes first then pores (assigned by networkArrays::build)
     double radius;                   // capillary radius (SI)
-    double length;                   // capillary length (SI)
     double volume;                   // capillary volume (SI)
-    double shapeFactor;              // capillary shape factor (dimensionless)
-    double shapeFactorConstant;      // capillary shape factor constant (dimensionless)
-    double entryPressureCoefficient; // 1 + 2 * sqrt(pi * shapeFactor)
+    double entryPressure;            // entryPressureCoefficient * OWSurfaceTension * cos(theta) / radius (SI), refreshed when theta changes
     double conductivity;             // capillary conductivity (SI)
     double capillaryPressure;        //capillary pressure across the element (SI)
     double theta, originalTheta;     // capillary oil-water contact angle
     double viscosity;                // capillary average viscosity (SI)
     double concentration;            // capillary concentration in tracer (between 0 and 1)
-    bool inlet;                      // a flag whether the capillary is connected to the inlet boundary
-    bool outlet;                     // a flag whether the capillary is connected to the outlet boundary
-    bool closed;                     // a flag whether the capillary is undefinetely closed (i.e. when assigning the coordination number)
-    bool active;                     // a flag whether the capillary is momentarily closed (i.e. when closing the capillaries with counter imbibition flow)
-    wettability wettabilityFlag;     // capillary wettability
-    phase phaseFlag;                 // capillary occupying phase
+    uint32_t flags;                  // inlet/outlet boundary, momentarily closed (active), wettability, occupying phase, trapping and films flags
     std::vector<element *> neighboors;
 
     //Simulation attributes
@@ -220,26 +274,13 @@ class element
     double waterFraction;                              // water fraction in the capillary
     double flow;                                       // fluid flow (SI) in the capillary
     double massFlow;                                   // mass flow (SI) in the capillary
-    double beta1, beta2, beta3;                        // half angles in the capillary
     double oilFilmVolume, waterFilmVolume;             // layer/film volumes
     double oilFilmConductivity, waterFilmConductivity; // layer/film conductivity
     double effectiveVolume;                            // bulk volume (volume - (film+layer) volume)
-    double filmAreaCoefficient;                        // a mathematical coefficient used in the calculation of film area (Oren, 98)
-    bool waterTrapped;                                 // a flag to whether water is topologically trapped in the capillary
-    bool oilTrapped;                                   // a flag to whether oil is topologically trapped in the capillary
-    bool oilCanFlowViaFilm, waterCanFlowViaFilm;       // flags whether a fluid can flow via layer/film
-    bool oilLayerActivated, waterCornerActivated;      // flags whether a fluid can flow via layer/film
-    bool oilConductor, waterConductor;                 // flags whether a fluid can flow through the capillary - through bulk OR film
-
-    //Clustering attributes
-    int clusterTemp;
-    cluster *clusterWaterWet;
-    cluster *clusterOilWet;
-    cluster *clusterWater;
-    cluster *clusterOil;
-    cluster *clusterWaterFilm;
-    cluster *clusterOilFilm;
-    cluster *clusterActive;
+
+    //Cold attributes, allocated in their own regions of the network elements arena
+    elementGeometry *geometry;
+    elementClusters *clusters;
 };
 
 } // namespace PNM
@@ -0,0 +1,118 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef ELEMENTARENA_H
+#define ELEMENTARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace PNM
+{
+
+// Regions of an elements arena: each region fills its own blocks, so the elements, their geometry and their
+// clustering scratch are each contiguous and a sweep over one of them does not pull the others into the cache
+enum class arenaRegion
+{
+    elements = 0,
+    geometry,
+    clusters,
+    count
+};
+
+// Bump allocator for the elements of a network: consecutive allocations in a region are contiguous in large
+// blocks, and the memory is only given back when the arena is destroyed. Allocations may come from several threads.
+class elementArena
+{
+  public:
+    elementArena() : reserved(0) {}
+    elementArena(const elementArena &) = delete;
+    elementArena(elementArena &&) = delete;
+    auto operator=(const elementArena &) -> elementArena & = delete;
+    auto operator=(elementArena &&) -> elementArena & = delete;
+
+    void *allocate(std::size_t bytes, std::size_t alignment, arenaRegion region = arenaRegion::elements)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cursor &c = cursors[static_cast<std::size_t>(region)];
+        std::size_t padding = (alignment - reinterpret_cast<std::size_t>(c.position) % alignment) % alignment;
+        if (padding + bytes > c.remaining)
+        {
+            addBlock(c, bytes + alignment > blockSize ? bytes + alignment : blockSize);
+            padding = (alignment - reinterpret_cast<std::size_t>(c.position) % alignment) % alignment;
+        }
+        char *address = c.position + padding;
+        c.position = address + bytes;
+        c.remaining -= padding + bytes;
+        return address;
+    }
+
+    // Value-initialised T in the given region; T must be trivially destructible, since it is never destroyed
+    template <typename T>
+    T *create(arenaRegion region)
+    {
+        return new (allocate(sizeof(T), alignof(T), region)) T();
+    }
+
+    std::size_t getReservedBytes()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return reserved;
+    }
+
+  protected:
+    static const std::size_t blockSize = 1 << 20;
+
+    struct cursor
+    {
+        char *position = nullptr;
+        std::size_t remaining = 0;
+    };
+
+    void addBlock(cursor &c, std::size_t bytes)
+    {
+        blocks.emplace_back(new char[bytes]);
+        c.position = blocks.back().get();
+        c.remaining = bytes;
+        reserved += bytes;
+    }
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    cursor cursors[static_cast<std::size_t>(arenaRegion::count)];
+    std::size_t reserved;
+    std::mutex mutex;
+};
+
+// Allocator for std::allocate_shared: the objects and their reference counts are placed in the arena, which is
+// kept alive by the allocator copies until the last object is released
+template <typename T>
+class arenaAllocator
+{
+  public:
+    using value_type = T;
+
+    arenaAllocator(std::shared_ptr<elementArena> arena) : arena(arena) {}
+    template <typename U>
+    arenaAllocator(const arenaAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(std::size_t n) { return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T *, std::size_t) {}
+
+    template <typename U>
+    bool operator==(const arenaAllocator<U> &other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const arenaAllocator<U> &other) const { return arena != other.arena; }
+
+    std::shared_ptr<elementArena> arena;
+};
+
+} // namespace PNM
+
+#endif // ELEMENTARENA_H
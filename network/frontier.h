@@ -0,0 +1,89 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef FRONTIER_H
+#define FRONTIER_H
+
+#include "networkmodel.h"
+#include "element.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace PNM
+{
+
+// Dense set of elements (e.g. the capillaries next to a moving interface): a position per element index and
+// the list of members. Insertion, removal and lookup are O(1), clearing is O(members), and the buffers are
+// reused until the network changes. Elements are referred to by their index, assigned by networkArrays::build.
+template <typename T>
+class frontier
+{
+  public:
+    void reset(networkModel &network)
+    {
+        if (!network.arrays.matches(network))
+            network.arrays.build(network);
+
+        clear();
+        positions.assign(network.totalNodes + network.totalPores, -1);
+    }
+
+    bool insert(T *e)
+    {
+        int &position = positions[e->getIndex()];
+        if (position != -1)
+            return false;
+        position = members.size();
+        members.push_back(e);
+        return true;
+    }
+
+    void erase(T *e)
+    {
+        int &position = positions[e->getIndex()];
+        if (position == -1)
+            return;
+        T *last = members.back();
+        members[position] = last;
+        positions[last->getIndex()] = position;
+        members.pop_back();
+        position = -1;
+    }
+
+    bool contains(T *e) const { return positions[e->getIndex()] != -1; }
+
+    void clear()
+    {
+        for (T *e : members)
+            positions[e->getIndex()] = -1;
+        members.clear();
+    }
+
+    // Orders the members by index, i.e. by their positions in the network tables
+    void sort()
+    {
+        std::sort(members.begin(), members.end(), [](T *a, T *b) { return a->getIndex() < b->getIndex(); });
+        for (unsigned i = 0; i < members.size(); ++i)
+            positions[members[i]->getIndex()] = i;
+    }
+
+    int position(T *e) const { return positions[e->getIndex()]; }
+    int size() const { return members.size(); }
+    bool empty() const { return members.empty(); }
+    T *operator[](int i) const { return members[i]; }
+    typename std::vector<T *>::const_iterator begin() const { return members.begin(); }
+    typename std::vector<T *>::const_iterator end() const { return members.end(); }
+
+  protected:
+    std::vector<int> positions;
+    std::vector<T *> members;
+};
+
+} // namespace PNM
+
+#endif // FRONTIER_H
@@ -17,79 +17,62 @@ namespace PNM
 
 using networkPtr = std::shared_ptr<networkModel>;
 
+// Contiguous views of the network tables: the elements are indexed like pnmRange<element>, nodes first then
+// pores. Spans, ranges and iterators only keep raw pointers to the tables, and are valid until those change.
 template <typename T>
-class pnmIterator
+class pnmSpan;
+
+template <>
+class pnmSpan<node>
 {
   public:
-    explicit pnmIterator(networkPtr net, int current) : net(net), current(current) {}
-
-    bool operator==(const pnmIterator &it) const
-    {
-        return this->current == it.current;
-    }
-    bool operator!=(const pnmIterator &it) const
-    {
-        return !(*this == it);
-    }
-    pnmIterator &operator++()
-    {
-        if (current < net->totalNodes + net->totalPores)
-            ++current;
-        return *this;
-    }
-    T *operator*() const
-    {
-        if (current < net->totalNodes)
-        { // node
-            return net->getNode(current);
-        }
-        else if (current < net->totalNodes + net->totalPores)
-        { //pore
-            return net->getPore(current - net->totalNodes);
-        }
-        throw std::out_of_range("pnmIterator out of range.\n");
-    }
+    explicit pnmSpan(const networkModel &net) : nodes(net.tableOfNodes.data()), count(net.totalNodes) {}
+    int size() const { return count; }
+    node *operator[](int i) const { return nodes[i].get(); }
 
   protected:
-    networkPtr net;
-    int current;
+    const networkModel::nodePtr *nodes;
+    int count;
 };
 
 template <>
-class pnmIterator<pore>
+class pnmSpan<pore>
 {
   public:
-    explicit pnmIterator(networkPtr net, int current) : net(net), current(current) {}
+    explicit pnmSpan(const networkModel &net) : pores(net.tableOfPores.data()), count(net.totalPores) {}
+    int size() const { return count; }
+    pore *operator[](int i) const { return pores[i].get(); }
 
-    bool operator==(const pnmIterator &it) const
-    {
-        return this->current == it.current;
-    }
-    bool operator!=(const pnmIterator &it) const
-    {
-        return !(*this == it);
-    }
-    pnmIterator &operator++()
-    {
-        if (current < net->totalPores)
-            ++current;
-        return *this;
-    }
-    pore *operator*() const
+  protected:
+    const networkModel::porePtr *pores;
+    int count;
+};
+
+template <typename T>
+class pnmSpan
+{
+  public:
+    explicit pnmSpan(const networkModel &net) : nodes(net.tableOfNodes.data()), pores(net.tableOfPores.data()), totalNodes(net.totalNodes), count(net.totalNodes + net.totalPores) {}
+    int size() const { return count; }
+    T *operator[](int i) const
     {
-        return net->getPore(current);
+        if (i < totalNodes)
+            return nodes[i].get();
+        return pores[i - totalNodes].get();
     }
 
   protected:
-    networkPtr net;
-    int current;
+    const networkModel::nodePtr *nodes;
+    const networkModel::porePtr *pores;
+    int totalNodes;
+    int count;
 };
 
-template <>
-class pnmIterator<node>
+template <typename T>
+class pnmIterator
 {
   public:
-    explicit pnmIterator(networkPtr net, int current) : net(net), current(current) {}
+    explicit pnmIterator(const pnmSpan<T> &span, int current) : span(span), current(current) {}
 
     bool operator==(const pnmIterator &it) const
     {
@@ -101,88 +84,41 @@ class pnmIterator<node>
     }
     pnmIterator &operator++()
     {
-        if (current < net->totalNodes)
-            ++current;
+        ++current;
         return *this;
     }
-    node *operator*() const
+    T *operator*() const
     {
-        return net->getNode(current);
+        return span[current];
     }
 
   protected:
-    networkPtr net;
+    pnmSpan<T> span;
     int current;
 };
 
-template <typename T>
-class pnmIteratorBuilder
-{
-  public:
-    pnmIterator<T> buildBegin(networkPtr net)
-    {
-        return pnmIterator<T>(net, 0);
-        ;
-    }
-    pnmIterator<T> buildEnd(networkPtr net)
-    {
-        return pnmIterator<T>(net, net->totalNodes + net->totalPores);
-    }
-};
-
-template <>
-class pnmIteratorBuilder<pore>
-{
-  public:
-    pnmIterator<pore> buildBegin(networkPtr net)
-    {
-        return pnmIterator<pore>(net, 0);
-        ;
-    }
-    pnmIterator<pore> buildEnd(networkPtr net)
-    {
-        return pnmIterator<pore>(net, net->totalPores);
-    }
-};
-
-template <>
-class pnmIteratorBuilder<node>
-{
-  public:
-    pnmIterator<node> buildBegin(networkPtr net)
-    {
-        return pnmIterator<node>(net, 0);
-        ;
-    }
-    pnmIterator<node> buildEnd(networkPtr net)
-    {
-        return pnmIterator<node>(net, net->totalNodes);
-    }
-};
-
 template <typename T>
 class pnmRange
 {
   public:
-    explicit pnmRange(networkPtr net) : net(net) {}
-    auto begin() -> pnmIterator<T>
+    explicit pnmRange(const networkPtr &net) : span(*net) {}
+    auto begin() const -> pnmIterator<T>
     {
-        return builder.buildBegin(net);
+        return pnmIterator<T>(span, 0);
     }
-    auto end() -> pnmIterator<T>
+    auto end() const -> pnmIterator<T>
     {
-        return builder.buildEnd(net);
+        return pnmIterator<T>(span, span.size());
     }
 
   protected:
-    networkPtr net;
-    pnmIteratorBuilder<T> builder;
+    pnmSpan<T> span;
 };
 
 class pnmInlet
 {
   public:
-    explicit pnmInlet(networkPtr net) : net(net) {}
+    explicit pnmInlet(const networkPtr &net) : net(net.get()) {}
     auto begin()
     {
         return net->inletPores.begin();
@@ -193,13 +129,13 @@ class pnmInlet
     }
 
   protected:
-    networkPtr net;
+    networkModel *net;
 };
 
 class pnmOutlet
 {
   public:
-    explicit pnmOutlet(networkPtr net) : net(net) {}
+    explicit pnmOutlet(const networkPtr &net) : net(net.get()) {}
     auto begin()
     {
         return net->outletPores.begin();
@@ -210,9 +146,61 @@ class pnmOutlet
     }
 
   protected:
-    networkPtr net;
+    networkModel *net;
 };
 
+// Loops over the elements: f is called with each node, pore, or element (nodes first). The parallel variants
+// split the elements between the OpenMP threads, f being called concurrently on distinct elements.
+template <typename F>
+void forEachNode(const networkPtr &net, F f)
+{
+    pnmSpan<node> nodes(*net);
+    for (int i = 0; i < nodes.size(); ++i)
+        f(nodes[i]);
+}
+
+template <typename F>
+void forEachPore(const networkPtr &net, F f)
+{
+    pnmSpan<pore> pores(*net);
+    for (int i = 0; i < pores.size(); ++i)
+        f(pores[i]);
+}
+
+template <typename F>
+void forEachElement(const networkPtr &net, F f)
+{
+    forEachNode(net, f);
+    forEachPore(net, f);
+}
+
+template <typename F>
+void parallelForEachNode(const networkPtr &net, F f)
+{
+    pnmSpan<node> nodes(*net);
+#pragma omp parallel for
+    for (int i = 0; i < nodes.size(); ++i)
+        f(nodes[i]);
+}
+
+template <typename F>
+void parallelForEachPore(const networkPtr &net, F f)
+{
+    pnmSpan<pore> pores(*net);
+#pragma omp parallel for
+    for (int i = 0; i < pores.size(); ++i)
+        f(pores[i]);
+}
+
+template <typename F>
+void parallelForEachElement(const networkPtr &net, F f)
+{
+    pnmSpan<element> elements(*net);
+#pragma omp parallel for
+    for (int i = 0; i < elements.size(); ++i)
+        f(elements[i]);
+}
+
 } // namespace PNM
 
 #endif // ITERATOR2_H
@@ -0,0 +1,171 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "networkArrays.h"
+#include "networkmodel.h"
+#include "node.h"
+#include "pore.h"
+#include "misc/numaPlacement.h"
+
+#include <numeric>
+
+namespace PNM
+{
+
+void networkArrays::build(const networkModel &network)
+{
+#pragma omp parallel for
+    for (int i = 0; i < network.totalNodes; ++i)
+        network.getNode(i)->setIndex(i);
+#pragma omp parallel for
+    for (int i = 0; i < network.totalPores; ++i)
+        network.getPore(i)->setIndex(network.totalNodes + i);
+
+    //Rows sizes, their offsets by a prefix sum, then each row filled on its own
+    nodePoresOffset.assign(network.totalNodes + 1, 0);
+#pragma omp parallel for
+    for (int i = 0; i < network.totalNodes; ++i)
+        nodePoresOffset[i + 1] = network.getNode(i)->getNeighboors().size();
+    std::partial_sum(nodePoresOffset.begin(), nodePoresOffset.end(), nodePoresOffset.begin());
+
+    nodePores.resize(nodePoresOffset[network.totalNodes]);
+#pragma omp parallel for
+    for (int i = 0; i < network.totalNodes; ++i)
+    {
+        int k = nodePoresOffset[i];
+        for (element *e : network.getNode(i)->getNeighboors())
+            nodePores[k++] = e->getIndex() - network.totalNodes;
+    }
+
+    poreNodeIn.resize(network.totalPores);
+    poreNodeOut.resize(network.totalPores);
+    poreInlet.resize(network.totalPores);
+    poreOutlet.resize(network.totalPores);
+#pragma omp parallel for
+    for (int i = 0; i < network.totalPores; ++i)
+    {
+        pore *p = network.getPore(i);
+        poreNodeIn[i] = p->getNodeIn() == 0 ? -1 : p->getNodeIn()->getIndex();
+        poreNodeOut[i] = p->getNodeOut() == 0 ? -1 : p->getNodeOut()->getIndex();
+        poreInlet[i] = p->getInlet();
+        poreOutlet[i] = p->getOutlet();
+    }
+
+    nodeRadius.resize(network.totalNodes);
+    nodeLength.resize(network.totalNodes);
+    nodeConductivity.resize(network.totalNodes);
+    nodeFlow.resize(network.totalNodes);
+    nodePressure.resize(network.totalNodes);
+    nodeConcentration.resize(network.totalNodes);
+    nodePhase.resize(network.totalNodes);
+
+    poreRadius.resize(network.totalPores);
+    poreLength.resize(network.totalPores);
+    poreVolume.resize(network.totalPores);
+    poreConductivity.resize(network.totalPores);
+    poreCapillaryPressure.resize(network.totalPores);
+    poreFlow.resize(network.totalPores);
+    poreConcentration.resize(network.totalPores);
+    porePhase.resize(network.totalPores);
+    poreActive.resize(network.totalPores);
+
+    nodeConductanceFactor.clear();
+    poreConductanceFactor.clear();
+    nodeViscosity.resize(network.totalNodes);
+    poreViscosity.resize(network.totalPores);
+    poreThroatConductivity.resize(network.totalPores);
+
+    gather(network);
+    distribute();
+}
+
+void networkArrays::gather(const networkModel &network)
+{
+#pragma omp parallel for
+    for (int i = 0; i < network.totalNodes; ++i)
+    {
+        node *n = network.getNode(i);
+        nodeRadius[i] = n->getRadius();
+        nodeLength[i] = n->getLength();
+        nodeConductivity[i] = n->getConductivity();
+        nodeFlow[i] = n->getFlow();
+        nodePressure[i] = n->getPressure();
+        nodeConcentration[i] = n->getConcentration();
+        nodePhase[i] = n->getPhaseFlag();
+    }
+
+#pragma omp parallel for
+    for (int i = 0; i < network.totalPores; ++i)
+    {
+        pore *p = network.getPore(i);
+        poreRadius[i] = p->getRadius();
+        poreLength[i] = p->getLength();
+        poreVolume[i] = p->getVolume();
+        poreFlow[i] = p->getFlow();
+        poreConcentration[i] = p->getConcentration();
+        porePhase[i] = p->getPhaseFlag();
+    }
+
+    gatherFlowAttributes(network);
+}
+
+void networkArrays::gatherFlowAttributes(const networkModel &network)
+{
+#pragma omp parallel for
+    for (int i = 0; i < network.totalPores; ++i)
+    {
+        pore *p = network.getPore(i);
+        poreConductivity[i] = p->getConductivity();
+        poreCapillaryPressure[i] = p->getCapillaryPressure();
+        poreActive[i] = p->getActive();
+    }
+}
+
+void networkArrays::scatter(networkModel &network) const
+{
+    for (int i = 0; i < network.totalNodes; ++i)
+    {
+        node *n = network.getNode(i);
+        n->setPressure(nodePressure[i]);
+        n->setFlow(nodeFlow[i]);
+        n->setConcentration(nodeConcentration[i]);
+    }
+
+    for (int i = 0; i < network.totalPores; ++i)
+    {
+        pore *p = network.getPore(i);
+        p->setFlow(poreFlow[i]);
+        p->setConcentration(poreConcentration[i]);
+    }
+}
+
+void networkArrays::distribute()
+{
+    if (!numaPlacement::isEnabled())
+        return;
+
+    //Nodes arrays by nodes, pores arrays by pores, and the adjacency by its nodes rows
+    numaPlacement::distributeRows(nodePores.data(), nodePoresOffset.data(), int(nodePoresOffset.size()) - 1);
+    numaPlacement::distribute(nodePoresOffset);
+    for (auto *values : {&nodeRadius, &nodeLength, &nodeConductivity, &nodeFlow, &nodePressure, &nodeConcentration, &nodeViscosity,
+                         &poreRadius, &poreLength, &poreVolume, &poreConductivity, &poreCapillaryPressure, &poreFlow,
+                         &poreConcentration, &poreViscosity, &poreThroatConductivity})
+        numaPlacement::distribute(*values);
+    for (auto *values : {&poreInlet, &poreOutlet, &poreActive})
+        numaPlacement::distribute(*values);
+    numaPlacement::distribute(poreNodeIn);
+    numaPlacement::distribute(poreNodeOut);
+    numaPlacement::distribute(nodePhase);
+    numaPlacement::distribute(porePhase);
+}
+
+bool networkArrays::matches(const networkModel &network) const
+{
+    return int(nodePoresOffset.size()) == network.totalNodes + 1 && int(poreNodeIn.size()) == network.totalPores;
+}
+
+} // namespace PNM
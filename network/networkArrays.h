@@ -0,0 +1,77 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef NETWORKARRAYS_H
+#define NETWORKARRAYS_H
+
+#include "element.h"
+
+#include <vector>
+
+namespace PNM
+{
+
+struct networkModel;
+
+// Contiguous (struct of arrays) mirror of the network elements.
+// Node i and pore i are the elements at position i in tableOfNodes and tableOfPores; build also assigns the elements indices.
+struct networkArrays
+{
+    ///////////// Synchronisation with the element objects
+
+    void build(const networkModel &);                // topology and all attributes
+    void gather(const networkModel &);               // all attributes
+    void gatherFlowAttributes(const networkModel &); // attributes changing between pressure solves
+    void scatter(networkModel &) const;              // simulation results: pressures, flows, concentrations
+    bool matches(const networkModel &) const;
+    void distribute(); // pages of the arrays to the threads owning them in the kernels loops (numaAware)
+
+    ///////////// Topology
+
+    std::vector<int> nodePoresOffset; // CSR adjacency: pores of node i are nodePores[nodePoresOffset[i]] .. nodePores[nodePoresOffset[i + 1] - 1]
+    std::vector<int> nodePores;
+    std::vector<int> poreNodeIn;  // -1 at the outlet boundary
+    std::vector<int> poreNodeOut; // -1 at the inlet boundary
+    std::vector<char> poreInlet;
+    std::vector<char> poreOutlet;
+
+    ///////////// Nodes attributes
+
+    std::vector<double> nodeRadius;
+    std::vector<double> nodeLength;
+    std::vector<double> nodeConductivity;
+    std::vector<double> nodeFlow;
+    std::vector<double> nodePressure;
+    std::vector<double> nodeConcentration;
+    std::vector<phase> nodePhase;
+
+    ///////////// Pores attributes
+
+    std::vector<double> poreRadius;
+    std::vector<double> poreLength;
+    std::vector<double> poreVolume;
+    std::vector<double> poreConductivity;
+    std::vector<double> poreCapillaryPressure;
+    std::vector<double> poreFlow;
+    std::vector<double> poreConcentration;
+    std::vector<phase> porePhase;
+    std::vector<char> poreActive;
+
+    ///////////// Conductivities terms
+
+    std::vector<double> nodeConductanceFactor; // poreConductivityConstant * shapeFactorConstant * radius ^ poreConductivityExponent / (16 * shapeFactor)
+    std::vector<double> poreConductanceFactor;
+    std::vector<double> nodeViscosity;
+    std::vector<double> poreViscosity;
+    std::vector<double> poreThroatConductivity; // throat conductivity, without the pore bodies halves
+    double conductanceConstant = 0;             // poreConductivityConstant and poreConductivityExponent used for the factors
+    double conductanceExponent = 0;
+};
+
+} // namespace PNM
+
+#endif // NETWORKARRAYS_H
@@ -0,0 +1,104 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef NETWORKVIEW_H
+#define NETWORKVIEW_H
+
+#include "networkmodel.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace PNM
+{
+
+// Read-only window over a contiguous array: a pointer and a size, without copy nor ownership.
+template <typename T>
+class arrayView
+{
+  public:
+    arrayView() : values(nullptr), length(0) {}
+    arrayView(const std::vector<T> &vector) : values(vector.data()), length(vector.size()) {}
+
+    const T *data() const { return values; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    const T &operator[](size_t i) const { return values[i]; }
+    const T *begin() const { return values; }
+    const T *end() const { return values + length; }
+
+  private:
+    const T *values;
+    size_t length;
+};
+
+// Typed views over the networkArrays of a network, for analysis and coupling code running in the same process
+// (through the library target numSCAL_core). The views point into the arrays: they stay valid, and follow the
+// simulation, until the network is rebuilt (networkArrays::build). Nodes come first in the elements indices, then pores;
+// topology arrays use the nodes and pores positions, as documented in networkArrays.
+// Simulations refresh the arrays before calling their step callback (simulation::setStepCallback).
+struct networkView
+{
+    networkView() : totalNodes(0), totalPores(0), xEdgeLength(0), yEdgeLength(0), zEdgeLength(0), totalNetworkVolume(0) {}
+    explicit networkView(const networkModel &network)
+        : totalNodes(network.totalNodes), totalPores(network.totalPores), xEdgeLength(network.xEdgeLength),
+          yEdgeLength(network.yEdgeLength), zEdgeLength(network.zEdgeLength), totalNetworkVolume(network.totalNetworkVolume),
+          nodePoresOffset(network.arrays.nodePoresOffset), nodePores(network.arrays.nodePores),
+          poreNodeIn(network.arrays.poreNodeIn), poreNodeOut(network.arrays.poreNodeOut), poreInlet(network.arrays.poreInlet),
+          poreOutlet(network.arrays.poreOutlet), nodeRadius(network.arrays.nodeRadius), nodeLength(network.arrays.nodeLength),
+          nodeConductivity(network.arrays.nodeConductivity), nodeFlow(network.arrays.nodeFlow),
+          nodePressure(network.arrays.nodePressure), nodeConcentration(network.arrays.nodeConcentration),
+          nodePhase(network.arrays.nodePhase), poreRadius(network.arrays.poreRadius), poreLength(network.arrays.poreLength),
+          poreVolume(network.arrays.poreVolume), poreConductivity(network.arrays.poreConductivity),
+          poreCapillaryPressure(network.arrays.poreCapillaryPressure), poreFlow(network.arrays.poreFlow),
+          poreConcentration(network.arrays.poreConcentration), porePhase(network.arrays.porePhase),
+          poreActive(network.arrays.poreActive)
+    {
+    }
+
+    int totalNodes;
+    int totalPores;
+    double xEdgeLength;
+    double yEdgeLength;
+    double zEdgeLength;
+    double totalNetworkVolume;
+
+    ///////////// Topology
+
+    arrayView<int> nodePoresOffset;
+    arrayView<int> nodePores;
+    arrayView<int> poreNodeIn;
+    arrayView<int> poreNodeOut;
+    arrayView<char> poreInlet;
+    arrayView<char> poreOutlet;
+
+    ///////////// Nodes state
+
+    arrayView<double> nodeRadius;
+    arrayView<double> nodeLength;
+    arrayView<double> nodeConductivity;
+    arrayView<double> nodeFlow;
+    arrayView<double> nodePressure;
+    arrayView<double> nodeConcentration;
+    arrayView<phase> nodePhase;
+
+    ///////////// Pores state
+
+    arrayView<double> poreRadius;
+    arrayView<double> poreLength;
+    arrayView<double> poreVolume;
+    arrayView<double> poreConductivity;
+    arrayView<double> poreCapillaryPressure;
+    arrayView<double> poreFlow;
+    arrayView<double> poreConcentration;
+    arrayView<phase> porePhase;
+    arrayView<char> poreActive;
+};
+
+} // namespace PNM
+
+#endif // NETWORKVIEW_H
@@ -6,10 +6,54 @@
 /////////////////////////////////////////////////////////////////////////////
 
 #include "networkmodel.h"
+#include "node.h"
+#include "pore.h"
+
+#include <algorithm>
+#include <numeric>
 
 namespace PNM
 {
 
+namespace
+{
+const int compactionBlock = 4096;
+
+//The active elements keep their order, at positions given by a prefix sum of the blocks counts. Kept pointers are moved and
+//dropped ones released in parallel, without copies of the shared pointers
+template <typename T>
+int compactTable(std::vector<std::shared_ptr<T>> &table)
+{
+    int count = table.size();
+    int blocks = (count + compactionBlock - 1) / compactionBlock;
+    std::vector<int> offsets(blocks + 1, 0);
+
+#pragma omp parallel for
+    for (int b = 0; b < blocks; ++b)
+        for (int i = b * compactionBlock; i < std::min(count, (b + 1) * compactionBlock); ++i)
+            offsets[b + 1] += table[i]->getActive();
+
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<std::shared_ptr<T>> kept(offsets[blocks]);
+#pragma omp parallel for
+    for (int b = 0; b < blocks; ++b)
+    {
+        int position = offsets[b];
+        for (int i = b * compactionBlock; i < std::min(count, (b + 1) * compactionBlock); ++i)
+        {
+            if (table[i]->getActive())
+                kept[position++] = std::move(table[i]);
+            else
+                table[i].reset();
+        }
+    }
+
+    table.swap(kept);
+    return table.size();
+}
+} // namespace
+
 pore *networkModel::getPore(int i) const
 {
     if (i < 0 || i > totalPores - 1)
@@ -24,4 +68,40 @@ node *networkModel::getNode(int i) const
     return tableOfNodes[i].get();
 }
 
+void networkModel::removeInactiveElements()
+{
+    auto inactive = [](pore *p) { return !p->getActive(); };
+    inletPores.erase(std::remove_if(inletPores.begin(), inletPores.end(), inactive), inletPores.end());
+    outletPores.erase(std::remove_if(outletPores.begin(), outletPores.end(), inactive), outletPores.end());
+
+    //The neighboors lists of the kept elements only, the others being released with the tables
+    auto removeInactiveNeighboors = [](element *e) {
+        std::vector<element *> &neighboors = e->getNeighboors();
+        neighboors.erase(std::remove_if(neighboors.begin(), neighboors.end(), [](element *n) { return !n->getActive(); }), neighboors.end());
+    };
+
+#pragma omp parallel for
+    for (int i = 0; i < totalNodes; ++i)
+        if (tableOfNodes[i]->getActive())
+            removeInactiveNeighboors(tableOfNodes[i].get());
+
+#pragma omp parallel for
+    for (int i = 0; i < totalPores; ++i)
+        if (tableOfPores[i]->getActive())
+            removeInactiveNeighboors(tableOfPores[i].get());
+
+    totalNodes = compactTable(tableOfNodes);
+    totalPores = compactTable(tableOfPores);
+
+#pragma omp parallel for
+    for (int i = 0; i < totalNodes; ++i)
+        tableOfNodes[i]->setId(i + 1);
+
+#pragma omp parallel for
+    for (int i = 0; i < totalPores; ++i)
+        tableOfPores[i]->setId(i + 1);
+
+    arrays.build(*this);
+}
+
 } // namespace PNM
@@ -8,6 +8,11 @@
 #ifndef NETWORKMODEL_H
 #define NETWORKMODEL_H
 
+#include "networkArrays.h"
+#include "elementArena.h"
+#include "spatialIndex.h"
+
+#include <array>
 #include <vector>
 #include <memory>
 
@@ -27,6 +32,21 @@ struct networkModel
     pore *getPore(int) const;
     node *getNode(int) const;
 
+    // Closed nodes and pores are taken out of the tables, the boundary lists and the neighboors lists; the kept
+    // elements are renumbered in their order and the arrays rebuilt
+    void removeInactiveElements();
+
+    // New node or pore, allocated in the network elements arena; its geometry and clustering scratch go to their
+    // own regions of the arena
+    template <typename T, typename... Args>
+    std::shared_ptr<T> createElement(Args &&... args)
+    {
+        auto e = std::allocate_shared<T>(arenaAllocator<T>(elementsArena), std::forward<Args>(args)...);
+        e->setColdAttributes(elementsArena->create<elementGeometry>(arenaRegion::geometry),
+                             elementsArena->create<elementClusters>(arenaRegion::clusters));
+        return e;
+    }
+
     ///////////// Attributes
 
     int totalPores;
@@ -44,10 +64,27 @@ struct networkModel
     double normalisedFlow;
     bool is2D;
 
+    // Permeability tensor (SI) under linear pressure conditions on the six faces: row a holds the mean flow along each
+    // axis for a pressure gradient along axis a. Zero unless the directional permeabilities are enabled.
+    std::array<std::array<double, 3>, 3> permeabilityTensor = {};
+
     std::vector<porePtr> tableOfPores;
     std::vector<nodePtr> tableOfNodes;
     std::vector<pore *> inletPores;
     std::vector<pore *> outletPores;
+    std::shared_ptr<elementArena> elementsArena = std::make_shared<elementArena>();
+
+    // Ids the nodes and pores had when built, by table position; empty when the network was not renumbered
+    std::vector<int> originalNodesIds;
+    std::vector<int> originalPoresIds;
+
+    ///////////// Contiguous mirror of the elements
+
+    networkArrays arrays;
+
+    ///////////// Grid of the nodes, for box queries
+
+    spatialIndex nodesIndex;
 };
 
 } // namespace PNM
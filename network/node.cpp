@@ -12,7 +12,7 @@ namespace PNM
 
 node::node(double X, double Y, double Z)
 {
-    type = capillaryType::poreBody;
+    setFlag(poreBodyBit, true);
     x = X;
     y = Y;
     z = Z;
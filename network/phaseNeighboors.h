@@ -0,0 +1,62 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef PHASENEIGHBOORS_H
+#define PHASENEIGHBOORS_H
+
+#include "networkmodel.h"
+#include "node.h"
+#include "pore.h"
+
+#include <vector>
+
+namespace PNM
+{
+
+// Oil-filled and water-filled pores around each node (the cooperative pore-filling counts), kept by node index.
+// Counted once by reset, then updated by the caller for each pore changing phase, through its two nodes only.
+class phaseNeighboors
+{
+  public:
+    void reset(networkModel &network)
+    {
+        if (!network.arrays.matches(network))
+            network.arrays.build(network);
+
+        counts.assign(2 * network.totalNodes, 0);
+        for (const auto &p : network.tableOfPores)
+            add(p.get(), p->getPhaseFlag(), 1);
+    }
+
+    void update(pore *p, phase previous)
+    {
+        if (previous == p->getPhaseFlag())
+            return;
+        add(p, previous, -1);
+        add(p, p->getPhaseFlag(), 1);
+    }
+
+    int count(const node *n, phase phaseFlag) const { return counts[2 * n->getIndex() + (phaseFlag == phase::water ? 1 : 0)]; }
+
+  protected:
+    void add(const pore *p, phase phaseFlag, int increment)
+    {
+        if (phaseFlag != phase::oil && phaseFlag != phase::water)
+            return;
+        int slot = phaseFlag == phase::water ? 1 : 0;
+        if (p->getNodeIn() != 0)
+            counts[2 * p->getNodeIn()->getIndex() + slot] += increment;
+        if (p->getNodeOut() != 0)
+            counts[2 * p->getNodeOut()->getIndex() + slot] += increment;
+    }
+
+    std::vector<int> counts; // oil then water pores, interleaved by node
+};
+
+} // namespace PNM
+
+#endif // PHASENEIGHBOORS_H
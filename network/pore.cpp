@@ -17,7 +17,7 @@ using namespace std;
 
 pore::pore(node *const &pNodeIn, node *const &pNodeOut)
 {
-    type = capillaryType::throat;
+    setFlag(poreBodyBit, false);
     nodeIn = pNodeIn;
     nodeOut = pNodeOut;
     fullLength = 0;
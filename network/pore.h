@@ -35,17 +35,17 @@ public:
   double getFullLength() const { return fullLength; }
   void setFullLength(double value) { fullLength = value; }
 
-  bool getNodeInOil() const { return nodeInOil; }
-  void setNodeInOil(bool value) { nodeInOil = value; }
+  bool getNodeInOil() const { return getFlag(nodeInOilBit); }
+  void setNodeInOil(bool value) { setFlag(nodeInOilBit, value); }
 
-  bool getNodeOutWater() const { return nodeOutWater; }
-  void setNodeOutWater(bool value) { nodeOutWater = value; }
+  bool getNodeOutWater() const { return getFlag(nodeOutWaterBit); }
+  void setNodeOutWater(bool value) { setFlag(nodeOutWaterBit, value); }
 
-  bool getNodeInWater() const { return nodeInWater; }
-  void setNodeInWater(bool value) { nodeInWater = value; }
+  bool getNodeInWater() const { return getFlag(nodeInWaterBit); }
+  void setNodeInWater(bool value) { setFlag(nodeInWaterBit, value); }
 
-  bool getNodeOutOil() const { return nodeOutOil; }
-  void setNodeOutOil(bool value) { nodeOutOil = value; }
+  bool getNodeOutOil() const { return getFlag(nodeOutOilBit); }
+  void setNodeOutOil(bool value) { setFlag(nodeOutOilBit, value); }
 
   //implemented methods
 
@@ -67,11 +67,11 @@ protected:
   node *nodeOut;     // node pointer at the second end of the pore
   double fullLength; // distance (SI) between both connecting nodes centers
 
-  // simulation related attributes
-  bool nodeInOil;    // flags oil existence at nodeIn
-  bool nodeOutWater; // flags water existence at nodeOut
-  bool nodeInWater;  // flags water existence at nodeIn
-  bool nodeOutOil;   // flags oil existence at nodeOut
+  // simulation related attributes, as bits of the element flags
+  static const uint32_t nodeInOilBit = firstDerivedBit;         // flags oil existence at nodeIn
+  static const uint32_t nodeOutWaterBit = firstDerivedBit << 1; // flags water existence at nodeOut
+  static const uint32_t nodeInWaterBit = firstDerivedBit << 2;  // flags water existence at nodeIn
+  static const uint32_t nodeOutOilBit = firstDerivedBit << 3;   // flags oil existence at nodeOut
 };
 
 } // namespace PNM
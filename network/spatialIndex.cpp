@@ -0,0 +1,133 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "spatialIndex.h"
+#include "networkmodel.h"
+#include "node.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace PNM
+{
+
+void spatialIndex::build(const networkModel &network)
+{
+    nodes = network.totalNodes;
+
+    std::vector<double> nodesCoordinates(3 * nodes);
+#pragma omp parallel for
+    for (int i = 0; i < nodes; ++i)
+    {
+        const node *n = network.getNode(i);
+        nodesCoordinates[3 * i] = n->getXCoordinate();
+        nodesCoordinates[3 * i + 1] = n->getYCoordinate();
+        nodesCoordinates[3 * i + 2] = n->getZCoordinate();
+    }
+
+    //Bounding box of the nodes, cut into cells as cubic as the extents allow; flat axes (2D networks) get one cell
+    double extent[3], volume(1);
+    int spreadAxes(0);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        double lower = nodes > 0 ? nodesCoordinates[axis] : 0, upper = lower;
+        for (int i = 0; i < nodes; ++i)
+        {
+            lower = std::min(lower, nodesCoordinates[3 * i + axis]);
+            upper = std::max(upper, nodesCoordinates[3 * i + axis]);
+        }
+        origin[axis] = lower;
+        extent[axis] = upper - lower;
+        if (extent[axis] > 0)
+        {
+            volume *= extent[axis];
+            spreadAxes++;
+        }
+    }
+
+    double side = spreadAxes > 0 ? std::pow(volume / std::max(1, nodes), 1.0 / spreadAxes) : 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        cells[axis] = extent[axis] > 0 ? std::max(1, int(extent[axis] / side)) : 1;
+        cellSize[axis] = extent[axis] > 0 ? extent[axis] / cells[axis] : 1;
+    }
+
+    //Counting sort of the nodes by cell, each cell keeping its nodes in increasing order
+    int totalCells = cells[0] * cells[1] * cells[2];
+    std::vector<int> nodesCells(nodes);
+#pragma omp parallel for
+    for (int i = 0; i < nodes; ++i)
+        nodesCells[i] = (getCell(0, nodesCoordinates[3 * i]) * cells[1] + getCell(1, nodesCoordinates[3 * i + 1])) * cells[2] +
+                        getCell(2, nodesCoordinates[3 * i + 2]);
+
+    cellsOffset.assign(totalCells + 1, 0);
+    for (int i = 0; i < nodes; ++i)
+        cellsOffset[nodesCells[i] + 1]++;
+    std::partial_sum(cellsOffset.begin(), cellsOffset.end(), cellsOffset.begin());
+
+    cellsNodes.resize(nodes);
+    coordinates.resize(3 * nodes);
+    std::vector<int> fill(cellsOffset.begin(), cellsOffset.end() - 1);
+    for (int i = 0; i < nodes; ++i)
+    {
+        int k = fill[nodesCells[i]]++;
+        cellsNodes[k] = i;
+        std::copy(&nodesCoordinates[3 * i], &nodesCoordinates[3 * i] + 3, &coordinates[3 * k]);
+    }
+}
+
+bool spatialIndex::indexes(const networkModel &network) const
+{
+    return nodes == network.totalNodes && int(cellsNodes.size()) == nodes && !cellsOffset.empty();
+}
+
+std::vector<int> spatialIndex::getNodesInBox(const double lower[3], const double upper[3]) const
+{
+    std::vector<int> inside;
+    if (cellsOffset.empty())
+        return inside;
+
+    int first[3], last[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (upper[axis] < lower[axis])
+            return inside;
+        first[axis] = getCell(axis, lower[axis]);
+        last[axis] = getCell(axis, upper[axis]);
+    }
+
+    for (int i = first[0]; i <= last[0]; ++i)
+        for (int j = first[1]; j <= last[1]; ++j)
+            for (int k = first[2]; k <= last[2]; ++k)
+            {
+                int cell = (i * cells[1] + j) * cells[2] + k;
+                for (int e = cellsOffset[cell]; e < cellsOffset[cell + 1]; ++e)
+                {
+                    const double *x = &coordinates[3 * e];
+                    if (x[0] >= lower[0] && x[0] <= upper[0] && x[1] >= lower[1] && x[1] <= upper[1] && x[2] >= lower[2] && x[2] <= upper[2])
+                        inside.push_back(cellsNodes[e]);
+                }
+            }
+
+    std::sort(inside.begin(), inside.end());
+    return inside;
+}
+
+size_t spatialIndex::getMemoryUsage() const
+{
+    return (cellsOffset.capacity() + cellsNodes.capacity()) * sizeof(int) + coordinates.capacity() * sizeof(double);
+}
+
+int spatialIndex::getCell(int axis, double coordinate) const
+{
+    //Coordinates out of the nodes bounding box fall in the border cells
+    double position = std::floor((coordinate - origin[axis]) / cellSize[axis]);
+    return int(std::max(0.0, std::min(double(cells[axis] - 1), position)));
+}
+
+} // namespace PNM
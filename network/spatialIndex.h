@@ -0,0 +1,44 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <cstddef>
+#include <vector>
+
+namespace PNM
+{
+
+struct networkModel;
+
+// Uniform grid over the nodes centers, of about one node per cell, for the box queries of the network operations.
+// Nodes are indexed like the networkArrays; the index is rebuilt whenever the nodes table changes.
+class spatialIndex
+{
+  public:
+    spatialIndex() : nodes(0) {}
+    void build(const networkModel &);
+    bool indexes(const networkModel &) const;
+    std::vector<int> getNodesInBox(const double lower[3], const double upper[3]) const; // bounds included, nodes in increasing order
+    size_t getMemoryUsage() const;
+
+  protected:
+    int getCell(int axis, double coordinate) const;
+
+    int nodes;
+    int cells[3];
+    double origin[3];
+    double cellSize[3];
+    std::vector<int> cellsOffset; // CSR: nodes of cell c are cellsNodes[cellsOffset[c]] .. cellsNodes[cellsOffset[c + 1] - 1]
+    std::vector<int> cellsNodes;
+    std::vector<double> coordinates; // x, y, z of each entry of cellsNodes
+};
+
+} // namespace PNM
+
+#endif // SPATIALINDEX_H
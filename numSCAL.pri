@@ -0,0 +1,144 @@
+#-------------------------------------------------
+#
+# Simulation core of numSCAL: networks, operations and simulations, without the GUI.
+# Shared by the application (numSCAL.pro) and the library (numSCAL_core.pro).
+#
+#-------------------------------------------------
+
+QT       += core
+
+CONFIG += c++14
+
+QMAKE_CXXFLAGS += -fopenmp
+LIBS += -fopenmp
+
+win32 {
+    LIBS += -lpsapi
+}
+
+
+SOURCES += \
+    builders/networkCache.cpp \
+    builders/networkbuilder.cpp \
+    builders/numscalNetworkBuilder.cpp \
+    builders/regularNetworkBuilder.cpp \
+    builders/latticeNetworkBuilder.cpp \
+    builders/statoilNetworkBuilder.cpp \
+    misc/outputWriter.cpp \
+    misc/taskScheduler.cpp \
+    misc/progressReporter.cpp \
+    misc/randomGenerator.cpp \
+    misc/resultsStore.cpp \
+    misc/counterRandom.cpp \
+    misc/scopedtimer.cpp \
+    misc/tools.cpp \
+    misc/userInput.cpp \
+    misc/videoEncoder.cpp \
+    network/cluster.cpp \
+    network/element.cpp \
+    network/networkArrays.cpp \
+    network/spatialIndex.cpp \
+    network/networkmodel.cpp \
+    network/node.cpp \
+    network/pore.cpp \
+    operations/hkClustering.cpp \
+    operations/clusterTracker.cpp \
+    operations/domainDecomposition.cpp \
+    operations/relativePermeabilityCache.cpp \
+    operations/networkStateFile.cpp \
+    operations/pnmOperation.cpp \
+    operations/pnmSolver.cpp \
+    operations/reverseTrapping.cpp \
+    operations/simulationContext.cpp \
+    simulations/steady-state-cycle/forcedWaterInjection.cpp \
+    simulations/steady-state-cycle/filmVolumetrics.cpp \
+    simulations/steady-state-cycle/invasionQueue.cpp \
+    simulations/steady-state-cycle/primaryDrainage.cpp \
+    simulations/steady-state-cycle/secondaryOilDrainage.cpp \
+    simulations/steady-state-cycle/spontaneousImbibtion.cpp \
+    simulations/steady-state-cycle/spontaneousOilInvasion.cpp \
+    simulations/steady-state-cycle/steadyStateSimulation.cpp \
+    simulations/tracer-flow/tracerFlowSimulation.cpp \
+    simulations/unsteady-state-flow/unsteadyStateSimulation.cpp \
+    simulations/template-simulation/templateFlowSimulation.cpp \
+    simulations/benchmarkRunner.cpp \
+    simulations/simulation.cpp \
+    simulations/simulationCheckpoint.cpp \
+    simulations/sweepRunner.cpp \
+    simulations/renderer/renderer.cpp \
+    misc/maths.cpp \
+    misc/memoryFootprint.cpp \
+    misc/numaPlacement.cpp
+
+
+HEADERS += \
+    builders/networkCache.h \
+    builders/networkbuilder.h \
+    builders/numscalNetworkBuilder.h \
+    builders/regularNetworkBuilder.h \
+    builders/latticeNetworkBuilder.h \
+    builders/statoilNetworkBuilder.h \
+    misc/maths.h \
+    misc/memoryFootprint.h \
+    misc/numaPlacement.h \
+    misc/outputWriter.h \
+    misc/taskScheduler.h \
+    misc/progressReporter.h \
+    misc/randomGenerator.h \
+    misc/reproducibleSum.h \
+    misc/resultsStore.h \
+    misc/counterRandom.h \
+    misc/scopedtimer.h \
+    misc/tools.h \
+    misc/userInput.h \
+    misc/videoEncoder.h \
+    network/cluster.h \
+    network/element.h \
+    network/elementArena.h \
+    network/iterator.h \
+    network/networkArrays.h \
+    network/spatialIndex.h \
+    network/frontier.h \
+    network/networkmodel.h \
+    network/networkView.h \
+    network/phaseNeighboors.h \
+    network/node.h \
+    network/pore.h \
+    operations/hkClustering.h \
+    operations/clusterTracker.h \
+    operations/domainDecomposition.h \
+    operations/relativePermeabilityCache.h \
+    operations/networkStateFile.h \
+    operations/pnmOperation.h \
+    operations/pnmSolver.h \
+    operations/reverseTrapping.h \
+    operations/simulationContext.h \
+    simulations/steady-state-cycle/forcedWaterInjection.h \
+    simulations/steady-state-cycle/filmVolumetrics.h \
+    simulations/steady-state-cycle/invasionQueue.h \
+    simulations/steady-state-cycle/primaryDrainage.h \
+    simulations/steady-state-cycle/secondaryOilDrainage.h \
+    simulations/steady-state-cycle/spontaneousImbibtion.h \
+    simulations/steady-state-cycle/spontaneousOilInvasion.h \
+    simulations/steady-state-cycle/steadyStateSimulation.h \
+    simulations/tracer-flow/tracerFlowSimulation.h \
+    simulations/unsteady-state-flow/unsteadyStateSimulation.h \
+    simulations/template-simulation/templateFlowSimulation.h \
+    simulations/benchmarkRunner.h \
+    simulations/convergenceMonitor.h \
+    simulations/simulation.h \
+    simulations/simulationCheckpoint.h \
+    simulations/sweepRunner.h \
+    simulations/renderer/renderer.h
+
+
+INCLUDEPATH += \
+    network \
+    builders \
+    simulations \
+    simulations/steady-state-cycle \
+    simulations/tracer-flow \
+    simulations/unsteady-state-flow \
+    operations \
+    misc \
+    libs
@@ -0,0 +1,17 @@
+#-------------------------------------------------
+#
+# Simulation core of numSCAL as a library, for analysis and coupling code running in the same process.
+# The network state is exposed without copies by network/networkView.h; simulations call their step callback
+# (simulation::setStepCallback) with it while they run.
+#
+#-------------------------------------------------
+
+QT       -= gui
+
+TARGET = numSCAL_core
+TEMPLATE = lib
+CONFIG += shared
+
+include(numSCAL.pri)
+
+CONFIG += warn_off
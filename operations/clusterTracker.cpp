@@ -0,0 +1,341 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "clusterTracker.h"
+#include "network/networkmodel.h"
+#include "network/cluster.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace PNM
+{
+
+bool clusterTracker::tracks(const networkModel &network) const
+{
+    return trackedNetwork == &network && trackedNodes == network.totalNodes && trackedPores == network.totalPores;
+}
+
+void clusterTracker::reset(const networkModel &network, std::vector<clusterPtr> &clusters, clusterPool &clustersPool, const std::vector<char> &elementsMembers, const std::vector<int> &elementsClusters)
+{
+    trackedNetwork = &network;
+    trackedNodes = network.totalNodes;
+    trackedPores = network.totalPores;
+    arrays = &network.arrays;
+    clustersList = &clusters;
+    pool = &clustersPool;
+
+    int totalElements = trackedNodes + trackedPores;
+    members.assign(elementsMembers.begin(), elementsMembers.begin() + totalElements);
+    clusterIndices.assign(elementsClusters.begin(), elementsClusters.begin() + totalElements);
+
+    boundary.assign(totalElements, 0);
+    for (int i = 0; i < trackedPores; ++i)
+        boundary[trackedNodes + i] = (arrays->poreInlet[i] ? 1 : 0) | (arrays->poreOutlet[i] ? 2 : 0);
+
+    //the clusters ids of a full clustering are their positions in the clusters list
+    clusterSlots = clusters;
+    positions.resize(clusterSlots.size());
+    std::iota(positions.begin(), positions.end(), 0);
+    sizes.assign(clusterSlots.size(), 0);
+    inletPores.assign(clusterSlots.size(), 0);
+    outletPores.assign(clusterSlots.size(), 0);
+    freeSlots.clear();
+    touchedSlots.clear();
+    relabelled.clear();
+
+    for (int i = 0; i < totalElements; ++i)
+    {
+        if (members[i])
+        {
+            int slot = clusterIndices[i];
+            sizes[slot]++;
+            inletPores[slot] += boundary[i] & 1;
+            outletPores[slot] += (boundary[i] & 2) >> 1;
+        }
+    }
+
+    spanningClusters = 0;
+    for (clusterPtr &c : clusterSlots)
+        if (c->getSpanning())
+            spanningClusters++;
+
+    searchMarks.assign(totalElements, 0);
+    searchStamp = 0;
+}
+
+void clusterTracker::update(const std::vector<int> &changedElements)
+{
+    relabelled.clear();
+
+    for (int i : changedElements)
+    {
+        if (members[i])
+            erase(i);
+        else
+            insert(i);
+    }
+
+    finalise();
+}
+
+void clusterTracker::insert(int i)
+{
+    members[i] = 1;
+
+    //the largest neighboor cluster absorbs the other ones
+    int target = -1;
+    forEachNeighboor(i, [this, &target](int j) {
+        if (members[j] && clusterIndices[j] != -1 && (target == -1 || sizes[clusterIndices[j]] > sizes[target]))
+            target = clusterIndices[j];
+    });
+
+    if (target == -1)
+        target = createCluster();
+
+    forEachNeighboor(i, [this, target](int j) {
+        if (members[j] && clusterIndices[j] != -1 && clusterIndices[j] != target)
+        {
+            int absorbed = clusterIndices[j];
+            relabelCluster(j, absorbed, target);
+            deleteCluster(absorbed);
+        }
+    });
+
+    clusterIndices[i] = target;
+    sizes[target]++;
+    inletPores[target] += boundary[i] & 1;
+    outletPores[target] += (boundary[i] & 2) >> 1;
+    relabelled.push_back(i);
+    touchedSlots.push_back(target);
+}
+
+void clusterTracker::erase(int i)
+{
+    int source = clusterIndices[i];
+    members[i] = 0;
+    clusterIndices[i] = -1;
+    sizes[source]--;
+    inletPores[source] -= boundary[i] & 1;
+    outletPores[source] -= (boundary[i] & 2) >> 1;
+    touchedSlots.push_back(source);
+
+    if (sizes[source] == 0)
+    {
+        deleteCluster(source);
+        return;
+    }
+
+    //the remaining neighboors belong to the same cluster: check whether they are still connected to each other
+    int searches(0);
+    forEachNeighboor(i, [this, &searches](int j) {
+        if (members[j])
+        {
+            if (int(searchVisits.size()) <= searches)
+                searchVisits.resize(searches + 1);
+            searchVisits[searches].assign(1, j);
+            searches++;
+        }
+    });
+
+    if (searches <= 1)
+        return;
+
+    if (searchStamp > std::numeric_limits<int>::max() - searches - 1)
+    {
+        std::fill(searchMarks.begin(), searchMarks.end(), 0);
+        searchStamp = 0;
+    }
+    int base = searchStamp + 1;
+    searchStamp += searches;
+
+    searchHeads.assign(searches, 0);
+    searchGroups.resize(searches);
+    std::iota(searchGroups.begin(), searchGroups.end(), 0);
+    searchSplit.assign(searches, 0);
+    for (int s = 0; s < searches; ++s)
+        searchMarks[searchVisits[s][0]] = base + s;
+
+    auto findGroup = [this](int s) -> int {
+        while (searchGroups[s] != s)
+            s = searchGroups[s];
+        return s;
+    };
+
+    //breadth-first searches run in lockstep until a single group of connected searches is still running;
+    //groups of searches which run out of elements are split off as new clusters
+    int activeGroups = searches;
+    while (activeGroups > 1)
+    {
+        bool exhaustedSearch = false;
+        for (int s = 0; s < searches && activeGroups > 1; ++s)
+        {
+            if (searchHeads[s] == int(searchVisits[s].size()))
+                continue;
+
+            int x = searchVisits[s][searchHeads[s]++];
+            forEachNeighboor(x, [this, s, base, searches, &activeGroups, &findGroup](int y) {
+                if (!members[y])
+                    return;
+                int mark = searchMarks[y] - base;
+                if (mark < 0 || mark >= searches)
+                {
+                    searchMarks[y] = base + s;
+                    searchVisits[s].push_back(y);
+                }
+                else
+                {
+                    int group = findGroup(s), otherGroup = findGroup(mark);
+                    if (group != otherGroup)
+                    {
+                        searchGroups[std::max(group, otherGroup)] = std::min(group, otherGroup);
+                        activeGroups--;
+                    }
+                }
+            });
+
+            if (searchHeads[s] == int(searchVisits[s].size()))
+                exhaustedSearch = true;
+        }
+
+        if (!exhaustedSearch)
+            continue;
+
+        for (int group = 0; group < searches && activeGroups > 1; ++group)
+        {
+            if (findGroup(group) != group || searchSplit[group])
+                continue;
+
+            bool exhausted = true;
+            for (int s = 0; s < searches; ++s)
+                if (findGroup(s) == group && searchHeads[s] < int(searchVisits[s].size()))
+                    exhausted = false;
+            if (!exhausted)
+                continue;
+
+            int piece = createCluster();
+            for (int s = 0; s < searches; ++s)
+                if (findGroup(s) == group)
+                    for (int y : searchVisits[s])
+                        moveElement(y, piece);
+
+            searchSplit[group] = 1;
+            activeGroups--;
+        }
+    }
+}
+
+void clusterTracker::finalise()
+{
+    for (int slot : touchedSlots)
+    {
+        if (!clusterSlots[slot])
+            continue;
+
+        cluster *c = clusterSlots[slot];
+        bool wasSpanning = c->getSpanning();
+        c->setInlet(inletPores[slot] > 0);
+        c->setOutlet(outletPores[slot] > 0);
+        c->setSpanning(c->getInlet() && c->getOutlet());
+        spanningClusters += int(c->getSpanning()) - int(wasSpanning);
+    }
+    touchedSlots.clear();
+}
+
+template <typename F>
+void clusterTracker::forEachNeighboor(int i, F f)
+{
+    if (i < trackedNodes)
+    {
+        for (int k = arrays->nodePoresOffset[i]; k < arrays->nodePoresOffset[i + 1]; ++k)
+            f(trackedNodes + arrays->nodePores[k]);
+    }
+    else
+    {
+        int nodeIn = arrays->poreNodeIn[i - trackedNodes];
+        int nodeOut = arrays->poreNodeOut[i - trackedNodes];
+        if (nodeIn != -1)
+            f(nodeIn);
+        if (nodeOut != -1 && nodeOut != nodeIn)
+            f(nodeOut);
+    }
+}
+
+int clusterTracker::createCluster()
+{
+    int slot;
+    if (!freeSlots.empty())
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        slot = clusterSlots.size();
+        clusterSlots.emplace_back();
+        positions.push_back(0);
+        sizes.push_back(0);
+        inletPores.push_back(0);
+        outletPores.push_back(0);
+    }
+
+    clusterSlots[slot] = pool->acquire(slot + 1);
+    sizes[slot] = 0;
+    inletPores[slot] = 0;
+    outletPores[slot] = 0;
+    positions[slot] = clustersList->size();
+    clustersList->push_back(clusterSlots[slot]);
+    touchedSlots.push_back(slot);
+    return slot;
+}
+
+void clusterTracker::deleteCluster(int slot)
+{
+    if (clusterSlots[slot]->getSpanning())
+        spanningClusters--;
+
+    int lastSlot = clustersList->back()->getId() - 1;
+    (*clustersList)[positions[slot]] = clustersList->back();
+    positions[lastSlot] = positions[slot];
+    clustersList->pop_back();
+
+    clusterSlots[slot] = nullptr;
+    freeSlots.push_back(slot);
+}
+
+void clusterTracker::moveElement(int i, int slot)
+{
+    int source = clusterIndices[i];
+    sizes[source]--;
+    inletPores[source] -= boundary[i] & 1;
+    outletPores[source] -= (boundary[i] & 2) >> 1;
+
+    clusterIndices[i] = slot;
+    sizes[slot]++;
+    inletPores[slot] += boundary[i] & 1;
+    outletPores[slot] += (boundary[i] & 2) >> 1;
+    relabelled.push_back(i);
+}
+
+void clusterTracker::relabelCluster(int start, int source, int target)
+{
+    mergeQueue.assign(1, start);
+    moveElement(start, target);
+    for (unsigned head = 0; head < mergeQueue.size(); ++head)
+    {
+        forEachNeighboor(mergeQueue[head], [this, source, target](int j) {
+            if (members[j] && clusterIndices[j] == source)
+            {
+                moveElement(j, target);
+                mergeQueue.push_back(j);
+            }
+        });
+    }
+}
+
+} // namespace PNM
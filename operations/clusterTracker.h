@@ -0,0 +1,86 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLUSTERTRACKER_H
+#define CLUSTERTRACKER_H
+
+#include <vector>
+
+namespace PNM
+{
+
+struct networkModel;
+struct networkArrays;
+class cluster;
+class clusterPool;
+
+using clusterPtr = cluster *;
+
+// Incremental maintenance of a clustering between two calls: elements joining the clustered set are merged
+// into their neighboors clusters (the smaller clusters being relabelled), elements leaving it trigger a local
+// search among their neighboors that only relabels the pieces split off the largest one.
+// Elements are indexed like pnmRange<element>: nodes first, then pores.
+class clusterTracker
+{
+  public:
+    clusterTracker() : trackedNetwork(0), trackedNodes(0), trackedPores(0), arrays(0), clustersList(0), pool(0), spanningClusters(0), searchStamp(0) {}
+    bool tracks(const networkModel &) const;
+    void forget() { trackedNetwork = 0; }
+    void reset(const networkModel &, std::vector<clusterPtr> &, clusterPool &, const std::vector<char> &, const std::vector<int> &);
+    void update(const std::vector<int> &);
+
+    bool getMember(int i) const { return members[i]; }
+    cluster *getCluster(int i) const { return clusterSlots[clusterIndices[i]]; }
+    const std::vector<int> &getRelabelledElements() const { return relabelled; }
+    bool isSpanning() const { return spanningClusters > 0; }
+
+  protected:
+    void insert(int);
+    void erase(int);
+    void finalise();
+    template <typename F>
+    void forEachNeighboor(int, F);
+    int createCluster();
+    void deleteCluster(int);
+    void moveElement(int, int);
+    void relabelCluster(int, int, int);
+
+    const networkModel *trackedNetwork;
+    int trackedNodes;
+    int trackedPores;
+    const networkArrays *arrays;
+    std::vector<clusterPtr> *clustersList;
+    clusterPool *pool; // storage of the clusters, slot i being the entry of the cluster id i + 1
+
+    std::vector<char> members;
+    std::vector<char> boundary; // 1: inlet pore, 2: outlet pore
+    std::vector<int> clusterIndices;
+    std::vector<int> relabelled;
+    std::vector<int> mergeQueue;
+
+    // clusters slots: stable indices, with their position in the clusters list and their statistics
+    std::vector<clusterPtr> clusterSlots;
+    std::vector<int> positions;
+    std::vector<int> sizes;
+    std::vector<int> inletPores;
+    std::vector<int> outletPores;
+    std::vector<int> freeSlots;
+    std::vector<int> touchedSlots;
+    int spanningClusters;
+
+    // local searches buffers
+    std::vector<int> searchMarks;
+    int searchStamp;
+    std::vector<std::vector<int>> searchVisits;
+    std::vector<int> searchHeads;
+    std::vector<int> searchGroups;
+    std::vector<char> searchSplit;
+};
+
+} // namespace PNM
+
+#endif // CLUSTERTRACKER_H
@@ -0,0 +1,205 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "domainDecomposition.h"
+#include "network/networkmodel.h"
+#include "network/node.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace PNM
+{
+
+bool domainDecomposition::partitions(const networkModel &network, int domainsNumber) const
+{
+    return partitionedNetwork == &network && partitionedNodes == network.totalNodes && partitionedPores == network.totalPores &&
+           domains == std::max(1, std::min(domainsNumber, network.totalNodes));
+}
+
+void domainDecomposition::partition(const networkModel &network, int domainsNumber)
+{
+    partitionedNetwork = &network;
+    partitionedNodes = network.totalNodes;
+    partitionedPores = network.totalPores;
+    domains = std::max(1, std::min(domainsNumber, partitionedNodes));
+
+    coordinates.resize(3 * partitionedNodes);
+    for (int i = 0; i < partitionedNodes; ++i)
+    {
+        const node *n = network.tableOfNodes[i].get();
+        coordinates[3 * i] = n->getXCoordinate();
+        coordinates[3 * i + 1] = n->getYCoordinate();
+        coordinates[3 * i + 2] = n->getZCoordinate();
+    }
+
+    std::vector<int> nodes(partitionedNodes);
+    std::iota(nodes.begin(), nodes.end(), 0);
+    nodeDomains.assign(partitionedNodes, 0);
+    int nextDomain(0);
+    if (partitionedNodes > 0)
+        bisect(nodes.begin(), nodes.end(), domains, nextDomain);
+
+    //Subdomains nodes are listed in the nodes order, which keeps the blocks as local as the system
+    domainOffsets.assign(domains + 1, 0);
+    for (int n = 0; n < partitionedNodes; ++n)
+        domainOffsets[nodeDomains[n] + 1]++;
+    std::partial_sum(domainOffsets.begin(), domainOffsets.end(), domainOffsets.begin());
+
+    domainNodes.resize(partitionedNodes);
+    localIndices.resize(partitionedNodes);
+    std::vector<int> fill(domainOffsets.begin(), domainOffsets.end() - 1);
+    for (int n = 0; n < partitionedNodes; ++n)
+    {
+        int d = nodeDomains[n];
+        localIndices[n] = fill[d] - domainOffsets[d];
+        domainNodes[fill[d]++] = n;
+    }
+
+    const networkArrays &arrays = network.arrays;
+    haloPores = 0;
+    for (int p = 0; p < partitionedPores; ++p)
+    {
+        int in = arrays.poreNodeIn[p], out = arrays.poreNodeOut[p];
+        if (in != -1 && out != -1 && nodeDomains[in] != nodeDomains[out])
+            haloPores++;
+    }
+
+    blocks.clear();
+    blocksValues.clear();
+    solvers.clear();
+}
+
+size_t domainDecomposition::getMemoryUsage() const
+{
+    size_t bytes = (coordinates.capacity()) * sizeof(double) +
+                   (nodeDomains.capacity() + localIndices.capacity() + domainOffsets.capacity() + domainNodes.capacity()) * sizeof(int);
+    for (int d = 0; d < int(blocks.size()); ++d)
+    {
+        bytes += blocks[d].nonZeros() * (sizeof(double) + sizeof(int)) + blocksValues[d].capacity() * sizeof(int);
+        if (solvers[d])
+            bytes += solvers[d]->matrixL().nestedExpression().nonZeros() * (sizeof(double) + sizeof(int));
+    }
+    return bytes;
+}
+
+void domainDecomposition::bisect(std::vector<int>::iterator first, std::vector<int>::iterator last, int parts, int &nextDomain)
+{
+    if (parts == 1)
+    {
+        for (auto it = first; it != last; ++it)
+            nodeDomains[*it] = nextDomain;
+        nextDomain++;
+        return;
+    }
+
+    //Cut across the longest extent of the nodes, in proportion of the subdomains on each side
+    double lower[3], upper[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        lower[axis] = coordinates[3 * *first + axis];
+        upper[axis] = lower[axis];
+    }
+    for (auto it = first; it != last; ++it)
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            lower[axis] = std::min(lower[axis], coordinates[3 * *it + axis]);
+            upper[axis] = std::max(upper[axis], coordinates[3 * *it + axis]);
+        }
+
+    int axis = 0;
+    for (int a = 1; a < 3; ++a)
+        if (upper[a] - lower[a] > upper[axis] - lower[axis])
+            axis = a;
+
+    int lowerParts = parts / 2;
+    auto cut = first + (last - first) * lowerParts / parts;
+    std::nth_element(first, cut, last, [this, axis](int i, int j) {
+        return coordinates[3 * i + axis] < coordinates[3 * j + axis] || (coordinates[3 * i + axis] == coordinates[3 * j + axis] && i < j);
+    });
+
+    bisect(first, cut, lowerParts, nextDomain);
+    bisect(cut, last, parts - lowerParts, nextDomain);
+}
+
+void domainDecomposition::analyzePattern(const Eigen::SparseMatrix<double> &matrix)
+{
+    const int *columnsOffset = matrix.outerIndexPtr();
+    const int *rows = matrix.innerIndexPtr();
+
+    blocks.resize(domains);
+    blocksValues.resize(domains);
+    solvers.resize(domains);
+
+    int threads = Eigen::nbThreads();
+
+#pragma omp parallel for schedule(dynamic) if (threads > 1) num_threads(threads)
+    for (int d = 0; d < domains; ++d)
+    {
+        int size = domainOffsets[d + 1] - domainOffsets[d];
+        Eigen::SparseMatrix<double> &block = blocks[d];
+        std::vector<int> &values = blocksValues[d];
+        values.clear();
+
+        //Rows of a column are sorted, and so are their positions in the subdomain: the block is filled in order
+        block.resize(size, size);
+        block.setZero();
+        for (int j = 0; j < size; ++j)
+        {
+            int n = domainNodes[domainOffsets[d] + j];
+            block.startVec(j);
+            for (int k = columnsOffset[n]; k < columnsOffset[n + 1]; ++k)
+                if (nodeDomains[rows[k]] == d)
+                {
+                    block.insertBack(localIndices[rows[k]], j) = 0;
+                    values.push_back(k);
+                }
+        }
+        block.finalize();
+
+        solvers[d].reset(new blockSolver);
+        solvers[d]->analyzePattern(block);
+    }
+}
+
+void domainDecomposition::factorize(const Eigen::SparseMatrix<double> &matrix, double scale)
+{
+    const double *systemValues = matrix.valuePtr();
+    int threads = Eigen::nbThreads();
+
+#pragma omp parallel for schedule(dynamic) if (threads > 1) num_threads(threads)
+    for (int d = 0; d < domains; ++d)
+    {
+        double *values = blocks[d].valuePtr();
+        const std::vector<int> &positions = blocksValues[d];
+        for (size_t k = 0; k < positions.size(); ++k)
+            values[k] = scale * systemValues[positions[k]];
+        solvers[d]->factorize(blocks[d]);
+    }
+}
+
+void domainDecomposition::apply(const Eigen::VectorXd &residual, Eigen::VectorXd &correction) const
+{
+    correction.resize(residual.size());
+    int threads = Eigen::nbThreads();
+
+#pragma omp parallel for schedule(dynamic) if (threads > 1) num_threads(threads)
+    for (int d = 0; d < domains; ++d)
+    {
+        int size = domainOffsets[d + 1] - domainOffsets[d];
+        const int *nodes = domainNodes.data() + domainOffsets[d];
+
+        Eigen::VectorXd local(size);
+        for (int j = 0; j < size; ++j)
+            local[j] = residual[nodes[j]];
+        local = solvers[d]->solve(local);
+        for (int j = 0; j < size; ++j)
+            correction[nodes[j]] = local[j];
+    }
+}
+
+} // namespace PNM
@@ -0,0 +1,66 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef DOMAINDECOMPOSITION_H
+#define DOMAINDECOMPOSITION_H
+
+#include <libs/Eigen/Sparse>
+#include <libs/Eigen/SparseCholesky>
+
+#include <memory>
+#include <vector>
+
+namespace PNM
+{
+
+struct networkModel;
+
+// Partition of the network nodes into compact subdomains by recursive coordinate bisection, the pores joining
+// two subdomains forming their halo. On a pressure system, the subdomains define a block Jacobi preconditioner:
+// each diagonal block (the system restricted to one subdomain, its halo couplings dropped) is factorized and
+// solved independently of the others, in parallel. Nodes are indexed like the networkArrays.
+class domainDecomposition
+{
+  public:
+    domainDecomposition() : partitionedNetwork(0), partitionedNodes(0), partitionedPores(0), domains(0), haloPores(0) {}
+    bool partitions(const networkModel &, int) const;
+    void partition(const networkModel &, int);
+    void analyzePattern(const Eigen::SparseMatrix<double> &);
+    void factorize(const Eigen::SparseMatrix<double> &, double scale = 1);
+    void apply(const Eigen::VectorXd &, Eigen::VectorXd &) const;
+
+    int getDomains() const { return domains; }
+    int getHaloPores() const { return haloPores; }
+    int getNodeDomain(int n) const { return nodeDomains[n]; }
+    size_t getMemoryUsage() const;
+
+  protected:
+    void bisect(std::vector<int>::iterator, std::vector<int>::iterator, int, int &);
+
+    using blockSolver = Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>>;
+
+    const networkModel *partitionedNetwork;
+    int partitionedNodes;
+    int partitionedPores;
+    int domains;
+    int haloPores;
+    std::vector<double> coordinates; // x, y, z of each node
+
+    std::vector<int> nodeDomains;
+    std::vector<int> localIndices;  // position of each node in its subdomain
+    std::vector<int> domainOffsets; // CSR: nodes of subdomain d are domainNodes[domainOffsets[d]] .. domainNodes[domainOffsets[d + 1] - 1]
+    std::vector<int> domainNodes;
+
+    // Diagonal blocks, whose values are refilled from the system values before each factorization
+    std::vector<Eigen::SparseMatrix<double>> blocks;
+    std::vector<std::vector<int>> blocksValues; // position in the system values of each block value
+    std::vector<std::unique_ptr<blockSolver>> solvers;
+};
+
+} // namespace PNM
+
+#endif // DOMAINDECOMPOSITION_H
@@ -6,118 +6,136 @@
 /////////////////////////////////////////////////////////////////////////////
 
 #include "hkClustering.h"
+#include "simulationContext.h"
 #include "network/iterator.h"
 #include "network/cluster.h"
+#include "misc/scopedtimer.h"
+#include "misc/memoryFootprint.h"
 
-#include <set>
 #include <algorithm>
 
 namespace PNM
 {
 
-hkClustering hkClustering::instance;
+clusterMembers clustersMembers::get(const cluster *c) const
+{
+    //clusters of an older clustering are not indexed anymore
+    auto it = rows.find(c);
+    if (it == rows.end())
+        return clusterMembers(nullptr, nullptr);
+    return clusterMembers(elements.data() + offsets[it->second], elements.data() + offsets[it->second + 1]);
+}
 
 hkClustering &hkClustering::get(std::shared_ptr<networkModel> network)
 {
+    hkClustering &instance = simulationContext::current().clustering;
     instance.network = network;
     return instance;
 }
 
 void hkClustering::clusterWaterWetElements()
 {
-    cluster *(element::*getter)() const = &element::getClusterWaterWet;
-    void (element::*setter)(cluster *) = &element::setClusterWaterWet;
-    wettability (element::*status)(void) const = &element::getWettabilityFlag;
-    clusterElements(getter, setter, status, wettability::waterWet, waterWetClusters);
+    clusterElements<clusteringPolicy::waterWet>(waterWetClusters, waterWetClustersPool);
 }
 
 void hkClustering::clusterOilWetElements()
 {
-    cluster *(element::*getter)() const = &element::getClusterOilWet;
-    void (element::*setter)(cluster *) = &element::setClusterOilWet;
-    wettability (element::*status)(void) const = &element::getWettabilityFlag;
-    clusterElements(getter, setter, status, wettability::oilWet, oilWetClusters);
+    clusterElements<clusteringPolicy::oilWet>(oilWetClusters, oilWetClustersPool);
 }
 
 void hkClustering::clusterWaterElements()
 {
-    cluster *(element::*getter)() const = &element::getClusterWater;
-    void (element::*setter)(cluster *) = &element::setClusterWater;
-    phase (element::*status)(void) const = &element::getPhaseFlag;
-    clusterElements(getter, setter, status, phase::water, waterClusters);
+    clusterElements<clusteringPolicy::water>(waterClusters, waterClustersPool, &waterClustersMembers);
 
     isWaterSpanning = isSpanning(waterClusters);
 }
 
 void hkClustering::clusterOilElements()
 {
-    cluster *(element::*getter)() const = &element::getClusterOil;
-    void (element::*setter)(cluster *) = &element::setClusterOil;
-    phase (element::*status)(void) const = &element::getPhaseFlag;
-    clusterElements(getter, setter, status, phase::oil, oilClusters);
+    clusterElements<clusteringPolicy::oil>(oilClusters, oilClustersPool, &oilClustersMembers);
 
     isOilSpanning = isSpanning(oilClusters);
 }
 
 void hkClustering::clusterOilConductorElements()
 {
-    cluster *(element::*getter)() const = &element::getClusterOilConductor;
-    void (element::*setter)(cluster *) = &element::setClusterOilFilm;
-    bool (element::*status)(void) const = &element::getOilConductor;
-    clusterElements(getter, setter, status, true, oilFilmClusters);
+    updateClusters<clusteringPolicy::oilConductor>(oilFilmClusters, oilFilmClustersPool, oilConductorTracker);
 
-    isOilSpanningThroughFilms = isSpanning(oilFilmClusters);
+    isOilSpanningThroughFilms = oilConductorTracker.isSpanning();
 }
 
 void hkClustering::clusterWaterConductorElements()
 {
-    cluster *(element::*getter)() const = &element::getClusterWaterConductor;
-    void (element::*setter)(cluster *) = &element::setClusterWaterFilm;
-    bool (element::*status)(void) const = &element::getWaterConductor;
-    clusterElements(getter, setter, status, true, waterFilmClusters);
+    updateClusters<clusteringPolicy::waterConductor>(waterFilmClusters, waterFilmClustersPool, waterConductorTracker);
 
-    isWaterSpanningThroughFilms = isSpanning(waterFilmClusters);
+    isWaterSpanningThroughFilms = waterConductorTracker.isSpanning();
 }
 
-void hkClustering::clusterActiveElements()
+void hkClustering::clusterActiveElements(bool tracked)
 {
-    cluster *(element::*getter)() const = &element::getClusterActive;
-    void (element::*setter)(cluster *) = &element::setClusterActive;
-    bool (element::*status)(void) const = &element::getActive;
-    clusterElements(getter, setter, status, true, activeClusters);
+    if (!tracked)
+    {
+        //Network builders cluster once, before the elements are renumbered: nothing is worth tracking
+        clusterElements<clusteringPolicy::active>(activeClusters, activeClustersPool);
+        activeTracker.forget();
+        isNetworkSpanning = isSpanning(activeClusters);
+        return;
+    }
 
-    isNetworkSpanning = isSpanning(activeClusters);
+    updateClusters<clusteringPolicy::active>(activeClusters, activeClustersPool, activeTracker);
+
+    isNetworkSpanning = activeTracker.isSpanning();
 }
 
-int hkClustering::hkFind(int x, std::vector<int> &labels)
+void hkClustering::resetTrackedClusters()
 {
-    int y = x;
-    while (labels[y] != y)
-        y = labels[y];
+    waterConductorTracker.forget();
+    oilConductorTracker.forget();
+    activeTracker.forget();
+}
 
-    while (labels[x] != x)
+int hkClustering::hkFind(int x)
+{
+    //path halving: concurrent updates only ever move a label closer to its root
+    while (true)
     {
-        int z = labels[x];
-        labels[x] = y;
-        x = z;
+        int parent = labels[x].load();
+        if (parent == x)
+            return x;
+        int grandParent = labels[parent].load();
+        if (parent != grandParent)
+            labels[x].compare_exchange_weak(parent, grandParent);
+        x = grandParent;
     }
-    return y;
 }
 
-int hkClustering::hkUnion(std::vector<int> &v, std::vector<int> &labels)
+void hkClustering::hkUnion(int x, int y)
 {
-    //joins equivalence classes and returns the canonical label of the resulting class.
-    for (unsigned i = 1; i < v.size(); ++i)
-        labels[hkFind(v[i], labels)] = hkFind(v[0], labels);
-    return hkFind(v[0], labels);
+    //joins equivalence classes by attaching the larger root to the smaller one
+    while (true)
+    {
+        x = hkFind(x);
+        y = hkFind(y);
+        if (x == y)
+            return;
+        if (x < y)
+            std::swap(x, y);
+        int root = x;
+        if (labels[x].compare_exchange_strong(root, y))
+            return;
+    }
 }
 
-int hkClustering::hkMakeSet(std::vector<int> &labels)
+void hkClustering::reserveLabels(int size)
 {
-    //creates a new equivalence class and returns its label
-    labels[0]++;
-    labels.push_back(labels[0]);
-    return labels[0];
+    if (size > labelsCapacity)
+    {
+        labels.reset(new std::atomic<int>[size]);
+        labelsCapacity = size;
+    }
+    members.resize(size);
+    roots.resize(size);
+    newLabels.resize(size);
 }
 
 bool hkClustering::isSpanning(const std::vector<clusterPtr> &clustersList)
@@ -133,78 +151,188 @@ bool hkClustering::isSpanning(const std::vector<clusterPtr> &clustersList)
     return false;
 }
 
-template <typename T>
-void hkClustering::clusterElements(cluster *(element::*getter)() const, void (element::*setter)(cluster *), T (element::*status)() const, T flag, std::vector<clusterPtr> &clustersList)
+element *hkClustering::getElement(int i)
+{
+    return pnmSpan<element>(*network)[i];
+}
+
+template <typename Policy>
+void hkClustering::gatherMembers()
 {
+    pnmSpan<node> nodes(*network);
+    pnmSpan<pore> pores(*network);
+    int totalNodes = nodes.size();
+
+#pragma omp parallel for
+    for (int i = 0; i < totalNodes; ++i)
+    {
+        members[i] = Policy::member(nodes[i]);
+        labels[i].store(i);
+    }
+
+#pragma omp parallel for
+    for (int i = 0; i < pores.size(); ++i)
+    {
+        members[totalNodes + i] = Policy::member(pores[i]);
+        labels[totalNodes + i].store(totalNodes + i);
+    }
+}
+
+template <typename Policy>
+void hkClustering::clusterElements(std::vector<clusterPtr> &clustersList, clusterPool &pool, clustersMembers *index)
+{
+    MEASURE_FUNCTION();
     clustersList.clear();
 
-    for (element *e : pnmRange<element>(network))
-        if ((e->*status)() == flag)
-            e->setClusterTemp(0);
+    networkArrays &arrays = network->arrays;
+    if (!arrays.matches(*network))
+        arrays.build(*network);
 
-    std::vector<int> labels;
-    labels.push_back(0);
+    int totalNodes = network->totalNodes;
+    int totalElements = network->totalNodes + network->totalPores;
+    reserveLabels(totalElements);
+    gatherMembers<Policy>();
 
-    for (element *e : pnmRange<element>(network))
+    //Lock-free union-find over the node-to-pore adjacency
+#pragma omp parallel for
+    for (int i = 0; i < network->totalPores; ++i)
     {
-        if ((e->*status)() == flag)
-        {
-            std::vector<int> neighboorsClusters;
-            std::vector<element *> &neighboors = e->getNeighboors();
-            for (element *neigh : neighboors)
-            {
-                if ((neigh->*status)() == flag && neigh->getClusterTemp() != 0)
-                    neighboorsClusters.push_back(neigh->getClusterTemp());
-            }
-            if (neighboorsClusters.empty())
-                e->setClusterTemp(hkMakeSet(labels));
-            else if (neighboorsClusters.size() == 1)
-                e->setClusterTemp(neighboorsClusters[0]);
-            else
-                e->setClusterTemp(hkUnion(neighboorsClusters, labels));
-        }
+        int p = totalNodes + i;
+        if (!members[p])
+            continue;
+        if (arrays.poreNodeIn[i] != -1 && members[arrays.poreNodeIn[i]])
+            hkUnion(p, arrays.poreNodeIn[i]);
+        if (arrays.poreNodeOut[i] != -1 && members[arrays.poreNodeOut[i]])
+            hkUnion(p, arrays.poreNodeOut[i]);
     }
 
-    //Create a mapping from the canonical labels determined by union/find into a new set of canonical labels, which are guaranteed to be sequential.
+#pragma omp parallel for
+    for (int i = 0; i < totalElements; ++i)
+        if (members[i])
+            roots[i] = hkFind(i);
 
-    std::vector<int> new_labels(labels.size(), 0);
+    //Create a mapping from the canonical labels determined by union/find into a new set of canonical labels, which are guaranteed to be sequential.
 
-    for (element *e : pnmRange<element>(network))
+    std::fill(newLabels.begin(), newLabels.end(), 0);
+    for (int i = 0; i < totalElements; ++i)
     {
-        if ((e->*status)() == flag)
+        if (members[i] && newLabels[roots[i]] == 0)
         {
-            int x = hkFind(e->getClusterTemp(), labels);
-            if (new_labels[x] == 0)
-            {
-                new_labels[0]++;
-                new_labels[x] = new_labels[0];
-                clustersList.push_back(std::shared_ptr<cluster>(new cluster(new_labels[0])));
-            }
-            (e->*setter)(clustersList[new_labels[x] - 1].get());
+            newLabels[roots[i]] = clustersList.size() + 1;
+            clustersList.push_back(pool.acquire(newLabels[roots[i]]));
         }
     }
 
-    //Identify sepecial clusters
-    std::set<cluster *> inletClusters, outletClusters, spanningClusters;
+    pnmSpan<element> elements(*network);
+#pragma omp parallel for
+    for (int i = 0; i < totalElements; ++i)
+        if (members[i])
+            Policy::set(elements[i], clustersList[newLabels[roots[i]] - 1]);
 
-    for (pore *p : pnmInlet(network))
-        if ((p->*status)() == flag)
-            inletClusters.insert((p->*getter)());
+    classifyClusters(clustersList);
 
-    for (pore *p : pnmOutlet(network))
-        if ((p->*status)() == flag)
-            outletClusters.insert((p->*getter)());
+    PROFILE_COUNTER("clusters", clustersList.size());
 
-    for (cluster *c : inletClusters)
-        c->setInlet(true);
+    if (index)
+        indexMembers(clustersList, *index);
 
-    for (cluster *c : outletClusters)
-        c->setOutlet(true);
+    recordMemoryUsage();
+}
+
+void hkClustering::recordMemoryUsage()
+{
+    size_t clusters(0);
+    for (const std::vector<clusterPtr> *clustersList : {&waterClusters, &oilClusters, &waterWetClusters, &oilWetClusters, &oilFilmClusters,
+                                                        &waterFilmClusters, &oilLayerClusters, &waterLayerClusters, &activeClusters})
+        clusters += memoryFootprint::of(*clustersList) + clustersList->size() * sizeof(cluster);
+
+    size_t buffers = labelsCapacity * sizeof(std::atomic<int>) + memoryFootprint::of(members) + memoryFootprint::of(roots) +
+                     memoryFootprint::of(newLabels) + memoryFootprint::of(clustersBoundary) + memoryFootprint::of(changedElements);
+    for (const clustersMembers *index : {&waterClustersMembers, &oilClustersMembers})
+        buffers += memoryFootprint::of(index->offsets) + memoryFootprint::of(index->elements) + index->rows.size() * 2 * sizeof(void *);
+
+    PROFILE_COUNTER("memory.clusters(MB)", memoryFootprint::toMB(clusters + buffers));
+}
+
+void hkClustering::classifyClusters(std::vector<clusterPtr> &clustersList)
+{
+    //Identify sepecial clusters from the boundary pores, in a flat array indexed by the cluster labels
+    const networkArrays &arrays = network->arrays;
+    int totalNodes = network->totalNodes;
+    clustersBoundary.assign(clustersList.size(), 0);
+
+    for (int i = 0; i < network->totalPores; ++i)
+    {
+        int p = totalNodes + i;
+        if (members[p])
+            clustersBoundary[newLabels[roots[p]] - 1] |= (arrays.poreInlet[i] ? 1 : 0) | (arrays.poreOutlet[i] ? 2 : 0);
+    }
+
+    for (unsigned r = 0; r < clustersList.size(); ++r)
+    {
+        char boundary = clustersBoundary[r];
+        clustersList[r]->setInlet(boundary & 1);
+        clustersList[r]->setOutlet(boundary & 2);
+        clustersList[r]->setSpanning(boundary == 3);
+    }
+}
+
+void hkClustering::indexMembers(const std::vector<clusterPtr> &clustersList, clustersMembers &index)
+{
+    //Counting sort of the elements by cluster label, labels being sequential after clusterElements
+    int totalElements = network->totalNodes + network->totalPores;
+    index.offsets.assign(clustersList.size() + 1, 0);
+    for (int i = 0; i < totalElements; ++i)
+        if (members[i])
+            index.offsets[newLabels[roots[i]] - 1]++;
+
+    for (unsigned r = 0; r < clustersList.size(); ++r)
+        index.offsets[r + 1] += index.offsets[r];
+
+    index.elements.resize(index.offsets.back());
+    for (int i = totalElements - 1; i >= 0; --i)
+        if (members[i])
+            index.elements[--index.offsets[newLabels[roots[i]] - 1]] = getElement(i);
+
+    index.rows.clear();
+    index.rows.reserve(clustersList.size());
+    for (unsigned r = 0; r < clustersList.size(); ++r)
+        index.rows[clustersList[r]] = r;
+}
+
+template <typename Policy>
+void hkClustering::updateClusters(std::vector<clusterPtr> &clustersList, clusterPool &pool, clusterTracker &tracker)
+{
+    networkArrays &arrays = network->arrays;
+    if (!arrays.matches(*network))
+        arrays.build(*network);
+
+    int totalElements = network->totalNodes + network->totalPores;
+    pnmSpan<element> elements(*network);
+
+    //Repair the previous clustering when only a few elements changed status since the last call
+    if (tracker.tracks(*network))
+    {
+        changedElements.clear();
+        for (int i = 0; i < totalElements; ++i)
+            if (Policy::member(elements[i]) != tracker.getMember(i))
+                changedElements.push_back(i);
+
+        if (changedElements.size() < unsigned(totalElements / 8))
+        {
+            tracker.update(changedElements);
+            for (int i : tracker.getRelabelledElements())
+                if (tracker.getMember(i))
+                    Policy::set(elements[i], tracker.getCluster(i));
+            return;
+        }
+    }
 
-    std::set_intersection(inletClusters.begin(), inletClusters.end(), outletClusters.begin(), outletClusters.end(), std::inserter(spanningClusters, spanningClusters.begin()));
+    clusterElements<Policy>(clustersList, pool);
 
-    for (cluster *c : spanningClusters)
-        c->setSpanning(true);
+    for (int i = 0; i < totalElements; ++i)
+        roots[i] = members[i] ? newLabels[roots[i]] - 1 : -1;
+    tracker.reset(*network, clustersList, pool, members, roots);
 }
 
 } // namespace PNM
@@ -8,17 +8,92 @@
 #ifndef HKCLUSTERING_H
 #define HKCLUSTERING_H
 
+#include "clusterTracker.h"
+#include "network/cluster.h"
+#include "network/element.h"
+
+#include <atomic>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace PNM
 {
 
 class networkModel;
-class cluster;
-class element;
 
-using clusterPtr = std::shared_ptr<cluster>;
+// Clustering policies: which elements belong to the clustered set, and where their cluster is stored.
+// They are resolved at compile time so that the predicates and accessors inline in the clustering loops.
+namespace clusteringPolicy
+{
+
+struct waterWet
+{
+    static bool member(const element *e) { return e->getWettabilityFlag() == wettability::waterWet; }
+    static void set(element *e, cluster *c) { e->setClusterWaterWet(c); }
+};
+
+struct oilWet
+{
+    static bool member(const element *e) { return e->getWettabilityFlag() == wettability::oilWet; }
+    static void set(element *e, cluster *c) { e->setClusterOilWet(c); }
+};
+
+struct water
+{
+    static bool member(const element *e) { return e->getPhaseFlag() == phase::water; }
+    static void set(element *e, cluster *c) { e->setClusterWater(c); }
+};
+
+struct oil
+{
+    static bool member(const element *e) { return e->getPhaseFlag() == phase::oil; }
+    static void set(element *e, cluster *c) { e->setClusterOil(c); }
+};
+
+struct oilConductor
+{
+    static bool member(const element *e) { return e->getOilConductor(); }
+    static void set(element *e, cluster *c) { e->setClusterOilFilm(c); }
+};
+
+struct waterConductor
+{
+    static bool member(const element *e) { return e->getWaterConductor(); }
+    static void set(element *e, cluster *c) { e->setClusterWaterFilm(c); }
+};
+
+struct active
+{
+    static bool member(const element *e) { return e->getActive(); }
+    static void set(element *e, cluster *c) { e->setClusterActive(c); }
+};
+
+} // namespace clusteringPolicy
+
+// Elements of a cluster, as listed by a clustersMembers index
+class clusterMembers
+{
+  public:
+    clusterMembers(element *const *first, element *const *last) : first(first), last(last) {}
+    element *const *begin() const { return first; }
+    element *const *end() const { return last; }
+
+  protected:
+    element *const *first;
+    element *const *last;
+};
+
+// Cluster-to-elements index of a clustering, in CSR form: the elements of the cluster in row r are
+// elements[offsets[r]] .. elements[offsets[r + 1] - 1], in the pnmRange<element> order
+struct clustersMembers
+{
+    clusterMembers get(const cluster *) const;
+
+    std::vector<int> offsets;
+    std::vector<element *> elements;
+    std::unordered_map<const cluster *, int> rows;
+};
 
 class hkClustering
 {
@@ -30,7 +105,10 @@ class hkClustering
     void clusterOilElements();
     void clusterOilConductorElements();
     void clusterWaterConductorElements();
-    void clusterActiveElements();
+    void clusterActiveElements(bool tracked = true); // untracked: one full pass, the incremental tracker left empty
+    void resetTrackedClusters();
+    clusterMembers getWaterClusterMembers(const cluster *c) const { return waterClustersMembers.get(c); }
+    clusterMembers getOilClusterMembers(const cluster *c) const { return oilClustersMembers.get(c); }
     bool isOilSpanning;
     bool isWaterSpanning;
     bool isOilSpanningThroughFilms;
@@ -47,21 +125,56 @@ class hkClustering
     std::vector<clusterPtr> activeClusters;
 
   protected:
-    hkClustering() {}
+    // Storage of the clusters listed above, reused from a call to the next
+    clusterPool waterClustersPool;
+    clusterPool oilClustersPool;
+    clusterPool waterWetClustersPool;
+    clusterPool oilWetClustersPool;
+    clusterPool oilFilmClustersPool;
+    clusterPool waterFilmClustersPool;
+    clusterPool activeClustersPool;
+
+    hkClustering() : labelsCapacity(0) {}
     ~hkClustering() {}
     hkClustering(const hkClustering &) = delete;
     hkClustering(hkClustering &&) = delete;
     auto operator=(const hkClustering &) -> hkClustering & = delete;
     auto operator=(hkClustering &&) -> hkClustering & = delete;
-    int hkFind(int, std::vector<int> &);
-    int hkUnion(std::vector<int> &, std::vector<int> &);
-    int hkMakeSet(std::vector<int> &);
-    template <typename T>
-    void clusterElements(cluster *(element::*)(void)const, void (element::*)(cluster *), T (element::*)(void) const, T, std::vector<clusterPtr> &);
+    friend class simulationContext;
+    int hkFind(int);
+    void hkUnion(int, int);
+    void reserveLabels(int);
+    template <typename Policy>
+    void clusterElements(std::vector<clusterPtr> &, clusterPool &, clustersMembers * = nullptr);
+    template <typename Policy>
+    void gatherMembers();
+    void classifyClusters(std::vector<clusterPtr> &);
+    void indexMembers(const std::vector<clusterPtr> &, clustersMembers &);
+    template <typename Policy>
+    void updateClusters(std::vector<clusterPtr> &, clusterPool &, clusterTracker &);
     bool isSpanning(const std::vector<clusterPtr> &);
+    void recordMemoryUsage();
+    element *getElement(int);
 
     std::shared_ptr<networkModel> network;
-    static hkClustering instance;
+
+    // Union-find buffers indexed like pnmRange<element>, reused between calls
+    std::unique_ptr<std::atomic<int>[]> labels;
+    int labelsCapacity;
+    std::vector<char> members;
+    std::vector<int> roots;
+    std::vector<int> newLabels;
+    std::vector<char> clustersBoundary; // per cluster label: 1 touches the inlet, 2 the outlet
+
+    // Members of the last water and oil clusterings
+    clustersMembers waterClustersMembers;
+    clustersMembers oilClustersMembers;
+
+    // Conductor and active clusters are repaired incrementally between calls
+    clusterTracker waterConductorTracker;
+    clusterTracker oilConductorTracker;
+    clusterTracker activeTracker;
+    std::vector<int> changedElements;
 };
 
 } // namespace PNM
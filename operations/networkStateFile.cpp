@@ -0,0 +1,304 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "networkStateFile.h"
+#include "network/networkmodel.h"
+#include "network/iterator.h"
+
+#include <libs/csvParser/csv.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace PNM
+{
+
+namespace
+{
+
+const char magic[4] = {'N', 'U', 'M', 'S'};
+const uint32_t version = 1;
+const uint32_t deltaFlag = 1;    // the payload is the XOR of the frame with the previous one
+const uint32_t zeroRunsFlag = 2; // the payload zero runs are removed
+
+struct frameHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t totalNodes;
+    uint32_t totalPores;
+    uint64_t signature;
+    uint32_t flags;
+    uint32_t payloadSize;
+};
+
+void appendUInt32(std::vector<unsigned char> &out, uint32_t value)
+{
+    unsigned char bytes[4];
+    std::memcpy(bytes, &value, 4);
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+} // namespace
+
+uint64_t networkStateFile::getSignature(std::shared_ptr<networkModel> network)
+{
+    if (!network->arrays.matches(*network))
+        network->arrays.build(*network);
+
+    //FNV-1a hash of the elements counts and of the pores connections
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](int value) {
+        for (int i = 0; i < 4; ++i)
+        {
+            hash ^= (value >> (8 * i)) & 0xff;
+            hash *= 1099511628211ULL;
+        }
+    };
+
+    mix(network->totalNodes);
+    mix(network->totalPores);
+    for (int i = 0; i < network->totalPores; ++i)
+    {
+        mix(network->arrays.poreNodeIn[i]);
+        mix(network->arrays.poreNodeOut[i]);
+    }
+    return hash;
+}
+
+void networkStateFile::capture(std::shared_ptr<networkModel> network, int frame, networkState &state)
+{
+    state.frame = frame;
+    state.totalNodes = network->totalNodes;
+    state.totalPores = network->totalPores;
+    state.signature = getSignature(network);
+    state.phases.resize(network->totalNodes + network->totalPores);
+    state.concentrations.resize(network->totalNodes + network->totalPores);
+    for (element *e : pnmRange<element>(network))
+    {
+        state.phases[e->getIndex()] = static_cast<unsigned char>(e->getPhaseFlag());
+        state.concentrations[e->getIndex()] = e->getConcentration();
+    }
+}
+
+void networkStateFile::write(const std::string &path, const networkState &state, bool compressed)
+{
+    int totalElements = state.totalNodes + state.totalPores;
+
+    currentFrame.resize(5 * totalElements);
+    unsigned char *concentrations = currentFrame.data() + totalElements;
+    std::copy(state.phases.begin(), state.phases.end(), currentFrame.begin());
+    for (int i = 0; i < totalElements; ++i)
+    {
+        float concentration = float(state.concentrations[i]);
+        std::memcpy(concentrations + 4 * i, &concentration, 4);
+    }
+
+    bool keyFrame = state.frame == 0 || state.signature != signature || previousFrame.size() != currentFrame.size() || framesSinceKeyFrame + 1 >= keyFrameInterval;
+    framesSinceKeyFrame = keyFrame ? 0 : framesSinceKeyFrame + 1;
+    signature = state.signature;
+
+    uint32_t flags(0);
+    const std::vector<unsigned char> *payload = &currentFrame;
+    if (compressed)
+    {
+        std::vector<unsigned char> &delta = previousFrame;
+        if (!keyFrame)
+        {
+            for (unsigned i = 0; i < delta.size(); ++i)
+                delta[i] ^= currentFrame[i];
+            flags |= deltaFlag;
+        }
+        else
+            delta = currentFrame;
+
+        encodeZeroRuns(delta, buffer);
+        flags |= zeroRunsFlag;
+        payload = &buffer;
+    }
+
+    frameHeader header;
+    std::memcpy(header.magic, magic, 4);
+    header.version = version;
+    header.totalNodes = state.totalNodes;
+    header.totalPores = state.totalPores;
+    header.signature = signature;
+    header.flags = flags;
+    header.payloadSize = payload->size();
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(payload->data()), payload->size());
+
+    previousFrame.swap(currentFrame);
+}
+
+void networkStateFile::writeText(const std::string &path, const networkState &state)
+{
+    std::ofstream file;
+    file.open(path.c_str());
+
+    file << "phase,concentration\n";
+
+    for (unsigned i = 0; i < state.phases.size(); ++i)
+        file << int(state.phases[i]) << "," << state.concentrations[i] << "\n";
+
+    file.close();
+}
+
+bool networkStateFile::read(const std::string &path, std::shared_ptr<networkModel> network)
+{
+    loadedFrame frame;
+    load(path, network->totalNodes, network->totalPores, getSignature(network), frame);
+    return apply(frame, network);
+}
+
+void networkStateFile::load(const std::string &path, int totalNodes, int totalPores, uint64_t signature, loadedFrame &frame)
+{
+    frame.valid = false;
+    frame.delta = false;
+
+    std::ifstream file(path.c_str(), std::ios::binary);
+
+    frameHeader header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+        return;
+
+    if (std::memcmp(header.magic, magic, 4) != 0 || header.version != version || int(header.totalNodes) != totalNodes || int(header.totalPores) != totalPores || header.signature != signature)
+        return;
+
+    std::vector<unsigned char> payload(header.payloadSize);
+    if (!file.read(reinterpret_cast<char *>(payload.data()), payload.size()))
+        return;
+
+    frame.data.resize(5 * (totalNodes + totalPores));
+    if (header.flags & zeroRunsFlag)
+    {
+        if (!decodeZeroRuns(payload, frame.data))
+            return;
+    }
+    else if (payload.size() == frame.data.size())
+        frame.data.swap(payload);
+    else
+        return;
+
+    frame.delta = (header.flags & deltaFlag) != 0;
+    frame.valid = true;
+}
+
+void networkStateFile::loadText(const std::string &path, int totalElements, loadedFrame &frame)
+{
+    frame.valid = false;
+    frame.delta = false;
+    frame.data.resize(5 * totalElements);
+
+    int phaseFlag(0);
+    double concentration(0);
+    io::CSVReader<2> in(path);
+    in.read_header(io::ignore_missing_column, "phase", "concentration");
+
+    unsigned char *concentrations = frame.data.data() + totalElements;
+    for (int i = 0; i < totalElements; ++i)
+    {
+        if (!in.read_row(phaseFlag, concentration))
+            return;
+        float value = float(concentration);
+        frame.data[i] = static_cast<unsigned char>(phaseFlag);
+        std::memcpy(concentrations + 4 * i, &value, 4);
+    }
+
+    frame.valid = true;
+}
+
+bool networkStateFile::apply(loadedFrame &frame, std::shared_ptr<networkModel> network)
+{
+    int totalElements = network->totalNodes + network->totalPores;
+    if (!frame.valid || frame.data.size() != unsigned(5 * totalElements))
+        return false;
+
+    if (frame.delta)
+    {
+        if (previousFrame.size() != frame.data.size())
+            return false;
+        for (unsigned i = 0; i < frame.data.size(); ++i)
+            frame.data[i] ^= previousFrame[i];
+    }
+
+    const unsigned char *phases = frame.data.data();
+    const unsigned char *concentrations = frame.data.data() + totalElements;
+    for (element *e : pnmRange<element>(network))
+    {
+        int i = e->getIndex();
+        float concentration;
+        std::memcpy(&concentration, concentrations + 4 * i, 4);
+        e->setPhaseFlag(static_cast<phase>(phases[i]));
+        e->setConcentration(concentration);
+    }
+
+    previousFrame.swap(frame.data);
+    return true;
+}
+
+void networkStateFile::encodeZeroRuns(const std::vector<unsigned char> &in, std::vector<unsigned char> &out)
+{
+    //Blocks of a zero run length, a literals length and the literals; zero runs shorter than 8 bytes stay literals
+    const unsigned minimumRun = 8;
+    out.clear();
+
+    unsigned i = 0;
+    while (i < in.size())
+    {
+        unsigned zeros = 0;
+        while (i < in.size() && in[i] == 0)
+            ++zeros, ++i;
+
+        unsigned start = i;
+        while (i < in.size())
+        {
+            if (in[i] != 0)
+            {
+                ++i;
+                continue;
+            }
+            unsigned run = 0;
+            while (i + run < in.size() && in[i + run] == 0 && run < minimumRun)
+                ++run;
+            if (run == minimumRun || i + run == in.size())
+                break;
+            i += run;
+        }
+
+        appendUInt32(out, zeros);
+        appendUInt32(out, i - start);
+        out.insert(out.end(), in.begin() + start, in.begin() + i);
+    }
+}
+
+bool networkStateFile::decodeZeroRuns(const std::vector<unsigned char> &in, std::vector<unsigned char> &out)
+{
+    unsigned position = 0, i = 0;
+    while (i + 8 <= in.size())
+    {
+        uint32_t zeros, literals;
+        std::memcpy(&zeros, in.data() + i, 4);
+        std::memcpy(&literals, in.data() + i + 4, 4);
+        i += 8;
+
+        if (position + uint64_t(zeros) + literals > out.size() || i + uint64_t(literals) > in.size())
+            return false;
+
+        std::fill(out.begin() + position, out.begin() + position + zeros, 0);
+        position += zeros;
+        std::copy(in.begin() + i, in.begin() + i + literals, out.begin() + position);
+        position += literals;
+        i += literals;
+    }
+    return position == out.size() && i == in.size();
+}
+
+} // namespace PNM
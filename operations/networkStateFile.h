@@ -0,0 +1,77 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef NETWORKSTATEFILE_H
+#define NETWORKSTATEFILE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace PNM
+{
+
+struct networkModel;
+
+// Copy of the state of the network elements, in the pnmRange<element> order
+struct networkState
+{
+    int frame;
+    int totalNodes;
+    int totalPores;
+    uint64_t signature;
+    std::vector<unsigned char> phases;
+    std::vector<double> concentrations;
+};
+
+// Binary network state frames (.numsb): a header tied to the network (elements counts and a topology signature),
+// then one phase byte and one float concentration per element, in the pnmRange<element> order.
+// Compressed frames store their difference with the previous frame (bytes XOR) with the zero runs removed;
+// a key frame, readable on its own, is written every keyFrameInterval frames.
+class networkStateFile
+{
+  public:
+    networkStateFile() : signature(0), framesSinceKeyFrame(0) {}
+    static const int keyFrameInterval = 50;
+
+    static uint64_t getSignature(std::shared_ptr<networkModel>);
+    static void capture(std::shared_ptr<networkModel>, int frame, networkState &);
+
+    // Frame writer: frame 0 (or a change of network) starts a new sequence with a key frame
+    void write(const std::string &path, const networkState &, bool compressed);
+    static void writeText(const std::string &path, const networkState &);
+
+    // Frame reader: frames of a sequence are read in order; returns false if the file does not match the network
+    bool read(const std::string &path, std::shared_ptr<networkModel>);
+
+    // Reading in two steps, for concurrent readers: load() and loadText() unpack a file on their own, and may run
+    // concurrently for several files; apply() then copies the loaded frames, in order, to the network
+    struct loadedFrame
+    {
+        bool valid;
+        bool delta;                      // data is the XOR with the previous frame
+        std::vector<unsigned char> data; // phases then concentrations bytes
+    };
+    static void load(const std::string &path, int totalNodes, int totalPores, uint64_t signature, loadedFrame &);
+    static void loadText(const std::string &path, int totalElements, loadedFrame &);
+    bool apply(loadedFrame &, std::shared_ptr<networkModel>);
+
+  protected:
+    static void encodeZeroRuns(const std::vector<unsigned char> &, std::vector<unsigned char> &);
+    static bool decodeZeroRuns(const std::vector<unsigned char> &, std::vector<unsigned char> &);
+
+    uint64_t signature;
+    int framesSinceKeyFrame;
+    std::vector<unsigned char> previousFrame; // phases then concentrations bytes of the last frame
+    std::vector<unsigned char> currentFrame;
+    std::vector<unsigned char> buffer;
+};
+
+} // namespace PNM
+
+#endif // NETWORKSTATEFILE_H
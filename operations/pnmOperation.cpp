@@ -6,48 +6,191 @@
 /////////////////////////////////////////////////////////////////////////////
 
 #include "pnmOperation.h"
+#include "simulationContext.h"
 #include "network/iterator.h"
 #include "network/cluster.h"
 #include "simulations/steady-state-cycle/primaryDrainage.h"
 #include "hkClustering.h"
+#include "relativePermeabilityCache.h"
+#include "builders/networkCache.h"
 #include "misc/userInput.h"
 #include "misc/randomGenerator.h"
+#include "misc/counterRandom.h"
 #include "misc/maths.h"
+#include "misc/outputWriter.h"
+#include "misc/numaPlacement.h"
+#include "misc/reproducibleSum.h"
 
 #include "libs/boost/format.hpp"
 
 #include <algorithm>
 #include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
 
 namespace PNM
 {
 
-pnmOperation pnmOperation::instance;
+namespace
+{
+
+//The trailing arguments select the generator: none for randomGenerator, (index, draw) for counterRandom
+template <typename generator, typename... drawIndex>
+double drawRadius(generator &gen, drawIndex... index)
+{
+    auto radiusDistribution = userInput::get().poreSizeDistribution;
+    if (radiusDistribution == psd::rayleigh)
+        return gen.rayleigh(index..., userInput::get().minRadius, userInput::get().maxRadius, userInput::get().rayleighParameter);
+    if (radiusDistribution == psd::triangular)
+        return gen.triangular(index..., userInput::get().minRadius, userInput::get().maxRadius, userInput::get().triangularParameter);
+    if (radiusDistribution == psd::truncatedNormal)
+        return gen.normal(index..., userInput::get().minRadius, userInput::get().maxRadius, userInput::get().normalMuParameter, userInput::get().normalSigmaParameter);
+    return gen.uniform_real(index..., userInput::get().minRadius, userInput::get().maxRadius);
+}
+
+//Random permutation of the nodes, from counter-based keys indexed by the nodes positions
+template <typename nodePointer>
+void shuffleNodes(std::vector<nodePointer> &nodes, randomStream stream)
+{
+    counterRandom gen(userInput::get().seed, stream);
+    std::vector<std::pair<double, int>> keys(nodes.size());
+#pragma omp parallel for
+    for (int i = 0; i < int(nodes.size()); ++i)
+        keys[i] = {gen.uniform_real(nodes[i]->getIndex()), i};
+
+    std::sort(keys.begin(), keys.end());
+    std::vector<nodePointer> shuffledNodes(nodes.size());
+    for (unsigned i = 0; i < nodes.size(); ++i)
+        shuffledNodes[i] = nodes[keys[i].second];
+    nodes.swap(shuffledNodes);
+}
+
+// Reverse Cuthill-McKee order of the nodes over the pores adjacency: breadth-first search from the lowest degree
+// node of each component, visiting the neighboors by increasing degree. order[i] is the node placed at position i.
+std::vector<int> reverseCuthillMcKeeOrder(const networkArrays &arrays, int totalNodes)
+{
+    auto otherNode = [&arrays](int p, int n) -> int {
+        return arrays.poreNodeIn[p] == n ? arrays.poreNodeOut[p] : arrays.poreNodeIn[p];
+    };
+
+    std::vector<int> degrees(totalNodes, 0);
+    for (int n = 0; n < totalNodes; ++n)
+        for (int k = arrays.nodePoresOffset[n]; k < arrays.nodePoresOffset[n + 1]; ++k)
+            if (otherNode(arrays.nodePores[k], n) != -1)
+                ++degrees[n];
+    auto byDegree = [&degrees](int a, int b) -> bool { return degrees[a] < degrees[b]; };
+
+    std::vector<int> starts(totalNodes);
+    std::iota(starts.begin(), starts.end(), 0);
+    std::stable_sort(starts.begin(), starts.end(), byDegree);
+
+    std::vector<int> order;
+    order.reserve(totalNodes);
+    std::vector<char> visited(totalNodes, 0);
+    for (int start : starts)
+    {
+        if (visited[start])
+            continue;
+        visited[start] = 1;
+        order.push_back(start);
+        for (unsigned head = order.size() - 1; head < order.size(); ++head)
+        {
+            int n = order[head];
+            unsigned first = order.size();
+            for (int k = arrays.nodePoresOffset[n]; k < arrays.nodePoresOffset[n + 1]; ++k)
+            {
+                int m = otherNode(arrays.nodePores[k], n);
+                if (m != -1 && !visited[m])
+                {
+                    visited[m] = 1;
+                    order.push_back(m);
+                }
+            }
+            std::stable_sort(order.begin() + first, order.end(), byDegree);
+        }
+    }
+
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+// Spreads the 21 low bits of x three bits apart
+uint64_t spreadBits(uint64_t x)
+{
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffULL;
+    x = (x | x << 16) & 0x1f0000ff0000ffULL;
+    x = (x | x << 8) & 0x100f00f00f00f00fULL;
+    x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+    x = (x | x << 2) & 0x1249249249249249ULL;
+    return x;
+}
+
+// Morton (Z-curve) order of the nodes coordinates, quantized on a 2^21 grid per axis
+std::vector<int> mortonOrder(const networkModel &network)
+{
+    pnmSpan<node> nodes(network);
+    double lower[3] = {0, 0, 0}, upper[3] = {0, 0, 0};
+    for (int i = 0; i < nodes.size(); ++i)
+    {
+        double coordinates[3] = {nodes[i]->getXCoordinate(), nodes[i]->getYCoordinate(), nodes[i]->getZCoordinate()};
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            lower[axis] = i == 0 ? coordinates[axis] : std::min(lower[axis], coordinates[axis]);
+            upper[axis] = i == 0 ? coordinates[axis] : std::max(upper[axis], coordinates[axis]);
+        }
+    }
+
+    std::vector<uint64_t> keys(nodes.size());
+    for (int i = 0; i < nodes.size(); ++i)
+    {
+        double coordinates[3] = {nodes[i]->getXCoordinate(), nodes[i]->getYCoordinate(), nodes[i]->getZCoordinate()};
+        uint64_t key(0);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            double extent = upper[axis] - lower[axis];
+            uint64_t cell = extent > 0 ? uint64_t((coordinates[axis] - lower[axis]) / extent * 2097151) : 0;
+            key |= spreadBits(cell) << axis;
+        }
+        keys[i] = key;
+    }
+
+    std::vector<int> order(nodes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&keys](int a, int b) { return keys[a] < keys[b]; });
+    return order;
+}
+
+} // namespace
 
 pnmOperation &pnmOperation::get(std::shared_ptr<networkModel> network)
 {
+    pnmOperation &instance = simulationContext::current().operation;
     instance.network = network;
     return instance;
 }
 
 void pnmOperation::assignRadii()
 {
-    randomGenerator gen(userInput::get().seed);
-    for (pore *p : pnmRange<pore>(network))
+    if (userInput::get().counterBasedRandom)
+    {
+        counterRandom gen(userInput::get().seed, randomStream::poreRadius);
+#pragma omp parallel for
+        for (int i = 0; i < network->totalPores; ++i)
+            network->getPore(i)->setRadius(drawRadius(gen, uint64_t(i), 0u));
+    }
+    else
     {
-        auto radiusDistribution = userInput::get().poreSizeDistribution;
-        if (radiusDistribution == psd::uniform)
-            p->setRadius(gen.uniform_real(userInput::get().minRadius, userInput::get().maxRadius));
-        if (radiusDistribution == psd::rayleigh)
-            p->setRadius(gen.rayleigh(userInput::get().minRadius, userInput::get().maxRadius, userInput::get().rayleighParameter));
-        if (radiusDistribution == psd::triangular)
-            p->setRadius(gen.triangular(userInput::get().minRadius, userInput::get().maxRadius, userInput::get().triangularParameter));
-        if (radiusDistribution == psd::truncatedNormal)
-            p->setRadius(gen.normal(userInput::get().minRadius, userInput::get().maxRadius, userInput::get().normalMuParameter, userInput::get().normalSigmaParameter));
+        randomGenerator gen(userInput::get().seed);
+        for (pore *p : pnmRange<pore>(network))
+            p->setRadius(drawRadius(gen));
     }
 
-    for (node *n : pnmRange<node>(network))
+#pragma omp parallel for
+    for (int i = 0; i < network->totalNodes; ++i)
     {
+        node *n = network->getNode(i);
         double maxRadius(0), averageRadius(0);
         int neighboorsNumber(0);
         for (element *p : n->getNeighboors())
@@ -84,19 +227,37 @@ void pnmOperation::distortNetwork()
     if (userInput::get().degreeOfDistortion <= 0)
         return;
 
-    randomGenerator gen(userInput::get().seed);
     double length = userInput::get().length;
     double degreeOfDistortion = userInput::get().degreeOfDistortion;
-    for (node *n : pnmRange<node>(network))
+    if (userInput::get().counterBasedRandom)
     {
-        n->setXCoordinate(n->getXCoordinate() + length * degreeOfDistortion * (-1 + 2 * gen.uniform_real()));
-        n->setYCoordinate(n->getYCoordinate() + length * degreeOfDistortion * (-1 + 2 * gen.uniform_real()));
-        if (!network->is2D)
-            n->setZCoordinate(n->getZCoordinate() + length * degreeOfDistortion * (-1 + 2 * gen.uniform_real()));
-    };
+        counterRandom gen(userInput::get().seed, randomStream::nodeDistortion);
+#pragma omp parallel for
+        for (int i = 0; i < network->totalNodes; ++i)
+        {
+            node *n = network->getNode(i);
+            n->setXCoordinate(n->getXCoordinate() + length * degreeOfDistortion * (-1 + 2 * gen.uniform_real(i, 0)));
+            n->setYCoordinate(n->getYCoordinate() + length * degreeOfDistortion * (-1 + 2 * gen.uniform_real(i, 1)));
+            if (!network->is2D)
+                n->setZCoordinate(n->getZCoordinate() + length * degreeOfDistortion * (-1 + 2 * gen.uniform_real(i, 2)));
+        }
+    }
+    else
+    {
+        randomGenerator gen(userInput::get().seed);
+        for (node *n : pnmRange<node>(network))
+        {
+            n->setXCoordinate(n->getXCoordinate() + length * degreeOfDistortion * (-1 + 2 * gen.uniform_real()));
+            n->setYCoordinate(n->getYCoordinate() + length * degreeOfDistortion * (-1 + 2 * gen.uniform_real()));
+            if (!network->is2D)
+                n->setZCoordinate(n->getZCoordinate() + length * degreeOfDistortion * (-1 + 2 * gen.uniform_real()));
+        };
+    }
 
-    for (pore *p : pnmRange<pore>(network))
+#pragma omp parallel for
+    for (int i = 0; i < network->totalPores; ++i)
     {
+        pore *p = network->getPore(i);
         if (p->getNodeIn() == 0 || p->getNodeOut() == 0)
             continue;
         double length = std::sqrt(std::pow(p->getNodeIn()->getXCoordinate() - p->getNodeOut()->getXCoordinate(), 2) + std::pow(p->getNodeIn()->getYCoordinate() - p->getNodeOut()->getYCoordinate(), 2) + std::pow(p->getNodeIn()->getZCoordinate() - p->getNodeOut()->getZCoordinate(), 2));
@@ -151,48 +312,106 @@ void pnmOperation::assignViscosities()
 
 void pnmOperation::assignConductivities()
 {
-    for (node *n : pnmRange<node>(network))
+    networkArrays &arrays = network->arrays;
+    if (!arrays.matches(*network))
+        arrays.build(*network);
+
+    int totalNodes = network->totalNodes;
+    int totalPores = network->totalPores;
+    pnmSpan<node> nodes(*network);
+    pnmSpan<pore> pores(*network);
+    double conductanceConstant = userInput::get().poreConductivityConstant;
+    double conductanceExponent = userInput::get().poreConductivityExponent;
+    double unitsFactor = pow(10, (6 * conductanceExponent - 24));
+
+    //Geometric factors, only recalculated when the network or the conductivity parameters change
+    if (int(arrays.nodeConductanceFactor.size()) != totalNodes || arrays.conductanceConstant != conductanceConstant || arrays.conductanceExponent != conductanceExponent)
     {
-        n->setConductivity(userInput::get().poreConductivityConstant * n->getShapeFactorConstant() * pow(n->getRadius(), userInput::get().poreConductivityExponent) / (16 * n->getShapeFactor()) / (n->getLength() * n->getViscosity()) * pow(10, (6 * userInput::get().poreConductivityExponent - 24)));
-    }
+        arrays.nodeConductanceFactor.resize(totalNodes);
+        arrays.poreConductanceFactor.resize(totalPores);
 
-    for (pore *p : pnmRange<pore>(network))
-    {
-        node *nodeIn = p->getNodeIn();
-        node *nodeOut = p->getNodeOut();
-        auto throatConductivityInverse(0.0), nodeInConductivityInverse(0.0), nodeOutConductivityInverse(0.0);
+#pragma omp parallel for
+        for (int i = 0; i < totalNodes; ++i)
+        {
+            node *n = nodes[i];
+            arrays.nodeLength[i] = n->getLength();
+            arrays.nodeConductanceFactor[i] = conductanceConstant * n->getShapeFactorConstant() * pow(n->getRadius(), conductanceExponent) / (16 * n->getShapeFactor());
+        }
 
-        auto throatConductivity = userInput::get().poreConductivityConstant * p->getShapeFactorConstant() * pow(p->getRadius(), userInput::get().poreConductivityExponent) / (16 * p->getShapeFactor()) / (p->getLength() * p->getViscosity()) * pow(10, (6 * userInput::get().poreConductivityExponent - 24));
+#pragma omp parallel for
+        for (int i = 0; i < totalPores; ++i)
+        {
+            pore *p = pores[i];
+            arrays.poreLength[i] = p->getLength();
+            arrays.poreConductanceFactor[i] = conductanceConstant * p->getShapeFactorConstant() * pow(p->getRadius(), conductanceExponent) / (16 * p->getShapeFactor());
+        }
 
-        throatConductivityInverse = 1 / throatConductivity;
+        numaPlacement::distribute(arrays.nodeConductanceFactor);
+        numaPlacement::distribute(arrays.poreConductanceFactor);
+        arrays.conductanceConstant = conductanceConstant;
+        arrays.conductanceExponent = conductanceExponent;
+    }
 
-        if (nodeIn != 0)
-            nodeInConductivityInverse = 1 / (nodeIn->getConductivity() * 2);
+#pragma omp parallel for
+    for (int i = 0; i < totalNodes; ++i)
+        arrays.nodeViscosity[i] = nodes[i]->getViscosity();
+
+#pragma omp parallel for
+    for (int i = 0; i < totalPores; ++i)
+        arrays.poreViscosity[i] = pores[i]->getViscosity();
+
+    const double *nodeFactor = arrays.nodeConductanceFactor.data();
+    const double *nodeLength = arrays.nodeLength.data();
+    const double *nodeViscosity = arrays.nodeViscosity.data();
+    double *nodeConductivity = arrays.nodeConductivity.data();
+
+#pragma omp parallel for
+    for (int i = 0; i < totalNodes; ++i)
+        nodeConductivity[i] = nodeFactor[i] / (nodeLength[i] * nodeViscosity[i]) * unitsFactor;
+
+    const double *poreFactor = arrays.poreConductanceFactor.data();
+    const double *poreLength = arrays.poreLength.data();
+    const double *poreViscosity = arrays.poreViscosity.data();
+    const int *poreNodeIn = arrays.poreNodeIn.data();
+    const int *poreNodeOut = arrays.poreNodeOut.data();
+    double *throatConductivity = arrays.poreThroatConductivity.data();
+    double *poreConductivity = arrays.poreConductivity.data();
+
+#pragma omp parallel for
+    for (int i = 0; i < totalPores; ++i)
+    {
+        throatConductivity[i] = poreFactor[i] / (poreLength[i] * poreViscosity[i]) * unitsFactor;
 
-        if (nodeOut != 0)
-            nodeOutConductivityInverse = 1 / (nodeOut->getConductivity() * 2);
+        double throatConductivityInverse = 1 / throatConductivity[i];
+        double nodeInConductivityInverse = poreNodeIn[i] != -1 ? 1 / (nodeConductivity[poreNodeIn[i]] * 2) : 0;
+        double nodeOutConductivityInverse = poreNodeOut[i] != -1 ? 1 / (nodeConductivity[poreNodeOut[i]] * 2) : 0;
 
-        p->setConductivity(1. / (throatConductivityInverse + nodeInConductivityInverse + nodeOutConductivityInverse));
+        poreConductivity[i] = 1. / (throatConductivityInverse + nodeInConductivityInverse + nodeOutConductivityInverse);
     }
+
+#pragma omp parallel for
+    for (int i = 0; i < totalNodes; ++i)
+        nodes[i]->setConductivity(nodeConductivity[i]);
+
+#pragma omp parallel for
+    for (int i = 0; i < totalPores; ++i)
+        pores[i]->setConductivity(poreConductivity[i]);
 }
 
 void pnmOperation::calculateNetworkVolume()
 {
-    network->totalNodesVolume = 0;
-    network->totalPoresVolume = 0;
-    network->inletPoresArea = 0;
-
-    for (node *n : pnmRange<node>(network))
-    {
-        network->totalNodesVolume += n->getVolume();
-    }
+    pnmSpan<node> nodes(*network);
+    pnmSpan<pore> pores(*network);
 
-    for (pore *p : pnmRange<pore>(network))
-    {
-        network->totalPoresVolume += p->getVolume();
-        if (p->getInlet())
-            network->inletPoresArea += p->getVolume() / p->getLength();
-    }
+    network->totalNodesVolume = reproducibleSum(nodes.size(), [&nodes](int i) {
+        return nodes[i]->getVolume();
+    });
+    network->totalPoresVolume = reproducibleSum(pores.size(), [&pores](int i) {
+        return pores[i]->getVolume();
+    });
+    network->inletPoresArea = reproducibleSum(pores.size(), [&pores](int i) {
+        return pores[i]->getInlet() ? pores[i]->getVolume() / pores[i]->getLength() : 0.;
+    });
 
     network->totalNetworkVolume = network->totalNodesVolume + network->totalPoresVolume;
 }
@@ -274,35 +493,58 @@ void pnmOperation::assignFilmsStability()
 
 void pnmOperation::assignWettabilities()
 {
+    if (!network->arrays.matches(*network))
+        network->arrays.build(*network);
+
+    //Counter-based draws are indexed by the elements, and computed in parallel
+    bool counterBased = userInput::get().counterBasedRandom;
     randomGenerator gen(userInput::get().seed);
+    counterRandom thetaGen(userInput::get().seed, randomStream::contactAngle);
+    counterRandom poreGen(userInput::get().seed, randomStream::poreWettability);
+    auto drawTheta = [&](element *e, uint32_t draw, double min, double max) -> double {
+        return counterBased ? thetaGen.uniform_real(e->getIndex(), draw, min, max) : gen.uniform_real(min, max);
+    };
+    int totalElements = network->totalNodes + network->totalPores;
+    auto getElement = [this](int i) -> element * {
+        return i < network->totalNodes ? static_cast<element *>(network->getNode(i)) : network->getPore(i - network->totalNodes);
+    };
 
     if (userInput::get().wettability == networkWettability::oilWet)
     {
-        for (element *e : pnmRange<element>(network))
+#pragma omp parallel for if (counterBased)
+        for (int i = 0; i < totalElements; ++i)
         {
-            e->setTheta(gen.uniform_real(userInput::get().minOilWetTheta, userInput::get().maxOilWetTheta));
+            element *e = getElement(i);
+            e->setTheta(drawTheta(e, 0, userInput::get().minOilWetTheta, userInput::get().maxOilWetTheta));
             e->setWettabilityFlag(wettability::oilWet);
         };
         pnmOperation::get(network).backupWettability();
+        assignEntryPressures();
         return;
     }
 
-    for (element *e : pnmRange<element>(network))
+#pragma omp parallel for if (counterBased)
+    for (int i = 0; i < totalElements; ++i)
     {
-        e->setTheta(gen.uniform_real(userInput::get().minWaterWetTheta, userInput::get().maxWaterWetTheta));
+        element *e = getElement(i);
+        e->setTheta(drawTheta(e, 0, userInput::get().minWaterWetTheta, userInput::get().maxWaterWetTheta));
         e->setWettabilityFlag(wettability::waterWet);
     };
 
     if (userInput::get().wettability == networkWettability::waterWet)
     {
         pnmOperation::get(network).backupWettability();
+        assignEntryPressures();
         return;
     }
 
     if (userInput::get().wettability == networkWettability::fracionalWet) //FW
     {
         auto shuffledNodes = network->tableOfNodes;
-        std::shuffle(shuffledNodes.begin(), shuffledNodes.end(), gen.getGen());
+        if (counterBased)
+            shuffleNodes(shuffledNodes, randomStream::wettabilityOrder);
+        else
+            std::shuffle(shuffledNodes.begin(), shuffledNodes.end(), gen.getGen());
 
         auto oilWetSoFar(0);
         while ((double(oilWetSoFar) / network->totalNodes) < userInput::get().oilWetFraction)
@@ -311,7 +553,7 @@ void pnmOperation::assignWettabilities()
             shuffledNodes.pop_back();
             if (n->getWettabilityFlag() != wettability::oilWet)
             {
-                n->setTheta(gen.uniform_real(userInput::get().minOilWetTheta, userInput::get().maxOilWetTheta));
+                n->setTheta(drawTheta(n.get(), 1, userInput::get().minOilWetTheta, userInput::get().maxOilWetTheta));
                 n->setWettabilityFlag(wettability::oilWet);
                 oilWetSoFar++;
             }
@@ -330,7 +572,7 @@ void pnmOperation::assignWettabilities()
         while ((double(oilWetSoFar) / network->totalNodes) < userInput::get().oilWetFraction)
         {
             auto biggestElement = workingElements.back();
-            biggestElement->setTheta(gen.uniform_real(userInput::get().minOilWetTheta, userInput::get().maxOilWetTheta));
+            biggestElement->setTheta(drawTheta(biggestElement.get(), 1, userInput::get().minOilWetTheta, userInput::get().maxOilWetTheta));
             biggestElement->setWettabilityFlag(wettability::oilWet);
             oilWetSoFar++;
             workingElements.pop_back();
@@ -349,15 +591,17 @@ void pnmOperation::assignWettabilities()
         while ((double(oilWetSoFar) / network->totalNodes) < userInput::get().oilWetFraction)
         {
             auto smallestElement = workingElements.back();
-            smallestElement->setTheta(gen.uniform_real(userInput::get().minOilWetTheta, userInput::get().maxOilWetTheta));
+            smallestElement->setTheta(drawTheta(smallestElement.get(), 1, userInput::get().minOilWetTheta, userInput::get().maxOilWetTheta));
             smallestElement->setWettabilityFlag(wettability::oilWet);
             oilWetSoFar++;
             workingElements.pop_back();
         }
     }
 
-    for (pore *p : pnmRange<pore>(network))
+#pragma omp parallel for if (counterBased)
+    for (int i = 0; i < network->totalPores; ++i)
     {
+        pore *p = network->getPore(i);
         if (p->getNodeIn() == 0)
         {
             auto connectedNode = p->getNodeOut();
@@ -381,12 +625,14 @@ void pnmOperation::assignWettabilities()
             }
             else
             {
-                p->setTheta(gen.uniform_int() ? connectedNode1->getTheta() : connectedNode2->getTheta());
+                p->setTheta((counterBased ? poreGen.uniform_int(p->getIndex()) : gen.uniform_int()) ? connectedNode1->getTheta() : connectedNode2->getTheta());
                 if (p->getTheta() > maths::pi() / 2)
                     p->setWettabilityFlag(wettability::oilWet);
             }
         }
     };
+
+    assignEntryPressures();
 }
 
 void pnmOperation::backupWettability()
@@ -404,6 +650,8 @@ void pnmOperation::restoreWettability()
         e->setTheta(e->getOriginalTheta());
         e->setWettabilityFlag(e->getTheta() <= maths::pi() / 2 ? wettability::waterWet : wettability::oilWet);
     }
+
+    assignEntryPressures();
 }
 
 void pnmOperation::assignWWWettability()
@@ -413,30 +661,46 @@ void pnmOperation::assignWWWettability()
         e->setTheta(0);
         e->setWettabilityFlag(wettability::waterWet);
     }
+
+    assignEntryPressures();
+}
+
+void pnmOperation::assignEntryPressures()
+{
+    double OWSurfaceTension = userInput::get().OWSurfaceTension;
+    parallelForEachElement(network, [&](element *e) {
+        e->setEntryPressure(e->getEntryPressureCoefficient() * OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius());
+    });
 }
 
-void pnmOperation::assignOilConductivities()
+void pnmOperation::assignOilConductivities(bool spanningClustersOnly)
 {
     assignConductivities();
-    for (node *n : pnmRange<node>(network))
-    {
+
+    const std::vector<double> &throatConductivities = network->arrays.poreThroatConductivity;
+    double filmConductanceResistivity = userInput::get().filmConductanceResistivity;
+
+    parallelForEachNode(network, [&](node *n) {
         n->setActive(true);
         if (n->getPhaseFlag() == phase::oil)
         {
-            if (!n->getClusterOilConductor()->getSpanning())
+            if (spanningClustersOnly && !n->getClusterOilConductor()->getSpanning())
                 n->setActive(false);
         }
         if (n->getPhaseFlag() == phase::water)
         {
-            if (n->getOilLayerActivated() && n->getClusterOilConductor()->getSpanning())
-                n->setConductivity(n->getOilFilmConductivity() / userInput::get().filmConductanceResistivity);
+            if (n->getOilLayerActivated() && (!spanningClustersOnly || n->getClusterOilConductor()->getSpanning()))
+                n->setConductivity(n->getOilFilmConductivity() / filmConductanceResistivity);
             else
                 n->setActive(false);
         }
-    }
+    });
 
-    for (pore *p : pnmRange<pore>(network))
+    pnmSpan<pore> pores(*network);
+#pragma omp parallel for
+    for (int i = 0; i < pores.size(); ++i)
     {
+        pore *p = pores[i];
         p->setActive(true);
 
         node *nodeIn = p->getNodeIn();
@@ -452,8 +716,8 @@ void pnmOperation::assignOilConductivities()
 
         if (p->getPhaseFlag() == phase::oil)
         {
-            if (p->getClusterOilConductor()->getSpanning())
-                throatConductivity = userInput::get().poreConductivityConstant * p->getShapeFactorConstant() * pow(p->getRadius(), userInput::get().poreConductivityExponent) / (16 * p->getShapeFactor()) / (p->getLength() * p->getViscosity()) * pow(10, (6 * userInput::get().poreConductivityExponent - 24));
+            if (!spanningClustersOnly || p->getClusterOilConductor()->getSpanning())
+                throatConductivity = throatConductivities[i];
             else
             {
                 p->setActive(false);
@@ -462,8 +726,8 @@ void pnmOperation::assignOilConductivities()
         }
         if (p->getPhaseFlag() == phase::water)
         {
-            if (p->getOilLayerActivated() && p->getClusterOilConductor()->getSpanning())
-                throatConductivity = p->getOilFilmConductivity() / userInput::get().filmConductanceResistivity;
+            if (p->getOilLayerActivated() && (!spanningClustersOnly || p->getClusterOilConductor()->getSpanning()))
+                throatConductivity = p->getOilFilmConductivity() / filmConductanceResistivity;
             else
             {
                 p->setActive(false);
@@ -479,28 +743,34 @@ void pnmOperation::assignOilConductivities()
     }
 }
 
-void pnmOperation::assignWaterConductivities()
+void pnmOperation::assignWaterConductivities(bool spanningClustersOnly)
 {
     assignConductivities();
-    for (node *n : pnmRange<node>(network))
-    {
+
+    const std::vector<double> &throatConductivities = network->arrays.poreThroatConductivity;
+    double filmConductanceResistivity = userInput::get().filmConductanceResistivity;
+
+    parallelForEachNode(network, [&](node *n) {
         n->setActive(true);
         if (n->getPhaseFlag() == phase::water)
         {
-            if (!n->getClusterWaterConductor()->getSpanning())
+            if (spanningClustersOnly && !n->getClusterWaterConductor()->getSpanning())
                 n->setActive(false);
         }
         if (n->getPhaseFlag() == phase::oil)
         {
-            if (n->getWaterCornerActivated() && n->getClusterWaterConductor()->getSpanning())
-                n->setConductivity(n->getWaterFilmConductivity() / userInput::get().filmConductanceResistivity);
+            if (n->getWaterCornerActivated() && (!spanningClustersOnly || n->getClusterWaterConductor()->getSpanning()))
+                n->setConductivity(n->getWaterFilmConductivity() / filmConductanceResistivity);
             else
                 n->setActive(false);
         }
-    }
+    });
 
-    for (pore *p : pnmRange<pore>(network))
+    pnmSpan<pore> pores(*network);
+#pragma omp parallel for
+    for (int i = 0; i < pores.size(); ++i)
     {
+        pore *p = pores[i];
         p->setActive(true);
 
         node *nodeIn = p->getNodeIn();
@@ -516,8 +786,8 @@ void pnmOperation::assignWaterConductivities()
 
         if (p->getPhaseFlag() == phase::water)
         {
-            if (p->getClusterWaterConductor()->getSpanning())
-                throatConductivity = userInput::get().poreConductivityConstant * p->getShapeFactorConstant() * pow(p->getRadius(), userInput::get().poreConductivityExponent) / (16 * p->getShapeFactor()) / (p->getLength() * p->getViscosity()) * pow(10, (6 * userInput::get().poreConductivityExponent - 24));
+            if (!spanningClustersOnly || p->getClusterWaterConductor()->getSpanning())
+                throatConductivity = throatConductivities[i];
             else
             {
                 p->setActive(false);
@@ -526,8 +796,8 @@ void pnmOperation::assignWaterConductivities()
         }
         if (p->getPhaseFlag() == phase::oil)
         {
-            if (p->getWaterCornerActivated() && p->getClusterWaterConductor()->getSpanning())
-                throatConductivity = p->getWaterFilmConductivity() / userInput::get().filmConductanceResistivity;
+            if (p->getWaterCornerActivated() && (!spanningClustersOnly || p->getClusterWaterConductor()->getSpanning()))
+                throatConductivity = p->getWaterFilmConductivity() / filmConductanceResistivity;
             else
             {
                 p->setActive(false);
@@ -545,7 +815,12 @@ void pnmOperation::assignWaterConductivities()
 
 void pnmOperation::setSwi()
 {
+    if (!network->arrays.matches(*network))
+        network->arrays.build(*network);
+
+    bool counterBased = userInput::get().counterBasedRandom;
     randomGenerator gen(userInput::get().seed);
+    counterRandom poreGen(userInput::get().seed, randomStream::initialWaterPhase);
 
     if (userInput::get().initialWaterSaturation == 1)
     {
@@ -570,7 +845,10 @@ void pnmOperation::setSwi()
         shuffledNodes.reserve(network->totalNodes);
         for (node *n : pnmRange<node>(network))
             shuffledNodes.push_back(n);
-        std::shuffle(shuffledNodes.begin(), shuffledNodes.end(), gen.getGen());
+        if (counterBased)
+            shuffleNodes(shuffledNodes, randomStream::initialWaterOrder);
+        else
+            std::shuffle(shuffledNodes.begin(), shuffledNodes.end(), gen.getGen());
 
         auto actualWaterVolume(0.0);
         while ((actualWaterVolume / network->totalNodesVolume) < userInput::get().initialWaterSaturation)
@@ -629,12 +907,41 @@ void pnmOperation::setSwi()
 
     if (userInput::get().waterDistribution == swi::afterPrimaryDrainage)
     {
-        auto sim = std::make_shared<primaryDrainage>(userInput::get().initialWaterSaturation);
-        sim->setNetwork(network);
-        sim->execute();
+        //The drained state only depends on the network and the drainage inputs: it is reused if they did not change
+        bool cached = userInput::get().primaryDrainageCache;
+        uint64_t checksum(0);
+        std::string statePath;
+        if (cached)
+        {
+            //Each drained state has its own file, named after its checksum, so that different inputs do not overwrite each other
+            const userInput &input = userInput::get();
+            checksum = networkCache::getStateChecksum(network, {input.initialWaterSaturation, input.OWSurfaceTension, input.oilViscosity,
+                                                                input.waterViscosity, double(input.twoPhaseSimulationSteps),
+                                                                input.filmConductanceResistivity, double(input.seed),
+                                                                double(input.reverseTrapping)});
+            std::ostringstream name;
+            name << "numSCAL_Networks/primaryDrainage_" << std::hex << checksum << ".numd";
+            statePath = name.str();
+            if (networkCache::loadState(statePath, network, checksum))
+                std::cout << "Initial water distribution loaded from " << statePath << std::endl;
+            else
+                cached = false;
+        }
+
+        if (!cached)
+        {
+            auto sim = std::make_shared<primaryDrainage>(userInput::get().initialWaterSaturation);
+            sim->setNetwork(network);
+            sim->execute();
+            if (userInput::get().primaryDrainageCache)
+                networkCache::saveState(statePath, network, checksum);
+        }
     }
 
-    std::for_each(pnmRange<pore>(network).begin(), pnmRange<pore>(network).end(), [&gen](pore *p) {
+#pragma omp parallel for if (counterBased)
+    for (int i = 0; i < network->totalPores; ++i)
+    {
+        pore *p = network->getPore(i);
         if (p->getNodeIn() == 0)
         {
             auto connectedNode = p->getNodeOut();
@@ -653,10 +960,10 @@ void pnmOperation::setSwi()
             }
             else
             {
-                p->setPhaseFlag(gen.uniform_int() ? p->getNodeIn()->getPhaseFlag() : p->getNodeOut()->getPhaseFlag());
+                p->setPhaseFlag((counterBased ? poreGen.uniform_int(p->getIndex()) : gen.uniform_int()) ? p->getNodeIn()->getPhaseFlag() : p->getNodeOut()->getPhaseFlag());
             }
         }
-    });
+    }
 }
 
 void pnmOperation::fillWithWater()
@@ -668,32 +975,304 @@ void pnmOperation::fillWithWater()
 
 double pnmOperation::getSw()
 {
-    double waterVolume(0);
+    pnmSpan<element> elements(*network);
+    double waterVolume = reproducibleSum(elements.size(), [&elements](int i) {
+        return elements[i]->getVolume() * elements[i]->getWaterFraction();
+    });
+
+    return waterVolume / network->totalNetworkVolume;
+}
+
+void pnmOperation::resetVolumes()
+{
+    networkArrays &arrays = network->arrays;
+    if (!arrays.matches(*network))
+        arrays.build(*network);
+
+    int totalElements = network->totalNodes + network->totalPores;
+    elementsWaterVolumes.assign(totalElements, 0);
+    elementsWaterFilmsVolumes.assign(totalElements, 0);
+    elementsOilFilmsVolumes.assign(totalElements, 0);
+    waterVolume = 0;
+    waterFilmsVolume = 0;
+    oilFilmsVolume = 0;
+    configurationHash = 0;
+    if (userInput::get().cachedRelativePermeabilities)
+        elementsKeys.assign(totalElements, 0);
+    else
+        elementsKeys.clear();
+
     for (element *e : pnmRange<element>(network))
+        updateVolumes(e);
+}
+
+void pnmOperation::updateVolumes(element *e)
+{
+    //Water fills the whole capillary of a water-wet element, and the bulk left by the oil layers of an oil-wet one
+    double water(e->getWaterFilmVolume());
+    if (e->getPhaseFlag() == phase::water)
+        water = e->getWettabilityFlag() == wettability::oilWet ? e->getEffectiveVolume() + e->getWaterFilmVolume() : e->getVolume();
+
+    int index = e->getIndex();
+    waterVolume += water - elementsWaterVolumes[index];
+    waterFilmsVolume += e->getWaterFilmVolume() - elementsWaterFilmsVolumes[index];
+    oilFilmsVolume += e->getOilFilmVolume() - elementsOilFilmsVolumes[index];
+    elementsWaterVolumes[index] = water;
+    elementsWaterFilmsVolumes[index] = e->getWaterFilmVolume();
+    elementsOilFilmsVolumes[index] = e->getOilFilmVolume();
+
+    if (!elementsKeys.empty())
     {
-        waterVolume += e->getVolume() * e->getWaterFraction();
-    };
+        uint64_t key = relativePermeabilityCache::getElementKey(e);
+        configurationHash ^= elementsKeys[index] ^ key;
+        elementsKeys[index] = key;
+    }
+}
 
+bool pnmOperation::getConfigurationHash(uint64_t &hash) const
+{
+    if (int(elementsKeys.size()) != network->totalNodes + network->totalPores)
+        return false;
+    hash = configurationHash;
+    return true;
+}
+
+double pnmOperation::getWaterSaturation() const
+{
     return waterVolume / network->totalNetworkVolume;
 }
 
+double pnmOperation::getOilVolume() const
+{
+    return network->totalNetworkVolume - waterVolume;
+}
+
 double pnmOperation::getFlow(phase phaseFlag)
 {
-    double outletFlow(0);
-    for (pore *p : pnmOutlet(network))
-        if (p->getActive() && p->getPhaseFlag() == phaseFlag)
-            outletFlow += p->getFlow();
-    return outletFlow;
+    const std::vector<pore *> &outletPores = network->outletPores;
+    return reproducibleSum(outletPores.size(), [&outletPores, phaseFlag](int i) {
+        pore *p = outletPores[i];
+        return p->getActive() && p->getPhaseFlag() == phaseFlag ? p->getFlow() : 0.;
+    });
 }
 
 double pnmOperation::getInletPoresVolume()
 {
-    double inletPoresVolume(0.0);
-    for (pore *p : pnmInlet(network))
-        if(p->getActive())
-            inletPoresVolume += p->getVolume();
+    const std::vector<pore *> &inletPores = network->inletPores;
+    return reproducibleSum(inletPores.size(), [&inletPores](int i) {
+        return inletPores[i]->getActive() ? inletPores[i]->getVolume() : 0.;
+    });
+}
+
+void pnmOperation::reorderElements()
+{
+    elementsOrdering ordering = userInput::get().networkOrdering;
+    if (ordering == elementsOrdering::none)
+        return;
 
-    return inletPoresVolume;
+    std::cout << "Renumbering nodes and pores..." << std::endl;
+
+    networkArrays &arrays = network->arrays;
+    arrays.build(*network);
+
+    int totalNodes = network->totalNodes;
+    int totalPores = network->totalPores;
+    std::vector<int> nodesOrder = ordering == elementsOrdering::morton ? mortonOrder(*network) : reverseCuthillMcKeeOrder(arrays, totalNodes);
+    std::vector<int> nodesPositions(totalNodes);
+    for (int i = 0; i < totalNodes; ++i)
+        nodesPositions[nodesOrder[i]] = i;
+
+    //Pores follow their nodes: by first then second node new position, boundary pores along their only node
+    std::vector<std::pair<int, int>> poresKeys(totalPores);
+    for (int p = 0; p < totalPores; ++p)
+    {
+        int nodeIn = arrays.poreNodeIn[p], nodeOut = arrays.poreNodeOut[p];
+        int first = nodesPositions[nodeIn == -1 ? nodeOut : nodeIn];
+        int second = nodesPositions[nodeOut == -1 ? nodeIn : nodeOut];
+        poresKeys[p] = std::make_pair(std::min(first, second), std::max(first, second));
+    }
+    std::vector<int> poresOrder(totalPores);
+    std::iota(poresOrder.begin(), poresOrder.end(), 0);
+    std::stable_sort(poresOrder.begin(), poresOrder.end(), [&poresKeys](int a, int b) { return poresKeys[a] < poresKeys[b]; });
+
+    //The original ids are carried over from an earlier renumbering
+    std::vector<int> nodesIds(totalNodes), poresIds(totalPores);
+    for (int i = 0; i < totalNodes; ++i)
+        nodesIds[i] = network->originalNodesIds.empty() ? network->getNode(nodesOrder[i])->getId() : network->originalNodesIds[nodesOrder[i]];
+    for (int i = 0; i < totalPores; ++i)
+        poresIds[i] = network->originalPoresIds.empty() ? network->getPore(poresOrder[i])->getId() : network->originalPoresIds[poresOrder[i]];
+    network->originalNodesIds.swap(nodesIds);
+    network->originalPoresIds.swap(poresIds);
+
+    std::vector<networkModel::nodePtr> nodes(totalNodes);
+    for (int i = 0; i < totalNodes; ++i)
+        nodes[i] = std::move(network->tableOfNodes[nodesOrder[i]]);
+    network->tableOfNodes.swap(nodes);
+
+    std::vector<networkModel::porePtr> pores(totalPores);
+    for (int i = 0; i < totalPores; ++i)
+        pores[i] = std::move(network->tableOfPores[poresOrder[i]]);
+    network->tableOfPores.swap(pores);
+
+    for (int i = 0; i < totalNodes; ++i)
+    {
+        network->getNode(i)->setId(i + 1);
+        network->getNode(i)->setRank(i);
+    }
+    for (int i = 0; i < totalPores; ++i)
+        network->getPore(i)->setId(i + 1);
+
+    //Neighboors lists and boundary pores are sorted in the new order
+    arrays.build(*network);
+    auto byIndex = [](element *a, element *b) { return a->getIndex() < b->getIndex(); };
+    for (node *n : pnmRange<node>(network))
+        std::sort(n->getNeighboors().begin(), n->getNeighboors().end(), byIndex);
+    std::sort(network->inletPores.begin(), network->inletPores.end(), byIndex);
+    std::sort(network->outletPores.begin(), network->outletPores.end(), byIndex);
+    arrays.build(*network);
+
+    //Systems and clusterings of the former order are rebuilt on their next use
+    for (pressureSystem system : {pressureSystem::flow, pressureSystem::oil, pressureSystem::water})
+        pnmSolver::get(network, system).resetSystemPattern();
+    hkClustering::get(network).resetTrackedClusters();
+}
+
+void pnmOperation::extractSubVolume(const double lower[3], const double upper[3])
+{
+    std::cout << "Extracting sub-volume..." << std::endl;
+
+    double extents[3] = {network->xEdgeLength, network->yEdgeLength, network->zEdgeLength};
+    double boxLower[3], boxUpper[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        boxLower[axis] = std::max(0.0, std::min(1.0, lower[axis])) * extents[axis];
+        boxUpper[axis] = std::max(0.0, std::min(1.0, upper[axis])) * extents[axis];
+    }
+
+    networkArrays &arrays = network->arrays;
+    if (!arrays.matches(*network))
+        arrays.build(*network);
+    if (!network->nodesIndex.indexes(*network))
+        network->nodesIndex.build(*network);
+
+    std::vector<char> inside(network->totalNodes, 0);
+    for (int i : network->nodesIndex.getNodesInBox(boxLower, boxUpper))
+        inside[i] = 1;
+
+#pragma omp parallel for
+    for (int i = 0; i < network->totalNodes; ++i)
+        if (!inside[i])
+            network->getNode(i)->setActive(false);
+
+    //Pores between two inside nodes are kept, as are the former boundary pores of the inside nodes. Pores leaving the box
+    //through its x faces become its inlet and outlet pores, the others are closed with the outside nodes
+#pragma omp parallel for
+    for (int i = 0; i < network->totalPores; ++i)
+    {
+        pore *p = network->getPore(i);
+        int nodeIn = arrays.poreNodeIn[i], nodeOut = arrays.poreNodeOut[i];
+        bool inIn = nodeIn != -1 && inside[nodeIn], inOut = nodeOut != -1 && inside[nodeOut];
+
+        if ((inIn || nodeIn == -1) && (inOut || nodeOut == -1))
+            continue;
+
+        if (inIn == inOut || nodeIn == -1 || nodeOut == -1)
+        {
+            p->setActive(false);
+            continue;
+        }
+
+        node *kept = inIn ? p->getNodeIn() : p->getNodeOut();
+        node *removed = inIn ? p->getNodeOut() : p->getNodeIn();
+        if (removed->getXCoordinate() < boxLower[0])
+        {
+            p->setNodeIn(kept);
+            p->setNodeOut(0);
+            p->setInlet(true);
+        }
+        else if (removed->getXCoordinate() > boxUpper[0])
+        {
+            p->setNodeIn(0);
+            p->setNodeOut(kept);
+            p->setOutlet(true);
+        }
+        else
+            p->setActive(false);
+    }
+
+    network->inletPores.clear();
+    network->outletPores.clear();
+    for (pore *p : pnmRange<pore>(network))
+    {
+        if (p->getActive() && p->getInlet())
+            network->inletPores.push_back(p);
+        if (p->getActive() && p->getOutlet())
+            network->outletPores.push_back(p);
+    }
+
+#pragma omp parallel for
+    for (int i = 0; i < network->totalNodes; ++i)
+    {
+        node *n = network->getNode(i);
+        if (!n->getActive())
+            continue;
+        bool inlet(false), outlet(false);
+        for (element *e : n->getNeighboors())
+        {
+            inlet = inlet || (e->getActive() && e->getInlet());
+            outlet = outlet || (e->getActive() && e->getOutlet());
+        }
+        n->setInlet(inlet);
+        n->setOutlet(outlet);
+    }
+
+    //Only the cluster joining the box inlet to its outlet is kept
+    arrays.build(*network);
+    hkClustering::get(network).clusterActiveElements(false);
+    if (!hkClustering::get(network).isNetworkSpanning)
+        throw std::invalid_argument("The sub-volume does not connect its inlet to its outlet.\n");
+
+    pnmSpan<element> elements(*network);
+#pragma omp parallel for
+    for (int i = 0; i < int(elements.size()); ++i)
+        if (elements[i]->getActive() && !elements[i]->getClusterActive()->getSpanning())
+            elements[i]->setActive(false);
+
+    //The original ids of the kept elements follow them
+    std::vector<int> nodesIds, poresIds;
+    for (int i = 0; i < network->totalNodes; ++i)
+        if (network->getNode(i)->getActive())
+            nodesIds.push_back(network->originalNodesIds.empty() ? network->getNode(i)->getId() : network->originalNodesIds[i]);
+    for (int i = 0; i < network->totalPores; ++i)
+        if (network->getPore(i)->getActive())
+            poresIds.push_back(network->originalPoresIds.empty() ? network->getPore(i)->getId() : network->originalPoresIds[i]);
+    network->originalNodesIds.swap(nodesIds);
+    network->originalPoresIds.swap(poresIds);
+
+    network->removeInactiveElements();
+
+    //The box corner becomes the origin of the network
+#pragma omp parallel for
+    for (int i = 0; i < network->totalNodes; ++i)
+    {
+        node *n = network->getNode(i);
+        n->setXCoordinate(n->getXCoordinate() - boxLower[0]);
+        n->setYCoordinate(n->getYCoordinate() - boxLower[1]);
+        n->setZCoordinate(n->getZCoordinate() - boxLower[2]);
+    }
+    network->xEdgeLength = boxUpper[0] - boxLower[0];
+    network->yEdgeLength = boxUpper[1] - boxLower[1];
+    network->zEdgeLength = boxUpper[2] - boxLower[2];
+    network->nodesIndex.build(*network);
+
+    for (pressureSystem system : {pressureSystem::flow, pressureSystem::oil, pressureSystem::water})
+        pnmSolver::get(network, system).resetSystemPattern();
+    hkClustering::get(network).resetTrackedClusters();
+
+    calculateNetworkVolume();
+    pnmSolver::get(network).calculatePermeabilityAndPorosity();
+
+    std::cout << "Sub-volume: " << network->totalNodes << " nodes / " << network->totalPores << " throats" << std::endl;
 }
 
 void pnmOperation::exportToNumcalFormat()
@@ -748,21 +1327,35 @@ void pnmOperation::exportToNumcalFormat()
              << std::endl;
     }
     file.close();
+
+    //Ids of the renumbered elements in the network as built
+    if (!network->originalNodesIds.empty())
+    {
+        file.open("numSCAL_Networks/_ordering.num");
+        file << "element"
+             << ","
+             << "id"
+             << ","
+             << "originalId" << std::endl;
+
+        for (int i = 0; i < network->totalNodes; ++i)
+            file << "node," << i + 1 << "," << network->originalNodesIds[i] << std::endl;
+        for (int i = 0; i < network->totalPores; ++i)
+            file << "throat," << i + 1 << "," << network->originalPoresIds[i] << std::endl;
+        file.close();
+    }
 }
 
 void pnmOperation::generateNetworkState(int frame, std::string folderPath)
 {
-    std::string path = "Network_State/" + folderPath + "/network_state_" + boost::str(boost::format("%07d") % frame) + ".nums";
-
-    std::ofstream file;
-    file.open(path.c_str());
+    std::string path = userInput::get().networkStateFolder + "/" + folderPath + "/network_state_" + boost::str(boost::format("%07d") % frame);
 
-    file << "phase,concentration" << std::endl;
+    //The elements states are copied here; the file itself is written by the output thread
+    std::unique_ptr<networkState> state(new networkState);
+    networkStateFile::capture(network, frame, *state);
 
-    for (element *e : pnmRange<element>(network))
-        file << int(e->getPhaseFlag()) << "," << e->getConcentration() << std::endl;
-
-    file.close();
+    bool binary = userInput::get().binaryNetworkStates;
+    outputWriter::get().writeNetworkState(path + (binary ? ".numsb" : ".nums"), std::move(state), binary, userInput::get().compressNetworkStates);
 }
 
 } // namespace PNM
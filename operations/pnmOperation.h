@@ -8,12 +8,16 @@
 #ifndef PNMOPERATION_H
 #define PNMOPERATION_H
 
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace PNM
 {
 
 class networkModel;
+class element;
 enum class phase;
 
 class pnmOperation
@@ -35,26 +39,51 @@ class pnmOperation
     void backupWettability();
     void restoreWettability();
     void assignWWWettability();
-    void assignOilConductivities();
-    void assignWaterConductivities();
+    void assignEntryPressures();
+    void assignOilConductivities(bool spanningClustersOnly = true);
+    void assignWaterConductivities(bool spanningClustersOnly = true);
     void setSwi();
     void fillWithWater();
     double getSw();
+    void resetVolumes();
+    void updateVolumes(element *);
+    double getWaterSaturation() const;
+    double getWaterVolume() const { return waterVolume; }
+    double getOilVolume() const;
+    double getWaterFilmsVolume() const { return waterFilmsVolume; }
+    double getOilFilmsVolume() const { return oilFilmsVolume; }
     double getFlow(phase);
     double getInletPoresVolume();
+    bool getConfigurationHash(uint64_t &) const; // false when the hash is not maintained
+    void reorderElements();
+    void extractSubVolume(const double lower[3], const double upper[3]); // box as fractions of the network extents
     void exportToNumcalFormat();
     void generateNetworkState(int frame, std::string folderPath = "");
 
   protected:
-    pnmOperation() {}
+    pnmOperation() : waterVolume(0), waterFilmsVolume(0), oilFilmsVolume(0), configurationHash(0) {}
     ~pnmOperation() {}
     pnmOperation(const pnmOperation &) = delete;
     pnmOperation(pnmOperation &&) = delete;
     auto operator=(const pnmOperation &) -> pnmOperation & = delete;
     auto operator=(pnmOperation &&) -> pnmOperation & = delete;
+    friend class simulationContext;
 
     std::shared_ptr<networkModel> network;
-    static pnmOperation instance;
+
+    // Running volumes of the two-phase stages: the contribution of each element, by element index, is kept so that
+    // a phase change or a film adjustment only adds its difference
+    std::vector<double> elementsWaterVolumes;
+    std::vector<double> elementsWaterFilmsVolumes;
+    std::vector<double> elementsOilFilmsVolumes;
+    double waterVolume;
+    double waterFilmsVolume;
+    double oilFilmsVolume;
+
+    // Zobrist hash of the phases configuration, updated with the volumes when relative permeabilities are cached:
+    // the key each element last contributed is XORed out of the hash and its new one in
+    std::vector<uint64_t> elementsKeys;
+    uint64_t configurationHash;
 };
 
 } // namespace PNM
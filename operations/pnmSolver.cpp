@@ -6,15 +6,22 @@
 /////////////////////////////////////////////////////////////////////////////
 
 #include "pnmSolver.h"
+#include "simulationContext.h"
 #include "operations/hkClustering.h"
 #include "operations/pnmOperation.h"
 #include "network/iterator.h"
 #include "misc/userInput.h"
+#include "misc/scopedtimer.h"
+#include "misc/numaPlacement.h"
+#include "misc/reproducibleSum.h"
+#include "misc/memoryFootprint.h"
 
 //Eigen library
 #include <libs/Eigen/Sparse>
 #include <libs/Eigen/IterativeLinearSolvers>
 #include <libs/Eigen/SparseCholesky>
+#include <libs/Eigen/LU>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -24,159 +31,1078 @@ namespace PNM
 using namespace Eigen;
 using namespace std;
 
-pnmSolver pnmSolver::instance;
+std::atomic<int> pnmSolver::sharedThreads(-1);
 
-pnmSolver &pnmSolver::get(std::shared_ptr<networkModel> network)
+pnmSolver &pnmSolver::get(std::shared_ptr<networkModel> network, pressureSystem system)
 {
+    simulationContext &context = simulationContext::current();
+    pnmSolver &instance = system == pressureSystem::oil ? context.oilSolver : system == pressureSystem::water ? context.waterSolver : context.solver;
     instance.network = network;
+    instance.system = system;
     return instance;
 }
 
 double pnmSolver::solvePressuresConstantGradient(double pressureIn, double pressureOut, bool defaultSolver)
 {
-    SparseMatrix<double> conductivityMatrix(network->totalNodes, network->totalNodes);
-    conductivityMatrix.reserve(VectorXi::Constant(network->totalNodes, network->maxConnectionNumber + 3));
-    VectorXd b = VectorXd::Zero(network->totalNodes);
-    VectorXd pressures = VectorXd::Zero(network->totalNodes);
+    if (!isSystemPatternValid())
+        buildSystemPattern();
 
+    setSolverThreads();
+    networkArrays &arrays = network->arrays;
+    arrays.gatherFlowAttributes(*network);
+    assembleConstantGradientSystem(pressureIn, pressureOut, arrays.poreActive, arrays.poreConductivity, arrays.poreCapillaryPressure);
+    solveSystem(defaultSolver);
+    updateNodesPressures();
+
+    return updateFlowsConstantGradient(pressureIn, pressureOut);
+}
+
+double pnmSolver::solvePressuresConstantFlowRate()
+{
+    if (!isSystemPatternValid())
+        buildSystemPattern();
+
+    setSolverThreads();
+    assembleConstantFlowRateSystem();
+    solveSystem(false);
+    updateNodesPressures();
+
+    return updateFlowsConstantFlowRate();
+}
+
+double pnmSolver::solvePressuresConstantGradient(flowBuffers &buffers, double pressureIn, double pressureOut)
+{
+    //Only reads the network topology and the buffers: the pattern has to be built, and the solver threads set, beforehand
+    assembleConstantGradientSystem(pressureIn, pressureOut, buffers.poreActive, buffers.poreConductivity, buffers.poreCapillaryPressure);
+    solveSystem(false);
+
+    const networkArrays &arrays = network->arrays;
+    buffers.nodePressure.assign(pressures.data(), pressures.data() + network->totalNodes);
+    buffers.poreFlow.assign(network->totalPores, 0);
+
+    for (int i = 0; i < network->totalPores; ++i)
+    {
+        if (!buffers.poreActive[i])
+            continue;
+        int nodeIn = arrays.poreNodeIn[i], nodeOut = arrays.poreNodeOut[i];
+        int activeNode = nodeIn == -1 ? nodeOut : nodeIn;
+        if (arrays.poreOutlet[i])
+            buffers.poreFlow[i] = (pressures[activeNode] - pressureOut) * buffers.poreConductivity[i];
+        if (arrays.poreInlet[i])
+            buffers.poreFlow[i] = (pressureIn - pressures[activeNode]) * buffers.poreConductivity[i];
+        if (!arrays.poreInlet[i] && !arrays.poreOutlet[i])
+            buffers.poreFlow[i] = (pressures[nodeOut] - pressures[nodeIn]) * buffers.poreConductivity[i];
+    }
+
+    return reproducibleSum(network->totalPores, [&arrays, &buffers](int i) {
+        return buffers.poreActive[i] && arrays.poreOutlet[i] ? buffers.poreFlow[i] : 0.;
+    });
+}
+
+void flowBuffers::gather(const networkModel &network)
+{
+    poreActive.resize(network.totalPores);
+    poreConductivity.resize(network.totalPores);
+    poreCapillaryPressure.resize(network.totalPores);
+    for (int i = 0; i < network.totalPores; ++i)
+    {
+        pore *p = network.getPore(i);
+        poreActive[i] = p->getActive();
+        poreConductivity[i] = p->getConductivity();
+        poreCapillaryPressure[i] = p->getCapillaryPressure();
+    }
+}
+
+void flowBuffers::scatter(networkModel &network) const
+{
+    for (int i = 0; i < network.totalNodes; ++i)
+    {
+        network.arrays.nodePressure[i] = nodePressure[i];
+        network.getNode(i)->setPressure(nodePressure[i]);
+    }
+    for (int i = 0; i < network.totalPores; ++i)
+        network.getPore(i)->setFlow(poreFlow[i]);
+}
+
+void pnmSolver::resetSystemPattern()
+{
+    patternNetwork = 0;
+}
+
+bool pnmSolver::isSystemPatternValid() const
+{
+    return patternNetwork == network.get() && patternNodes == network->totalNodes && patternPores == network->totalPores;
+}
+
+void pnmSolver::buildSystemPattern()
+{
     auto rank(0);
     for (node *n : pnmRange<node>(network))
         n->setRank(rank++);
 
-    int row = 0;
-    for (node *n : pnmRange<node>(network))
+    networkArrays &arrays = network->arrays;
+    arrays.build(*network);
+
+    auto otherNode = [&arrays](int p, int n) -> int {
+        return arrays.poreNodeIn[p] == n ? arrays.poreNodeOut[p] : arrays.poreNodeIn[p];
+    };
+
+    //The pattern holds every internal pore, whatever its active flag: closed pores only zero their coefficients
+    std::vector<Triplet<double>> triplets;
+    triplets.reserve(network->totalNodes + 2 * network->totalPores);
+    for (int row = 0; row < network->totalNodes; ++row)
+    {
+        triplets.push_back(Triplet<double>(row, row, 0));
+        for (int k = arrays.nodePoresOffset[row]; k < arrays.nodePoresOffset[row + 1]; ++k)
+        {
+            int p = arrays.nodePores[k];
+            if (!arrays.poreInlet[p] && !arrays.poreOutlet[p])
+                triplets.push_back(Triplet<double>(row, otherNode(p, row), 0));
+        }
+    }
+
+    conductivityMatrix.resize(network->totalNodes, network->totalNodes);
+    conductivityMatrix.setFromTriplets(triplets.begin(), triplets.end());
+    conductivityMatrix.makeCompressed();
+
+    //The matrix is symmetric: (row, col) is stored as (col, row), so that each row owns its storage segment
+    auto valueIndex = [this](int row, int col) -> int {
+        const int *begin = conductivityMatrix.innerIndexPtr() + conductivityMatrix.outerIndexPtr()[row];
+        const int *end = conductivityMatrix.innerIndexPtr() + conductivityMatrix.outerIndexPtr()[row + 1];
+        return std::lower_bound(begin, end, col) - conductivityMatrix.innerIndexPtr();
+    };
+
+    diagonalIndices.resize(network->totalNodes);
+    neighboorsIndices.resize(arrays.nodePores.size());
+
+    for (int row = 0; row < network->totalNodes; ++row)
+    {
+        diagonalIndices[row] = valueIndex(row, row);
+        for (int k = arrays.nodePoresOffset[row]; k < arrays.nodePoresOffset[row + 1]; ++k)
+        {
+            int p = arrays.nodePores[k];
+            neighboorsIndices[k] = !arrays.poreInlet[p] && !arrays.poreOutlet[p] ? valueIndex(row, otherNode(p, row)) : -1;
+        }
+    }
+
+    b = VectorXd::Zero(network->totalNodes);
+    pressures = VectorXd::Zero(network->totalNodes);
+    boundaryConductivities.assign(network->totalNodes, 0);
+
+    //The rows of the matrix and the nodes vectors go to the threads assembling and multiplying them
+    const int *rowsOffset = conductivityMatrix.outerIndexPtr();
+    numaPlacement::distributeRows(conductivityMatrix.valuePtr(), rowsOffset, network->totalNodes);
+    numaPlacement::distributeRows(conductivityMatrix.innerIndexPtr(), rowsOffset, network->totalNodes);
+    numaPlacement::distributeRows(neighboorsIndices.data(), arrays.nodePoresOffset.data(), network->totalNodes);
+    numaPlacement::distribute(diagonalIndices);
+    numaPlacement::distribute(boundaryConductivities);
+    numaPlacement::distribute(b.data(), b.size());
+    numaPlacement::distribute(pressures.data(), pressures.size());
+
+    patternNetwork = network.get();
+    patternNodes = network->totalNodes;
+    patternPores = network->totalPores;
+    pressuresSolved = false;
+    choleskyPatternAnalyzed = false;
+    choleskyFactorized = false;
+    preconditionerPatternAnalyzed = false;
+    reducedPatternAnalyzed = false;
+    decompositionPatternAnalyzed = false;
+    mixedPatternAnalyzed = false;
+    directionalPatternAnalyzed = false;
+
+    poreCoefficients.assign(network->totalPores, 0);
+    updatePositions.assign(network->totalPores + network->totalNodes, -1);
+    clearLowRankUpdate();
+}
+
+void pnmSolver::assembleConstantGradientSystem(double pressureIn, double pressureOut, const std::vector<char> &poresActive, const std::vector<double> &poresConductivity, const std::vector<double> &poresCapillaryPressure)
+{
+    const networkArrays &arrays = network->arrays;
+
+    double *values = conductivityMatrix.valuePtr();
+    const int *rowsOffset = conductivityMatrix.outerIndexPtr();
+    int threads = Eigen::nbThreads();
+
+#pragma omp parallel for schedule(static) if (threads > 1) num_threads(threads)
+    for (int row = 0; row < network->totalNodes; ++row)
     {
-        double conductivity(1e-200);
-        for (element *e : n->getNeighboors())
+        std::fill(values + rowsOffset[row], values + rowsOffset[row + 1], 0.0);
+        b(row) = 0;
+
+        double conductivity(1e-200), boundaryConductivity(0);
+        for (int k = arrays.nodePoresOffset[row]; k < arrays.nodePoresOffset[row + 1]; ++k)
         {
-            pore *p = static_cast<pore *>(e);
-            if (p->getActive())
+            int p = arrays.nodePores[k];
+            if (poresActive[p])
             {
-                if (p->getInlet())
+                double poreConductivity = poresConductivity[p];
+                if (arrays.poreInlet[p])
                 {
-                    b(row) = -pressureIn * p->getConductivity();
-                    conductivity -= p->getConductivity();
+                    b(row) = -pressureIn * poreConductivity;
+                    conductivity -= poreConductivity;
+                    boundaryConductivity += poreConductivity;
                 }
-                if (p->getOutlet())
+                if (arrays.poreOutlet[p])
                 {
-                    b(row) = -pressureOut * p->getConductivity();
-                    conductivity -= p->getConductivity();
+                    b(row) = -pressureOut * poreConductivity;
+                    conductivity -= poreConductivity;
+                    boundaryConductivity += poreConductivity;
                 }
-                if (!p->getInlet() && !p->getOutlet())
+                if (!arrays.poreInlet[p] && !arrays.poreOutlet[p])
                 {
-                    node *neighboor = p->getOtherNode(n);
-                    conductivityMatrix.insert(row, neighboor->getRank()) = p->getConductivity();
-                    conductivity -= p->getConductivity();
+                    values[neighboorsIndices[k]] += poreConductivity;
+                    conductivity -= poreConductivity;
 
                     //Capillary Pressure
-                    if (neighboor == p->getNodeOut())
-                        b(row) += p->getCapillaryPressure() * p->getConductivity();
-                    if (neighboor == p->getNodeIn())
-                        b(row) -= p->getCapillaryPressure() * p->getConductivity();
+                    if (arrays.poreNodeIn[p] == row)
+                        b(row) += poresCapillaryPressure[p] * poreConductivity;
+                    if (arrays.poreNodeOut[p] == row)
+                        b(row) -= poresCapillaryPressure[p] * poreConductivity;
                 }
             }
         }
-        conductivityMatrix.insert(row, n->getRank()) = conductivity;
-        row++;
+        values[diagonalIndices[row]] = conductivity;
+        boundaryConductivities[row] = boundaryConductivity;
     }
-    conductivityMatrix.makeCompressed();
+
+    updatePoreCoefficients(true, poresActive, poresConductivity);
+}
+
+void pnmSolver::assembleConstantFlowRateSystem()
+{
+    networkArrays &arrays = network->arrays;
+    arrays.gatherFlowAttributes(*network);
+
+    double *values = conductivityMatrix.valuePtr();
+    const int *rowsOffset = conductivityMatrix.outerIndexPtr();
+    int threads = Eigen::nbThreads();
+
+    double inletPoresVolume = pnmOperation::get(network).getInletPoresVolume();
+    double flowRate = userInput::get().flowRate;
+
+#pragma omp parallel for schedule(static) if (threads > 1) num_threads(threads)
+    for (int row = 0; row < network->totalNodes; ++row)
+    {
+        std::fill(values + rowsOffset[row], values + rowsOffset[row + 1], 0.0);
+        b(row) = 0;
+
+        double conductivity(1e-200), boundaryConductivity(0);
+        for (int k = arrays.nodePoresOffset[row]; k < arrays.nodePoresOffset[row + 1]; ++k)
+        {
+            int p = arrays.nodePores[k];
+            if (arrays.poreActive[p])
+            {
+                double poreConductivity = arrays.poreConductivity[p];
+                if (arrays.poreInlet[p])
+                {
+                    b(row) -= arrays.poreVolume[p] / inletPoresVolume * flowRate;
+                }
+                if (arrays.poreOutlet[p])
+                {
+                    conductivity -= poreConductivity;
+                    boundaryConductivity += poreConductivity;
+                }
+                if (!arrays.poreInlet[p] && !arrays.poreOutlet[p])
+                {
+                    values[neighboorsIndices[k]] += poreConductivity;
+                    conductivity -= poreConductivity;
+
+                    //Capillary Pressure
+                    if (arrays.poreNodeIn[p] == row)
+                        b(row) += arrays.poreCapillaryPressure[p] * poreConductivity;
+                    if (arrays.poreNodeOut[p] == row)
+                        b(row) -= arrays.poreCapillaryPressure[p] * poreConductivity;
+                }
+            }
+        }
+        values[diagonalIndices[row]] = conductivity;
+        boundaryConductivities[row] = boundaryConductivity;
+    }
+
+    updatePoreCoefficients(false, arrays.poreActive, arrays.poreConductivity);
+}
+
+void pnmSolver::updatePoreCoefficients(bool inletPoresCoefficients, const std::vector<char> &poresActive, const std::vector<double> &poresConductivity)
+{
+    //Each active pore adds its conductivity to the diagonal of its nodes and substracts it between them
+    const networkArrays &arrays = network->arrays;
+    for (int p = 0; p < network->totalPores; ++p)
+    {
+        bool inMatrix = poresActive[p] && (inletPoresCoefficients || !arrays.poreInlet[p]);
+        poreCoefficients[p] = inMatrix ? poresConductivity[p] : 0;
+    }
+}
+
+void pnmSolver::setSolverThreads()
+{
+    //0 threads lets Eigen use every available core
+    if (sharedThreads < 0)
+        Eigen::setNbThreads(userInput::get().parallelSolver ? userInput::get().solverThreads : 1);
+    numaPlacement::pinThreads();
+}
+
+void pnmSolver::setSharedThreads(int threads)
+{
+    //Set before the concurrent simulations start, the global count is then only read
+    if (threads >= 0)
+        Eigen::setNbThreads(threads);
+    sharedThreads = threads;
+}
+
+void pnmSolver::solveSystem(bool defaultSolver)
+{
+    MEASURE_FUNCTION();
+    PROFILE_COUNTER("matrixNonZeros", conductivityMatrix.nonZeros());
+
+    //A relative permeability system is warm-started from its own last solution, the flow system from the nodes pressures
+    VectorXd guess;
+    if (system != pressureSystem::flow && pressuresSolved)
+        guess = pressures;
+    pressures.setZero();
+
+    if (userInput::get().reducedPressureSystem || userInput::get().condensedPressureSystem)
+    {
+        solveReducedSystem(defaultSolver, guess);
+        pressuresSolved = true;
+        recordMemoryUsage();
+        return;
+    }
+
+    //Being symmetric, the matrix storage is also its row-major storage, whose products Eigen runs in parallel
+    Map<const rowMajorMatrix> rowMajorView(network->totalNodes, network->totalNodes, conductivityMatrix.nonZeros(),
+                                           conductivityMatrix.outerIndexPtr(), conductivityMatrix.innerIndexPtr(), conductivityMatrix.valuePtr());
 
     if (defaultSolver || userInput::get().solverChoice == solver::conjugateGradient)
     {
-        ConjugateGradient<SparseMatrix<double>, Lower | Upper> solver;
+        ConjugateGradient<rowMajorMatrix, Lower | Upper> solver;
         solver.setTolerance(1e-25);
         solver.setMaxIterations(2000);
-        solver.compute(conductivityMatrix);
+        solver.compute(rowMajorView);
         pressures = solver.solve(b);
+        solverIterations = solver.iterations();
+        solverError = solver.error();
+        PROFILE_COUNTER("solverIterations", solverIterations);
+    }
+
+    else if (userInput::get().solverChoice == solver::preconditionedConjugateGradient)
+    {
+        if (guess.size() != network->totalNodes)
+        {
+            guess.resize(network->totalNodes);
+            for (node *n : pnmRange<node>(network))
+                guess[n->getRank()] = n->getPressure();
+        }
+
+        //The conductivity matrix is negative definite: the incomplete factorization runs on its opposite
+        conductivityMatrix *= -1;
+
+        if (!preconditionerPatternAnalyzed)
+        {
+            preconditionedSolver.setTolerance(1e-12);
+            preconditionedSolver.setMaxIterations(2000);
+            preconditionedSolver.analyzePattern(rowMajorView);
+            preconditionerPatternAnalyzed = true;
+        }
+        preconditionedSolver.factorize(rowMajorView);
+        pressures = preconditionedSolver.solveWithGuess(-b, guess);
+        solverIterations = preconditionedSolver.iterations();
+        solverError = preconditionedSolver.error();
+        PROFILE_COUNTER("solverIterations", solverIterations);
+
+        conductivityMatrix *= -1;
     }
 
+    else if (userInput::get().solverChoice == solver::domainDecomposition)
+        solveDecomposedSystem(guess);
+
+    else if (userInput::get().solverChoice == solver::mixedPrecision)
+        solveMixedPrecisionSystem();
+
     else if (userInput::get().solverChoice == solver::cholesky)
+        solveCholeskySystem();
+
+    pressuresSolved = true;
+    recordMemoryUsage();
+}
+
+void pnmSolver::solveCholeskySystem()
+{
+    if (!choleskyPatternAnalyzed)
     {
-        SimplicialLDLT<SparseMatrix<double>> solver;
-        solver.compute(conductivityMatrix);
-        pressures = solver.solve(b);
+        choleskySolver.analyzePattern(conductivityMatrix);
+        choleskyPatternAnalyzed = true;
     }
+    if (!solveLowRankUpdate())
+    {
+        choleskySolver.factorize(conductivityMatrix);
+        choleskyFactorized = true;
+        factorizedCoefficients = poreCoefficients;
+        clearLowRankUpdate();
+        pressures = choleskySolver.solve(b);
+    }
+}
 
-    for (node *n : pnmRange<node>(network))
-        n->setPressure(pressures[n->getRank()]);
+void pnmSolver::recordMemoryUsage()
+{
+    //Sparse matrices as values and rows indices with the columns offsets, factors as their lower triangle
+    auto sparseBytes = [](const auto &matrix, size_t valueSize) {
+        return matrix.nonZeros() * (valueSize + sizeof(int)) + (matrix.outerSize() + 1) * sizeof(int);
+    };
 
-    return updateFlowsConstantGradient(pressureIn, pressureOut);
+    size_t matrices = sparseBytes(conductivityMatrix, sizeof(double)) + sparseBytes(reducedMatrix, sizeof(double)) +
+                      sparseBytes(mixedMatrix, sizeof(float)) + sparseBytes(directionalMatrix, sizeof(double)) +
+                      (b.size() + pressures.size() + reducedB.size() + mixedScaling.size()) * sizeof(double) +
+                      memoryFootprint::of(diagonalIndices) + memoryFootprint::of(neighboorsIndices) + memoryFootprint::of(boundaryConductivities) +
+                      memoryFootprint::of(reducedRows) + memoryFootprint::of(reducedNodes) + memoryFootprint::of(componentLabels) +
+                      memoryFootprint::of(componentNodes) + memoryFootprint::of(reducedPattern) + memoryFootprint::of(condensedNodes);
+
+    //Only the factorizations done are read, Eigen asserting otherwise
+    size_t factorizations(0);
+    if (choleskyFactorized)
+        factorizations += sparseBytes(choleskySolver.matrixL().nestedExpression(), sizeof(double));
+    if (mixedPatternAnalyzed)
+        factorizations += sparseBytes(mixedSolver.matrixL().nestedExpression(), sizeof(float));
+    if (directionalPatternAnalyzed)
+        factorizations += sparseBytes(directionalSolver.matrixL().nestedExpression(), sizeof(double));
+    if (decompositionPatternAnalyzed)
+        factorizations += decomposition.getMemoryUsage();
+    if (preconditionerPatternAnalyzed)
+        factorizations += sparseBytes(preconditionedSolver.preconditioner().matrixL(), sizeof(double));
+    if (reducedPatternAnalyzed && (userInput::get().solverChoice == solver::cholesky || userInput::get().solverChoice == solver::mixedPrecision))
+        factorizations += sparseBytes(reducedCholeskySolver.matrixL().nestedExpression(), sizeof(double));
+    else if (reducedPatternAnalyzed)
+        factorizations += sparseBytes(reducedPreconditionedSolver.preconditioner().matrixL(), sizeof(double));
+    for (const VectorXd &column : updateColumns)
+        factorizations += column.size() * sizeof(double);
+
+    PROFILE_COUNTER("memory.solverMatrices(MB)", memoryFootprint::toMB(matrices));
+    PROFILE_COUNTER("memory.solverFactorizations(MB)", memoryFootprint::toMB(factorizations));
 }
 
-double pnmSolver::solvePressuresConstantFlowRate()
+void pnmSolver::solveReducedSystem(bool defaultSolver, VectorXd &guess)
 {
-    SparseMatrix<double> conductivityMatrix(network->totalNodes, network->totalNodes);
-    conductivityMatrix.reserve(VectorXi::Constant(network->totalNodes, network->maxConnectionNumber + 3));
-    VectorXd b = VectorXd::Zero(network->totalNodes);
-    VectorXd pressures = VectorXd::Zero(network->totalNodes);
+    selectReducedNodes();
+    buildReducedSystem();
 
-    auto rank(0);
-    for (node *n : pnmRange<node>(network))
-        n->setRank(rank++);
+    int rows = reducedNodes.size();
+    PROFILE_COUNTER("reducedRows", rows);
+    PROFILE_COUNTER("condensedNodes", condensedNodes.size());
+    solverIterations = 0;
+    solverError = 0;
+    if (rows == 0)
+        return;
 
-    double inletPoresVolume = pnmOperation::get(network).getInletPoresVolume();
+    Map<const rowMajorMatrix> rowMajorView(rows, rows, reducedMatrix.nonZeros(), reducedMatrix.outerIndexPtr(), reducedMatrix.innerIndexPtr(), reducedMatrix.valuePtr());
+    VectorXd solution;
 
-    int row = 0;
-    for (node *n : pnmRange<node>(network))
+    if (defaultSolver || userInput::get().solverChoice == solver::conjugateGradient)
+    {
+        ConjugateGradient<rowMajorMatrix, Lower | Upper> solver;
+        solver.setTolerance(1e-25);
+        solver.setMaxIterations(2000);
+        solver.compute(rowMajorView);
+        solution = solver.solve(reducedB);
+        solverIterations = solver.iterations();
+        solverError = solver.error();
+        PROFILE_COUNTER("solverIterations", solverIterations);
+    }
+
+    //The compacted system changes with each solve: the domain decomposition solver falls back to the incomplete factorization there
+    else if (userInput::get().solverChoice == solver::preconditionedConjugateGradient || userInput::get().solverChoice == solver::domainDecomposition)
+    {
+        VectorXd reducedGuess(rows);
+        for (int r = 0; r < rows; ++r)
+            reducedGuess[r] = guess.size() == network->totalNodes ? guess[reducedNodes[r]] : network->getNode(reducedNodes[r])->getPressure();
+
+        //The compacted matrix is rebuilt by each solve: it is simply left negated
+        reducedMatrix *= -1;
+
+        if (!reducedPatternAnalyzed)
+        {
+            reducedPreconditionedSolver.setTolerance(1e-12);
+            reducedPreconditionedSolver.setMaxIterations(2000);
+            reducedPreconditionedSolver.analyzePattern(rowMajorView);
+            reducedPatternAnalyzed = true;
+        }
+        reducedPreconditionedSolver.factorize(rowMajorView);
+        solution = reducedPreconditionedSolver.solveWithGuess(-reducedB, reducedGuess);
+        solverIterations = reducedPreconditionedSolver.iterations();
+        solverError = reducedPreconditionedSolver.error();
+        PROFILE_COUNTER("solverIterations", solverIterations);
+    }
+
+    //The compacted system is factorized once per solve anyway: the mixed precision solver uses the double factorization there
+    else if (userInput::get().solverChoice == solver::cholesky || userInput::get().solverChoice == solver::mixedPrecision)
+    {
+        if (!reducedPatternAnalyzed)
+        {
+            reducedCholeskySolver.analyzePattern(reducedMatrix);
+            reducedPatternAnalyzed = true;
+        }
+        reducedCholeskySolver.factorize(reducedMatrix);
+        solution = reducedCholeskySolver.solve(reducedB);
+    }
+
+    else
+        return;
+
+    for (int r = 0; r < rows; ++r)
+        pressures[reducedNodes[r]] = solution[r];
+    recoverCondensedNodes();
+}
+
+void pnmSolver::solveDecomposedSystem(VectorXd &guess)
+{
+    int totalNodes = network->totalNodes;
+    if (guess.size() != totalNodes)
+    {
+        guess.resize(totalNodes);
+        for (node *n : pnmRange<node>(network))
+            guess[n->getRank()] = n->getPressure();
+    }
+
+    int domains = userInput::get().solverDomains;
+    if (!decomposition.partitions(*network, domains))
+    {
+        decomposition.partition(*network, domains);
+        decompositionPatternAnalyzed = false;
+        PROFILE_COUNTER("haloPores", decomposition.getHaloPores());
+    }
+    if (!decompositionPatternAnalyzed)
+    {
+        decomposition.analyzePattern(conductivityMatrix);
+        decompositionPatternAnalyzed = true;
+    }
+
+    //The conductivity matrix is negative definite: the subdomains blocks and the iterations work on its opposite
+    decomposition.factorize(conductivityMatrix, -1);
+
+    Map<const rowMajorMatrix> rowMajorView(totalNodes, totalNodes, conductivityMatrix.nonZeros(),
+                                           conductivityMatrix.outerIndexPtr(), conductivityMatrix.innerIndexPtr(), conductivityMatrix.valuePtr());
+
+    VectorXd rhs = -b;
+    double rhsNorm = rhs.norm();
+    pressures = guess;
+    solverIterations = 0;
+    solverError = 0;
+    if (rhsNorm == 0)
+    {
+        pressures.setZero();
+        return;
+    }
+
+    const double tolerance = 1e-12;
+    const int maxIterations = 2000;
+
+    VectorXd residual = rhs + rowMajorView * pressures;
+    VectorXd correction, direction, product;
+    decomposition.apply(residual, correction);
+    direction = correction;
+    double residualCorrection = residual.dot(correction);
+
+    solverError = residual.norm() / rhsNorm;
+    while (solverError > tolerance && solverIterations < maxIterations)
     {
-        double conductivity(1e-200);
-        for (element *e : n->getNeighboors())
+        product.noalias() = -(rowMajorView * direction);
+        double step = residualCorrection / direction.dot(product);
+        pressures += step * direction;
+        residual -= step * product;
+        solverIterations++;
+
+        solverError = residual.norm() / rhsNorm;
+        if (solverError <= tolerance)
+            break;
+
+        decomposition.apply(residual, correction);
+        double previous = residualCorrection;
+        residualCorrection = residual.dot(correction);
+        direction = correction + (residualCorrection / previous) * direction;
+    }
+    PROFILE_COUNTER("solverIterations", solverIterations);
+}
+
+void pnmSolver::solveMixedPrecisionSystem()
+{
+    int totalNodes = network->totalNodes;
+    const double *values = conductivityMatrix.valuePtr();
+    const int *columnsOffset = conductivityMatrix.outerIndexPtr();
+    const int *rows = conductivityMatrix.innerIndexPtr();
+
+    //Conductivities span many orders of magnitude below the single precision range: the system is scaled to a unit
+    //diagonal first, and negated to be positive definite
+    if (!mixedPatternAnalyzed)
+    {
+        mixedMatrix = conductivityMatrix.cast<float>();
+        mixedScaling.resize(totalNodes);
+    }
+    for (int n = 0; n < totalNodes; ++n)
+        mixedScaling[n] = 1 / std::sqrt(std::abs(values[diagonalIndices[n]]));
+
+    float *mixedValues = mixedMatrix.valuePtr();
+    int threads = Eigen::nbThreads();
+#pragma omp parallel for if (threads > 1) num_threads(threads)
+    for (int col = 0; col < totalNodes; ++col)
+        for (int k = columnsOffset[col]; k < columnsOffset[col + 1]; ++k)
+            mixedValues[k] = float(-values[k] * mixedScaling[rows[k]] * mixedScaling[col]);
+
+    if (!mixedPatternAnalyzed)
+    {
+        mixedSolver.analyzePattern(mixedMatrix);
+        mixedPatternAnalyzed = true;
+    }
+    mixedSolver.factorize(mixedMatrix);
+
+    Map<const rowMajorMatrix> rowMajorView(totalNodes, totalNodes, conductivityMatrix.nonZeros(),
+                                           conductivityMatrix.outerIndexPtr(), conductivityMatrix.innerIndexPtr(), conductivityMatrix.valuePtr());
+
+    //Iterative refinement: A x = b is solved as (-S A S) y = -S b with x = S y, each correction by the single precision
+    //factor, each residual in double precision. A relative residual of 1e-12 keeps the pores flows signs
+    const double tolerance = 1e-12;
+    const int maxRefinements = 50;
+
+    double rhsNorm = b.norm();
+    pressures.setZero();
+    solverIterations = 0;
+    solverError = 0;
+    if (rhsNorm == 0)
+        return;
+
+    VectorXd residual = b;
+    VectorXf scaledResidual(totalNodes);
+    solverError = 1;
+    while (mixedSolver.info() == Success && solverError > tolerance && solverIterations < maxRefinements)
+    {
+        scaledResidual = (-mixedScaling.cwiseProduct(residual)).cast<float>();
+        VectorXf correction = mixedSolver.solve(scaledResidual);
+        pressures += mixedScaling.cwiseProduct(correction.cast<double>());
+        solverIterations++;
+
+        residual = b;
+        residual.noalias() -= rowMajorView * pressures;
+        solverError = residual.norm() / rhsNorm;
+    }
+    PROFILE_COUNTER("solverIterations", solverIterations);
+
+    //A failed single precision factorization, or a system too ill-conditioned for it (the refinement then stalls or
+    //diverges), is solved by the double precision factorization
+    if (mixedSolver.info() != Success || !(solverError <= tolerance))
+    {
+        PROFILE_COUNTER("mixedPrecisionFallbacks", 1);
+        solveCholeskySystem();
+        residual = b;
+        residual.noalias() -= rowMajorView * pressures;
+        solverError = residual.norm() / rhsNorm;
+    }
+}
+
+void pnmSolver::selectReducedNodes()
+{
+    int totalNodes = network->totalNodes;
+    const int *offsets = conductivityMatrix.outerIndexPtr();
+    const int *indices = conductivityMatrix.innerIndexPtr();
+    const double *values = conductivityMatrix.valuePtr();
+
+    componentLabels.assign(totalNodes, -1);
+    reducedRows.assign(totalNodes, -1);
+
+    for (int start = 0; start < totalNodes; ++start)
+    {
+        if (componentLabels[start] != -1)
+            continue;
+
+        //Nodes connected to the start node by pores in the matrix (the matrix is symmetric: columns are rows)
+        componentNodes.clear();
+        componentNodes.push_back(start);
+        componentLabels[start] = start;
+        for (unsigned k = 0; k < componentNodes.size(); ++k)
         {
-            pore *p = static_cast<pore *>(e);
-            if (p->getActive())
+            int n = componentNodes[k];
+            for (int j = offsets[n]; j < offsets[n + 1]; ++j)
             {
-                if (p->getInlet())
-                {
-                    b(row) -= p->getVolume() / inletPoresVolume * userInput::get().flowRate;
-                }
-                if (p->getOutlet())
+                int m = indices[j];
+                if (m != n && values[j] != 0 && componentLabels[m] == -1)
                 {
-                    conductivity -= p->getConductivity();
+                    componentLabels[m] = start;
+                    componentNodes.push_back(m);
                 }
-                if (!p->getInlet() && !p->getOutlet())
-                {
-                    node *neighboor = p->getOtherNode(n);
-                    conductivityMatrix.insert(row, neighboor->getRank()) = p->getConductivity();
-                    conductivity -= p->getConductivity();
+            }
+        }
 
-                    //Capillary Pressure
-                    if (neighboor == p->getNodeOut())
-                        b(row) += p->getCapillaryPressure() * p->getConductivity();
-                    if (neighboor == p->getNodeIn())
-                        b(row) -= p->getCapillaryPressure() * p->getConductivity();
-                }
+        //A component without flow has the uniform pressure of its boundary pores, which balances every row; an isolated
+        //component (no fixed pressure boundary) has no defined pressure and is set to 0
+        double pressure(0);
+        bool anchored(false), uniform(true);
+        for (int n : componentNodes)
+        {
+            if (boundaryConductivities[n] > 0)
+            {
+                pressure = -b(n) / boundaryConductivities[n];
+                anchored = true;
+                break;
             }
         }
-        conductivityMatrix.insert(row, n->getRank()) = conductivity;
-        row++;
+        for (int n : componentNodes)
+        {
+            double balance = boundaryConductivities[n] * pressure;
+            if (std::abs(balance + b(n)) > 1e-12 * (std::abs(balance) + std::abs(b(n))))
+            {
+                uniform = false;
+                break;
+            }
+        }
+
+        if (anchored && !uniform)
+        {
+            for (int n : componentNodes)
+                reducedRows[n] = 0;
+        }
+        else
+        {
+            for (int n : componentNodes)
+                pressures[n] = uniform ? pressure : 0;
+        }
     }
-    conductivityMatrix.makeCompressed();
 
-    if (userInput::get().solverChoice == solver::conjugateGradient)
+    reducedNodes.clear();
+    for (int n = 0; n < totalNodes; ++n)
     {
-        ConjugateGradient<SparseMatrix<double>, Lower | Upper> solver;
-        solver.setTolerance(1e-25);
-        solver.setMaxIterations(2000);
-        solver.compute(conductivityMatrix);
-        pressures = solver.solve(b);
+        if (reducedRows[n] != -1)
+        {
+            reducedRows[n] = reducedNodes.size();
+            reducedNodes.push_back(n);
+        }
     }
+}
 
-    else if (userInput::get().solverChoice == solver::cholesky)
+void pnmSolver::buildReducedSystem()
+{
+    const int *offsets = conductivityMatrix.outerIndexPtr();
+    const int *indices = conductivityMatrix.innerIndexPtr();
+    const double *values = conductivityMatrix.valuePtr();
+
+    //Rows are renumbered in the nodes order, so that the kept coefficients stay sorted; closed pores are left out
+    int rows = reducedNodes.size();
+    reducedMatrix.resize(rows, rows);
+    reducedMatrix.reserve(conductivityMatrix.nonZeros());
+    reducedB.resize(rows);
+    for (int r = 0; r < rows; ++r)
     {
-        SimplicialLDLT<SparseMatrix<double>> solver;
-        solver.compute(conductivityMatrix);
-        pressures = solver.solve(b);
+        int n = reducedNodes[r];
+        reducedMatrix.startVec(r);
+        for (int j = offsets[n]; j < offsets[n + 1]; ++j)
+        {
+            int m = indices[j];
+            if (reducedRows[m] != -1 && (values[j] != 0 || m == n))
+                reducedMatrix.insertBack(reducedRows[m], r) = values[j];
+        }
+        reducedB[r] = b(n);
     }
+    reducedMatrix.finalize();
 
-    for (node *n : pnmRange<node>(network))
-        n->setPressure(pressures[n->getRank()]);
+    condensedNodes.clear();
+    if (userInput::get().condensedPressureSystem)
+        condenseReducedSystem();
 
-    return updateFlowsConstantFlowRate();
+    //The symbolic analysis is kept while the compacted pattern does not change
+    const int *reducedOffsets = reducedMatrix.outerIndexPtr();
+    const int *reducedIndices = reducedMatrix.innerIndexPtr();
+    int nonZeros = reducedMatrix.nonZeros();
+    bool samePattern = reducedPattern.size() == unsigned(rows + 1 + nonZeros) &&
+                       std::equal(reducedOffsets, reducedOffsets + rows + 1, reducedPattern.begin()) &&
+                       std::equal(reducedIndices, reducedIndices + nonZeros, reducedPattern.begin() + rows + 1);
+    if (!samePattern)
+    {
+        reducedPattern.assign(reducedOffsets, reducedOffsets + rows + 1);
+        reducedPattern.insert(reducedPattern.end(), reducedIndices, reducedIndices + nonZeros);
+        reducedPatternAnalyzed = false;
+    }
+}
+
+void pnmSolver::condenseReducedSystem()
+{
+    struct coefficient
+    {
+        int row;
+        double value;
+    };
+
+    int rows = reducedNodes.size();
+    const int *offsets = reducedMatrix.outerIndexPtr();
+    const int *indices = reducedMatrix.innerIndexPtr();
+    const double *values = reducedMatrix.valuePtr();
+
+    std::vector<std::vector<coefficient>> neighboors(rows);
+    std::vector<double> diagonal(rows);
+    for (int r = 0; r < rows; ++r)
+    {
+        for (int j = offsets[r]; j < offsets[r + 1]; ++j)
+        {
+            if (indices[j] == r)
+                diagonal[r] = values[j];
+            else
+                neighboors[r].push_back({indices[j], values[j]});
+        }
+    }
+
+    auto addCoupling = [&neighboors](int r, int m, double value) {
+        for (coefficient &t : neighboors[r])
+        {
+            if (t.row == m)
+            {
+                t.value += value;
+                return;
+            }
+        }
+        neighboors[r].push_back({m, value});
+    };
+
+    //Eliminating a row never adds neighboors to the others: the rows left with one or two neighboors are condensed in turn,
+    //which peels the dead-end branches and shortens the chains down to the anchored rows
+    std::vector<char> eliminated(rows, 0);
+    auto isCondensable = [&](int r) {
+        return !eliminated[r] && !neighboors[r].empty() && neighboors[r].size() <= 2 && boundaryConductivities[reducedNodes[r]] == 0;
+    };
+
+    std::vector<int> candidates;
+    for (int r = 0; r < rows; ++r)
+        if (isCondensable(r))
+            candidates.push_back(r);
+
+    while (!candidates.empty())
+    {
+        int c = candidates.back();
+        candidates.pop_back();
+        if (!isCondensable(c))
+            continue;
+
+        const std::vector<coefficient> &terms = neighboors[c];
+        condensedNode condensed;
+        condensed.node = reducedNodes[c];
+        condensed.diagonal = diagonal[c];
+        condensed.b = reducedB[c];
+        for (int i = 0; i < 2; ++i)
+        {
+            condensed.neighboors[i] = i < int(terms.size()) ? reducedNodes[terms[i].row] : -1;
+            condensed.conductivities[i] = i < int(terms.size()) ? terms[i].value : 0;
+        }
+        condensedNodes.push_back(condensed);
+
+        //The row pressure (b_c - sum g_i p_i) / a_cc is substituted in its neighboors rows: in a chain, the two pores
+        //become one of their series conductance, and the capillary pressure terms are carried to the ends
+        for (const coefficient &t : terms)
+        {
+            std::vector<coefficient> &other = neighboors[t.row];
+            other.erase(std::find_if(other.begin(), other.end(), [c](const coefficient &x) { return x.row == c; }));
+            diagonal[t.row] -= t.value * t.value / diagonal[c];
+            reducedB[t.row] -= t.value * reducedB[c] / diagonal[c];
+        }
+        if (terms.size() == 2)
+        {
+            double series = -terms[0].value * terms[1].value / diagonal[c];
+            addCoupling(terms[0].row, terms[1].row, series);
+            addCoupling(terms[1].row, terms[0].row, series);
+        }
+
+        eliminated[c] = 1;
+        for (const coefficient &t : terms)
+            if (isCondensable(t.row))
+                candidates.push_back(t.row);
+        neighboors[c].clear();
+    }
+
+    if (condensedNodes.empty())
+        return;
+
+    //The kept rows are renumbered in the nodes order, and the condensed nodes set directly
+    std::vector<int> keptRows(rows, -1);
+    std::vector<int> keptNodes;
+    for (int r = 0; r < rows; ++r)
+    {
+        if (eliminated[r])
+        {
+            reducedRows[reducedNodes[r]] = -1;
+            continue;
+        }
+        keptRows[r] = keptNodes.size();
+        reducedRows[reducedNodes[r]] = keptNodes.size();
+        keptNodes.push_back(reducedNodes[r]);
+    }
+
+    int kept = keptNodes.size();
+    SparseMatrix<double> condensedMatrix(kept, kept);
+    condensedMatrix.reserve(reducedMatrix.nonZeros());
+    VectorXd condensedB(kept);
+    std::vector<coefficient> row;
+    for (int r = 0; r < rows; ++r)
+    {
+        if (eliminated[r])
+            continue;
+
+        row.assign(1, {keptRows[r], diagonal[r]});
+        for (const coefficient &t : neighboors[r])
+            row.push_back({keptRows[t.row], t.value});
+        std::sort(row.begin(), row.end(), [](const coefficient &x, const coefficient &y) { return x.row < y.row; });
+
+        condensedMatrix.startVec(keptRows[r]);
+        for (const coefficient &t : row)
+            condensedMatrix.insertBack(t.row, keptRows[r]) = t.value;
+        condensedB[keptRows[r]] = reducedB[r];
+    }
+    condensedMatrix.finalize();
+
+    reducedMatrix.swap(condensedMatrix);
+    reducedB.swap(condensedB);
+    reducedNodes.swap(keptNodes);
+}
+
+void pnmSolver::recoverCondensedNodes()
+{
+    //Every node is interpolated from its neighboors at its elimination, solved or eliminated after it
+    for (auto it = condensedNodes.rbegin(); it != condensedNodes.rend(); ++it)
+    {
+        double rhs = it->b;
+        for (int i = 0; i < 2; ++i)
+            if (it->neighboors[i] != -1)
+                rhs -= it->conductivities[i] * pressures[it->neighboors[i]];
+        pressures[it->node] = rhs / it->diagonal;
+    }
+}
+
+void pnmSolver::updateNodesPressures()
+{
+    pnmSpan<node> nodes(*network);
+    for (int i = 0; i < nodes.size(); ++i)
+    {
+        network->arrays.nodePressure[i] = pressures[i];
+        nodes[i]->setPressure(pressures[i]);
+    }
+}
+
+bool pnmSolver::solveLowRankUpdate()
+{
+    int maxUpdates = system == pressureSystem::flow ? userInput::get().maxLowRankUpdates : userInput::get().relativePermeabilityUpdates;
+    if (!choleskyFactorized || maxUpdates <= 0)
+        return false;
+
+    networkArrays &arrays = network->arrays;
+    const double *values = conductivityMatrix.valuePtr();
+    int totalPores = network->totalPores;
+
+    //Correction terms: the pores whose contribution changed, and the nodes they left without any open pore,
+    //whose diagonal is restored so that the corrected matrix stays well conditioned
+    for (int p = 0; p < totalPores; ++p)
+    {
+        if (poreCoefficients[p] == factorizedCoefficients[p])
+            continue;
+
+        addUpdateTerm(p);
+        for (int n : {arrays.poreNodeIn[p], arrays.poreNodeOut[p]})
+        {
+            if (n != -1 && values[diagonalIndices[n]] == 1e-200)
+            {
+                if (b[n] != 0)
+                    return false;
+                addUpdateTerm(totalPores + n);
+            }
+        }
+
+        if (int(updatedTerms.size()) > maxUpdates)
+            return false;
+    }
+
+    for (unsigned t = updateColumns.size(); t < updatedTerms.size(); ++t)
+    {
+        VectorXd termVector = VectorXd::Zero(network->totalNodes);
+        forEachTermNode(updatedTerms[t], [&termVector](int n, double sign) { termVector[n] += sign; });
+        updateColumns.push_back(choleskySolver.solve(termVector));
+    }
+
+    //(A + U D U') x = b is solved as x = y - Z (I + D U' Z)^-1 D U' y, where A y = b and A Z = U
+    auto coefficient = [&](int t) -> double {
+        if (t < totalPores)
+            return factorizedCoefficients[t] - poreCoefficients[t];
+
+        int n = t - totalPores;
+        double restoredDiagonal(0);
+        if (values[diagonalIndices[n]] == 1e-200)
+            for (int k = arrays.nodePoresOffset[n]; k < arrays.nodePoresOffset[n + 1]; ++k)
+                restoredDiagonal -= factorizedCoefficients[arrays.nodePores[k]];
+        return restoredDiagonal;
+    };
+
+    auto project = [this](int t, const VectorXd &v) -> double {
+        double projection(0);
+        forEachTermNode(t, [&projection, &v](int n, double sign) { projection += sign * v[n]; });
+        return projection;
+    };
+
+    VectorXd y = choleskySolver.solve(b);
+    int rank = updatedTerms.size();
+    if (rank == 0)
+    {
+        pressures = y;
+        return true;
+    }
+
+    MatrixXd capacitance = MatrixXd::Identity(rank, rank);
+    VectorXd projections(rank);
+    for (int i = 0; i < rank; ++i)
+    {
+        double c = coefficient(updatedTerms[i]);
+        projections[i] = c * project(updatedTerms[i], y);
+        for (int j = 0; j < rank; ++j)
+            capacitance(i, j) += c * project(updatedTerms[i], updateColumns[j]);
+    }
+
+    VectorXd weights = capacitance.partialPivLu().solve(projections);
+    pressures = y;
+    for (int j = 0; j < rank; ++j)
+        pressures -= weights[j] * updateColumns[j];
+
+    //Nodes without any open pore carry no flow
+    for (int t : updatedTerms)
+        if (t >= totalPores && values[diagonalIndices[t - totalPores]] == 1e-200)
+            pressures[t - totalPores] = 0;
+
+    //The correction is only kept when it is as accurate as a direct solve
+    double residual = (conductivityMatrix * pressures - b).norm();
+    return residual <= 1e-10 * b.norm();
+}
+
+void pnmSolver::addUpdateTerm(int t)
+{
+    if (updatePositions[t] != -1)
+        return;
+    updatePositions[t] = updatedTerms.size();
+    updatedTerms.push_back(t);
+}
+
+template <typename F>
+void pnmSolver::forEachTermNode(int t, F f) const
+{
+    const networkArrays &arrays = network->arrays;
+    if (t >= network->totalPores)
+    {
+        f(t - network->totalPores, 1);
+        return;
+    }
+    if (arrays.poreNodeIn[t] != -1)
+        f(arrays.poreNodeIn[t], 1);
+    if (arrays.poreNodeOut[t] != -1)
+        f(arrays.poreNodeOut[t], -1);
+}
+
+void pnmSolver::clearLowRankUpdate()
+{
+    for (int t : updatedTerms)
+        updatePositions[t] = -1;
+    updatedTerms.clear();
+    updateColumns.clear();
 }
 
 double pnmSolver::updateFlowsConstantGradient(double pressureIn, double pressureOut)
 {
-    double outletFlow(0);
     for (pore *p : pnmRange<pore>(network))
     {
         p->setFlow(0);
@@ -186,7 +1112,6 @@ double pnmSolver::updateFlowsConstantGradient(double pressureIn, double pressure
             {
                 node *activeNode = p->getNodeIn() == 0 ? p->getNodeOut() : p->getNodeIn();
                 p->setFlow((activeNode->getPressure() - pressureOut) * p->getConductivity());
-                outletFlow += p->getFlow();
             }
             if (p->getInlet())
             {
@@ -199,13 +1124,20 @@ double pnmSolver::updateFlowsConstantGradient(double pressureIn, double pressure
             }
         }
     }
-    return outletFlow;
+    return getOutletFlow();
+}
+
+double pnmSolver::getOutletFlow() const
+{
+    const std::vector<pore *> &outletPores = network->outletPores;
+    return reproducibleSum(outletPores.size(), [&outletPores](int i) {
+        return outletPores[i]->getActive() ? outletPores[i]->getFlow() : 0.;
+    });
 }
 
 double pnmSolver::updateFlowsConstantFlowRate()
 {
     double inletPoresVolume = pnmOperation::get(network).getInletPoresVolume();
-    double outletFlow(0);
     for (pore *p : pnmRange<pore>(network))
     {
         p->setFlow(0);
@@ -215,7 +1147,6 @@ double pnmSolver::updateFlowsConstantFlowRate()
             {
                 node *activeNode = p->getNodeIn() == 0 ? p->getNodeOut() : p->getNodeIn();
                 p->setFlow((activeNode->getPressure()) * p->getConductivity());
-                outletFlow += p->getFlow();
             }
             if (p->getInlet())
             {
@@ -250,7 +1181,17 @@ double pnmSolver::updateFlowsConstantFlowRate()
         }
     }
 
-    return outletFlow;
+    return getOutletFlow();
+}
+
+int pnmSolver::getSolverIterations() const
+{
+    return solverIterations;
+}
+
+double pnmSolver::getSolverError() const
+{
+    return solverError;
 }
 
 double pnmSolver::getDeltaP()
@@ -291,13 +1232,266 @@ void pnmSolver::calculatePermeabilityAndPorosity()
     network->absolutePermeability = (outletFlow * network->xEdgeLength) / (network->yEdgeLength * network->zEdgeLength);
 
     network->porosity = network->totalNetworkVolume / (network->xEdgeLength * network->yEdgeLength * network->zEdgeLength);
+
+    if (userInput::get().directionalPermeabilities)
+        calculatePermeabilityTensor();
+}
+
+void pnmSolver::calculatePermeabilityTensor()
+{
+    pnmOperation::get(network).assignConductivities();
+    auto flows = solveDirectionalFlows();
+
+    //Mean flow per unit of volume, for a unit pressure drop across the domain
+    for (int a = 0; a < 3; ++a)
+        for (int b = 0; b < 3; ++b)
+            network->permeabilityTensor[a][b] = domainAxes[a] && domainAxes[b] ? flows[a][b] * domainExtents[a] / domainVolume : 0;
+}
+
+std::array<std::pair<double, double>, 3> pnmSolver::calculateDirectionalRelativePermeabilities()
+{
+    std::array<std::pair<double, double>, 3> relativePermeabilities = {};
+    pnmOperation::get(network).assignViscosities();
+
+    //Every conducting cluster contributes: the face conditions leave the clusters reaching no face without flow
+    pnmOperation::get(network).assignOilConductivities(false);
+    auto oilFlows = solveDirectionalFlows();
+    pnmOperation::get(network).assignWaterConductivities(false);
+    auto waterFlows = solveDirectionalFlows();
+
+    for (int a = 0; a < 3; ++a)
+    {
+        double permeability = network->permeabilityTensor[a][a];
+        if (!domainAxes[a] || permeability <= 0)
+            continue;
+        double phaseFactor = domainExtents[a] / domainVolume / permeability;
+        relativePermeabilities[a].first = oilFlows[a][a] * phaseFactor * userInput::get().oilViscosity;
+        relativePermeabilities[a].second = waterFlows[a][a] * phaseFactor * userInput::get().waterViscosity;
+    }
+
+    return relativePermeabilities;
+}
+
+void pnmSolver::classifyFaceNodes()
+{
+    networkArrays &arrays = network->arrays;
+    int totalNodes = network->totalNodes;
+
+    nodesCoordinates.resize(totalNodes, 3);
+    pnmSpan<node> nodes(*network);
+    for (int i = 0; i < totalNodes; ++i)
+    {
+        nodesCoordinates(i, 0) = nodes[i]->getXCoordinate();
+        nodesCoordinates(i, 1) = nodes[i]->getYCoordinate();
+        nodesCoordinates(i, 2) = nodes[i]->getZCoordinate();
+    }
+
+    //The faces are the nodes within half the mean internal pore span of the bounding box sides
+    double span(0);
+    int internalPores(0);
+    for (int p = 0; p < network->totalPores; ++p)
+    {
+        if (arrays.poreNodeIn[p] == -1 || arrays.poreNodeOut[p] == -1)
+            continue;
+        span += (nodesCoordinates.row(arrays.poreNodeIn[p]) - nodesCoordinates.row(arrays.poreNodeOut[p])).norm();
+        ++internalPores;
+    }
+    double slab = internalPores > 0 ? span / internalPores / 2 : 0;
+
+    double edgeLengths[3] = {network->xEdgeLength, network->yEdgeLength, network->zEdgeLength};
+    VectorXd lower = totalNodes > 0 ? VectorXd(nodesCoordinates.colwise().minCoeff()) : VectorXd::Zero(3);
+    VectorXd upper = totalNodes > 0 ? VectorXd(nodesCoordinates.colwise().maxCoeff()) : VectorXd::Zero(3);
+    domainVolume = 1;
+    for (int a = 0; a < 3; ++a)
+    {
+        domainExtents[a] = upper[a] - lower[a];
+        domainAxes[a] = domainExtents[a] > 2 * slab && domainExtents[a] > 0;
+        domainVolume *= domainAxes[a] ? domainExtents[a] : edgeLengths[a];
+    }
+
+    faceNodes.assign(totalNodes, 0);
+    faceFields = MatrixXd::Zero(totalNodes, 3);
+    for (int i = 0; i < totalNodes; ++i)
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            if (!domainAxes[a])
+                continue;
+            if (nodesCoordinates(i, a) - lower[a] < slab || upper[a] - nodesCoordinates(i, a) < slab)
+                faceNodes[i] = 1;
+            faceFields(i, a) = 1 - (nodesCoordinates(i, a) - lower[a]) / domainExtents[a];
+        }
+    }
+}
+
+std::array<std::array<double, 3>, 3> pnmSolver::solveDirectionalFlows()
+{
+    if (!isSystemPatternValid())
+        buildSystemPattern();
+
+    setSolverThreads();
+    networkArrays &arrays = network->arrays;
+    arrays.gatherFlowAttributes(*network);
+
+    if (!directionalPatternAnalyzed)
+    {
+        classifyFaceNodes();
+        directionalMatrix = conductivityMatrix;
+    }
+
+    auto otherNode = [&arrays](int p, int n) -> int {
+        return arrays.poreNodeIn[p] == n ? arrays.poreNodeOut[p] : arrays.poreNodeIn[p];
+    };
+    auto isInternal = [&arrays](int p) -> bool {
+        return arrays.poreActive[p] && !arrays.poreInlet[p] && !arrays.poreOutlet[p] && arrays.poreNodeIn[p] != -1 && arrays.poreNodeOut[p] != -1;
+    };
+
+    //Positive definite assembly: face rows are identities, their pressures being moved to the free rows right hand sides
+    int totalNodes = network->totalNodes;
+    double *values = directionalMatrix.valuePtr();
+    const int *rowsOffset = directionalMatrix.outerIndexPtr();
+    MatrixXd fields = MatrixXd::Zero(totalNodes, 3);
+    anchoredNodes.assign(totalNodes, 0);
+    int threads = Eigen::nbThreads();
+
+#pragma omp parallel for if (threads > 1) num_threads(threads)
+    for (int row = 0; row < totalNodes; ++row)
+    {
+        std::fill(values + rowsOffset[row], values + rowsOffset[row + 1], 0.0);
+        if (faceNodes[row])
+        {
+            values[diagonalIndices[row]] = 1;
+            fields.row(row) = faceFields.row(row);
+            continue;
+        }
+
+        double conductivity(0);
+        for (int k = arrays.nodePoresOffset[row]; k < arrays.nodePoresOffset[row + 1]; ++k)
+        {
+            int p = arrays.nodePores[k];
+            if (!isInternal(p))
+                continue;
+            int m = otherNode(p, row);
+            double poreConductivity = arrays.poreConductivity[p];
+            conductivity += poreConductivity;
+            if (faceNodes[m])
+            {
+                fields.row(row) += poreConductivity * faceFields.row(m);
+                anchoredNodes[row] = anchoredNodes[row] || poreConductivity > 0;
+            }
+            else
+                values[neighboorsIndices[k]] -= poreConductivity;
+        }
+        values[diagonalIndices[row]] = conductivity;
+    }
+
+    //Free components reaching no face have no defined pressure: they are set to 0 through identity rows
+    componentLabels.assign(totalNodes, -1);
+    for (int start = 0; start < totalNodes; ++start)
+    {
+        if (faceNodes[start] || componentLabels[start] != -1)
+            continue;
+
+        componentNodes.clear();
+        componentNodes.push_back(start);
+        componentLabels[start] = start;
+        bool anchored(false);
+        for (unsigned c = 0; c < componentNodes.size(); ++c)
+        {
+            int n = componentNodes[c];
+            anchored = anchored || anchoredNodes[n];
+            for (int k = arrays.nodePoresOffset[n]; k < arrays.nodePoresOffset[n + 1]; ++k)
+            {
+                int p = arrays.nodePores[k];
+                int m = isInternal(p) ? otherNode(p, n) : -1;
+                if (m != -1 && !faceNodes[m] && values[neighboorsIndices[k]] != 0 && componentLabels[m] == -1)
+                {
+                    componentLabels[m] = start;
+                    componentNodes.push_back(m);
+                }
+            }
+        }
+
+        if (!anchored)
+        {
+            for (int n : componentNodes)
+            {
+                std::fill(values + rowsOffset[n], values + rowsOffset[n + 1], 0.0);
+                values[diagonalIndices[n]] = 1;
+                fields.row(n).setZero();
+            }
+        }
+    }
+
+    if (!directionalPatternAnalyzed)
+    {
+        directionalSolver.analyzePattern(directionalMatrix);
+        directionalPatternAnalyzed = true;
+    }
+    directionalSolver.factorize(directionalMatrix);
+    MatrixXd directionalPressures = directionalSolver.solve(fields);
+
+    //Sum over the pores of their flow times their extent along each axis
+    std::array<std::array<double, 3>, 3> flows = {};
+    for (int p = 0; p < network->totalPores; ++p)
+    {
+        if (!isInternal(p))
+            continue;
+        int nodeIn = arrays.poreNodeIn[p], nodeOut = arrays.poreNodeOut[p];
+        for (int a = 0; a < 3; ++a)
+        {
+            double flow = arrays.poreConductivity[p] * (directionalPressures(nodeIn, a) - directionalPressures(nodeOut, a));
+            for (int b = 0; b < 3; ++b)
+                flows[a][b] += flow * (nodesCoordinates(nodeOut, b) - nodesCoordinates(nodeIn, b));
+        }
+    }
+
+    return flows;
 }
 
 std::pair<double, double> pnmSolver::calculateRelativePermeabilities()
+{
+    return userInput::get().concurrentRelativePermeabilities ? calculateRelativePermeabilitiesConcurrently() : calculateRelativePermeabilitiesSequentially();
+}
+
+bool pnmSolver::findCachedRelativePermeability(phase flowingPhase, relativePermeabilityCache::key &key, double &relativePermeability)
+{
+    //Called once the conductivities of the phase are assigned. A configuration already evaluated, in this simulation or
+    //another one of the process, is not solved again: its elements get their conductivities and active flags, but keep
+    //the pressures and flows of the previous solve, which the stages do not read. A phase flowing through films depends
+    //on their conductivities, which the configuration hash leaves out: it is always solved.
+    key = relativePermeabilityCache::key(0, 0);
+    uint64_t configuration(0);
+    if (!userInput::get().cachedRelativePermeabilities || !pnmOperation::get(network).getConfigurationHash(configuration))
+        return false;
+
+    for (element *e : pnmRange<element>(network))
+        if (e->getActive() && e->getPhaseFlag() != flowingPhase)
+            return false;
+
+    key = relativePermeabilityCache::key(configuration, relativePermeabilityCache::getInputsKey(*network, flowingPhase));
+    if (!relativePermeabilityCache::get().find(key, relativePermeability))
+        return false;
+
+    PROFILE_COUNTER("relativePermeabilityCache.hits", 1);
+    return true;
+}
+
+void pnmSolver::cacheRelativePermeability(const relativePermeabilityCache::key &key, double relativePermeability)
+{
+    if (key.second != 0)
+        relativePermeabilityCache::get().insert(key, relativePermeability);
+}
+
+std::pair<double, double> pnmSolver::calculateRelativePermeabilitiesSequentially()
 {
     double oilRelativePermeability(0), waterRelativePermeability(0);
     pnmOperation::get(network).assignViscosities();
 
+    //Incremental evaluation: each phase keeps its own system, factorization and last solution between the output
+    //points, so that only the pores invaded in between are applied as a low-rank correction (or a warm start)
+    bool incremental = userInput::get().relativePermeabilityUpdates > 0;
+
     //Oil Rel Perm
 
     hkClustering::get(network).clusterOilConductorElements();
@@ -305,8 +1499,13 @@ std::pair<double, double> pnmSolver::calculateRelativePermeabilities()
     if (hkClustering::get(network).isOilSpanningThroughFilms)
     {
         pnmOperation::get(network).assignOilConductivities();
-        double oilFlow = solvePressuresConstantGradient();
-        oilRelativePermeability = oilFlow * userInput::get().oilViscosity / network->normalisedFlow;
+        relativePermeabilityCache::key key;
+        if (!findCachedRelativePermeability(phase::oil, key, oilRelativePermeability))
+        {
+            double oilFlow = incremental ? pnmSolver::get(network, pressureSystem::oil).solvePressuresConstantGradient() : solvePressuresConstantGradient();
+            oilRelativePermeability = oilFlow * userInput::get().oilViscosity / network->normalisedFlow;
+            cacheRelativePermeability(key, oilRelativePermeability);
+        }
     }
 
     //Water Rel Perm
@@ -316,8 +1515,89 @@ std::pair<double, double> pnmSolver::calculateRelativePermeabilities()
     if (hkClustering::get(network).isWaterSpanningThroughFilms)
     {
         pnmOperation::get(network).assignWaterConductivities();
-        double waterFlow = solvePressuresConstantGradient();
+        relativePermeabilityCache::key key;
+        if (!findCachedRelativePermeability(phase::water, key, waterRelativePermeability))
+        {
+            double waterFlow = incremental ? pnmSolver::get(network, pressureSystem::water).solvePressuresConstantGradient() : solvePressuresConstantGradient();
+            waterRelativePermeability = waterFlow * userInput::get().waterViscosity / network->normalisedFlow;
+            cacheRelativePermeability(key, waterRelativePermeability);
+        }
+    }
+
+    return std::make_pair(oilRelativePermeability, waterRelativePermeability);
+}
+
+std::pair<double, double> pnmSolver::calculateRelativePermeabilitiesConcurrently()
+{
+    double oilRelativePermeability(0), waterRelativePermeability(0);
+    pnmOperation::get(network).assignViscosities();
+
+    //The phases conductivities are assigned in turn, then both systems are solved at the same time into their buffers
+    flowBuffers oilBuffers, waterBuffers;
+    relativePermeabilityCache::key oilKey, waterKey;
+
+    hkClustering::get(network).clusterOilConductorElements();
+    bool oilSpanning = hkClustering::get(network).isOilSpanningThroughFilms;
+    bool oilSolved(false);
+    if (oilSpanning)
+    {
+        pnmOperation::get(network).assignOilConductivities();
+        oilSolved = !findCachedRelativePermeability(phase::oil, oilKey, oilRelativePermeability);
+        if (oilSolved)
+            oilBuffers.gather(*network);
+    }
+
+    hkClustering::get(network).clusterWaterConductorElements();
+    bool waterSpanning = hkClustering::get(network).isWaterSpanningThroughFilms;
+    bool waterSolved(false);
+    if (waterSpanning)
+    {
+        pnmOperation::get(network).assignWaterConductivities();
+        waterSolved = !findCachedRelativePermeability(phase::water, waterKey, waterRelativePermeability);
+        if (waterSolved)
+            waterBuffers.gather(*network);
+    }
+
+    pnmSolver &oilSystem = pnmSolver::get(network, pressureSystem::oil);
+    pnmSolver &waterSystem = pnmSolver::get(network, pressureSystem::water);
+    for (pnmSolver *system : {&oilSystem, &waterSystem})
+        if (!system->isSystemPatternValid())
+            system->buildSystemPattern();
+    setSolverThreads();
+
+    double oilFlow(0), waterFlow(0);
+    simulationContext &context = simulationContext::current();
+#pragma omp parallel sections num_threads(2)
+    {
+#pragma omp section
+        {
+            simulationContext::scope contextScope(context);
+            if (oilSolved)
+                oilFlow = oilSystem.solvePressuresConstantGradient(oilBuffers);
+        }
+#pragma omp section
+        {
+            simulationContext::scope contextScope(context);
+            if (waterSolved)
+                waterFlow = waterSystem.solvePressuresConstantGradient(waterBuffers);
+        }
+    }
+
+    //The elements are left with the last phase solved, as by the sequential evaluation
+    if (waterSolved)
+        waterBuffers.scatter(*network);
+    else if (oilSolved)
+        oilBuffers.scatter(*network);
+
+    if (oilSolved)
+    {
+        oilRelativePermeability = oilFlow * userInput::get().oilViscosity / network->normalisedFlow;
+        cacheRelativePermeability(oilKey, oilRelativePermeability);
+    }
+    if (waterSolved)
+    {
         waterRelativePermeability = waterFlow * userInput::get().waterViscosity / network->normalisedFlow;
+        cacheRelativePermeability(waterKey, waterRelativePermeability);
     }
 
     return std::make_pair(oilRelativePermeability, waterRelativePermeability);
@@ -8,35 +8,198 @@
 #ifndef PNMSOLVER_H
 #define PNMSOLVER_H
 
+#include "domainDecomposition.h"
+#include "relativePermeabilityCache.h"
+
+#include <libs/Eigen/Sparse>
+#include <libs/Eigen/SparseCholesky>
+#include <libs/Eigen/IterativeLinearSolvers>
+
+#include <array>
+#include <atomic>
 #include <memory>
+#include <vector>
 
 namespace PNM
 {
 
 class networkModel;
 
+// Pressure systems kept by each context: the flow system, and the oil and water systems of the relative
+// permeabilities, kept apart when their incremental updates are enabled
+enum class pressureSystem
+{
+    flow,
+    oil,
+    water
+};
+
+// Caller-owned inputs and results of a pressure solve, in the networkArrays order: the pores attributes the system is
+// assembled from, and the nodes pressures and pores flows it yields. Solving into buffers leaves the network elements
+// untouched, so that independent solves can run in parallel threads.
+struct flowBuffers
+{
+    void gather(const networkModel &); // pores active flags, conductivities and capillary pressures of the elements
+    void scatter(networkModel &) const; // nodes pressures and pores flows to the elements
+
+    std::vector<char> poreActive;
+    std::vector<double> poreConductivity;
+    std::vector<double> poreCapillaryPressure;
+    std::vector<double> nodePressure;
+    std::vector<double> poreFlow;
+};
+
 class pnmSolver
 {
   public:
-    static pnmSolver &get(std::shared_ptr<networkModel>);
+    static pnmSolver &get(std::shared_ptr<networkModel>, pressureSystem = pressureSystem::flow);
     double solvePressuresConstantGradient(double pressureIn = 1, double pressureOut = 0, bool defaultSolver = false);
     double solvePressuresConstantFlowRate();
+    double solvePressuresConstantGradient(flowBuffers &, double pressureIn = 1, double pressureOut = 0);
     double updateFlowsConstantGradient(double pressureIn = 1, double pressureOut = 0);
     double updateFlowsConstantFlowRate();
     double getDeltaP();
     void calculatePermeabilityAndPorosity();
     std::pair<double, double> calculateRelativePermeabilities();
+    void calculatePermeabilityTensor();
+    std::array<std::pair<double, double>, 3> calculateDirectionalRelativePermeabilities();
+    void resetSystemPattern();
+    int getSolverIterations() const;
+    double getSolverError() const;
+
+    // Eigen thread count fixed for concurrent simulations, e.g. the cases of a sweep: the solves stop setting it from
+    // their parameters (0: each calling thread's OpenMP threads, -1: back to the parameters)
+    static void setSharedThreads(int);
 
   protected:
-    pnmSolver() {}
+    pnmSolver() : system(pressureSystem::flow), patternNetwork(0), patternNodes(0), patternPores(0), pressuresSolved(false), choleskyPatternAnalyzed(false), choleskyFactorized(false), preconditionerPatternAnalyzed(false), reducedPatternAnalyzed(false), decompositionPatternAnalyzed(false), mixedPatternAnalyzed(false), directionalPatternAnalyzed(false), domainVolume(0), solverIterations(0), solverError(0) {}
     ~pnmSolver() {}
     pnmSolver(const pnmSolver &) = delete;
     pnmSolver(pnmSolver &&) = delete;
     auto operator=(const pnmSolver &) -> pnmSolver & = delete;
     auto operator=(pnmSolver &&) -> pnmSolver & = delete;
+    friend class simulationContext;
+    bool isSystemPatternValid() const;
+    void buildSystemPattern();
+    void assembleConstantGradientSystem(double pressureIn, double pressureOut, const std::vector<char> &poresActive, const std::vector<double> &poresConductivity, const std::vector<double> &poresCapillaryPressure);
+    void assembleConstantFlowRateSystem();
+    void solveSystem(bool defaultSolver);
+    void solveReducedSystem(bool defaultSolver, Eigen::VectorXd &guess);
+    void solveDecomposedSystem(Eigen::VectorXd &guess);
+    void solveMixedPrecisionSystem();
+    void solveCholeskySystem();
+    void selectReducedNodes();
+    void buildReducedSystem();
+    void condenseReducedSystem();
+    void recoverCondensedNodes();
+    void updateNodesPressures();
+    double getOutletFlow() const;
+    void updatePoreCoefficients(bool inletPoresCoefficients, const std::vector<char> &poresActive, const std::vector<double> &poresConductivity);
+    std::pair<double, double> calculateRelativePermeabilitiesSequentially();
+    std::pair<double, double> calculateRelativePermeabilitiesConcurrently();
+    bool findCachedRelativePermeability(phase, relativePermeabilityCache::key &, double &);
+    void cacheRelativePermeability(const relativePermeabilityCache::key &, double);
+    bool solveLowRankUpdate();
+    void addUpdateTerm(int);
+    template <typename F>
+    void forEachTermNode(int, F) const;
+    void clearLowRankUpdate();
+    void setSolverThreads();
+    void recordMemoryUsage();
+    void classifyFaceNodes();
+    std::array<std::array<double, 3>, 3> solveDirectionalFlows();
+
+    using rowMajorMatrix = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+
+    static std::atomic<int> sharedThreads;
 
     std::shared_ptr<networkModel> network;
-    static pnmSolver instance;
+    pressureSystem system;
+
+    // Sparsity pattern of the conductivity matrix, built once per network topology
+    Eigen::SparseMatrix<double> conductivityMatrix;
+    Eigen::VectorXd b;
+    Eigen::VectorXd pressures;
+    std::vector<int> diagonalIndices;  // position of each row diagonal in the matrix values
+    std::vector<int> neighboorsIndices; // position of each neighboor coefficient in the matrix values, by node-to-pore adjacency slot (-1 for boundary pores)
+    std::vector<double> boundaryConductivities; // conductivity of the fixed pressure boundary pores of each row, as last assembled
+    const networkModel *patternNetwork;
+    int patternNodes;
+    int patternPores;
+    bool pressuresSolved; // pressures hold a solution of the current pattern
+
+    // Direct solver kept alive to reuse the ordering and symbolic analysis of the pattern
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> choleskySolver;
+    bool choleskyPatternAnalyzed;
+    bool choleskyFactorized;
+
+    // Pores whose contribution to the matrix changed since the last factorization are solved as a low-rank
+    // correction of that factorization (Woodbury identity) instead of a new factorization
+    std::vector<double> poreCoefficients;       // contribution of each pore to the assembled matrix
+    std::vector<double> factorizedCoefficients; // contribution of each pore to the factorized matrix
+    std::vector<int> updatedTerms;              // terms of the correction: pore p as p, node n as totalPores + n
+    std::vector<int> updatePositions;           // position of each term in updatedTerms (-1 if absent)
+    std::vector<Eigen::VectorXd> updateColumns; // factorized matrix inverse applied to each term vector
+
+    // Warm-started iterative solver, preconditioned by an incomplete Cholesky factorization
+    Eigen::ConjugateGradient<rowMajorMatrix, Eigen::Lower | Eigen::Upper, Eigen::IncompleteCholesky<double>> preconditionedSolver;
+    bool preconditionerPatternAnalyzed;
+
+    // Compacted system over the nodes of the components connected to a fixed pressure boundary and carrying flow.
+    // The other nodes are not solved for: they take the uniform pressure of their component (0 when it is isolated)
+    std::vector<int> reducedRows;  // row of each node in the compacted system, -1 when its pressure is set directly
+    std::vector<int> reducedNodes; // node of each row of the compacted system, in the nodes order
+    std::vector<int> componentLabels;
+    std::vector<int> componentNodes;
+    std::vector<int> reducedPattern; // columns offsets and rows of the last analyzed compacted matrix
+    Eigen::SparseMatrix<double> reducedMatrix;
+    Eigen::VectorXd reducedB;
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> reducedCholeskySolver;
+    Eigen::ConjugateGradient<rowMajorMatrix, Eigen::Lower | Eigen::Upper, Eigen::IncompleteCholesky<double>> reducedPreconditionedSolver;
+    bool reducedPatternAnalyzed;
+
+    // Series chains and dead-end branches condensed out of the compacted system (condensedPressureSystem). Rows with at
+    // most two neighboors and no fixed pressure boundary are eliminated one after the other: their neighboors take the
+    // series conductance between them, and their right hand sides (capillary pressures, injected flows). Their pressures
+    // are interpolated back from their neighboors, in the reverse order, after the solve
+    struct condensedNode
+    {
+        int node;
+        int neighboors[2]; // -1 when unused
+        double conductivities[2];
+        double diagonal;
+        double b;
+    };
+    std::vector<condensedNode> condensedNodes; // in the elimination order
+
+    // Conjugate gradient preconditioned by the independent solves of compact subdomains (block Jacobi), the
+    // couplings through the halo pores between the subdomains being only resolved by the outer iterations
+    domainDecomposition decomposition;
+    bool decompositionPatternAnalyzed;
+
+    // Single precision factorization of the symmetrically scaled system (unit diagonal), refined in double precision
+    // until the relative residual target: the factor takes half the memory and bandwidth of the double one
+    Eigen::SparseMatrix<float> mixedMatrix;
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<float>> mixedSolver;
+    Eigen::VectorXd mixedScaling;
+    bool mixedPatternAnalyzed;
+
+    // Linear pressure conditions on the six faces: every face node is fixed, so that the three axes share one matrix
+    // over the flow system pattern, factorized once per conductivities set and solved for the three fields at once
+    Eigen::SparseMatrix<double> directionalMatrix;
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> directionalSolver;
+    bool directionalPatternAnalyzed;
+    std::vector<char> faceNodes;
+    std::vector<char> anchoredNodes;  // free nodes with an open pore to a face node
+    Eigen::MatrixXd nodesCoordinates; // one row per node
+    Eigen::MatrixXd faceFields;       // pressure of each face node for a unit pressure drop along each axis
+    std::array<double, 3> domainExtents;
+    std::array<bool, 3> domainAxes; // axes along which the network has distinct faces
+    double domainVolume;
+
+    // Statistics of the last iterative solve
+    int solverIterations;
+    double solverError;
 };
 
 } // namespace PNM
@@ -0,0 +1,79 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "relativePermeabilityCache.h"
+#include "network/networkmodel.h"
+#include "network/element.h"
+#include "misc/userInput.h"
+
+#include <cstring>
+
+namespace PNM
+{
+
+namespace
+{
+//splitmix64 finalizer: every input bit changes half of the output bits
+uint64_t mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+uint64_t bitsOf(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+} // namespace
+
+relativePermeabilityCache &relativePermeabilityCache::get()
+{
+    static relativePermeabilityCache instance;
+    return instance;
+}
+
+uint64_t relativePermeabilityCache::getElementKey(const element *e)
+{
+    //Phase, wettability and films flags: the state read by the clusterings and the conductivities assignments
+    uint64_t state = uint64_t(e->getPhaseFlag()) | uint64_t(e->getWettabilityFlag()) << 2 | uint64_t(e->getOilLayerActivated()) << 4 |
+                     uint64_t(e->getWaterCornerActivated()) << 5 | uint64_t(e->getOilConductor()) << 6 | uint64_t(e->getWaterConductor()) << 7;
+
+    return mix(uint64_t(e->getIndex()) << 8 | state);
+}
+
+uint64_t relativePermeabilityCache::getInputsKey(const networkModel &network, phase flowingPhase)
+{
+    //The network is identified by its size and its single-phase flow, which depends on all its geometry
+    uint64_t key = mix(uint64_t(network.totalNodes) << 32 | uint32_t(network.totalPores));
+    for (double input : {network.normalisedFlow, userInput::get().oilViscosity, userInput::get().waterViscosity})
+        key = mix(key ^ bitsOf(input));
+    return mix(key ^ uint64_t(flowingPhase));
+}
+
+bool relativePermeabilityCache::find(const key &k, double &relativePermeability)
+{
+    std::lock_guard<std::mutex> lock(entriesMutex);
+    auto it = entries.find(k);
+    if (it == entries.end())
+        return false;
+    relativePermeability = it->second;
+    return true;
+}
+
+void relativePermeabilityCache::insert(const key &k, double relativePermeability)
+{
+    std::lock_guard<std::mutex> lock(entriesMutex);
+    if (entries.size() >= maxEntries)
+        entries.clear();
+    entries[k] = relativePermeability;
+}
+
+} // namespace PNM
@@ -0,0 +1,56 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef RELATIVEPERMEABILITYCACHE_H
+#define RELATIVEPERMEABILITYCACHE_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace PNM
+{
+
+class element;
+struct networkModel;
+enum class phase;
+
+// Relative permeabilities already evaluated by the simulations of the process, shared by the steady-state cycles and
+// the sweep cases. A phases configuration is hashed by XOR of one key per element (Zobrist hashing), a function of the
+// element index and of its phase, wettability, layers and conductors flags: pnmOperation keeps the hash up to date on
+// each element update. Entries are looked up by that hash and by the flowing phase and the network and fluids inputs of
+// the evaluation. The film conductivities change with Pc and are not hashed: a phase flowing through films is solved
+// with the current films and is not cached.
+class relativePermeabilityCache
+{
+  public:
+    using key = std::pair<uint64_t, uint64_t>; // configuration, inputs
+
+    static relativePermeabilityCache &get();
+    static uint64_t getElementKey(const element *);
+    static uint64_t getInputsKey(const networkModel &, phase);
+    bool find(const key &, double &);
+    void insert(const key &, double);
+
+  protected:
+    relativePermeabilityCache() {}
+    ~relativePermeabilityCache() {}
+    relativePermeabilityCache(const relativePermeabilityCache &) = delete;
+    relativePermeabilityCache(relativePermeabilityCache &&) = delete;
+    auto operator=(const relativePermeabilityCache &) -> relativePermeabilityCache & = delete;
+    auto operator=(relativePermeabilityCache &&) -> relativePermeabilityCache & = delete;
+
+    static const size_t maxEntries = 1 << 16; // cleared when full, the recurrent configurations coming back quickly
+
+    std::mutex entriesMutex;
+    std::map<key, double> entries; // relative permeability of the flowing phase
+};
+
+} // namespace PNM
+
+#endif // RELATIVEPERMEABILITYCACHE_H
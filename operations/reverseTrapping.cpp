@@ -0,0 +1,123 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "reverseTrapping.h"
+#include "network/networkmodel.h"
+#include "network/iterator.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace PNM
+{
+
+void reverseTrapping::label(std::shared_ptr<networkModel> network, const std::vector<int> &invasionRounds, const std::vector<char> &conductorsOnceInvaded)
+{
+    int totalElements = network->totalNodes + network->totalPores;
+    outlet = totalElements;
+
+    parents.resize(totalElements + 1);
+    for (int i = 0; i <= totalElements; ++i)
+        parents[i] = i;
+    members.assign(totalElements + 1, std::vector<int>());
+    present.assign(totalElements + 1, 0);
+    present[outlet] = 1;
+    trapped.assign(totalElements, 0);
+    disconnectionRounds.assign(totalElements, -2);
+
+    std::vector<char> outletElements(totalElements, 0);
+    std::vector<std::vector<int>> neighboors(totalElements);
+    for (element *e : pnmRange<element>(network))
+    {
+        outletElements[e->getIndex()] = e->getOutlet();
+        for (element *n : e->getNeighboors())
+            neighboors[e->getIndex()].push_back(n->getIndex());
+    }
+
+    //Rounds buckets
+    int lastRound = invasionRounds.empty() ? -1 : *std::max_element(invasionRounds.begin(), invasionRounds.end());
+    std::vector<int> roundsOffsets(lastRound + 2, 0);
+    for (int i = 0; i < totalElements; ++i)
+        if (invasionRounds[i] != -1)
+            roundsOffsets[invasionRounds[i] + 1]++;
+    for (int r = 0; r <= lastRound; ++r)
+        roundsOffsets[r + 1] += roundsOffsets[r];
+    std::vector<int> roundsElements(roundsOffsets.back());
+    std::vector<int> fill(roundsOffsets.begin(), roundsOffsets.end() - 1);
+    for (int i = 0; i < totalElements; ++i)
+        if (invasionRounds[i] != -1)
+            roundsElements[fill[invasionRounds[i]]++] = i;
+
+    auto connect = [&](int i, int round) {
+        present[i] = 1;
+        members[i].push_back(i);
+        if (outletElements[i])
+            unite(i, outlet, round);
+        for (int n : neighboors[i])
+            if (present[n])
+                unite(i, n, round);
+    };
+
+    //Defending elements at the end of the invasion: never invaded, or conductors once invaded
+    for (int i = 0; i < totalElements; ++i)
+        if (invasionRounds[i] == -1 || conductorsOnceInvaded[i])
+            connect(i, std::numeric_limits<int>::max());
+
+    //Undoing the round r restores the defending clusters as they were before it, after the round r - 1
+    for (int r = lastRound; r >= 0; --r)
+    {
+        for (int k = roundsOffsets[r]; k < roundsOffsets[r + 1]; ++k)
+            if (!present[roundsElements[k]])
+                connect(roundsElements[k], r - 1);
+
+        for (int k = roundsOffsets[r]; k < roundsOffsets[r + 1]; ++k)
+            trapped[roundsElements[k]] = find(roundsElements[k]) != outlet;
+    }
+
+    members.clear();
+    members.shrink_to_fit();
+}
+
+int reverseTrapping::find(int i)
+{
+    while (parents[i] != i)
+    {
+        parents[i] = parents[parents[i]];
+        i = parents[i];
+    }
+    return i;
+}
+
+void reverseTrapping::unite(int i, int j, int round)
+{
+    i = find(i);
+    j = find(j);
+    if (i == j)
+        return;
+
+    //The outlet stays the root of its cluster: the other cluster gets connected to the outlet from this round backwards
+    if (i == outlet || j == outlet)
+    {
+        int other = i == outlet ? j : i;
+        for (int k : members[other])
+            disconnectionRounds[k] = round;
+        members[other].clear();
+        members[other].shrink_to_fit();
+        parents[other] = outlet;
+        return;
+    }
+
+    //Smaller members lists are moved into the larger ones
+    if (members[i].size() < members[j].size())
+        std::swap(i, j);
+    members[i].insert(members[i].end(), members[j].begin(), members[j].end());
+    members[j].clear();
+    members[j].shrink_to_fit();
+    parents[j] = i;
+}
+
+} // namespace PNM
@@ -0,0 +1,48 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef REVERSETRAPPING_H
+#define REVERSETRAPPING_H
+
+#include <memory>
+#include <vector>
+
+namespace PNM
+{
+
+struct networkModel;
+
+// Trapping of the defending phase of a quasi-static invasion, labelled in one union-find pass once the invasion order
+// is known. The invasion is run first without trapping, which gives each element the round it is invaded at (-1 if
+// never); the rounds are then undone in reverse order, the defending elements being added back to the union-find.
+// An element is trapped if its defending cluster, before its round, is not connected to the outlet: since the
+// defending clusters only shrink, the elements reached through trapped ones are trapped as well, and the trapped
+// elements are only to be skipped by the invasion. Elements keeping a defending conductor once invaded (corners)
+// belong to the defending clusters at all times.
+class reverseTrapping
+{
+  public:
+    void label(std::shared_ptr<networkModel>, const std::vector<int> &invasionRounds, const std::vector<char> &conductorsOnceInvaded);
+    bool isTrapped(int index) const { return trapped[index] != 0; }
+    // The defending conductor of the element is connected to the outlet once the rounds up to this one are done
+    bool isConnected(int index, int round) const { return disconnectionRounds[index] >= round; }
+
+  protected:
+    int find(int);
+    void unite(int, int, int);
+
+    std::vector<int> parents; // union-find over the elements indices, the last entry standing for the outlet
+    std::vector<std::vector<int>> members; // elements of each root not yet connected to the outlet
+    std::vector<char> present;
+    std::vector<char> trapped;
+    std::vector<int> disconnectionRounds; // last round after which the element is connected to the outlet
+    int outlet;
+};
+
+} // namespace PNM
+
+#endif // REVERSETRAPPING_H
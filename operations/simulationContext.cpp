@@ -0,0 +1,39 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "simulationContext.h"
+
+namespace PNM
+{
+
+thread_local simulationContext *simulationContext::installed = nullptr;
+
+simulationContext::simulationContext() : parameters(current().parameters)
+{
+}
+
+simulationContext::simulationContext(defaultTag)
+{
+}
+
+simulationContext &simulationContext::current()
+{
+    static simulationContext defaultContext{defaultTag()};
+    return installed ? *installed : defaultContext;
+}
+
+simulationContext::scope::scope(simulationContext &context) : previous(installed)
+{
+    installed = &context;
+}
+
+simulationContext::scope::~scope()
+{
+    installed = previous;
+}
+
+} // namespace PNM
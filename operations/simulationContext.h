@@ -0,0 +1,72 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIMULATIONCONTEXT_H
+#define SIMULATIONCONTEXT_H
+
+#include "pnmSolver.h"
+#include "hkClustering.h"
+#include "pnmOperation.h"
+#include "misc/userInput.h"
+
+namespace PNM
+{
+
+// State behind the pnmSolver, hkClustering, pnmOperation and userInput getters: the solvers and clustering buffers and
+// a parameters set. The getters return the members of the context installed on the calling thread by a scope, or of
+// the default context when none is installed, so that independent simulations can run in parallel threads, each one
+// in its own context. Contexts are thread-local: OpenMP regions read the parameters and get the operations before
+// the parallel loops.
+class simulationContext
+{
+  public:
+    simulationContext();
+    ~simulationContext() {}
+    simulationContext(const simulationContext &) = delete;
+    simulationContext(simulationContext &&) = delete;
+    auto operator=(const simulationContext &) -> simulationContext & = delete;
+    auto operator=(simulationContext &&) -> simulationContext & = delete;
+
+    static simulationContext &current();
+
+    // Installs a context on the calling thread for the scope lifetime
+    class scope
+    {
+      public:
+        explicit scope(simulationContext &);
+        ~scope();
+        scope(const scope &) = delete;
+        auto operator=(const scope &) -> scope & = delete;
+
+      protected:
+        simulationContext *previous;
+    };
+
+    userInput parameters; // copied from the current context parameters on construction
+
+  protected:
+    struct defaultTag
+    {
+    };
+    explicit simulationContext(defaultTag);
+
+    friend class pnmSolver;
+    friend class hkClustering;
+    friend class pnmOperation;
+
+    pnmSolver solver;
+    pnmSolver oilSolver;
+    pnmSolver waterSolver;
+    hkClustering clustering;
+    pnmOperation operation;
+
+    static thread_local simulationContext *installed;
+};
+
+} // namespace PNM
+
+#endif // SIMULATIONCONTEXT_H
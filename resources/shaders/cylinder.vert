@@ -15,16 +15,19 @@ layout(location = 0) in vec3  cylinderPosition;
 layout(location = 1) in float cylinderExt;
 layout(location = 2) in vec3  cylinderDirection;
 layout(location = 3) in float cylinderRadius;
-layout(location = 4) in vec2  cylinderColor;
+layout(location = 4) in vec3  cylinderColor; // color key, concentration, visibility flags
 
 out vec3 cylinder_color_in;
 out vec3 cylinder_direction_in;
 out float cylinder_radius_in;
 out float cylinder_ext_in;
+out float cylinder_visible_in;
 
 uniform vec3 oilColor;
 uniform vec3 waterColor;
 uniform vec3 tracerColor;
+uniform vec3 cutPlanes;
+uniform int hiddenFlags;
 
 const float epsilon = 0.01;
 
@@ -39,5 +42,10 @@ void main()
                      :abs(cylinderColor.x - 3) < epsilon ? vec3(0.0f, 1.0f, 0.0f)
                      :vec3(0.2f, 0.2f, 1.0f);
 
+  // cut planes are tested against the inlet node of the throat
+  vec3 nodeIn = cylinderPosition + 0.5 * cylinderDirection;
+  bool hidden = (int(cylinderColor.z + 0.5) & hiddenFlags) != 0 || any(greaterThan(nodeIn, cutPlanes));
+  cylinder_visible_in = hidden ? 0.0 : 1.0;
+
   gl_Position = vec4(cylinderPosition,1.0);
 }
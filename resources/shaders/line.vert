@@ -10,13 +10,16 @@
 #version 330 core
 
 layout(location = 0) in vec3 pos;
-layout(location = 1) in vec2 color;
+layout(location = 1) in vec3 color;     // color key, concentration, visibility flags
+layout(location = 2) in vec3 centerPos; // throat center
 
 uniform mat4 view;
 uniform mat4 projection;
 uniform vec3 oilColor;
 uniform vec3 waterColor;
 uniform vec3 tracerColor;
+uniform vec3 cutPlanes;
+uniform int hiddenFlags;
 
 const float epsilon = 0.01;
 
@@ -27,4 +30,8 @@ void main()
     o_color = abs(color.x) < epsilon ? oilColor + (tracerColor - oilColor) * color.y
                                      : waterColor+ (tracerColor - waterColor) * color.y;;
     gl_Position = projection  * view * vec4(pos, 1.0);
+
+    //Filtered lines are moved out of the clip volume
+    if ((int(color.z + 0.5) & hiddenFlags) != 0 || any(greaterThan(centerPos, cutPlanes)))
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
 }
@@ -11,12 +11,14 @@
 
 layout(location = 0) in vec3 spherePos;
 layout(location = 1) in float sphereRadius;
-layout(location = 2) in vec2  sphereColor;
+layout(location = 2) in vec3  sphereColor; // color key, concentration, visibility flags
 
 uniform mat4 view;
 uniform vec3 oilColor;
 uniform vec3 waterColor;
 uniform vec3 tracerColor;
+uniform vec3 cutPlanes;
+uniform int hiddenFlags;
 
 const float epsilon = 0.01;
 
@@ -25,6 +27,7 @@ out VertexData
     vec3 cameraSpherePos;
     float sphereRadius;
     vec3 sphereColor;
+    float visible;
 } outData;
 
 void main()
@@ -33,4 +36,6 @@ void main()
     outData.sphereRadius = sphereRadius;
     outData.sphereColor = abs(sphereColor.x) < epsilon ? oilColor + (tracerColor - oilColor) * sphereColor.y
                                              : waterColor+ (tracerColor - waterColor) * sphereColor.y;
+    bool hidden = (int(sphereColor.z + 0.5) & hiddenFlags) != 0 || any(greaterThan(spherePos, cutPlanes));
+    outData.visible = hidden ? 0.0 : 1.0;
 }
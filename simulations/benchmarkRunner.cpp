@@ -0,0 +1,198 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "benchmarkRunner.h"
+#include "simulation.h"
+#include "builders/networkbuilder.h"
+#include "builders/networkCache.h"
+#include "network/networkmodel.h"
+#include "operations/simulationContext.h"
+#include "operations/pnmSolver.h"
+#include "misc/scopedtimer.h"
+#include "misc/tools.h"
+
+#include <libs/boost/property_tree/ptree.hpp>
+#include <libs/boost/property_tree/ini_parser.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace PNM
+{
+
+void benchmarkRunner::load(const std::string &path)
+{
+    boost::property_tree::ptree pt;
+    boost::property_tree::ini_parser::read_ini(path, pt);
+
+    timeSteps = pt.get<int>("Benchmark.timeSteps", 100);
+    tolerance = pt.get<double>("Benchmark.tolerance", 0.1);
+    baselinePath = pt.get<std::string>("Benchmark.baseline", "");
+
+    overrides.clear();
+    auto parameters = pt.get_child_optional("Parameters");
+    if (parameters)
+        for (auto &value : *parameters)
+            overrides.push_back({value.first, value.second.data()});
+}
+
+bool benchmarkRunner::run()
+{
+    userInput::get().loadNetworkData(overrides);
+    userInput::get().loadSimulationData(overrides);
+    tools::createRequiredFolders();
+    tools::createFolder("Results/Benchmark");
+    tools::createFolder("Network_State/Benchmark");
+    measures.clear();
+
+    runScenario("import", {}, [this]() {
+        auto builder = networkBuilder::createBuilder();
+        networkSnapshot = networkCache::serialize(builder->build());
+    });
+
+    runScenario("permeability", {}, [this]() {
+        auto network = networkCache::deserialize(networkSnapshot);
+        pnmSolver::get(network).calculatePermeabilityAndPorosity();
+    });
+
+    parameterOverrides noCycle = {{"FluidInjection_Cycles.twoPhaseSS", "false"},
+                                  {"FluidInjection_Cycles.drainageUSS", "false"},
+                                  {"FluidInjection_Cycles.tracerFlow", "false"},
+                                  {"FluidInjection_Cycles.templateFlow", "false"}};
+
+    parameterOverrides drainage = noCycle;
+    drainage.insert(drainage.end(), {{"FluidInjection_Cycles.twoPhaseSS", "true"},
+                                     {"FluidInjection_Cycles.primaryDrainageSimulation", "true"},
+                                     {"FluidInjection_Cycles.primaryImbibitionSimulation", "false"},
+                                     {"FluidInjection_Cycles.secondaryDrainageSimulation", "false"},
+                                     {"FluidInjection_Cycles.secondaryImbibitionSimulation", "false"},
+                                     {"FluidInjection_Cycles.tertiaryDrainageSimulation", "false"},
+                                     {"FluidInjection_SS.relativePermeabilitiesCalculation", "true"}});
+    runSimulation("primaryDrainage", drainage);
+
+    parameterOverrides unsteadyState = noCycle;
+    unsteadyState.insert(unsteadyState.end(), {{"FluidInjection_Cycles.drainageUSS", "true"},
+                                               {"FluidInjection_USS.maxTimeSteps", std::to_string(timeSteps)}});
+    runSimulation("unsteadyState", unsteadyState);
+
+    parameterOverrides tracer = noCycle;
+    tracer.insert(tracer.end(), {{"FluidInjection_Cycles.tracerFlow", "true"},
+                                 {"FluidInjection_USS.maxTimeSteps", std::to_string(timeSteps)}});
+    runSimulation("tracerFlow", tracer);
+
+    std::ofstream file("Results/Benchmark/benchmark.txt");
+    file << "Scenario\tMetric\tValue" << std::endl;
+    for (const measure &m : measures)
+        file << m.scenario << "\t" << m.metric << "\t" << m.value << std::endl;
+    file.close();
+
+    return baselinePath.empty() || checkBaseline();
+}
+
+void benchmarkRunner::runScenario(const std::string &name, const parameterOverrides &scenarioOverrides, const std::function<void()> &scenario)
+{
+    std::cout << "########## Benchmark: " << name << " ##########" << std::endl;
+
+    auto context = std::make_shared<simulationContext>();
+    simulationContext::scope contextScope(*context);
+
+    parameterOverrides allOverrides = overrides;
+    allOverrides.insert(allOverrides.end(), scenarioOverrides.begin(), scenarioOverrides.end());
+    userInput::get().loadNetworkData(allOverrides);
+    userInput::get().loadSimulationData(allOverrides);
+    userInput::get().resultsFolder = "Results/Benchmark/" + name;
+    userInput::get().networkStateFolder = "Network_State/Benchmark/" + name;
+    tools::createFolder(userInput::get().resultsFolder);
+    tools::createFolder(userInput::get().networkStateFolder);
+
+    ScopedTimer::reset();
+    auto start = std::chrono::steady_clock::now();
+    scenario();
+    double wallTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    measures.push_back({name, "wallTime(ms)", wallTime});
+    measures.push_back({name, "peakMemory(MB)", getPeakMemory()});
+    for (auto &scope : ScopedTimer::getProfileData())
+        measures.push_back({name, "scope:" + scope.first + "(ms)", scope.second.first / 1e6});
+}
+
+void benchmarkRunner::runSimulation(const std::string &name, const parameterOverrides &scenarioOverrides)
+{
+    runScenario(name, scenarioOverrides, [this]() {
+        auto network = networkCache::deserialize(networkSnapshot);
+        auto scenarioSimulation = simulation::createSimulation();
+        scenarioSimulation->setNetwork(network);
+        scenarioSimulation->execute();
+    });
+}
+
+bool benchmarkRunner::checkBaseline() const
+{
+    std::ifstream file(baselinePath.c_str());
+    if (!file)
+    {
+        std::cerr << "Benchmark baseline " << baselinePath << " not found." << std::endl;
+        return false;
+    }
+
+    std::map<std::string, double> baseline;
+    std::string line;
+    std::getline(file, line);
+    while (std::getline(file, line))
+    {
+        std::istringstream row(line);
+        std::string scenario, metric;
+        double value;
+        if (std::getline(row, scenario, '\t') && std::getline(row, metric, '\t') && row >> value)
+            baseline[scenario + "\t" + metric] = value;
+    }
+
+    //Only the scenarios wall times are compared: the scopes detail where a regression comes from
+    bool passed = true;
+    for (const measure &m : measures)
+    {
+        if (m.metric != "wallTime(ms)")
+            continue;
+
+        auto reference = baseline.find(m.scenario + "\t" + m.metric);
+        if (reference == baseline.end())
+            continue;
+
+        bool regressed = m.value > reference->second * (1 + tolerance);
+        std::cout << "Benchmark " << m.scenario << ": " << m.value << " ms / baseline " << reference->second << " ms"
+                  << (regressed ? " REGRESSION" : "") << std::endl;
+        passed = passed && !regressed;
+    }
+    return passed;
+}
+
+double benchmarkRunner::getPeakMemory()
+{
+    //Peak resident memory of the process so far
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize / 1048576.;
+    return 0;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.;
+#endif
+}
+
+} // namespace PNM
@@ -0,0 +1,65 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef BENCHMARKRUNNER_H
+#define BENCHMARKRUNNER_H
+
+#include "misc/userInput.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace PNM
+{
+
+class networkModel;
+
+// Fixed benchmark scenarios: network import, permeability calculation, a primary drainage with relative
+// permeabilities, and a given number of USS and tracer time steps, each one on a copy of the imported network.
+// The benchmark file (an ini file) holds a [Benchmark] section (timeSteps, baseline, tolerance) and an optional
+// [Parameters] section of "Section.key=value" replacements of Input_Data/Parameters.txt values, used to select the
+// network (a bundled one in prerequisites/ for instance).
+// Wall times, peak memory and profiled scopes are written to Results/Benchmark/benchmark.txt; if a baseline file
+// (a previous benchmark.txt) is given, the wall times more than tolerance slower than the baseline are reported.
+class benchmarkRunner
+{
+  public:
+    benchmarkRunner() : timeSteps(100), tolerance(0.1) {}
+    ~benchmarkRunner() {}
+    benchmarkRunner(const benchmarkRunner &) = delete;
+    benchmarkRunner(benchmarkRunner &&) = delete;
+    auto operator=(const benchmarkRunner &) -> benchmarkRunner & = delete;
+    auto operator=(benchmarkRunner &&) -> benchmarkRunner & = delete;
+    void load(const std::string &path = "Input_Data/Benchmark.txt");
+    bool run(); // false if a scenario regressed
+
+  protected:
+    struct measure
+    {
+        std::string scenario;
+        std::string metric;
+        double value;
+    };
+
+    void runScenario(const std::string &name, const parameterOverrides &, const std::function<void()> &);
+    void runSimulation(const std::string &name, const parameterOverrides &);
+    bool checkBaseline() const;
+    static double getPeakMemory();
+
+    int timeSteps;
+    double tolerance;
+    std::string baselinePath;
+    parameterOverrides overrides;
+    std::vector<char> networkSnapshot;
+    std::vector<measure> measures;
+};
+
+} // namespace PNM
+
+#endif // BENCHMARKRUNNER_H
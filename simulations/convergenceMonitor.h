@@ -0,0 +1,59 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef CONVERGENCEMONITOR_H
+#define CONVERGENCEMONITOR_H
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace PNM
+{
+
+// Plateau detection on the curves of a flow simulation, sampled at its output intervals: the curves have converged
+// once their slopes per injected pore volume stayed under the tolerance for the required number of consecutive
+// intervals. A tolerance of 0 disables the detection.
+class convergenceMonitor
+{
+  public:
+    convergenceMonitor() : tolerance(0), intervals(0), flatIntervals(0), lastPVs(0) {}
+
+    void reset(double _tolerance, int _intervals)
+    {
+        tolerance = _tolerance;
+        intervals = _intervals;
+        flatIntervals = 0;
+        lastValues.clear();
+    }
+
+    bool update(double injectedPVs, const std::vector<double> &values)
+    {
+        if (tolerance <= 0)
+            return false;
+
+        bool flat = lastValues.size() == values.size() && injectedPVs > lastPVs;
+        for (unsigned i = 0; flat && i < values.size(); ++i)
+            flat = std::abs(values[i] - lastValues[i]) / (injectedPVs - lastPVs) < tolerance;
+
+        flatIntervals = flat ? flatIntervals + 1 : 0;
+        lastValues = values;
+        lastPVs = injectedPVs;
+        return intervals > 0 && flatIntervals >= intervals;
+    }
+
+  protected:
+    double tolerance;
+    int intervals;
+    int flatIntervals;
+    double lastPVs;
+    std::vector<double> lastValues;
+};
+
+} // namespace PNM
+
+#endif // CONVERGENCEMONITOR_H
@@ -10,11 +10,13 @@
 #include "misc/userInput.h"
 #include "misc/tools.h"
 #include "misc/maths.h"
-
-#include <libs/csvParser/csv.h>
+#include "misc/taskScheduler.h"
 
 #include <QDir>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <vector>
 #include <sstream>
 #include <iostream>
@@ -46,40 +48,102 @@ int renderer::getProgress()
 void renderer::loadStateFiles()
 {
     QDir directory(userInput::get().pathToNetworkStateFiles.c_str());
-    QStringList stateFiles = directory.entryList(QStringList() << "network_state*.nums", QDir::Files);
+    QStringList stateFiles = directory.entryList(QStringList() << "network_state*.nums"
+                                                                << "network_state*.numsb",
+                                                 QDir::Files, QDir::Name);
 
     totalFiles = stateFiles.length();
 
+    std::vector<std::string> paths;
+    std::vector<bool> binary;
     for (QString filename : stateFiles)
     {
+        paths.push_back(userInput::get().pathToNetworkStateFiles + "/" + filename.toStdString());
+        binary.push_back(filename.endsWith(".numsb"));
+    }
 
-        int phaseFlag(0);
-        double concentration(0);
-        io::CSVReader<2> in(userInput::get().pathToNetworkStateFiles + "/" + filename.toStdString());
-        in.read_header(io::ignore_missing_column, "phase", "concentration");
-
-        for (element *e : pnmRange<element>(network))
+    if (paths.empty())
+        return;
+
+    //Workers decode the files ahead, within a window of frames; the frames are applied and shown in order
+    int workersNumber = std::min<int>(taskScheduler::get().getWorkers(), paths.size());
+    unsigned window = 2 * workersNumber;
+    std::vector<networkStateFile::loadedFrame> frames(window);
+    std::vector<bool> ready(window, false);
+    unsigned consumed(0);
+    bool stopping(false);
+    std::mutex mutex;
+    std::condition_variable frameReady, slotFree;
+    std::atomic<unsigned> nextFile(0);
+
+    uint64_t signature = networkStateFile::getSignature(network);
+    int totalNodes(network->totalNodes), totalPores(network->totalPores);
+
+    auto decode = [&]() {
+        for (unsigned i = nextFile++; i < paths.size(); i = nextFile++)
         {
-            if (in.read_row(phaseFlag, concentration))
             {
-                e->setPhaseFlag(static_cast<phase>(phaseFlag));
-                e->setConcentration(concentration);
+                std::unique_lock<std::mutex> lock(mutex);
+                slotFree.wait(lock, [&] { return stopping || i < consumed + window; });
+                if (stopping)
+                    return;
+            }
+
+            networkStateFile::loadedFrame &frame = frames[i % window];
+            if (binary[i])
+                networkStateFile::load(paths[i], totalNodes, totalPores, signature, frame);
+            else
+                networkStateFile::loadText(paths[i], totalNodes + totalPores, frame);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ready[i % window] = true;
             }
+            frameReady.notify_all();
         }
+    };
+
+    taskScheduler::taskGroup workers;
+    for (int i = 0; i < workersNumber; ++i)
+        workers.run(decode);
+
+    for (unsigned i = 0; i < paths.size(); ++i)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frameReady.wait(lock, [&] { return ready[i % window]; });
+        }
+
+        if (!stateFile.apply(frames[i % window], network))
+            std::cout << "ERROR: " << paths[i] << " does not match the loaded network" << std::endl;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready[i % window] = false;
+            consumed = i + 1;
+        }
+        slotFree.notify_all();
 
         currentFileIndex++;
-        emit notifyGUI();
+        updateGUI();
 
         if (simulationInterrupted)
             break;
     }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    slotFree.notify_all();
+    workers.wait();
 }
 
 void renderer::processFrames()
 {
-    tools::renderVideo(PNM::userInput::get().rendererFPS);
-    if (!PNM::userInput::get().keepFrames)
-        tools::cleanVideosFolder();
+    //Without kept frames, the view streams its captures to the video encoder
+    if (PNM::userInput::get().keepFrames)
+        tools::renderVideo(PNM::userInput::get().rendererFPS);
 }
 
 } // namespace PNM
@@ -9,6 +9,7 @@
 #define RENDERER_H
 
 #include "simulations/simulation.h"
+#include "operations/networkStateFile.h"
 
 #include <memory>
 
@@ -34,6 +35,7 @@ class renderer : public simulation
 
     int currentFileIndex;
     int totalFiles;
+    networkStateFile stateFile; // frames reader, keeping the previous frame for deltas
 };
 
 } // namespace PNM
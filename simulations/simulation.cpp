@@ -12,17 +12,22 @@
 #include "simulations/template-simulation/templateFlowSimulation.h"
 #include "simulations/renderer/renderer.h"
 #include "misc/userInput.h"
+#include "operations/simulationContext.h"
 #include "misc/tools.h"
 #include "misc/scopedtimer.h"
+#include "misc/outputWriter.h"
+#include "network/networkmodel.h"
 
+#include <algorithm>
 #include <iostream>
 #include <thread>
 
 namespace PNM
 {
-simulation::simulation(QObject *parent) : QObject(parent)
+simulation::simulation(QObject *parent) : QObject(parent), phasesVersion(0), stepInterval(1)
 {
     simulationInterrupted = false;
+    snapshot = std::make_shared<progressSnapshot>(progressSnapshot{0, std::string(), 0});
 }
 
 std::shared_ptr<simulation> simulation::createSimulation()
@@ -49,29 +54,72 @@ std::shared_ptr<simulation> simulation::createRenderer()
 
 void simulation::execute()
 {
+    std::unique_ptr<simulationContext::scope> contextScope;
+    if (context)
+        contextScope.reset(new simulationContext::scope(*context));
+
     initialise();
     run();
     finalise();
 }
 
-void simulation::setNetwork(const std::shared_ptr<networkModel> &value)
+void simulation::setNetwork(const std::shared_ptr<networkModel> &value, const std::shared_ptr<simulationContext> &valueContext)
 {
     network = value;
+    context = valueContext;
 }
 
 void simulation::initialise()
 {
     tools::createRequiredFolders();
+    ScopedTimer::setTimeline(userInput::get().profileTimeline);
 }
 
 void simulation::finalise()
 {
+    outputWriter::get().close();
     ScopedTimer::printProfileData();
     emit finished();
 }
 
+void simulation::setProgressCallback(const progressCallback &callback, int intervalMilliseconds)
+{
+    reporter.setCallback(callback, intervalMilliseconds);
+}
+
+void simulation::setStepCallback(const stepCallback &callback, int intervalSteps)
+{
+    stepObserver = callback;
+    stepInterval = std::max(1, intervalSteps);
+}
+
+void simulation::notifyStep(int step)
+{
+    if (!stepObserver || step % stepInterval != 0)
+        return;
+
+    //The arrays are refreshed from the elements, then viewed as they are
+    synchroniseState();
+    if (!network->arrays.matches(*network))
+        network->arrays.build(*network);
+    else
+        network->arrays.gather(*network);
+
+    stepObserver(networkView(*network), step);
+}
+
+std::shared_ptr<const progressSnapshot> simulation::getProgressSnapshot() const
+{
+    return std::atomic_load(&snapshot);
+}
+
 void simulation::updateGUI()
 {
+    //The GUI and the renderer read the elements
+    synchroniseState();
+    std::atomic_store(&snapshot, std::shared_ptr<const progressSnapshot>(std::make_shared<progressSnapshot>(progressSnapshot{getProgress(), getNotification(), ++phasesVersion})));
+    if (reporter.isDue())
+        reporter.report(snapshot->notification, snapshot->progress);
     emit notifyGUI();
 }
 
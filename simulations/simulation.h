@@ -8,6 +8,10 @@
 #ifndef SIMULATION_H
 #define SIMULATION_H
 
+#include "misc/progressReporter.h"
+#include "network/networkView.h"
+
+#include <functional>
 #include <string>
 #include <memory>
 #include <QObject>
@@ -16,6 +20,20 @@ namespace PNM
 {
 
 class networkModel;
+class simulationContext;
+
+// Progress published by a simulation for the GUI, which polls it instead of waiting on the simulation thread.
+// phasesVersion is incremented each time the elements phases or concentrations may have changed.
+struct progressSnapshot
+{
+    int progress;
+    std::string notification;
+    unsigned phasesVersion;
+};
+
+// Called from the simulation thread every few steps (time steps, or stages of a steady-state cycle), with views over
+// the up-to-date network state. The simulation waits for it to return.
+using stepCallback = std::function<void(const networkView &, int step)>;
 
 class simulation : public QObject
 {
@@ -24,11 +42,14 @@ class simulation : public QObject
     virtual ~simulation() {}
     static std::shared_ptr<simulation> createSimulation();
     static std::shared_ptr<simulation> createRenderer();
-    void setNetwork(const std::shared_ptr<networkModel> &value);
+    void setNetwork(const std::shared_ptr<networkModel> &value, const std::shared_ptr<simulationContext> &valueContext = nullptr);
     void execute();
     virtual std::string getNotification() = 0;
     virtual int getProgress() = 0;
     virtual void interrupt();
+    void setProgressCallback(const progressCallback &, int intervalMilliseconds = 1000);
+    void setStepCallback(const stepCallback &, int intervalSteps = 1);
+    std::shared_ptr<const progressSnapshot> getProgressSnapshot() const;
 
   signals:
     void notifyGUI();
@@ -46,9 +67,17 @@ class simulation : public QObject
     virtual void run() = 0;
     void initialise();
     void finalise();
+    void notifyStep(int);
+    virtual void synchroniseState() {} // writes the state held by the simulation back into the elements
 
     std::shared_ptr<networkModel> network;
+    std::shared_ptr<simulationContext> context; // solver, clustering and parameters of the simulation; nested simulations use their parent's
     bool simulationInterrupted;
+    progressReporter reporter; // throttled progress callback, used without the GUI
+    std::shared_ptr<const progressSnapshot> snapshot; // read and replaced atomically
+    unsigned phasesVersion;
+    stepCallback stepObserver;
+    int stepInterval;
 };
 
 } // namespace PNM
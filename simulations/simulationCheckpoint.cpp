@@ -0,0 +1,149 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "simulationCheckpoint.h"
+#include "builders/networkCache.h"
+#include "operations/networkStateFile.h"
+#include "misc/userInput.h"
+#include "misc/outputWriter.h"
+
+#include <QFile>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace PNM
+{
+
+namespace
+{
+
+const char magic[4] = {'N', 'U', 'M', 'K'};
+const uint32_t version = 1;
+
+template <typename T>
+void put(std::ofstream &file, const T &value)
+{
+    file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+bool take(std::ifstream &file, T &value)
+{
+    return bool(file.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+} // namespace
+
+bool simulationCheckpoint::isDue() const
+{
+    double interval = userInput::get().checkpointInterval;
+    return interval > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - lastSave).count() >= interval;
+}
+
+void simulationCheckpoint::save(std::shared_ptr<networkModel> network, const std::vector<double> &variables, const std::vector<std::string> &resultsFiles)
+{
+    //The results files sizes are only known once the pending rows are written
+    outputWriter::get().close();
+
+    //Written aside then renamed, a checkpoint interrupted while written leaves the previous one
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath.c_str(), std::ios::binary);
+        file.write(magic, 4);
+        put<uint32_t>(file, version);
+        put<uint64_t>(file, networkStateFile::getSignature(network));
+
+        std::vector<char> state = networkCache::serializeState(network);
+        put<uint64_t>(file, state.size());
+        file.write(state.data(), state.size());
+
+        put<uint32_t>(file, variables.size());
+        for (double value : variables)
+            put<double>(file, value);
+
+        put<uint32_t>(file, resultsFiles.size());
+        for (const std::string &resultsFile : resultsFiles)
+        {
+            std::ifstream results(resultsFile.c_str(), std::ios::binary | std::ios::ate);
+            put<uint32_t>(file, resultsFile.size());
+            file.write(resultsFile.c_str(), resultsFile.size());
+            put<int64_t>(file, results ? int64_t(results.tellg()) : 0);
+        }
+
+        if (!file)
+        {
+            std::cout << "ERROR: Checkpoint could not be written to " << temporaryPath << std::endl;
+            return;
+        }
+    }
+
+    std::remove(path.c_str());
+    std::rename(temporaryPath.c_str(), path.c_str());
+    lastSave = std::chrono::steady_clock::now();
+}
+
+bool simulationCheckpoint::load(std::shared_ptr<networkModel> network, std::vector<double> &variables)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+
+    char fileMagic[4];
+    uint32_t fileVersion(0);
+    uint64_t signature(0), stateSize(0);
+    if (!file.read(fileMagic, 4) || std::memcmp(fileMagic, magic, 4) != 0 || !take(file, fileVersion) || fileVersion != version)
+        return false;
+    if (!take(file, signature) || signature != networkStateFile::getSignature(network) || !take(file, stateSize))
+        return false;
+
+    std::vector<char> state(stateSize);
+    if (!file.read(state.data(), stateSize))
+        return false;
+
+    uint32_t variablesNumber(0);
+    if (!take(file, variablesNumber) || variablesNumber != variables.size())
+        return false;
+    std::vector<double> values(variablesNumber);
+    for (double &value : values)
+        if (!take(file, value))
+            return false;
+
+    uint32_t filesNumber(0);
+    if (!take(file, filesNumber))
+        return false;
+    std::vector<std::pair<std::string, int64_t>> resultsFiles(filesNumber);
+    for (auto &resultsFile : resultsFiles)
+    {
+        uint32_t length(0);
+        if (!take(file, length))
+            return false;
+        resultsFile.first.resize(length);
+        if (!file.read(&resultsFile.first[0], length) || !take(file, resultsFile.second))
+            return false;
+    }
+
+    //The elements are only touched once the whole checkpoint is read
+    if (!networkCache::deserializeState(state, network))
+        return false;
+
+    variables = values;
+
+    //Rows written after the checkpoint are dropped, the resumed simulation writing them again
+    outputWriter::get().close();
+    for (auto &resultsFile : resultsFiles)
+        QFile(resultsFile.first.c_str()).resize(resultsFile.second);
+
+    lastSave = std::chrono::steady_clock::now();
+    std::cout << "Simulation resumed from " << path << std::endl;
+    return true;
+}
+
+} // namespace PNM
@@ -0,0 +1,41 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIMULATIONCHECKPOINT_H
+#define SIMULATIONCHECKPOINT_H
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace PNM
+{
+
+struct networkModel;
+
+// Binary checkpoint (.numk) of a running simulation: the fluid state of the elements (as saved by networkCache), the
+// variables of the simulation and the sizes of its results files. Loading a checkpoint restores the elements and
+// truncates the results files to their sizes at the time of the checkpoint, so that the resumed simulation appends
+// its rows after the last checkpointed ones. A checkpoint is only loaded on a network with the same signature.
+class simulationCheckpoint
+{
+  public:
+    simulationCheckpoint() : lastSave(std::chrono::steady_clock::now()) {}
+    void setPath(const std::string &value) { path = value; }
+    bool isDue() const;
+    void save(std::shared_ptr<networkModel>, const std::vector<double> &variables, const std::vector<std::string> &resultsFiles);
+    bool load(std::shared_ptr<networkModel>, std::vector<double> &variables);
+
+  protected:
+    std::string path;
+    std::chrono::steady_clock::time_point lastSave;
+};
+
+} // namespace PNM
+
+#endif // SIMULATIONCHECKPOINT_H
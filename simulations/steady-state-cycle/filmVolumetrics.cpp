@@ -0,0 +1,49 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "filmVolumetrics.h"
+#include "network/networkmodel.h"
+#include "network/node.h"
+#include "network/pore.h"
+#include "misc/userInput.h"
+#include "misc/maths.h"
+
+#include <cmath>
+
+namespace PNM
+{
+
+void filmVolumetrics::reset(networkModel &network, double viscosity)
+{
+    elements.reset(network);
+    resized.reset(network);
+
+    int totalElements = network.totalNodes + network.totalPores;
+    volumeCoefficients.resize(totalElements);
+    conductanceCoefficients.resize(totalElements);
+    bulkLimits.resize(totalElements);
+    resizedRSquared.assign(totalElements, 0);
+
+    auto assign = [&](const element *e) {
+        int index = e->getIndex();
+        volumeCoefficients[index] = e->getFilmAreaCoefficient() * e->getLength();
+        conductanceCoefficients[index] = 1 / (viscosity * e->getLength() * e->getLength());
+        bulkLimits[index] = (1 - 4 * maths::pi() * e->getShapeFactor()) * e->getVolume();
+    };
+
+    for (const auto &n : network.tableOfNodes)
+        assign(n.get());
+    for (const auto &p : network.tableOfPores)
+        assign(p.get());
+}
+
+void filmVolumetrics::setCapillaryPressure(double pc)
+{
+    rSquared = std::pow(userInput::get().OWSurfaceTension / pc, 2);
+}
+
+} // namespace PNM
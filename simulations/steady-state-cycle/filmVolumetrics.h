@@ -0,0 +1,68 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef FILMVOLUMETRICS_H
+#define FILMVOLUMETRICS_H
+
+#include "network/frontier.h"
+
+#include <vector>
+
+namespace PNM
+{
+
+// Corner films and layers of a steady-state stage. At a capillary pressure Pc, with r = OWSurfaceTension / Pc, a film
+// holds r^2 * filmAreaCoefficient * length and conducts r^2 * volume / (viscosity * length^2): the per-element
+// constants are computed once by stage, and r^2 once by Pc step. The film-bearing elements are tracked by the stage,
+// so that a Pc step only visits them.
+// The volumes enter the saturation of every Pc step, the conductivities only the relative permeabilities: a resized
+// element records its r^2 and its conductivity is computed by updateConductivities, before the next evaluation.
+class filmVolumetrics
+{
+public:
+  void reset(networkModel &, double viscosity);
+  void setCapillaryPressure(double);
+
+  double getVolume(const element *e) const { return rSquared * volumeCoefficients[e->getIndex()]; }
+  double getConductivity(const element *e, double volume) const { return resizedRSquared[e->getIndex()] * volume * conductanceCoefficients[e->getIndex()]; } // at the last resizing
+  double getBulkLimit(const element *e) const { return bulkLimits[e->getIndex()]; } // (1 - 4 pi G) * volume
+
+  void adjust(element *e)
+  {
+    resizedRSquared[e->getIndex()] = rSquared;
+    resized.insert(e);
+  }
+  template <typename F>
+  void updateConductivities(F update)
+  {
+    for (element *e : resized)
+      update(e);
+    resized.clear();
+  }
+
+  void insert(element *e) { elements.insert(e); }
+  void erase(element *e) // the stage sets the conductivities of the films it empties
+  {
+    elements.erase(e);
+    resized.erase(e);
+  }
+  std::vector<element *>::const_iterator begin() const { return elements.begin(); }
+  std::vector<element *>::const_iterator end() const { return elements.end(); }
+
+private:
+  double rSquared = 0;
+  std::vector<double> volumeCoefficients;
+  std::vector<double> conductanceCoefficients;
+  std::vector<double> bulkLimits;
+  std::vector<double> resizedRSquared;
+  frontier<element> elements;
+  frontier<element> resized; // resized since their conductivities were last computed
+};
+
+} // namespace PNM
+
+#endif // FILMVOLUMETRICS_H
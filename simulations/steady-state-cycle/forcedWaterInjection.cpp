@@ -13,9 +13,10 @@
 #include "network/cluster.h"
 #include "misc/userInput.h"
 #include "misc/tools.h"
+#include "misc/outputWriter.h"
 #include "misc/maths.h"
+#include "misc/scopedtimer.h"
 
-#include <unordered_set>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -26,6 +27,7 @@ namespace PNM
 
 void forcedWaterInjection::run()
 {
+    MEASURE_SCOPE("forcedWaterInjection");
     initialiseOutputFiles();
     initialiseCapillaries();
     initialiseSimulationAttributes();
@@ -43,6 +45,7 @@ void forcedWaterInjection::run()
         if (simulationInterrupted)
             break;
     }
+    updateFilmConductivities();
     finalise();
 }
 
@@ -62,20 +65,13 @@ int forcedWaterInjection::getProgress()
 
 void forcedWaterInjection::initialiseOutputFiles()
 {
-    tools::initialiseFolder("Network_State/Forced_Water_Injection");
+    tools::initialiseFolder(userInput::get().networkStateFolder + "/Forced_Water_Injection");
 
-    pcFilename = "Results/SS_Simulation/3-forcedWaterInjectionPcCurve.txt";
-    relPermFilename = "Results/SS_Simulation/3-forcedWaterInjectionRelativePermeabilies.txt";
+    pcFilename = userInput::get().resultsFolder + "/SS_Simulation/3-forcedWaterInjectionPcCurve.txt";
+    relPermFilename = userInput::get().resultsFolder + "/SS_Simulation/3-forcedWaterInjectionRelativePermeabilies.txt";
 
-    std::ofstream file;
-
-    file.open(pcFilename.c_str());
-    file << "Sw\tPc\n";
-    file.close();
-
-    file.open(relPermFilename.c_str());
-    file << "Sw\tKro\tKrw\n";
-    file.close();
+    outputWriter::get().createSeries(pcFilename, "Sw\tPc\n");
+    outputWriter::get().createSeries(relPermFilename, userInput::get().directionalPermeabilities ? "Sw\tKro\tKrw\tKrox\tKrwx\tKroy\tKrwy\tKroz\tKrwz\n" : "Sw\tKro\tKrw\n");
 }
 
 void forcedWaterInjection::initialiseSimulationAttributes()
@@ -95,7 +91,14 @@ void forcedWaterInjection::initialiseSimulationAttributes()
     elementsToInvade.clear();
     for (element *e : pnmRange<element>(network))
         if (e->getPhaseFlag() == phase::oil)
-            elementsToInvade.insert(e);
+            elementsToInvade.insert(e, -e->getEntryPressure());
+
+    films.reset(*network, userInput::get().oilViscosity);
+    for (element *e : pnmRange<element>(network))
+        if (hasFilm(e))
+            films.insert(e);
+
+    pnmOperation::get(network).resetVolumes();
 }
 
 void forcedWaterInjection::initialiseCapillaries()
@@ -107,7 +110,7 @@ double forcedWaterInjection::getMinPc()
     double minPc(1e20);
     for (element *e : pnmRange<element>(network))
     {
-        double pc = std::abs(e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius());
+        double pc = std::abs(e->getEntryPressure());
         if (pc < minPc)
             minPc = pc;
     }
@@ -119,7 +122,7 @@ double forcedWaterInjection::getMaxPc()
     double maxPc(-1e20);
     for (element *e : pnmRange<element>(network))
     {
-        double pc = std::abs(e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius());
+        double pc = std::abs(e->getEntryPressure());
         if (pc > maxPc)
             maxPc = pc;
     }
@@ -136,11 +139,17 @@ void forcedWaterInjection::invadeCapillariesAtCurrentPc()
         hkClustering::get(network).clusterWaterConductorElements();
         hkClustering::get(network).clusterOilConductorElements();
 
+        //only the candidates whose entry pressure is reached are checked
+        elementsToInvade.release(-(currentPc - 1e-5));
+
         std::vector<element *> invadedElements;
-        for (element *e : elementsToInvade)
+        PROFILE_COUNTER("invasionFrontier", elementsToInvade.getReleasedElements().size());
+        for (element *e : elementsToInvade.getReleasedElements())
         {
             if (isInvadable(e))
                 invadedElements.push_back(e);
+            else if (!e->getClusterOilConductor()->getOutlet())
+                elementsToInvade.erase(e);
         }
 
         for (element *e : invadedElements)
@@ -160,41 +169,22 @@ void forcedWaterInjection::invadeCapillariesAtCurrentPc()
 
 void forcedWaterInjection::dismissTrappedElements()
 {
-    std::vector<element *> trappedElements;
-    for (element *e : elementsToInvade)
-    {
+    //trapped candidates are dismissed lazily once their entry pressure is reached: the oil conductor clusters
+    //only shrink during the invasion, so a trapped element never becomes invadable again
+    elementsToInvade.release(-(currentPc - 1e-5));
+    for (element *e : elementsToInvade.getReleasedElements())
         if (!e->getClusterOilConductor()->getOutlet())
-            trappedElements.push_back(e);
-    }
-
-    for (element *e : trappedElements)
-        elementsToInvade.erase(e);
+            elementsToInvade.erase(e);
 }
 
 void forcedWaterInjection::adjustCapillaryVolumes()
 {
-    double waterVolume(0);
-
-    for (element *e : pnmRange<element>(network))
-    {
-        if (e->getPhaseFlag() == phase::oil && e->getWettabilityFlag() == wettability::waterWet)
-            waterVolume += e->getWaterFilmVolume();
-
-        if (e->getPhaseFlag() == phase::oil && e->getWettabilityFlag() == wettability::oilWet)
-            waterVolume += e->getWaterFilmVolume();
-
-        if (e->getPhaseFlag() == phase::water && e->getWettabilityFlag() == wettability::oilWet)
-        {
-            if (e->getOilLayerActivated() && e->getClusterWaterConductor()->getInlet() && e->getClusterOilConductor()->getOutlet())
-                adjustVolumetrics(e);
-            waterVolume += e->getEffectiveVolume() + e->getWaterFilmVolume();
-        }
-
-        if (e->getPhaseFlag() == phase::water && e->getWettabilityFlag() == wettability::waterWet)
-            waterVolume += e->getVolume();
-    }
+    films.setCapillaryPressure(currentPc);
+    for (element *e : films)
+        if (e->getClusterWaterConductor()->getInlet() && e->getClusterOilConductor()->getOutlet())
+            adjustVolumetrics(e);
 
-    currentSw = waterVolume / network->totalNetworkVolume;
+    currentSw = pnmOperation::get(network).getWaterSaturation();
 }
 
 bool forcedWaterInjection::isInvadable(element *e)
@@ -204,7 +194,7 @@ bool forcedWaterInjection::isInvadable(element *e)
     if (e->getType() == capillaryType::throat && (e->getInlet() || isConnectedToInletCluster(e)) && e->getClusterOilConductor()->getOutlet() ||
         e->getType() == capillaryType::poreBody && isConnectedToInletCluster(e) && e->getClusterOilConductor()->getOutlet())
     {
-        double entryPressure = e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius();
+        double entryPressure = e->getEntryPressure();
         if (currentPc - 1e-5 <= entryPressure)
             isInvadable = true;
     }
@@ -243,18 +233,37 @@ void forcedWaterInjection::fillWithWater(element *e)
         e->setWaterFilmVolume(0);
         e->setWaterFilmConductivity(1e-200);
     }
+
+    if (hasFilm(e))
+        films.insert(e);
+    else
+        films.erase(e);
+
+    pnmOperation::get(network).updateVolumes(e);
 }
 
 void forcedWaterInjection::adjustVolumetrics(element *e)
 {
-    double rSquared = std::pow(userInput::get().OWSurfaceTension / currentPc, 2);
-    double filmVolume = std::min(rSquared * e->getFilmAreaCoefficient() * e->getLength(), (1 - 4 * maths::pi() * e->getShapeFactor()) * e->getVolume());
+    double filmVolume = std::min(films.getVolume(e), films.getBulkLimit(e));
     double effectiveOilFilmVolume = std::max(0.0, filmVolume - e->getWaterFilmVolume());
-    double filmConductance = rSquared * effectiveOilFilmVolume / e->getLength() / (userInput::get().oilViscosity * e->getLength());
 
     e->setOilFilmVolume(effectiveOilFilmVolume);
-    e->setOilFilmConductivity(filmConductance);
     e->setEffectiveVolume(e->getVolume() - e->getOilFilmVolume() - e->getWaterFilmVolume());
+    films.adjust(e);
+
+    pnmOperation::get(network).updateVolumes(e);
+}
+
+void forcedWaterInjection::updateFilmConductivities()
+{
+    films.updateConductivities([this](element *e) {
+        e->setOilFilmConductivity(films.getConductivity(e, e->getOilFilmVolume()));
+    });
+}
+
+bool forcedWaterInjection::hasFilm(element *e)
+{
+    return e->getPhaseFlag() == phase::water && e->getWettabilityFlag() == wettability::oilWet && e->getOilLayerActivated();
 }
 
 void forcedWaterInjection::updateVariables()
@@ -273,19 +282,21 @@ void forcedWaterInjection::updateOutputFiles()
     if (std::abs(outputCounter - currentSw) < 0.01)
         return;
 
-    std::ofstream file;
-
-    file.open(pcFilename, std::ofstream::app);
-    file << currentSw << "\t" << currentPc << std::endl;
-    file.close();
+    outputWriter::get().appendRecord(pcFilename, currentSw, currentPc);
 
     if (userInput::get().relativePermeabilitiesCalculation)
     {
+        updateFilmConductivities();
         auto relPerms = pnmSolver::get(network).calculateRelativePermeabilities();
 
-        file.open(relPermFilename, std::ofstream::app);
-        file << currentSw << "\t" << relPerms.first << "\t" << relPerms.second << std::endl;
-        file.close();
+        if (userInput::get().directionalPermeabilities)
+        {
+            auto directional = pnmSolver::get(network).calculateDirectionalRelativePermeabilities();
+            outputWriter::get().appendRecord(relPermFilename, currentSw, relPerms.first, relPerms.second, directional[0].first, directional[0].second,
+                                             directional[1].first, directional[1].second, directional[2].first, directional[2].second);
+        }
+        else
+            outputWriter::get().appendRecord(relPermFilename, currentSw, relPerms.first, relPerms.second);
     }
 
     generateNetworkStateFiles();
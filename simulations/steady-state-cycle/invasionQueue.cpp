@@ -0,0 +1,64 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "invasionQueue.h"
+
+#include <algorithm>
+
+namespace PNM
+{
+
+void invasionQueue::clear()
+{
+    heap = decltype(heap)();
+    queued.clear();
+    erased.clear();
+    released.clear();
+}
+
+void invasionQueue::insert(element *e, double key)
+{
+    if (!queued.insert(e).second)
+        return;
+
+    //an erased candidate still in the heap is revived instead of being pushed twice
+    if (erased.erase(e))
+        return;
+
+    heap.push(entry(key, e));
+}
+
+void invasionQueue::erase(element *e)
+{
+    if (queued.erase(e))
+        erased.insert(e);
+}
+
+void invasionQueue::release(double threshold)
+{
+    //drop the erased candidates among the released ones
+    if (!erased.empty())
+    {
+        auto last = std::remove_if(released.begin(), released.end(), [this](element *e) {
+            return erased.count(e) != 0;
+        });
+        for (auto it = last; it != released.end(); ++it)
+            erased.erase(*it);
+        released.erase(last, released.end());
+    }
+
+    while (!heap.empty() && heap.top().first <= threshold)
+    {
+        element *e = heap.top().second;
+        heap.pop();
+        if (erased.erase(e))
+            continue;
+        released.push_back(e);
+    }
+}
+
+} // namespace PNM
@@ -0,0 +1,44 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef INVASIONQUEUE_H
+#define INVASIONQUEUE_H
+
+#include <queue>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace PNM
+{
+class element;
+
+// Candidates of an invasion, kept in a min-heap keyed on their entry threshold.
+// Candidates are released once the current threshold reaches their key; released candidates stay
+// available until they are erased. Erasing is lazy: the heap entries of erased candidates are skipped.
+class invasionQueue
+{
+public:
+  void clear();
+  void insert(element *, double);
+  void erase(element *);
+  void release(double);
+  bool empty() const { return heap.empty() && released.empty(); }
+  const std::vector<element *> &getReleasedElements() const { return released; }
+
+private:
+  using entry = std::pair<double, element *>;
+
+  std::priority_queue<entry, std::vector<entry>, std::greater<entry>> heap;
+  std::unordered_set<element *> queued;
+  std::unordered_set<element *> erased;
+  std::vector<element *> released;
+};
+
+} // namespace PNM
+
+#endif // INVASIONQUEUE_H
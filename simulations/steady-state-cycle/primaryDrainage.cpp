@@ -13,9 +13,10 @@
 #include "network/cluster.h"
 #include "misc/userInput.h"
 #include "misc/tools.h"
+#include "misc/outputWriter.h"
 #include "misc/maths.h"
+#include "misc/scopedtimer.h"
 
-#include <unordered_set>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -31,14 +32,20 @@ primaryDrainage::primaryDrainage(double _finalSwi)
 
 void primaryDrainage::run()
 {
+    MEASURE_SCOPE("primaryDrainage");
     initialiseOutputFiles();
     initialiseCapillaries();
     initialiseSimulationAttributes();
 
     while (step < userInput::get().twoPhaseSimulationSteps)
     {
-        invadeCapillariesAtCurrentPc();
-        dismissTrappedElements();
+        if (userInput::get().reverseTrapping)
+            invadeScheduledCapillaries();
+        else
+        {
+            invadeCapillariesAtCurrentPc();
+            dismissTrappedElements();
+        }
         adjustCapillaryVolumes();
 
         updateOutputFiles();
@@ -68,22 +75,15 @@ int primaryDrainage::getProgress()
 
 void primaryDrainage::initialiseOutputFiles()
 {
-    tools::initialiseFolder("Results/SS_Simulation");
-
-    tools::initialiseFolder("Network_State/Primary_Drainage");
-
-    pcFilename = "Results/SS_Simulation/1-primaryDrainagePcCurve.txt";
-    relPermFilename = "Results/SS_Simulation/1-primaryDrainageRelativePermeabilies.txt";
+    tools::initialiseFolder(userInput::get().resultsFolder + "/SS_Simulation");
 
-    std::ofstream file;
+    tools::initialiseFolder(userInput::get().networkStateFolder + "/Primary_Drainage");
 
-    file.open(pcFilename.c_str());
-    file << "Sw\tPc\n";
-    file.close();
+    pcFilename = userInput::get().resultsFolder + "/SS_Simulation/1-primaryDrainagePcCurve.txt";
+    relPermFilename = userInput::get().resultsFolder + "/SS_Simulation/1-primaryDrainageRelativePermeabilies.txt";
 
-    file.open(relPermFilename.c_str());
-    file << "Sw\tKro\tKrw\n";
-    file.close();
+    outputWriter::get().createSeries(pcFilename, "Sw\tPc\n");
+    outputWriter::get().createSeries(relPermFilename, userInput::get().directionalPermeabilities ? "Sw\tKro\tKrw\tKrox\tKrwx\tKroy\tKrwy\tKroz\tKrwz\n" : "Sw\tKro\tKrw\n");
 }
 
 void primaryDrainage::initialiseSimulationAttributes()
@@ -102,7 +102,17 @@ void primaryDrainage::initialiseSimulationAttributes()
 
     elementsToInvade.clear();
     for (pore *e : pnmInlet(network))
-        elementsToInvade.insert(e);
+        elementsToInvade.insert(e, e->getEntryPressure());
+
+    films.reset(*network, userInput::get().waterViscosity);
+    for (element *e : pnmRange<element>(network))
+        if (hasFilm(e))
+            films.insert(e);
+
+    pnmOperation::get(network).resetVolumes();
+
+    if (userInput::get().reverseTrapping)
+        scheduleInvasion();
 }
 
 void primaryDrainage::initialiseCapillaries()
@@ -133,7 +143,7 @@ double primaryDrainage::getMinPc()
     double minPc(1e20);
     for (element *e : pnmRange<element>(network))
     {
-        double pc = e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius();
+        double pc = e->getEntryPressure();
         if (pc < minPc)
             minPc = pc;
     }
@@ -145,7 +155,7 @@ double primaryDrainage::getMaxPc()
     double maxPc(-1e20);
     for (element *e : pnmRange<element>(network))
     {
-        double pc = e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius();
+        double pc = e->getEntryPressure();
         if (pc > maxPc)
             maxPc = pc;
     }
@@ -160,11 +170,17 @@ void primaryDrainage::invadeCapillariesAtCurrentPc()
         stillMore = false;
         hkClustering::get(network).clusterWaterConductorElements();
 
+        //only the candidates whose entry pressure is reached are checked
+        elementsToInvade.release(currentPc + 1e-5);
+
         std::vector<element *> invadedElements;
-        for (element *e : elementsToInvade)
+        PROFILE_COUNTER("invasionFrontier", elementsToInvade.getReleasedElements().size());
+        for (element *e : elementsToInvade.getReleasedElements())
         {
             if (isInvadable(e))
                 invadedElements.push_back(e);
+            else if (!e->getClusterWaterConductor()->getOutlet())
+                elementsToInvade.erase(e);
         }
 
         for (element *e : invadedElements)
@@ -187,50 +203,108 @@ void primaryDrainage::invadeCapillariesAtCurrentPc()
 
 void primaryDrainage::dismissTrappedElements()
 {
-    std::vector<element *> trappedElements;
-    for (element *e : elementsToInvade)
-    {
+    //trapped candidates are dismissed lazily once their entry pressure is reached: the water conductor clusters
+    //only shrink during the drainage, so a trapped element never becomes invadable again
+    elementsToInvade.release(currentPc + 1e-5);
+    for (element *e : elementsToInvade.getReleasedElements())
         if (!e->getClusterWaterConductor()->getOutlet())
-            trappedElements.push_back(e);
-    }
-
-    for (element *e : trappedElements)
-        elementsToInvade.erase(e);
+            elementsToInvade.erase(e);
 }
 
-void primaryDrainage::adjustCapillaryVolumes()
+void primaryDrainage::scheduleInvasion()
 {
-    double waterVolume(0);
+    //Invasion without trapping, in the rounds of invadeCapillariesAtCurrentPc at each capillary pressure step
+    std::vector<int> invasionRounds(network->totalNodes + network->totalPores, -1);
+    std::vector<char> conductorsOnceInvaded(invasionRounds.size(), 0);
+    roundsElements.clear();
+    roundsOffsets.assign(1, 0);
+    stepsRounds.assign(1, 0);
+    lastRound = -1;
+
+    invasionQueue candidates;
+    for (pore *e : pnmInlet(network))
+        candidates.insert(e, e->getEntryPressure());
 
-    for (element *e : pnmRange<element>(network))
+    double radius = currentRadius;
+    double pc = currentPc;
+    for (int s = 0; s < userInput::get().twoPhaseSimulationSteps; ++s)
     {
-        if (e->getPhaseFlag() == phase::oil)
+        while (true)
         {
-            if (e->getWaterCornerActivated() && e->getClusterWaterConductor()->getOutlet())
+            candidates.release(pc + 1e-5);
+            std::vector<element *> invadedElements(candidates.getReleasedElements());
+            if (invadedElements.empty())
+                break;
+
+            int round = roundsOffsets.size() - 1;
+            for (element *e : invadedElements)
             {
-                adjustVolumetrics(e);
+                invasionRounds[e->getIndex()] = round;
+                conductorsOnceInvaded[e->getIndex()] = e->getWaterCanFlowViaFilm();
+                candidates.erase(e);
+                roundsElements.push_back(e);
             }
-            waterVolume += e->getWaterFilmVolume();
+
+            for (element *e : invadedElements)
+                for (element *n : e->getNeighboors())
+                    if (invasionRounds[n->getIndex()] == -1)
+                        candidates.insert(n, n->getEntryPressure());
+
+            roundsOffsets.push_back(roundsElements.size());
         }
 
-        if (e->getPhaseFlag() == phase::water)
-            waterVolume += e->getVolume();
+        stepsRounds.push_back(roundsOffsets.size() - 1);
+        if (s + 1 != userInput::get().twoPhaseSimulationSteps)
+        {
+            radius -= radiusStep;
+            pc = 2 * userInput::get().OWSurfaceTension / radius;
+        }
     }
 
-    currentSw = waterVolume / network->totalNetworkVolume;
+    trapping.label(network, invasionRounds, conductorsOnceInvaded);
+}
+
+void primaryDrainage::invadeScheduledCapillaries()
+{
+    int s = int(step);
+    for (int r = stepsRounds[s]; r < stepsRounds[s + 1]; ++r)
+    {
+        for (int k = roundsOffsets[r]; k < roundsOffsets[r + 1]; ++k)
+            if (!trapping.isTrapped(roundsElements[k]->getIndex()))
+                fillWithOil(roundsElements[k]);
+        lastRound = r;
+
+        updateOutputFiles();
+        checkTerminationCondition();
+        updateGUI();
+
+        if (simulationInterrupted)
+            break;
+    }
+}
+
+void primaryDrainage::adjustCapillaryVolumes()
+{
+    bool scheduled = userInput::get().reverseTrapping;
+
+    films.setCapillaryPressure(currentPc);
+    for (element *e : films)
+        if (scheduled ? trapping.isConnected(e->getIndex(), lastRound) : e->getClusterWaterConductor()->getOutlet())
+            adjustVolumetrics(e);
+
+    currentSw = pnmOperation::get(network).getWaterSaturation();
 }
 
 bool primaryDrainage::isInvadable(element *e)
 {
-    double entryPressure = e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius();
-    return currentPc + 1e-5 >= entryPressure && e->getClusterWaterConductor()->getOutlet();
+    return currentPc + 1e-5 >= e->getEntryPressure() && e->getClusterWaterConductor()->getOutlet();
 }
 
 void primaryDrainage::addNeighboorsToElementsToInvade(element *e)
 {
     for (element *n : e->getNeighboors())
         if (n->getPhaseFlag() == phase::water && e->getClusterWaterConductor()->getOutlet())
-            elementsToInvade.insert(n);
+            elementsToInvade.insert(n, n->getEntryPressure());
 }
 
 void primaryDrainage::fillWithOil(element *e)
@@ -246,17 +320,34 @@ void primaryDrainage::fillWithOil(element *e)
     }
     else
         e->setWaterConductor(false);
+
+    if (hasFilm(e))
+        films.insert(e);
+    else
+        films.erase(e);
+
+    pnmOperation::get(network).updateVolumes(e);
 }
 
 void primaryDrainage::adjustVolumetrics(element *e)
 {
-    double rSquared = std::pow(userInput::get().OWSurfaceTension / currentPc, 2);
-    double filmVolume = rSquared * e->getFilmAreaCoefficient() * e->getLength();
-    double filmConductivity = rSquared * filmVolume / e->getLength() / (userInput::get().waterViscosity * e->getLength());
-
-    e->setWaterFilmVolume(filmVolume);
-    e->setWaterFilmConductivity(filmConductivity);
+    e->setWaterFilmVolume(films.getVolume(e));
     e->setEffectiveVolume(e->getVolume() - e->getWaterFilmVolume());
+    films.adjust(e);
+
+    pnmOperation::get(network).updateVolumes(e);
+}
+
+void primaryDrainage::updateFilmConductivities()
+{
+    films.updateConductivities([this](element *e) {
+        e->setWaterFilmConductivity(films.getConductivity(e, e->getWaterFilmVolume()));
+    });
+}
+
+bool primaryDrainage::hasFilm(element *e)
+{
+    return e->getPhaseFlag() == phase::oil && e->getWaterCornerActivated();
 }
 
 void primaryDrainage::updateVariables()
@@ -281,19 +372,21 @@ void primaryDrainage::updateOutputFiles()
     if (std::abs(outputCounter - currentSw) < 0.01)
         return;
 
-    std::ofstream file;
-
-    file.open(pcFilename, std::ofstream::app);
-    file << currentSw << "\t" << currentPc << std::endl;
-    file.close();
+    outputWriter::get().appendRecord(pcFilename, currentSw, currentPc);
 
     if (userInput::get().relativePermeabilitiesCalculation)
     {
+        updateFilmConductivities();
         auto relPerms = pnmSolver::get(network).calculateRelativePermeabilities();
 
-        file.open(relPermFilename, std::ofstream::app);
-        file << currentSw << "\t" << relPerms.first << "\t" << relPerms.second << std::endl;
-        file.close();
+        if (userInput::get().directionalPermeabilities)
+        {
+            auto directional = pnmSolver::get(network).calculateDirectionalRelativePermeabilities();
+            outputWriter::get().appendRecord(relPermFilename, currentSw, relPerms.first, relPerms.second, directional[0].first, directional[0].second,
+                                             directional[1].first, directional[1].second, directional[2].first, directional[2].second);
+        }
+        else
+            outputWriter::get().appendRecord(relPermFilename, currentSw, relPerms.first, relPerms.second);
     }
 
     generateNetworkStateFiles();
@@ -312,6 +405,7 @@ void primaryDrainage::generateNetworkStateFiles()
 
 void primaryDrainage::finalise()
 {
+    updateFilmConductivities();
     pnmOperation::get(network).restoreWettability();
     pnmOperation::get(network).assignFilmsStability();
 }
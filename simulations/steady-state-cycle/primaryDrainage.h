@@ -9,8 +9,9 @@
 #define PRIMARYDRAINAGE_H
 
 #include "simulations/simulation.h"
-
-#include <unordered_set>
+#include "filmVolumetrics.h"
+#include "invasionQueue.h"
+#include "operations/reverseTrapping.h"
 
 namespace PNM
 {
@@ -37,11 +38,15 @@ private:
   double getMaxPc();
   void invadeCapillariesAtCurrentPc();
   void dismissTrappedElements();
+  void scheduleInvasion();
+  void invadeScheduledCapillaries();
   void adjustCapillaryVolumes();
   bool isInvadable(element *);
   void addNeighboorsToElementsToInvade(element *);
   void fillWithOil(element *);
   void adjustVolumetrics(element *);
+  void updateFilmConductivities();
+  bool hasFilm(element *);
   void updateOutputFiles();
   void generateNetworkStateFiles();
   void updateVariables();
@@ -58,7 +63,16 @@ private:
   int frameCount;
   std::string pcFilename;
   std::string relPermFilename;
-  std::unordered_set<element *> elementsToInvade;
+  invasionQueue elementsToInvade;
+  filmVolumetrics films;
+
+  // Invasion order without trapping, for the reverse trapping: the elements of the round r are
+  // roundsElements[roundsOffsets[r]] .. [roundsOffsets[r + 1] - 1], the rounds of the step s are stepsRounds[s] .. stepsRounds[s + 1] - 1
+  std::vector<element *> roundsElements;
+  std::vector<int> roundsOffsets;
+  std::vector<int> stepsRounds;
+  int lastRound; // last round invaded
+  reverseTrapping trapping;
 };
 
 } // namespace PNM
@@ -13,9 +13,10 @@
 #include "network/cluster.h"
 #include "misc/userInput.h"
 #include "misc/tools.h"
+#include "misc/outputWriter.h"
 #include "misc/maths.h"
+#include "misc/scopedtimer.h"
 
-#include <unordered_set>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -26,6 +27,7 @@ namespace PNM
 
 void secondaryOilDrainage::run()
 {
+    MEASURE_SCOPE("secondaryOilDrainage");
     initialiseOutputFiles();
     initialiseCapillaries();
     initialiseSimulationAttributes();
@@ -43,6 +45,7 @@ void secondaryOilDrainage::run()
         if (simulationInterrupted)
             break;
     }
+    updateFilmConductivities();
     finalise();
 }
 
@@ -62,20 +65,13 @@ int secondaryOilDrainage::getProgress()
 
 void secondaryOilDrainage::initialiseOutputFiles()
 {
-    tools::initialiseFolder("Network_State/Secondary_Oil_Drainage");
+    tools::initialiseFolder(userInput::get().networkStateFolder + "/Secondary_Oil_Drainage");
 
-    pcFilename = "Results/SS_Simulation/5-secondaryOilDrainagePcCurve.txt";
-    relPermFilename = "Results/SS_Simulation/5-secondaryOilDrainageRelativePermeabilies.txt";
+    pcFilename = userInput::get().resultsFolder + "/SS_Simulation/5-secondaryOilDrainagePcCurve.txt";
+    relPermFilename = userInput::get().resultsFolder + "/SS_Simulation/5-secondaryOilDrainageRelativePermeabilies.txt";
 
-    std::ofstream file;
-
-    file.open(pcFilename.c_str());
-    file << "Sw\tPc\n";
-    file.close();
-
-    file.open(relPermFilename.c_str());
-    file << "Sw\tKro\tKrw\n";
-    file.close();
+    outputWriter::get().createSeries(pcFilename, "Sw\tPc\n");
+    outputWriter::get().createSeries(relPermFilename, userInput::get().directionalPermeabilities ? "Sw\tKro\tKrw\tKrox\tKrwx\tKroy\tKrwy\tKroz\tKrwz\n" : "Sw\tKro\tKrw\n");
 }
 
 void secondaryOilDrainage::initialiseSimulationAttributes()
@@ -95,7 +91,14 @@ void secondaryOilDrainage::initialiseSimulationAttributes()
     elementsToInvade.clear();
     for (element *e : pnmRange<element>(network))
         if (e->getPhaseFlag() == phase::water)
-            elementsToInvade.insert(e);
+            elementsToInvade.insert(e, e->getEntryPressure());
+
+    films.reset(*network, userInput::get().waterViscosity);
+    for (element *e : pnmRange<element>(network))
+        if (hasFilm(e))
+            films.insert(e);
+
+    pnmOperation::get(network).resetVolumes();
 }
 
 void secondaryOilDrainage::initialiseCapillaries()
@@ -107,7 +110,7 @@ double secondaryOilDrainage::getMinPc()
     double minPc(1e20);
     for (element *e : pnmRange<element>(network))
     {
-        double pc = std::abs(e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius());
+        double pc = std::abs(e->getEntryPressure());
         if (pc < minPc)
             minPc = pc;
     }
@@ -119,7 +122,7 @@ double secondaryOilDrainage::getMaxPc()
     double maxPc(-1e20);
     for (element *e : pnmRange<element>(network))
     {
-        double pc = std::abs(e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius());
+        double pc = std::abs(e->getEntryPressure());
         if (pc > maxPc)
             maxPc = pc;
     }
@@ -136,11 +139,17 @@ void secondaryOilDrainage::invadeCapillariesAtCurrentPc()
         hkClustering::get(network).clusterWaterConductorElements();
         hkClustering::get(network).clusterOilConductorElements();
 
+        //only the candidates whose entry pressure is reached are checked
+        elementsToInvade.release(currentPc + 1e-5);
+
         std::vector<element *> invadedElements;
-        for (element *e : elementsToInvade)
+        PROFILE_COUNTER("invasionFrontier", elementsToInvade.getReleasedElements().size());
+        for (element *e : elementsToInvade.getReleasedElements())
         {
             if (isInvadable(e))
                 invadedElements.push_back(e);
+            else if (!e->getClusterWaterConductor()->getOutlet())
+                elementsToInvade.erase(e);
         }
 
         for (element *e : invadedElements)
@@ -160,41 +169,22 @@ void secondaryOilDrainage::invadeCapillariesAtCurrentPc()
 
 void secondaryOilDrainage::dismissTrappedElements()
 {
-    std::vector<element *> trappedElements;
-    for (element *e : elementsToInvade)
-    {
+    //trapped candidates are dismissed lazily once their entry pressure is reached: the water conductor clusters
+    //only shrink during the invasion, so a trapped element never becomes invadable again
+    elementsToInvade.release(currentPc + 1e-5);
+    for (element *e : elementsToInvade.getReleasedElements())
         if (!e->getClusterWaterConductor()->getOutlet())
-            trappedElements.push_back(e);
-    }
-
-    for (element *e : trappedElements)
-        elementsToInvade.erase(e);
+            elementsToInvade.erase(e);
 }
 
 void secondaryOilDrainage::adjustCapillaryVolumes()
 {
-    double waterVolume(0);
-
-    for (element *e : pnmRange<element>(network))
-    {
-        if (e->getPhaseFlag() == phase::oil && e->getWettabilityFlag() == wettability::oilWet)
-            waterVolume += e->getWaterFilmVolume();
-
-        if (e->getPhaseFlag() == phase::oil && e->getWettabilityFlag() == wettability::waterWet)
-        {
-            if (e->getWaterCornerActivated() && e->getClusterOilConductor()->getInlet() && e->getClusterWaterConductor()->getOutlet())
-                adjustVolumetrics(e);
-            waterVolume += e->getWaterFilmVolume();
-        }
+    films.setCapillaryPressure(currentPc);
+    for (element *e : films)
+        if (e->getClusterOilConductor()->getInlet() && e->getClusterWaterConductor()->getOutlet())
+            adjustVolumetrics(e);
 
-        if (e->getPhaseFlag() == phase::water && e->getWettabilityFlag() == wettability::oilWet)
-            waterVolume += e->getEffectiveVolume() + e->getWaterFilmVolume();
-
-        if (e->getPhaseFlag() == phase::water && e->getWettabilityFlag() == wettability::waterWet)
-            waterVolume += e->getVolume();
-    }
-
-    currentSw = waterVolume / network->totalNetworkVolume;
+    currentSw = pnmOperation::get(network).getWaterSaturation();
 }
 
 bool secondaryOilDrainage::isInvadable(element *e)
@@ -204,7 +194,7 @@ bool secondaryOilDrainage::isInvadable(element *e)
     if (e->getType() == capillaryType::throat && (e->getInlet() || isConnectedToInletCluster(e)) && e->getClusterWaterConductor()->getOutlet() ||
         e->getType() == capillaryType::poreBody && isConnectedToInletCluster(e) && e->getClusterWaterConductor()->getOutlet())
     {
-        double entryPressure = e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius();
+        double entryPressure = e->getEntryPressure();
         if (currentPc + 1e-5 >= entryPressure)
             isInvadable = true;
     }
@@ -242,17 +232,35 @@ void secondaryOilDrainage::fillWithOil(element *e)
 
     if (!e->getWaterCornerActivated())
         e->setWaterConductor(false);
+
+    if (hasFilm(e))
+        films.insert(e);
+    else
+        films.erase(e);
+
+    pnmOperation::get(network).updateVolumes(e);
 }
 
 void secondaryOilDrainage::adjustVolumetrics(element *e)
 {
-    double rSquared = std::pow(userInput::get().OWSurfaceTension / currentPc, 2);
-    double filmVolume = std::min(rSquared * e->getFilmAreaCoefficient() * e->getLength(), e->getWaterFilmVolume());
-    double filmConductance = std::min(rSquared * filmVolume / e->getLength() / (userInput::get().waterViscosity * e->getLength()), e->getWaterFilmConductivity());
-
-    e->setWaterFilmVolume(filmVolume);
-    e->setWaterFilmConductivity(filmConductance);
+    e->setWaterFilmVolume(std::min(films.getVolume(e), e->getWaterFilmVolume()));
     e->setEffectiveVolume(e->getVolume() - e->getWaterFilmVolume());
+    films.adjust(e);
+
+    pnmOperation::get(network).updateVolumes(e);
+}
+
+void secondaryOilDrainage::updateFilmConductivities()
+{
+    films.updateConductivities([this](element *e) {
+        //the films only shrink while Pc rises: the conductivity of the last resizing is the smallest
+        e->setWaterFilmConductivity(std::min(films.getConductivity(e, e->getWaterFilmVolume()), e->getWaterFilmConductivity()));
+    });
+}
+
+bool secondaryOilDrainage::hasFilm(element *e)
+{
+    return e->getPhaseFlag() == phase::oil && e->getWettabilityFlag() == wettability::waterWet && e->getWaterCornerActivated();
 }
 
 void secondaryOilDrainage::updateVariables()
@@ -271,19 +279,21 @@ void secondaryOilDrainage::updateOutputFiles()
     if (std::abs(outputCounter - currentSw) < 0.01)
         return;
 
-    std::ofstream file;
-
-    file.open(pcFilename, std::ofstream::app);
-    file << currentSw << "\t" << currentPc << std::endl;
-    file.close();
+    outputWriter::get().appendRecord(pcFilename, currentSw, currentPc);
 
     if (userInput::get().relativePermeabilitiesCalculation)
     {
+        updateFilmConductivities();
         auto relPerms = pnmSolver::get(network).calculateRelativePermeabilities();
 
-        file.open(relPermFilename, std::ofstream::app);
-        file << currentSw << "\t" << relPerms.first << "\t" << relPerms.second << std::endl;
-        file.close();
+        if (userInput::get().directionalPermeabilities)
+        {
+            auto directional = pnmSolver::get(network).calculateDirectionalRelativePermeabilities();
+            outputWriter::get().appendRecord(relPermFilename, currentSw, relPerms.first, relPerms.second, directional[0].first, directional[0].second,
+                                             directional[1].first, directional[1].second, directional[2].first, directional[2].second);
+        }
+        else
+            outputWriter::get().appendRecord(relPermFilename, currentSw, relPerms.first, relPerms.second);
     }
 
     generateNetworkStateFiles();
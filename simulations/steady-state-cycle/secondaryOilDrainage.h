@@ -9,8 +9,8 @@
 #define SECONDARYOILDRAINAGE_H
 
 #include "simulations/simulation.h"
-
-#include <unordered_set>
+#include "filmVolumetrics.h"
+#include "invasionQueue.h"
 
 namespace PNM
 {
@@ -45,6 +45,8 @@ private:
   bool isConnectedToInletCluster(element *);
   void fillWithOil(element *);
   void adjustVolumetrics(element *);
+  void updateFilmConductivities();
+  bool hasFilm(element *);
   void updateOutputFiles();
   void generateNetworkStateFiles();
   void updateVariables();
@@ -58,7 +60,8 @@ private:
   int frameCount;
   std::string pcFilename;
   std::string relPermFilename;
-  std::unordered_set<element *> elementsToInvade;
+  invasionQueue elementsToInvade;
+  filmVolumetrics films;
 };
 
 } // namespace PNM
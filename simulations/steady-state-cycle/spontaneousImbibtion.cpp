@@ -13,7 +13,9 @@
 #include "network/cluster.h"
 #include "misc/userInput.h"
 #include "misc/tools.h"
+#include "misc/outputWriter.h"
 #include "misc/maths.h"
+#include "misc/scopedtimer.h"
 
 #include <unordered_set>
 #include <fstream>
@@ -26,6 +28,7 @@ namespace PNM
 
 void spontaneousImbibtion::run()
 {
+    MEASURE_SCOPE("spontaneousImbibtion");
     initialiseOutputFiles();
     initialiseCapillaries();
     initialiseSimulationAttributes();
@@ -43,6 +46,7 @@ void spontaneousImbibtion::run()
         if (simulationInterrupted)
             break;
     }
+    updateFilmConductivities();
     finalise();
 }
 
@@ -62,20 +66,13 @@ int spontaneousImbibtion::getProgress()
 
 void spontaneousImbibtion::initialiseOutputFiles()
 {
-    tools::initialiseFolder("Network_State/Spontaneous_Imbibition");
+    tools::initialiseFolder(userInput::get().networkStateFolder + "/Spontaneous_Imbibition");
 
-    pcFilename = "Results/SS_Simulation/2-spontaneousImbibtionPcCurve.txt";
-    relPermFilename = "Results/SS_Simulation/2-spontaneousImbibtionRelativePermeabilies.txt";
+    pcFilename = userInput::get().resultsFolder + "/SS_Simulation/2-spontaneousImbibtionPcCurve.txt";
+    relPermFilename = userInput::get().resultsFolder + "/SS_Simulation/2-spontaneousImbibtionRelativePermeabilies.txt";
 
-    std::ofstream file;
-
-    file.open(pcFilename.c_str());
-    file << "Sw\tPc\n";
-    file.close();
-
-    file.open(relPermFilename.c_str());
-    file << "Sw\tKro\tKrw\n";
-    file.close();
+    outputWriter::get().createSeries(pcFilename, "Sw\tPc\n");
+    outputWriter::get().createSeries(relPermFilename, userInput::get().directionalPermeabilities ? "Sw\tKro\tKrw\tKrox\tKrwx\tKroy\tKrwy\tKroz\tKrwz\n" : "Sw\tKro\tKrw\n");
 }
 
 void spontaneousImbibtion::initialiseSimulationAttributes()
@@ -96,6 +93,15 @@ void spontaneousImbibtion::initialiseSimulationAttributes()
     for (element *e : pnmRange<element>(network))
         if (e->getPhaseFlag() == phase::oil && e->getWettabilityFlag() == wettability::waterWet)
             elementsToInvade.insert(e);
+
+    nodesPhaseNeighboors.reset(*network);
+
+    films.reset(*network, userInput::get().waterViscosity);
+    for (element *e : pnmRange<element>(network))
+        if (hasFilm(e))
+            films.insert(e);
+
+    pnmOperation::get(network).resetVolumes();
 }
 
 void spontaneousImbibtion::initialiseCapillaries()
@@ -119,7 +125,7 @@ double spontaneousImbibtion::getMaxPc()
     double maxPc(-1e20);
     for (element *e : pnmRange<element>(network))
     {
-        double pc = std::abs(e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius());
+        double pc = std::abs(e->getEntryPressure());
         if (pc > maxPc)
             maxPc = pc;
     }
@@ -201,29 +207,12 @@ void spontaneousImbibtion::dismissTrappedElements()
 
 void spontaneousImbibtion::adjustCapillaryVolumes()
 {
-    double waterVolume(0);
-
-    for (element *e : pnmRange<element>(network))
-    {
-        if (e->getPhaseFlag() == phase::oil && e->getWettabilityFlag() == wettability::waterWet)
-        {
-            if (e->getWaterCornerActivated() && e->getClusterWaterConductor()->getInlet() && e->getClusterOilConductor()->getOutlet())
-                adjustVolumetrics(e);
-
-            waterVolume += e->getWaterFilmVolume();
-        }
-
-        if (e->getPhaseFlag() == phase::oil && e->getWettabilityFlag() == wettability::oilWet)
-            waterVolume += e->getWaterFilmVolume();
-
-        if (e->getPhaseFlag() == phase::water && e->getWettabilityFlag() == wettability::oilWet)
-            waterVolume += e->getEffectiveVolume() + e->getWaterFilmVolume();
-
-        if (e->getPhaseFlag() == phase::water && e->getWettabilityFlag() == wettability::waterWet)
-            waterVolume += e->getVolume();
-    }
+    films.setCapillaryPressure(currentPc);
+    for (element *e : films)
+        if (e->getClusterWaterConductor()->getInlet() && e->getClusterOilConductor()->getOutlet())
+            adjustVolumetrics(e);
 
-    currentSw = waterVolume / network->totalNetworkVolume;
+    currentSw = pnmOperation::get(network).getWaterSaturation();
 }
 
 bool spontaneousImbibtion::isInvadableViaSnapOff(element *e)
@@ -241,25 +230,20 @@ bool spontaneousImbibtion::isInvadableViaBulk(element *e)
 
     if (e->getType() == capillaryType::throat && (e->getInlet() || isConnectedToInletCluster(e)) && e->getClusterOilConductor()->getOutlet())
     {
-        double entryPressure = e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius();
+        double entryPressure = e->getEntryPressure();
         if (currentPc - 1e-5 <= entryPressure)
             isInvadable = true;
     }
 
     else if (e->getType() == capillaryType::poreBody && isConnectedToInletCluster(e) && e->getClusterOilConductor()->getOutlet())
     {
-        int oilNeighboorsNumber(0);
-        for (element *n : e->getNeighboors())
-        {
-            if (n->getPhaseFlag() == phase::oil)
-                oilNeighboorsNumber++;
-        }
+        int oilNeighboorsNumber = nodesPhaseNeighboors.count(static_cast<node *>(e), phase::oil);
 
         double entryPressureBodyFilling = 0;
         if (oilNeighboorsNumber == 1)
-            entryPressureBodyFilling = e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius();
+            entryPressureBodyFilling = e->getEntryPressure();
         if (oilNeighboorsNumber > 1)
-            entryPressureBodyFilling = e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius() / double(oilNeighboorsNumber);
+            entryPressureBodyFilling = e->getEntryPressure() / double(oilNeighboorsNumber);
 
         if (currentPc - 1e-5 <= entryPressureBodyFilling)
             isInvadable = true;
@@ -282,7 +266,10 @@ bool spontaneousImbibtion::isConnectedToInletCluster(element *e)
 
 void spontaneousImbibtion::fillWithWater(element *e)
 {
+    phase previous = e->getPhaseFlag();
     e->setPhaseFlag(phase::water);
+    if (e->getType() == capillaryType::throat)
+        nodesPhaseNeighboors.update(static_cast<pore *>(e), previous);
     e->setWaterConductor(true);
     e->setOilFraction(0);
     e->setWaterFraction(1);
@@ -291,17 +278,34 @@ void spontaneousImbibtion::fillWithWater(element *e)
     e->setWaterFilmConductivity(1e-200);
 
     e->setOilConductor(false);
+
+    if (hasFilm(e))
+        films.insert(e);
+    else
+        films.erase(e);
+
+    pnmOperation::get(network).updateVolumes(e);
 }
 
 void spontaneousImbibtion::adjustVolumetrics(element *e)
 {
-    double rSquared = std::pow(userInput::get().OWSurfaceTension / currentPc, 2);
-    double filmVolume = std::min(rSquared * e->getFilmAreaCoefficient() * e->getLength(), (1 - 4 * maths::pi() * e->getShapeFactor()) * e->getVolume());
-    double filmConductance = rSquared * filmVolume / e->getLength() / (userInput::get().waterViscosity * e->getLength());
-
-    e->setWaterFilmVolume(filmVolume);
-    e->setWaterFilmConductivity(filmConductance);
+    e->setWaterFilmVolume(std::min(films.getVolume(e), films.getBulkLimit(e)));
     e->setEffectiveVolume(e->getVolume() - e->getWaterFilmVolume());
+    films.adjust(e);
+
+    pnmOperation::get(network).updateVolumes(e);
+}
+
+void spontaneousImbibtion::updateFilmConductivities()
+{
+    films.updateConductivities([this](element *e) {
+        e->setWaterFilmConductivity(films.getConductivity(e, e->getWaterFilmVolume()));
+    });
+}
+
+bool spontaneousImbibtion::hasFilm(element *e)
+{
+    return e->getPhaseFlag() == phase::oil && e->getWettabilityFlag() == wettability::waterWet && e->getWaterCornerActivated();
 }
 
 void spontaneousImbibtion::updateVariables()
@@ -320,19 +324,21 @@ void spontaneousImbibtion::updateOutputFiles()
     if (std::abs(outputCounter - currentSw) < 0.01)
         return;
 
-    std::ofstream file;
-
-    file.open(pcFilename, std::ofstream::app);
-    file << currentSw << "\t" << currentPc << std::endl;
-    file.close();
+    outputWriter::get().appendRecord(pcFilename, currentSw, currentPc);
 
     if (userInput::get().relativePermeabilitiesCalculation)
     {
+        updateFilmConductivities();
         auto relPerms = pnmSolver::get(network).calculateRelativePermeabilities();
 
-        file.open(relPermFilename, std::ofstream::app);
-        file << currentSw << "\t" << relPerms.first << "\t" << relPerms.second << std::endl;
-        file.close();
+        if (userInput::get().directionalPermeabilities)
+        {
+            auto directional = pnmSolver::get(network).calculateDirectionalRelativePermeabilities();
+            outputWriter::get().appendRecord(relPermFilename, currentSw, relPerms.first, relPerms.second, directional[0].first, directional[0].second,
+                                             directional[1].first, directional[1].second, directional[2].first, directional[2].second);
+        }
+        else
+            outputWriter::get().appendRecord(relPermFilename, currentSw, relPerms.first, relPerms.second);
     }
 
     generateNetworkStateFiles();
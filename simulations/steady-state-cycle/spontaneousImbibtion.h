@@ -9,6 +9,8 @@
 #define SPONTANEOUSIMBIBTION_H
 
 #include "simulations/simulation.h"
+#include "filmVolumetrics.h"
+#include "network/phaseNeighboors.h"
 
 #include <unordered_set>
 
@@ -45,6 +47,8 @@ private:
   bool isConnectedToInletCluster(element *);
   void fillWithWater(element *);
   void adjustVolumetrics(element *);
+  void updateFilmConductivities();
+  bool hasFilm(element *);
   void updateOutputFiles();
   void generateNetworkStateFiles();
   void updateVariables();
@@ -59,6 +63,8 @@ private:
   std::string pcFilename;
   std::string relPermFilename;
   std::unordered_set<element *> elementsToInvade;
+  filmVolumetrics films;
+  phaseNeighboors nodesPhaseNeighboors;
 };
 
 } // namespace PNM
@@ -13,7 +13,9 @@
 #include "network/cluster.h"
 #include "misc/userInput.h"
 #include "misc/tools.h"
+#include "misc/outputWriter.h"
 #include "misc/maths.h"
+#include "misc/scopedtimer.h"
 
 #include <unordered_set>
 #include <fstream>
@@ -26,6 +28,7 @@ namespace PNM
 
 void spontaneousOilInvasion::run()
 {
+    MEASURE_SCOPE("spontaneousOilInvasion");
     initialiseOutputFiles();
     initialiseCapillaries();
     initialiseSimulationAttributes();
@@ -43,6 +46,7 @@ void spontaneousOilInvasion::run()
         if (simulationInterrupted)
             break;
     }
+    updateFilmConductivities();
     finalise();
 }
 
@@ -62,20 +66,13 @@ int spontaneousOilInvasion::getProgress()
 
 void spontaneousOilInvasion::initialiseOutputFiles()
 {
-    tools::initialiseFolder("Network_State/Spontaneous_Oil_Invasion");
+    tools::initialiseFolder(userInput::get().networkStateFolder + "/Spontaneous_Oil_Invasion");
 
-    pcFilename = "Results/SS_Simulation/4-spontaneousOilInvasionPcCurve.txt";
-    relPermFilename = "Results/SS_Simulation/4-spontaneousOilInvasionRelativePermeabilies.txt";
+    pcFilename = userInput::get().resultsFolder + "/SS_Simulation/4-spontaneousOilInvasionPcCurve.txt";
+    relPermFilename = userInput::get().resultsFolder + "/SS_Simulation/4-spontaneousOilInvasionRelativePermeabilies.txt";
 
-    std::ofstream file;
-
-    file.open(pcFilename.c_str());
-    file << "Sw\tPc\n";
-    file.close();
-
-    file.open(relPermFilename.c_str());
-    file << "Sw\tKro\tKrw\n";
-    file.close();
+    outputWriter::get().createSeries(pcFilename, "Sw\tPc\n");
+    outputWriter::get().createSeries(relPermFilename, userInput::get().directionalPermeabilities ? "Sw\tKro\tKrw\tKrox\tKrwx\tKroy\tKrwy\tKroz\tKrwz\n" : "Sw\tKro\tKrw\n");
 }
 
 void spontaneousOilInvasion::initialiseSimulationAttributes()
@@ -96,6 +93,15 @@ void spontaneousOilInvasion::initialiseSimulationAttributes()
     for (element *e : pnmRange<element>(network))
         if (e->getPhaseFlag() == phase::water && e->getWettabilityFlag() == wettability::oilWet)
             elementsToInvade.insert(e);
+
+    nodesPhaseNeighboors.reset(*network);
+
+    films.reset(*network, userInput::get().oilViscosity);
+    for (element *e : pnmRange<element>(network))
+        if (hasFilm(e))
+            films.insert(e);
+
+    pnmOperation::get(network).resetVolumes();
 }
 
 void spontaneousOilInvasion::initialiseCapillaries()
@@ -119,7 +125,7 @@ double spontaneousOilInvasion::getMaxPc()
     double maxPc(-1e20);
     for (element *e : pnmRange<element>(network))
     {
-        double pc = std::abs(e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius());
+        double pc = std::abs(e->getEntryPressure());
         if (pc > maxPc)
             maxPc = pc;
     }
@@ -201,29 +207,12 @@ void spontaneousOilInvasion::dismissTrappedElements()
 
 void spontaneousOilInvasion::adjustCapillaryVolumes()
 {
-    double waterVolume(0);
-
-    for (element *e : pnmRange<element>(network))
-    {
-        if (e->getPhaseFlag() == phase::oil && e->getWettabilityFlag() == wettability::waterWet)
-            waterVolume += e->getWaterFilmVolume();
-
-        if (e->getPhaseFlag() == phase::oil && e->getWettabilityFlag() == wettability::oilWet)
-            waterVolume += e->getWaterFilmVolume();
-
-        if (e->getPhaseFlag() == phase::water && e->getWettabilityFlag() == wettability::oilWet)
-        {
-            if (e->getOilLayerActivated() && e->getClusterOilConductor()->getInlet() && e->getClusterWaterConductor()->getOutlet())
-                adjustVolumetrics(e);
-
-            waterVolume += e->getEffectiveVolume() + e->getWaterFilmVolume();
-        }
-
-        if (e->getPhaseFlag() == phase::water && e->getWettabilityFlag() == wettability::waterWet)
-            waterVolume += e->getVolume();
-    }
+    films.setCapillaryPressure(currentPc);
+    for (element *e : films)
+        if (e->getClusterOilConductor()->getInlet() && e->getClusterWaterConductor()->getOutlet())
+            adjustVolumetrics(e);
 
-    currentSw = waterVolume / network->totalNetworkVolume;
+    currentSw = pnmOperation::get(network).getWaterSaturation();
 }
 
 bool spontaneousOilInvasion::isInvadableViaSnapOff(element *e)
@@ -241,25 +230,20 @@ bool spontaneousOilInvasion::isInvadableViaBulk(element *e)
 
     if (e->getType() == capillaryType::throat && (e->getInlet() || isConnectedToInletCluster(e)) && e->getClusterWaterConductor()->getOutlet())
     {
-        double entryPressure = e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius();
+        double entryPressure = e->getEntryPressure();
         if (currentPc + 1e-5 >= entryPressure)
             isInvadable = true;
     }
 
     else if (e->getType() == capillaryType::poreBody && isConnectedToInletCluster(e) && e->getClusterWaterConductor()->getOutlet())
     {
-        int waterNeighboorsNumber(0);
-        for (element *n : e->getNeighboors())
-        {
-            if (n->getPhaseFlag() == phase::water)
-                waterNeighboorsNumber++;
-        }
+        int waterNeighboorsNumber = nodesPhaseNeighboors.count(static_cast<node *>(e), phase::water);
 
         double entryPressureBodyFilling = 0;
         if (waterNeighboorsNumber == 1)
-            entryPressureBodyFilling = e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius();
+            entryPressureBodyFilling = e->getEntryPressure();
         if (waterNeighboorsNumber > 1)
-            entryPressureBodyFilling = e->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * std::cos(e->getTheta()) / e->getRadius() / double(waterNeighboorsNumber);
+            entryPressureBodyFilling = e->getEntryPressure() / double(waterNeighboorsNumber);
 
         if (currentPc + 1e-5 >= entryPressureBodyFilling)
             isInvadable = true;
@@ -282,7 +266,10 @@ bool spontaneousOilInvasion::isConnectedToInletCluster(element *e)
 
 void spontaneousOilInvasion::fillWithOil(element *e)
 {
+    phase previous = e->getPhaseFlag();
     e->setPhaseFlag(phase::oil);
+    if (e->getType() == capillaryType::throat)
+        nodesPhaseNeighboors.update(static_cast<pore *>(e), previous);
     e->setOilConductor(true);
     e->setOilFraction(1);
     e->setWaterFraction(0);
@@ -292,17 +279,34 @@ void spontaneousOilInvasion::fillWithOil(element *e)
 
     if (!e->getWaterCornerActivated())
         e->setWaterConductor(false);
+
+    if (hasFilm(e))
+        films.insert(e);
+    else
+        films.erase(e);
+
+    pnmOperation::get(network).updateVolumes(e);
 }
 
 void spontaneousOilInvasion::adjustVolumetrics(element *e)
 {
-    double rSquared = std::pow(userInput::get().OWSurfaceTension / currentPc, 2);
-    double filmVolume = std::min(rSquared * e->getFilmAreaCoefficient() * e->getLength(), (1 - 4 * maths::pi() * e->getShapeFactor()) * e->getVolume() - e->getWaterFilmVolume());
-    double filmConductance = rSquared * filmVolume / e->getLength() / (userInput::get().oilViscosity * e->getLength());
-
-    e->setOilFilmVolume(filmVolume);
-    e->setOilFilmConductivity(filmConductance);
+    e->setOilFilmVolume(std::min(films.getVolume(e), films.getBulkLimit(e) - e->getWaterFilmVolume()));
     e->setEffectiveVolume(e->getVolume() - e->getOilFilmVolume() - e->getWaterFilmVolume());
+    films.adjust(e);
+
+    pnmOperation::get(network).updateVolumes(e);
+}
+
+void spontaneousOilInvasion::updateFilmConductivities()
+{
+    films.updateConductivities([this](element *e) {
+        e->setOilFilmConductivity(films.getConductivity(e, e->getOilFilmVolume()));
+    });
+}
+
+bool spontaneousOilInvasion::hasFilm(element *e)
+{
+    return e->getPhaseFlag() == phase::water && e->getWettabilityFlag() == wettability::oilWet && e->getOilLayerActivated();
 }
 
 void spontaneousOilInvasion::updateVariables()
@@ -321,19 +325,21 @@ void spontaneousOilInvasion::updateOutputFiles()
     if (std::abs(outputCounter - currentSw) < 0.01)
         return;
 
-    std::ofstream file;
-
-    file.open(pcFilename, std::ofstream::app);
-    file << currentSw << "\t" << currentPc << std::endl;
-    file.close();
+    outputWriter::get().appendRecord(pcFilename, currentSw, currentPc);
 
     if (userInput::get().relativePermeabilitiesCalculation)
     {
+        updateFilmConductivities();
         auto relPerms = pnmSolver::get(network).calculateRelativePermeabilities();
 
-        file.open(relPermFilename, std::ofstream::app);
-        file << currentSw << "\t" << relPerms.first << "\t" << relPerms.second << std::endl;
-        file.close();
+        if (userInput::get().directionalPermeabilities)
+        {
+            auto directional = pnmSolver::get(network).calculateDirectionalRelativePermeabilities();
+            outputWriter::get().appendRecord(relPermFilename, currentSw, relPerms.first, relPerms.second, directional[0].first, directional[0].second,
+                                             directional[1].first, directional[1].second, directional[2].first, directional[2].second);
+        }
+        else
+            outputWriter::get().appendRecord(relPermFilename, currentSw, relPerms.first, relPerms.second);
     }
 
     generateNetworkStateFiles();
@@ -9,6 +9,8 @@
 #define SPONTANEOUSOILINVASION_H
 
 #include "simulations/simulation.h"
+#include "filmVolumetrics.h"
+#include "network/phaseNeighboors.h"
 
 #include <unordered_set>
 
@@ -45,6 +47,8 @@ class spontaneousOilInvasion : public simulation
     bool isConnectedToInletCluster(element *);
     void fillWithOil(element *);
     void adjustVolumetrics(element *);
+    void updateFilmConductivities();
+    bool hasFilm(element *);
     void updateOutputFiles();
     void generateNetworkStateFiles();
     void updateVariables();
@@ -60,6 +64,9 @@ class spontaneousOilInvasion : public simulation
     std::string relPermFilename;
 
     std::unordered_set<element *> elementsToInvade;
+
+    filmVolumetrics films;
+    phaseNeighboors nodesPhaseNeighboors;
 };
 
 } // namespace PNM
@@ -18,34 +18,40 @@ namespace PNM
 
 void steadyStateSimulation::run()
 {
-    if (userInput::get().primaryDrainageSimulation)
+    checkpoint.setPath(userInput::get().resultsFolder + "/SS_Simulation/checkpoint.numk");
+    std::vector<double> completedStages(1, 0);
+    if (userInput::get().resumeSimulation)
+        checkpoint.load(network, completedStages);
+    firstStage = int(completedStages[0]);
+
+    if (userInput::get().primaryDrainageSimulation && firstStage <= 0)
     {
         currentSimulation = std::make_shared<primaryDrainage>();
-        runCurrentSimulation();
+        runCurrentSimulation(0);
     }
 
-    if (!simulationInterrupted && userInput::get().spontaneousImbibitionSimulation)
+    if (!simulationInterrupted && userInput::get().spontaneousImbibitionSimulation && firstStage <= 1)
     {
         currentSimulation = std::make_shared<spontaneousImbibtion>();
-        runCurrentSimulation();
+        runCurrentSimulation(1);
     }
 
-    if (!simulationInterrupted && userInput::get().forcedWaterInjectionSimulation)
+    if (!simulationInterrupted && userInput::get().forcedWaterInjectionSimulation && firstStage <= 2)
     {
         currentSimulation = std::make_shared<forcedWaterInjection>();
-        runCurrentSimulation();
+        runCurrentSimulation(2);
     }
 
-    if (!simulationInterrupted && userInput::get().spontaneousOilInvasionSimulation)
+    if (!simulationInterrupted && userInput::get().spontaneousOilInvasionSimulation && firstStage <= 3)
     {
         currentSimulation = std::make_shared<spontaneousOilInvasion>();
-        runCurrentSimulation();
+        runCurrentSimulation(3);
     }
 
-    if (!simulationInterrupted && userInput::get().secondaryOilDrainageSimulation)
+    if (!simulationInterrupted && userInput::get().secondaryOilDrainageSimulation && firstStage <= 4)
     {
         currentSimulation = std::make_shared<secondaryOilDrainage>();
-        runCurrentSimulation();
+        runCurrentSimulation(4);
     }
 }
 
@@ -65,11 +71,16 @@ void steadyStateSimulation::interrupt()
     currentSimulation->interrupt();
 }
 
-void steadyStateSimulation::runCurrentSimulation()
+void steadyStateSimulation::runCurrentSimulation(int stage)
 {
     currentSimulation->setNetwork(network);
     connect(currentSimulation.get(), SIGNAL(notifyGUI()), this, SLOT(updateGUI()));
     currentSimulation->execute();
+    notifyStep(stage + 1);
+
+    //A resumed cycle starts with the stage following the last completed one
+    if (!simulationInterrupted && userInput::get().checkpointInterval > 0)
+        checkpoint.save(network, {double(stage + 1)}, {});
 }
 
 } // namespace PNM
@@ -9,6 +9,7 @@
 #define STEADYSTATESIMULATION_H
 
 #include "simulations/simulation.h"
+#include "simulations/simulationCheckpoint.h"
 
 #include "memory"
 
@@ -30,8 +31,10 @@ class steadyStateSimulation : public simulation
     virtual void interrupt() override;
 
   private:
-    void runCurrentSimulation();
+    void runCurrentSimulation(int);
     std::shared_ptr<simulation> currentSimulation;
+    simulationCheckpoint checkpoint; // network state after each completed stage
+    int firstStage;                  // stages before it completed by a previous run
 };
 
 } // namespace PNM
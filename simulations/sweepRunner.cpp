@@ -0,0 +1,151 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "sweepRunner.h"
+#include "simulation.h"
+#include "builders/networkbuilder.h"
+#include "builders/networkCache.h"
+#include "network/networkmodel.h"
+#include "operations/simulationContext.h"
+#include "operations/pnmSolver.h"
+#include "misc/tools.h"
+#include "misc/taskScheduler.h"
+#include "misc/numaPlacement.h"
+
+#include <libs/boost/property_tree/ptree.hpp>
+#include <libs/boost/property_tree/ini_parser.hpp>
+
+#include <omp.h>
+
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace PNM
+{
+
+void sweepRunner::load(const std::string &path)
+{
+    boost::property_tree::ptree pt;
+    boost::property_tree::ini_parser::read_ini(path, pt);
+
+    cases.clear();
+    threads = 0;
+    for (auto &section : pt)
+    {
+        if (section.first == "Sweep")
+        {
+            threads = section.second.get<int>("threads", 0);
+            continue;
+        }
+
+        sweepCase newCase{section.first, parameterOverrides(), false};
+        for (auto &value : section.second)
+        {
+            //Only the wettability of the shared network can change, other network values need a network of the case
+            const std::string &key = value.first;
+            //Eigen's thread count is global to the process, it is set once for all the cases
+            if (key == "FluidInjection_Misc.parallelSolver")
+                throw std::invalid_argument("Sweep case " + section.first + ": parallelSolver is shared by all the cases, set it in the parameters file.\n");
+            if (key.compare(0, 17, "NetworkGeneration") == 0 && key.compare(0, 30, "NetworkGeneration_Wettability.") != 0)
+                newCase.buildsNetwork = true;
+            newCase.overrides.push_back({key, value.second.data()});
+        }
+        cases.push_back(newCase);
+    }
+}
+
+int sweepRunner::run()
+{
+    userInput::get().loadNetworkData();
+    userInput::get().loadSimulationData();
+    tools::createRequiredFolders();
+
+    std::vector<char> networkSnapshot;
+    {
+        auto builder = networkBuilder::createBuilder();
+        networkSnapshot = networkCache::serialize(builder->build());
+    }
+
+    int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    int workersNumber = std::min<int>(threads > 0 ? threads : taskScheduler::get().getWorkers(), cases.size());
+    int caseThreads = std::max(1, hardwareThreads / std::max(1, workersNumber));
+
+    //Eigen reads its global thread count in every case: it is set once, to each case's OpenMP threads
+    pnmSolver::setSharedThreads(userInput::get().parallelSolver ? 0 : 1);
+
+    //With numaAware, each running case pins its team to its own cores, from the slot it holds
+    std::mutex outputMutex;
+    std::vector<bool> slotsUsed(workersNumber, false);
+    int failures(0);
+    taskScheduler::get().parallelFor(cases.size(), workersNumber, [&](int i) {
+        int slot;
+        {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            slot = std::find(slotsUsed.begin(), slotsUsed.end(), false) - slotsUsed.begin();
+            slotsUsed[slot] = true;
+        }
+        omp_set_num_threads(caseThreads);
+        numaPlacement::setTeamCores(slot * caseThreads);
+        try
+        {
+            runCase(cases[i], networkSnapshot);
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cout << "Sweep case " << cases[i].name << " done" << std::endl;
+        }
+        catch (const std::exception &e)
+        {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cerr << "Sweep case " << cases[i].name << " failed: " << e.what() << std::endl;
+            failures++;
+        }
+
+        numaPlacement::setTeamCores(0);
+        std::lock_guard<std::mutex> lock(outputMutex);
+        slotsUsed[slot] = false;
+    });
+
+    pnmSolver::setSharedThreads(-1);
+    return failures;
+}
+
+void sweepRunner::runCase(const sweepCase &currentCase, const std::vector<char> &networkSnapshot)
+{
+    auto context = std::make_shared<simulationContext>();
+    simulationContext::scope contextScope(*context);
+
+    userInput::get().loadNetworkData(currentCase.overrides);
+    userInput::get().loadSimulationData(currentCase.overrides);
+    userInput::get().resultsFolder = "Results/" + currentCase.name;
+    userInput::get().networkStateFolder = "Network_State/" + currentCase.name;
+    userInput::get().solverThreads = 0; // the case threads, as Eigen
+    tools::createFolder(userInput::get().resultsFolder);
+    tools::createFolder(userInput::get().networkStateFolder);
+
+    //The cache is keyed by the parameters file: it would give the shared network back
+    std::shared_ptr<networkModel> network;
+    if (currentCase.buildsNetwork)
+    {
+        userInput::get().networkCache = false;
+        std::lock_guard<std::mutex> lock(buildMutex);
+        network = networkBuilder::createBuilder()->build();
+    }
+    else
+    {
+        network = networkCache::deserialize(networkSnapshot);
+        pnmOperation::get(network).assignWettabilities();
+        pnmOperation::get(network).backupWettability();
+    }
+
+    auto caseSimulation = simulation::createSimulation();
+    caseSimulation->setNetwork(network, context);
+    caseSimulation->execute();
+}
+
+} // namespace PNM
@@ -0,0 +1,57 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef SWEEPRUNNER_H
+#define SWEEPRUNNER_H
+
+#include "misc/userInput.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace PNM
+{
+
+// Parameter sweep over one network. The sweep file is an ini file whose sections are the cases, each one listing
+// "Section.key=value" replacements of Input_Data/Parameters.txt values; an optional [Sweep] section sets the number of
+// parallel cases (threads=0 for one per core). The network is built once with the parameters file; each case runs on
+// a copy of it, with the wettabilities assigned again from the case parameters, in its own simulation context and
+// writes to Results/<case>/ and Network_State/<case>/. A case replacing other network generation values (e.g. the seed)
+// builds its own network instead. Empty sections are dropped by the ini parser: a case lists at least one value.
+// The cases share the cores: the solvers of each case use its OpenMP threads. parallelSolver applies to all the cases
+// and is rejected in a case.
+class sweepRunner
+{
+  public:
+    sweepRunner() : threads(0) {}
+    ~sweepRunner() {}
+    sweepRunner(const sweepRunner &) = delete;
+    sweepRunner(sweepRunner &&) = delete;
+    auto operator=(const sweepRunner &) -> sweepRunner & = delete;
+    auto operator=(sweepRunner &&) -> sweepRunner & = delete;
+    void load(const std::string &path = "Input_Data/Sweep.txt");
+    int run(); // failed cases
+
+  protected:
+    struct sweepCase
+    {
+        std::string name;
+        parameterOverrides overrides;
+        bool buildsNetwork; // changes the network geometry
+    };
+
+    void runCase(const sweepCase &, const std::vector<char> &networkSnapshot);
+
+    std::vector<sweepCase> cases;
+    int threads;
+    std::mutex buildMutex; // the builders export to the same numSCAL_Networks files
+};
+
+} // namespace PNM
+
+#endif // SWEEPRUNNER_H
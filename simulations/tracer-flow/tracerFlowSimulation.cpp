@@ -13,8 +13,11 @@
 #include "network/cluster.h"
 #include "misc/userInput.h"
 #include "misc/tools.h"
+#include "misc/outputWriter.h"
+#include "misc/scopedtimer.h"
+#include "misc/numaPlacement.h"
+#include "misc/reproducibleSum.h"
 
-#include <unordered_map>
 #include <sstream>
 #include <iostream>
 #include <iomanip>
@@ -25,24 +28,42 @@ namespace PNM
 
 void tracerFlowSimulation::run()
 {
-    initialiseOutputFiles();
+    MEASURE_SCOPE("tracerFlowSimulation");
     initialiseCapillaries();
     initialiseSimulationAttributes();
 
+    int timeSteps(0);
+    bool resumed = userInput::get().resumeSimulation && loadCheckpoint(timeSteps);
+    if (!resumed)
+        initialiseOutputFiles();
+
     fetchNonFlowingCapillaries();
     solvePressureField();
     calculateTimeStep();
 
     while (!simulationInterrupted && timeSoFar < simulationTime)
     {
-        updateConcentrations();
+        if (userInput::get().tracerSchemeChoice == tracerScheme::explicitEuler)
+            updateConcentrations();
+        else if (userInput::get().tracerSchemeChoice == tracerScheme::multirateExplicit)
+            updateConcentrationsMultirate();
+        else
+            updateConcentrationsImplicit();
         updateVariables();
         updateOutputFiles();
         updateGUI();
 
-        if (simulationInterrupted)
+        ++timeSteps;
+        notifyStep(timeSteps);
+        if (checkpoint.isDue())
+            saveCheckpoint(timeSteps);
+
+        if (simulationInterrupted || converged || timeSteps == userInput::get().maxTimeSteps)
             break;
     }
+
+    syncConcentrations();
+    recordTermination(timeSteps);
 }
 
 std::string tracerFlowSimulation::getNotification()
@@ -61,8 +82,8 @@ int tracerFlowSimulation::getProgress()
 
 void tracerFlowSimulation::initialiseOutputFiles()
 {
-    tools::initialiseFolder("Results/Tracer_Simulation");
-    tools::initialiseFolder("Network_State/Tracer_Simulation");
+    tools::initialiseFolder(userInput::get().resultsFolder + "/Tracer_Simulation");
+    tools::initialiseFolder(userInput::get().networkStateFolder + "/Tracer_Simulation");
 }
 
 void tracerFlowSimulation::initialiseSimulationAttributes()
@@ -78,6 +99,11 @@ void tracerFlowSimulation::initialiseSimulationAttributes()
 
     auto inletFlux = userInput::get().flowRate / network->inletPoresArea;
     flowVelocity = inletFlux * 86400;
+
+    converged = false;
+    convergence.reset(userInput::get().convergenceTolerance, userInput::get().convergenceIntervals);
+
+    checkpoint.setPath(userInput::get().resultsFolder + "/Tracer_Simulation/checkpoint.numk");
 }
 
 void tracerFlowSimulation::initialiseCapillaries()
@@ -126,185 +152,414 @@ void tracerFlowSimulation::solvePressureField()
     pnmSolver::get(network).solvePressuresConstantFlowRate();
 }
 
-void tracerFlowSimulation::calculateTimeStep()
+void tracerFlowSimulation::fetchFlowingCapillaries()
 {
     hkClustering::get(network).clusterOilElements();
 
-    timeStep = 1e50;
+    flowingNodes.reset(*network);
+    flowingPores.reset(*network);
+
+    for (node *n : pnmRange<node>(network))
+        if (n->getPhaseFlag() == phase::oil && n->getClusterOil()->getSpanning())
+            flowingNodes.insert(n);
 
     for (pore *p : pnmRange<pore>(network))
-    {
         if (p->getPhaseFlag() == phase::oil && p->getClusterOil()->getSpanning())
+            flowingPores.insert(p);
+}
+
+void tracerFlowSimulation::assembleExplicitScheme()
+{
+    int totalElements = network->totalNodes + network->totalPores;
+    concentrations.resize(totalElements);
+    for (element *e : pnmRange<element>(network))
+        concentrations[e->getIndex()] = e->getConcentration();
+
+    flowingElements.clear();
+    flowingVolumes.clear();
+    flowingOutflows.clear();
+    diffusionOffsets.assign(1, 0);
+    diffusionNeighboors.clear();
+    diffusionCoefficients.clear();
+    diffusionSums.clear();
+
+    auto addFlowingElement = [this](element *e) {
+        flowingElements.push_back(e->getIndex());
+        flowingVolumes.push_back(e->getVolume());
+        flowingOutflows.push_back(std::abs(e->getFlow()));
+
+        //Diffusion
+        double sumDiffusionSource = 0;
+        for (element *neighboor : e->getNeighboors())
         {
-            //Diffusion
-            double sumDiffusionSource = 0;
-            for (element *e : p->getNeighboors())
+            if (neighboor->getPhaseFlag() == phase::oil)
             {
-                if (e->getPhaseFlag() == phase::oil)
-                {
-                    double area = std::min(e->getVolume() / e->getLength(), p->getVolume() / p->getLength());
-                    sumDiffusionSource += userInput::get().tracerDiffusionCoef / area;
-                }
+                double area = std::min(neighboor->getVolume() / neighboor->getLength(), e->getVolume() / e->getLength());
+                diffusionNeighboors.push_back(neighboor->getIndex());
+                diffusionCoefficients.push_back(userInput::get().tracerDiffusionCoef / area);
+                sumDiffusionSource += diffusionCoefficients.back();
             }
-
-            //Convection
-            if ((std::abs(p->getFlow()) / p->getVolume() + sumDiffusionSource) > 1e-30)
+        }
+        diffusionOffsets.push_back(diffusionNeighboors.size());
+        diffusionSums.push_back(sumDiffusionSource);
+    };
+
+    for (node *n : flowingNodes)
+        addFlowingElement(n);
+    for (pore *p : flowingPores)
+        addFlowingElement(p);
+
+    //Convection into the nodes: the active pores flowing towards them
+    nodesInflowOffsets.assign(1, 0);
+    nodesInflowPores.clear();
+    nodesInflowRates.clear();
+    for (node *n : flowingNodes)
+    {
+        for (element *e : n->getNeighboors())
+        {
+            pore *p = static_cast<pore *>(e);
+            if (p->getPhaseFlag() == phase::oil && p->getActive())
             {
-                double step = 1. / (std::abs(p->getFlow()) / p->getVolume() + sumDiffusionSource);
-                if (step < timeStep)
+                if ((p->getNodeIn() == n && p->getFlow() > 1e-30) || (p->getNodeOut() == n && p->getFlow() < -1e-30))
                 {
-                    timeStep = step;
+                    nodesInflowPores.push_back(p->getIndex());
+                    nodesInflowRates.push_back(std::abs(p->getFlow()));
                 }
             }
         }
+        nodesInflowOffsets.push_back(nodesInflowPores.size());
     }
 
-    for (node *p : pnmRange<node>(network))
+    //Convection into the pores: from the inlet, or a share of the upstream node outflow
+    poresInflowNodes.clear();
+    poresInflowMasses.clear();
+    poresInflowRatios.clear();
+    for (pore *p : flowingPores)
     {
-        if (p->getPhaseFlag() == phase::oil && p->getClusterOil()->getSpanning())
+        node *inflowNode = 0;
+        double massIn = 0;
+        double flowIn = 0;
+
+        if (p->getInlet())
         {
-            //Diffusion
-            double sumDiffusionSource = 0;
-            for (element *e : p->getNeighboors())
+            if (std::abs(p->getFlow()) > 1e-30 && p->getActive())
             {
-                if (e->getPhaseFlag() == phase::oil)
-                {
-                    double area = std::min(e->getVolume() / e->getLength(), p->getVolume() / p->getLength());
-                    sumDiffusionSource += userInput::get().tracerDiffusionCoef / area;
-                }
+                massIn = std::abs(p->getFlow());
+                flowIn = std::abs(p->getFlow());
             }
-
-            //Convection
-            if ((std::abs(p->getFlow()) / p->getVolume() + sumDiffusionSource) > 1e-30)
+        }
+        else if (p->getOutlet())
+        {
+            if (std::abs(p->getFlow()) > 1e-30 && p->getActive())
             {
-                double step = 1. / (std::abs(p->getFlow()) / p->getVolume() + sumDiffusionSource);
-                if (step < timeStep)
-                {
-                    timeStep = step;
-                }
+                inflowNode = p->getNodeIn() == 0 ? p->getNodeOut() : p->getNodeIn();
+                flowIn = inflowNode->getFlow();
             }
         }
+        else
+        {
+            if (p->getFlow() > 1e-30 && p->getActive() && p->getNodeOut()->getPhaseFlag() == phase::oil)
+            {
+                inflowNode = p->getNodeOut();
+                flowIn = inflowNode->getFlow();
+            }
+            if (p->getFlow() < 1e-30 && p->getActive() && p->getNodeIn()->getPhaseFlag() == phase::oil)
+            {
+                inflowNode = p->getNodeIn();
+                flowIn = inflowNode->getFlow();
+            }
+        }
+
+        if (std::abs(p->getFlow()) < 1e-30 || flowIn < 1e-30 || !p->getActive())
+        {
+            inflowNode = 0;
+            massIn = 0;
+            flowIn = 1;
+        }
+
+        poresInflowNodes.push_back(inflowNode ? inflowNode->getIndex() : -1);
+        poresInflowMasses.push_back(massIn);
+        poresInflowRatios.push_back(std::abs(p->getFlow()) / flowIn);
     }
 }
 
-void tracerFlowSimulation::updateConcentrations()
+void tracerFlowSimulation::calculateTimeStep()
 {
-    std::unordered_map<element *, double> newConcentration;
+    fetchFlowingCapillaries();
+    assembleExplicitScheme();
 
-    for (node *n : pnmRange<node>(network))
+    timeStep = 1e50;
+
+    //Convection and diffusion
+    for (unsigned k = 0; k < flowingElements.size(); ++k)
     {
-        if (n->getPhaseFlag() == phase::oil && n->getClusterOil()->getSpanning())
-        {
-            //Convection
-            double massIn = 0;
-            for (element *e : n->getNeighboors())
-            {
-                pore *p = static_cast<pore *>(e);
-                if (p->getPhaseFlag() == phase::oil && p->getActive())
-                {
-                    if ((p->getNodeIn() == n && p->getFlow() > 1e-30) || (p->getNodeOut() == n && p->getFlow() < -1e-30))
-                    {
-                        massIn += p->getConcentration() * std::abs(p->getFlow());
-                    }
-                }
-            }
-            n->setMassFlow(massIn);
+        double rate = flowingOutflows[k] / flowingVolumes[k] + diffusionSums[k];
+        if (rate > 1e-30 && 1. / rate < timeStep)
+            timeStep = 1. / rate;
+    }
 
-            //Diffusion
-            double sumDiffusionIn = 0;
-            double sumDiffusionOut = 0;
-            for (element *e : n->getNeighboors())
-            {
-                if (e->getPhaseFlag() == phase::oil)
-                {
-                    double area = std::min(e->getVolume() / e->getLength(), n->getVolume() / n->getLength());
-                    sumDiffusionIn += e->getConcentration() * userInput::get().tracerDiffusionCoef / area;
-                    sumDiffusionOut += n->getConcentration() * userInput::get().tracerDiffusionCoef / area;
-                }
-            }
+    if (userInput::get().tracerSchemeChoice == tracerScheme::multirateExplicit)
+        assignRateLevels();
+    else if (userInput::get().tracerSchemeChoice != tracerScheme::explicitEuler)
+        timeStep *= userInput::get().tracerTimeStepFactor;
 
-            //Load new concentration in a temporary vector
-            newConcentration[n] = (n->getConcentration() + (massIn - std::abs(n->getFlow()) * n->getConcentration()) * timeStep / n->getVolume() + sumDiffusionIn * timeStep - sumDiffusionOut * timeStep);
-        }
+    assembleTransportOperator();
+}
+
+void tracerFlowSimulation::assignRateLevels()
+{
+    //The time step is doubled while the slowest capillaries allow it, each capillary taking the largest stable fraction of it
+    int totalFlowing = flowingElements.size();
+    double maxStep(0);
+    for (int k = 0; k < totalFlowing; ++k)
+    {
+        double rate = flowingOutflows[k] / flowingVolumes[k] + diffusionSums[k];
+        maxStep = std::max(maxStep, rate > 1e-30 ? 1. / rate : 1e50);
     }
 
-    for (pore *p : pnmRange<pore>(network))
+    double minStep = timeStep;
+    rateLevels = 0;
+    while (rateLevels < userInput::get().tracerRateLevels && minStep * (2 << rateLevels) <= maxStep)
+        rateLevels++;
+    timeStep = minStep * (1 << rateLevels);
+
+    flowingLevels.resize(totalFlowing);
+    levelsOffsets.assign(rateLevels + 2, 0);
+    snapshotsOffsets.assign(totalFlowing + 1, 0);
+    for (int k = 0; k < totalFlowing; ++k)
     {
-        if (p->getPhaseFlag() == phase::oil && p->getClusterOil()->getSpanning())
+        double rate = flowingOutflows[k] / flowingVolumes[k] + diffusionSums[k];
+        int level = 0;
+        while (level < rateLevels && timeStep / (1 << level) * rate > 1)
+            level++;
+        flowingLevels[k] = level;
+        levelsOffsets[level + 1]++;
+        snapshotsOffsets[k + 1] = snapshotsOffsets[k] + level + 1;
+    }
+    for (int l = 0; l <= rateLevels; ++l)
+        levelsOffsets[l + 1] += levelsOffsets[l];
+
+    levelsElements.resize(totalFlowing);
+    std::vector<int> fill(levelsOffsets.begin(), levelsOffsets.end() - 1);
+    for (int k = 0; k < totalFlowing; ++k)
+        levelsElements[fill[flowingLevels[k]]++] = k;
+
+    integralSnapshots.resize(snapshotsOffsets.back());
+    concentrationIntegrals.resize(totalFlowing);
+}
+
+void tracerFlowSimulation::assembleTransportOperator()
+{
+    int totalFlowingNodes = flowingNodes.size();
+    int totalFlowing = flowingElements.size();
+    bool multirateScheme = userInput::get().tracerSchemeChoice == tracerScheme::multirateExplicit;
+    bool explicitScheme = userInput::get().tracerSchemeChoice == tracerScheme::explicitEuler || multirateScheme;
+    double theta = explicitScheme ? 0 : userInput::get().tracerSchemeChoice == tracerScheme::crankNicolson ? 0.5 : 1;
+
+    std::vector<int> positions(network->totalNodes + network->totalPores, -1);
+    for (int k = 0; k < totalFlowing; ++k)
+        positions[flowingElements[k]] = k;
+
+    //The terms of the explicit scheme: capillaries outside the flowing ones keep their concentrations
+    std::vector<Eigen::Triplet<double>> triplets;
+    Eigen::VectorXd sources = Eigen::VectorXd::Zero(totalFlowing);
+    auto addTerm = [&](int k, int index, double coefficient) {
+        if (positions[index] != -1)
+            triplets.push_back(Eigen::Triplet<double>(k, positions[index], coefficient));
+        else
+            sources[k] += coefficient * concentrations[index];
+    };
+
+    for (int k = 0; k < totalFlowing; ++k)
+    {
+        triplets.push_back(Eigen::Triplet<double>(k, k, -flowingOutflows[k] / flowingVolumes[k] - diffusionSums[k]));
+        for (int j = diffusionOffsets[k]; j < diffusionOffsets[k + 1]; ++j)
+            addTerm(k, diffusionNeighboors[j], diffusionCoefficients[j]);
+    }
+
+    for (int i = 0; i < totalFlowingNodes; ++i)
+        for (int j = nodesInflowOffsets[i]; j < nodesInflowOffsets[i + 1]; ++j)
+            addTerm(i, nodesInflowPores[j], nodesInflowRates[j] / flowingVolumes[i]);
+
+    //Pores take a share of the mass flowing into their feeding node
+    for (int k = totalFlowingNodes; k < totalFlowing; ++k)
+    {
+        int i = k - totalFlowingNodes;
+        double ratio = poresInflowRatios[i] / flowingVolumes[k];
+        if (poresInflowNodes[i] == -1)
         {
-            double massIn = 0;
-            double flowIn = 0;
-            double sumDiffusionIn = 0;
-            double sumDiffusionOut = 0;
+            sources[k] += ratio * poresInflowMasses[i];
+            continue;
+        }
 
-            //Convection
-            if (p->getInlet())
-            {
-                if (std::abs(p->getFlow()) > 1e-30 && p->getActive())
-                {
-                    massIn = std::abs(p->getFlow());
-                    flowIn = std::abs(p->getFlow());
-                }
-            }
-            else if (p->getOutlet())
-            {
-                if (std::abs(p->getFlow()) > 1e-30 && p->getActive())
-                {
-                    node *activeNode = p->getNodeIn() == 0 ? p->getNodeOut() : p->getNodeIn();
-                    massIn = activeNode->getMassFlow();
-                    flowIn = activeNode->getFlow();
-                }
-            }
-            else
-            {
-                if (p->getFlow() > 1e-30 && p->getActive() && p->getNodeOut()->getPhaseFlag() == phase::oil)
-                {
-                    massIn = p->getNodeOut()->getMassFlow();
-                    flowIn = p->getNodeOut()->getFlow();
-                }
-                if (p->getFlow() < 1e-30 && p->getActive() && p->getNodeIn()->getPhaseFlag() == phase::oil)
-                {
-                    massIn = p->getNodeIn()->getMassFlow();
-                    flowIn = p->getNodeIn()->getFlow();
-                }
-            }
+        //A feeding node outside the flowing capillaries carries no tracer mass
+        int n = positions[poresInflowNodes[i]];
+        if (n == -1)
+            continue;
+        for (int j = nodesInflowOffsets[n]; j < nodesInflowOffsets[n + 1]; ++j)
+            addTerm(k, nodesInflowPores[j], ratio * nodesInflowRates[j]);
+    }
 
-            if (std::abs(p->getFlow()) < 1e-30 || flowIn < 1e-30 || !p->getActive())
-            {
-                massIn = 0;
-                flowIn = 1;
-            }
+    Eigen::SparseMatrix<double> transportOperator(totalFlowing, totalFlowing);
+    transportOperator.setFromTriplets(triplets.begin(), triplets.end());
 
-            //Diffusion
-            for (element *e : p->getNeighboors())
-            {
-                if (e->getPhaseFlag() == phase::oil)
-                {
-                    double area = std::min(e->getVolume() / e->getLength(), p->getVolume() / p->getLength());
-                    sumDiffusionIn += e->getConcentration() * userInput::get().tracerDiffusionCoef / area;
-                    sumDiffusionOut += p->getConcentration() * userInput::get().tracerDiffusionCoef / area;
-                }
-            }
+    Eigen::SparseMatrix<double> identity(totalFlowing, totalFlowing);
+    identity.setIdentity();
+
+    explicitOperator = identity + (1 - theta) * timeStep * transportOperator;
+    implicitSources = timeStep * sources;
+
+    if (multirateScheme)
+    {
+        rateOperator = transportOperator;
+        rateSources = sources;
+    }
 
-            //Load new concentration in a temporary vector
-            newConcentration[p] = (p->getConcentration() + (std::abs(p->getFlow()) / flowIn * massIn - std::abs(p->getFlow()) * p->getConcentration()) * timeStep / p->getVolume() + sumDiffusionIn * timeStep - sumDiffusionOut * timeStep);
+    if (!explicitScheme)
+    {
+        Eigen::SparseMatrix<double> implicitOperator = identity - theta * timeStep * transportOperator;
+        implicitSolver.analyzePattern(implicitOperator);
+        implicitSolver.factorize(implicitOperator);
+        if (implicitSolver.info() != Eigen::Success)
+        {
+            simulationInterrupted = true;
+            std::cout << "ERROR: Tracer transport system factorization failed" << std::endl;
         }
     }
 
-    //Update concentrations
-    for (element *e : pnmRange<element>(network))
+    flowingConcentrations.resize(totalFlowing);
+    for (int k = 0; k < totalFlowing; ++k)
+        flowingConcentrations[k] = concentrations[flowingElements[k]];
+    stepConcentrations.setZero(totalFlowing);
+
+    //The operators rows and the concentrations go to the threads updating them
+    for (auto *matrix : {&explicitOperator, &rateOperator})
+        if (matrix->rows() == totalFlowing)
+        {
+            numaPlacement::distributeRows(matrix->valuePtr(), matrix->outerIndexPtr(), totalFlowing);
+            numaPlacement::distributeRows(matrix->innerIndexPtr(), matrix->outerIndexPtr(), totalFlowing);
+        }
+    for (auto *values : {&flowingConcentrations, &stepConcentrations, &implicitSources})
+        numaPlacement::distribute(values->data(), totalFlowing);
+}
+
+void tracerFlowSimulation::updateConcentrations()
+{
+    //Explicit scheme: each capillary only reads the concentrations of the previous time step, through the rows of the
+    //operator (row-major products run in parallel)
+    stepConcentrations.noalias() = explicitOperator * flowingConcentrations;
+    stepConcentrations += implicitSources;
+    flowingConcentrations.swap(stepConcentrations);
+
+    checkConcentrations();
+}
+
+void tracerFlowSimulation::updateConcentrationsImplicit()
+{
+    if (simulationInterrupted)
+        return;
+
+    stepConcentrations.noalias() = explicitOperator * flowingConcentrations;
+    stepConcentrations += implicitSources;
+    flowingConcentrations = implicitSolver.solve(stepConcentrations);
+
+    checkConcentrations();
+}
+
+void tracerFlowSimulation::updateConcentrationsMultirate()
+{
+    const int *rowsOffsets = rateOperator.outerIndexPtr();
+    const int *columns = rateOperator.innerIndexPtr();
+    const double *values = rateOperator.valuePtr();
+    int totalFlowing = flowingConcentrations.size();
+    int substeps = 1 << rateLevels;
+    int threads = Eigen::nbThreads();
+
+    concentrationIntegrals.setZero();
+    std::fill(integralSnapshots.begin(), integralSnapshots.end(), 0.);
+
+    for (int s = 1; s <= substeps; ++s)
     {
-        if (e->getPhaseFlag() == phase::oil && e->getClusterOil()->getSpanning())
+        //The steps of the levels from firstLevel to the finest end with this substep, their capillaries being contiguous
+        int firstLevel = rateLevels;
+        while (firstLevel > 0 && s % (2 << (rateLevels - firstLevel)) == 0)
+            firstLevel--;
+        int first = levelsOffsets[firstLevel];
+
+#pragma omp parallel for if (threads > 1) num_threads(threads)
+        for (int i = first; i < totalFlowing; ++i)
+        {
+            int k = levelsElements[i];
+            concentrationIntegrals[k] += flowingConcentrations[k] * timeStep / (1 << flowingLevels[k]);
+        }
+
+#pragma omp parallel for if (threads > 1) num_threads(threads)
+        for (int i = first; i < totalFlowing; ++i)
         {
-            e->setConcentration(newConcentration[e]);
-            //  std::cout << e->getConcentration() <<" "<<e->getFlow() << std::endl;
-            if (e->getConcentration() < -0.00001 || e->getConcentration() > 1.0001)
+            int k = levelsElements[i];
+            int level = flowingLevels[k];
+            double step = timeStep / (1 << level);
+
+            double rate = rateSources[k];
+            for (int j = rowsOffsets[k]; j < rowsOffsets[k + 1]; ++j)
             {
-                simulationInterrupted = true;
-                std::cout << "ERROR: Concentration out of range: " << e->getConcentration() << std::endl;
+                int n = columns[j];
+                double concentration = flowingLevels[n] >= level ? (concentrationIntegrals[n] - integralSnapshots[snapshotsOffsets[n] + level]) / step
+                                                                 : flowingConcentrations[n];
+                rate += values[j] * concentration;
             }
+            stepConcentrations[k] = flowingConcentrations[k] + step * rate;
+        }
+
+#pragma omp parallel for if (threads > 1) num_threads(threads)
+        for (int i = first; i < totalFlowing; ++i)
+        {
+            int k = levelsElements[i];
+            flowingConcentrations[k] = stepConcentrations[k];
+            for (int l = firstLevel; l <= flowingLevels[k]; ++l)
+                integralSnapshots[snapshotsOffsets[k] + l] = concentrationIntegrals[k];
         }
     }
+
+    checkConcentrations();
+}
+
+void tracerFlowSimulation::checkConcentrations()
+{
+    int totalFlowing = flowingConcentrations.size();
+    bool outOfRange = false;
+
+#pragma omp parallel for reduction(|| : outOfRange)
+    for (int k = 0; k < totalFlowing; ++k)
+        if (flowingConcentrations[k] < -0.00001 || flowingConcentrations[k] > 1.0001)
+            outOfRange = true;
+
+    if (!outOfRange)
+        return;
+
+    simulationInterrupted = true;
+    for (int k = 0; k < totalFlowing; ++k)
+        if (flowingConcentrations[k] < -0.00001 || flowingConcentrations[k] > 1.0001)
+            std::cout << "ERROR: Concentration out of range: " << flowingConcentrations[k] << std::endl;
+}
+
+void tracerFlowSimulation::syncConcentrations()
+{
+    int totalFlowing = flowingConcentrations.size();
+
+#pragma omp parallel for
+    for (int k = 0; k < totalFlowing; ++k)
+    {
+        int index = flowingElements[k];
+        concentrations[index] = flowingConcentrations[k];
+        element *e = index < network->totalNodes ? static_cast<element *>(network->getNode(index)) : network->getPore(index - network->totalNodes);
+        e->setConcentration(concentrations[index]);
+    }
+}
+
+void tracerFlowSimulation::synchroniseState()
+{
+    syncConcentrations();
 }
 
 void tracerFlowSimulation::updateVariables()
@@ -318,9 +573,60 @@ void tracerFlowSimulation::updateOutputFiles()
     if (std::abs(outputCounter - injectedPVs) < 0.01)
         return;
 
+    syncConcentrations();
     generateNetworkStateFiles();
 
     outputCounter = injectedPVs;
+
+    //The outlet concentration is flat before the breakthrough as well
+    double outletConcentration = getOutletConcentration();
+    converged = convergence.update(injectedPVs, {outletConcentration}) && outletConcentration > 0;
+}
+
+double tracerFlowSimulation::getOutletConcentration()
+{
+    //Flow-weighted average over the flowing outlet pores
+    const std::vector<pore *> &outletPores = network->outletPores;
+    auto outletFlow = [&outletPores](int i) {
+        pore *p = outletPores[i];
+        return p->getActive() && p->getPhaseFlag() == phase::oil && std::abs(p->getFlow()) > 1e-30 ? std::abs(p->getFlow()) : 0.;
+    };
+    double massFlow = reproducibleSum(outletPores.size(), [&](int i) { return outletFlow(i) * outletPores[i]->getConcentration(); });
+    double flow = reproducibleSum(outletPores.size(), outletFlow);
+    return flow > 0 ? massFlow / flow : 0;
+}
+
+void tracerFlowSimulation::recordTermination(int timeSteps)
+{
+    std::string reason = converged ? "outlet concentration plateau"
+                                   : simulationInterrupted ? "interrupted"
+                                                           : timeSteps == userInput::get().maxTimeSteps && timeSteps > 0 ? "maximum time steps" : "simulation time";
+
+    std::cout << "Tracer simulation stopped: " << reason << std::endl;
+    std::string terminationFilename = userInput::get().resultsFolder + "/Tracer_Simulation/termination.txt";
+    outputWriter::get().createFile(terminationFilename, "reason\tinjectedPvs\ttimeSteps\n");
+    outputWriter::get().appendRow(terminationFilename, reason, injectedPVs, timeSteps);
+}
+
+bool tracerFlowSimulation::loadCheckpoint(int &timeSteps)
+{
+    //The restored concentrations are read from the elements when the transport operator is assembled
+    std::vector<double> variables(5);
+    if (!checkpoint.load(network, variables))
+        return false;
+
+    timeSoFar = variables[0];
+    injectedPVs = variables[1];
+    outputCounter = variables[2];
+    frameCount = int(variables[3]);
+    timeSteps = int(variables[4]);
+    return true;
+}
+
+void tracerFlowSimulation::saveCheckpoint(int timeSteps)
+{
+    syncConcentrations();
+    checkpoint.save(network, {timeSoFar, injectedPVs, outputCounter, double(frameCount), double(timeSteps)}, {});
 }
 
 void tracerFlowSimulation::generateNetworkStateFiles()
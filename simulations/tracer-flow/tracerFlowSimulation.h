@@ -9,6 +9,12 @@
 #define TRACERFLOWSIMULATION_H
 
 #include "simulations/simulation.h"
+#include "simulations/simulationCheckpoint.h"
+#include "simulations/convergenceMonitor.h"
+#include "network/frontier.h"
+
+#include <libs/Eigen/Sparse>
+#include <libs/Eigen/SparseLU>
 
 namespace PNM
 {
@@ -33,11 +39,24 @@ class tracerFlowSimulation : public simulation
     void setInitialAttributes();
     void fetchNonFlowingCapillaries();
     void solvePressureField();
+    void fetchFlowingCapillaries();
+    void assembleExplicitScheme();
+    void assembleTransportOperator();
     void calculateTimeStep();
+    void assignRateLevels();
     void updateConcentrations();
+    void updateConcentrationsImplicit();
+    void updateConcentrationsMultirate();
+    void checkConcentrations();
+    void syncConcentrations();
+    void synchroniseState() override;
     void updateVariables();
     void updateOutputFiles();
     void generateNetworkStateFiles();
+    bool loadCheckpoint(int &);
+    void saveCheckpoint(int);
+    double getOutletConcentration();
+    void recordTermination(int);
 
     double simulationTime;
     double timeSoFar;
@@ -46,6 +65,56 @@ class tracerFlowSimulation : public simulation
     double flowVelocity;
     double outputCounter;
     int frameCount;
+    bool converged;
+    frontier<node> flowingNodes; // oil-filled capillaries of the spanning oil clusters
+    frontier<pore> flowingPores;
+    simulationCheckpoint checkpoint;
+    convergenceMonitor convergence; // outlet concentration plateau, after the breakthrough
+
+    // Concentrations by element index, as of the last synchronisation with the elements
+    std::vector<double> concentrations;
+
+    // Explicit scheme coefficients, computed once since the flow field is frozen. The flowing capillaries are
+    // numbered as the flowing nodes followed by the flowing pores.
+    std::vector<int> flowingElements;          // element index
+    std::vector<double> flowingVolumes;        // capillary volume
+    std::vector<double> flowingOutflows;       // absolute flow through the capillary
+    std::vector<int> diffusionOffsets;         // CSR: diffusion neighboors of the capillary k are diffusionNeighboors[diffusionOffsets[k]] .. [diffusionOffsets[k + 1] - 1]
+    std::vector<int> diffusionNeighboors;      // element index of the oil-filled neighboors
+    std::vector<double> diffusionCoefficients; // tracerDiffusionCoef / area of the exchange
+    std::vector<double> diffusionSums;         // sum of the exchanges coefficients of the capillary
+    std::vector<int> nodesInflowOffsets;       // CSR: pores flowing into the node i are nodesInflowPores[nodesInflowOffsets[i]] .. [nodesInflowOffsets[i + 1] - 1]
+    std::vector<int> nodesInflowPores;         // element index of the pore
+    std::vector<double> nodesInflowRates;      // absolute flow of the pore
+    std::vector<int> poresInflowNodes;         // node index feeding the pore, -1 if fed by the inlet or not fed
+    std::vector<double> poresInflowMasses;     // tracer mass entering the pore from the inlet
+    std::vector<double> poresInflowRatios;     // share of the feeding node outflow taken by the pore
+
+    // Transport over the flowing capillaries, dc/dt = A c + s, integrated as (I - theta dt A) c' = (I + (1 - theta) dt A) c + dt s:
+    // theta = 0 is the explicit scheme, a single sparse product per time step, otherwise the factorization is reused
+    // at every time step. The concentrations stay in the compact vector between time steps, the elements and the
+    // concentrations by element index being only synchronised for the outputs and the GUI updates.
+    Eigen::SparseLU<Eigen::SparseMatrix<double>> implicitSolver;
+    Eigen::SparseMatrix<double, Eigen::RowMajor> explicitOperator; // I + (1 - theta) dt A
+    Eigen::VectorXd implicitSources;                               // dt s
+    Eigen::VectorXd flowingConcentrations;
+    Eigen::VectorXd stepConcentrations; // buffer of the next time step
+
+    // Multirate explicit scheme: the flowing capillaries are binned by their stable time step, the level l taking
+    // 2^l steps of timeStep / 2^l. A capillary reads its finer (or same level) neighboors averaged over its own step,
+    // from their integrals, and its coarser ones at the value they hold over their step: the mass exchanged between
+    // levels is the same on both sides.
+    Eigen::SparseMatrix<double, Eigen::RowMajor> rateOperator; // A
+    Eigen::VectorXd rateSources;                               // s
+    int rateLevels;                                            // finest level
+    std::vector<int> flowingLevels;
+    std::vector<int> levelsOffsets; // CSR: capillaries of the level l are levelsElements[levelsOffsets[l]] .. [levelsOffsets[l + 1] - 1]
+    std::vector<int> levelsElements;
+    std::vector<int> snapshotsOffsets;     // integral of the capillary k at the start of its current step of level l <= its level: integralSnapshots[snapshotsOffsets[k] + l]
+    std::vector<double> integralSnapshots;
+    Eigen::VectorXd concentrationIntegrals; // since the start of the time step
+
+    friend class tracerFlowTests; // transport assembly checks, tests/tracerFlowTests.cpp
 };
 
 } // namespace PNM
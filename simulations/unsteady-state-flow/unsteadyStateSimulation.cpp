@@ -13,10 +13,13 @@
 #include "network/cluster.h"
 #include "misc/userInput.h"
 #include "misc/tools.h"
+#include "misc/outputWriter.h"
 #include "misc/maths.h"
 #include "misc/scopedtimer.h"
+#include "misc/reproducibleSum.h"
 
 #include <vector>
+#include <algorithm>
 #include <sstream>
 #include <iostream>
 #include <iomanip>
@@ -27,10 +30,15 @@ namespace PNM
 
 void unsteadyStateSimulation::run()
 {
-    initialiseOutputFiles();
+    MEASURE_SCOPE("unsteadyStateSimulation");
     initialiseCapillaries();
     initialiseSimulationAttributes();
 
+    int timeSteps(0);
+    bool resumed = userInput::get().resumeSimulation && loadCheckpoint(timeSteps);
+    if (!resumed)
+        initialiseOutputFiles();
+
     while (!simulationInterrupted && timeSoFar < simulationTime)
     {
         fetchTrappedCapillaries();
@@ -44,9 +52,16 @@ void unsteadyStateSimulation::run()
         updateOutputFiles();
         updateGUI();
 
-        if (simulationInterrupted)
+        ++timeSteps;
+        notifyStep(timeSteps);
+        if (checkpoint.isDue())
+            saveCheckpoint(timeSteps);
+
+        if (simulationInterrupted || converged || timeSteps == userInput::get().maxTimeSteps)
             break;
     }
+
+    recordTermination(timeSteps);
 }
 
 std::string unsteadyStateSimulation::getNotification()
@@ -65,33 +80,23 @@ int unsteadyStateSimulation::getProgress()
 
 void unsteadyStateSimulation::initialiseOutputFiles()
 {
-    tools::initialiseFolder("Results/USS_Simulation");
-    tools::initialiseFolder("Network_State/USS_Simulation");
-
-    satFilename = "Results/USS_Simulation/saturations.txt";
-    fractionalFilename = "Results/USS_Simulation/fractionalFlows.txt";
-    pressureFilename = "Results/USS_Simulation/deltaP.txt";
-
-    std::ofstream file;
-
-    file.open(satFilename.c_str());
-    file << "injectedPvs\tSw\n";
-    file.close();
-
-    file.open(fractionalFilename.c_str());
-    file << "injectedPvs\tFo\tFw\n";
-    file.close();
+    tools::initialiseFolder(userInput::get().resultsFolder + "/USS_Simulation");
+    tools::initialiseFolder(userInput::get().networkStateFolder + "/USS_Simulation");
 
-    file.open(pressureFilename.c_str());
-    file << "injectedPvs\tdeltaP(psi)\n";
-    file.close();
+    outputWriter::get().createSeries(satFilename, "injectedPvs\tSw\n");
+    outputWriter::get().createSeries(fractionalFilename, "injectedPvs\tFo\tFw\n");
+    outputWriter::get().createSeries(pressureFilename, "injectedPvs\tdeltaP(psi)\n");
 }
 
 void unsteadyStateSimulation::initialiseCapillaries()
 {
     pnmOperation::get(network).setSwi();
+    pnmOperation::get(network).assignEntryPressures();
+    poresToCheck.reset(*network);
+    nodesToCheck.reset(*network);
     addWaterChannel();
     setInitialTerminalFlags();
+    nodesPhaseNeighboors.reset(*network);
 }
 
 void unsteadyStateSimulation::initialiseSimulationAttributes()
@@ -111,6 +116,13 @@ void unsteadyStateSimulation::initialiseSimulationAttributes()
     flowVelocity = inletFlux * 86400;
 
     updatePressureCalculation = true;
+    converged = false;
+    convergence.reset(userInput::get().convergenceTolerance, userInput::get().convergenceIntervals);
+
+    satFilename = userInput::get().resultsFolder + "/USS_Simulation/saturations.txt";
+    fractionalFilename = userInput::get().resultsFolder + "/USS_Simulation/fractionalFlows.txt";
+    pressureFilename = userInput::get().resultsFolder + "/USS_Simulation/deltaP.txt";
+    checkpoint.setPath(userInput::get().resultsFolder + "/USS_Simulation/checkpoint.numk");
 }
 
 void unsteadyStateSimulation::addWaterChannel()
@@ -174,7 +186,7 @@ void unsteadyStateSimulation::setInitialTerminalFlags()
 
 void unsteadyStateSimulation::fetchTrappedCapillaries()
 {
-    //MEASURE_FUNCTION(); //Profiling
+    MEASURE_FUNCTION();
 
     if (!updatePressureCalculation)
         return;
@@ -245,7 +257,7 @@ void unsteadyStateSimulation::fetchTrappedCapillaries()
 
 void unsteadyStateSimulation::updateCapillaryPropreties()
 {
-    //MEASURE_FUNCTION(); //Profiling
+    MEASURE_FUNCTION();
 
     if (!updatePressureCalculation)
         return;
@@ -287,12 +299,12 @@ void unsteadyStateSimulation::updateCapillaryPropreties()
                 if (!p->getInlet() && !p->getOutlet() && p->getNodeIn() != 0 && p->getNodeOut() != 0)
                 {
                     if (p->getNodeOut()->getPhaseFlag() == phase::oil && p->getNodeIn()->getPhaseFlag() == phase::water)
-                        p->setCapillaryPressure(p->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * cos(p->getTheta()) / p->getRadius());
+                        p->setCapillaryPressure(p->getEntryPressure());
                 }
                 if (!p->getInlet() && !p->getOutlet() && p->getNodeIn() != 0 && p->getNodeOut() != 0)
                 {
                     if (p->getNodeOut()->getPhaseFlag() == phase::water && p->getNodeIn()->getPhaseFlag() == phase::oil)
-                        p->setCapillaryPressure(-p->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * cos(p->getTheta()) / p->getRadius());
+                        p->setCapillaryPressure(-p->getEntryPressure());
                 }
             }
         }
@@ -317,39 +329,36 @@ void unsteadyStateSimulation::updateCapillaryPropreties()
                     if (nodeOut->getPhaseFlag() == phase::oil && nodeIn->getPhaseFlag() == phase::water)
                     {
                         //pore filling mechanism
-                        int oilNeighboorsNumber(0);
-                        for (element *n : nodeOut->getNeighboors())
-                            if (n->getPhaseFlag() == phase::oil)
-                                oilNeighboorsNumber++;
+                        int oilNeighboorsNumber = nodesPhaseNeighboors.count(nodeOut, phase::oil);
 
                         if (nodeOut->getTheta() > maths::pi() / 2) //drainage
-                            p->setCapillaryPressure(nodeOut->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * cos(nodeOut->getTheta()) / nodeOut->getRadius());
+                            p->setCapillaryPressure(nodeOut->getEntryPressure());
                         if (nodeOut->getTheta() < maths::pi() / 2) //imbibition
-                            p->setCapillaryPressure(nodeOut->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * cos(nodeOut->getTheta()) / nodeOut->getRadius() - oilNeighboorsNumber * userInput::get().OWSurfaceTension / nodeOut->getRadius());
+                            p->setCapillaryPressure(nodeOut->getEntryPressure() - oilNeighboorsNumber * userInput::get().OWSurfaceTension / nodeOut->getRadius());
                     }
 
                     if (nodeOut->getPhaseFlag() == phase::water && nodeIn->getPhaseFlag() == phase::oil)
                     {
                         //pore filling mechanism
-                        int oilNeighboorsNumber(0);
-                        for (element *n : nodeIn->getNeighboors())
-                            if (n->getPhaseFlag() == phase::oil)
-                                oilNeighboorsNumber++;
+                        int oilNeighboorsNumber = nodesPhaseNeighboors.count(nodeIn, phase::oil);
 
                         if (nodeIn->getTheta() > maths::pi() / 2) //drainage
-                            p->setCapillaryPressure(-nodeIn->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * cos(nodeIn->getTheta()) / nodeIn->getRadius());
+                            p->setCapillaryPressure(-nodeIn->getEntryPressure());
                         if (nodeIn->getTheta() < maths::pi() / 2) //imbibition
-                            p->setCapillaryPressure(-nodeIn->getEntryPressureCoefficient() * userInput::get().OWSurfaceTension * cos(nodeIn->getTheta()) / nodeIn->getRadius() + oilNeighboorsNumber * userInput::get().OWSurfaceTension / nodeIn->getRadius());
+                            p->setCapillaryPressure(-nodeIn->getEntryPressure() + oilNeighboorsNumber * userInput::get().OWSurfaceTension / nodeIn->getRadius());
                     }
                 }
             }
         }
     }
+
+    //visit the nodes in table order
+    nodesToCheck.sort();
 }
 
 void unsteadyStateSimulation::solvePressureField()
 {
-    //MEASURE_FUNCTION(); //Profiling
+    MEASURE_FUNCTION();
 
     if (!updatePressureCalculation)
         return;
@@ -388,61 +397,83 @@ void unsteadyStateSimulation::solvePressureField()
             }
         }
     }
+
+    //With several fillings per step, the flows only change with the next phase change or when water first reaches a
+    //node, which can close the oil pores around it. A single filling per step re-solves at every step.
+    if (userInput::get().maxFillingEventsPerStep > 1)
+        updatePressureCalculation = false;
 }
 
 void unsteadyStateSimulation::calculateTimeStep()
 {
-    //MEASURE_FUNCTION(); //Profiling
+    MEASURE_FUNCTION();
 
-    timeStep = 1e50;
-    for (pore *p : poresToCheck)
+    auto fillingTime = [](element *p) {
+        return p->getActive() && std::abs(p->getFlow()) > 1e-50 ? p->getVolume() * p->getOilFraction() / std::abs(p->getFlow()) : 1e50;
+    };
+    int checkedPores = poresToCheck.size();
+    timeStep = reproducibleMin(checkedPores + nodesToCheck.size(), [&](int i) {
+        return i < checkedPores ? fillingTime(poresToCheck[i]) : fillingTime(nodesToCheck[i - checkedPores]);
+    }, 1e50);
+
+    if (userInput::get().maxFillingEventsPerStep > 1)
+        timeStep = getMultipleFillingsTimeStep(timeStep);
+
+    if (hkClustering::get(network).isWaterSpanning) //if water is forming a spanning cluster
     {
-        if (p->getActive() && std::abs(p->getFlow()) > 1e-50)
-        {
-            double step = p->getVolume() * p->getOilFraction() / std::abs(p->getFlow());
-            if (step < timeStep)
-                timeStep = step;
-        }
+        double timeRequiredToFillOneTenthPV = network->totalNetworkVolume / userInput::get().flowRate / 10;
+        timeStep = std::min(timeStep, timeRequiredToFillOneTenthPV);
     }
+}
 
-    for (node *p : nodesToCheck)
-    {
+double unsteadyStateSimulation::getMultipleFillingsTimeStep(double shortestFillingTime)
+{
+    //extend the step to the other fillings within the tolerance, up to the allowed number of fillings
+    double maxFillingTime = shortestFillingTime * (1 + userInput::get().fillingTimeTolerance);
+    unsigned maxFillings = userInput::get().maxFillingEventsPerStep;
+
+    fillingTimes.clear();
+    auto addFillingTime = [this, maxFillingTime](element *p) {
         if (p->getActive() && std::abs(p->getFlow()) > 1e-50)
         {
             double step = p->getVolume() * p->getOilFraction() / std::abs(p->getFlow());
-            if (step < timeStep)
-                timeStep = step;
+            if (step <= maxFillingTime)
+                fillingTimes.push_back(step);
         }
-    }
+    };
+    for (pore *p : poresToCheck)
+        addFillingTime(p);
+    for (node *p : nodesToCheck)
+        addFillingTime(p);
 
-    if (hkClustering::get(network).isWaterSpanning) //if water is forming a spanning cluster
+    if (fillingTimes.empty())
+        return shortestFillingTime;
+
+    if (fillingTimes.size() > maxFillings)
     {
-        double timeRequiredToFillOneTenthPV = network->totalNetworkVolume / userInput::get().flowRate / 10;
-        timeStep = std::min(timeStep, timeRequiredToFillOneTenthPV);
+        std::nth_element(fillingTimes.begin(), fillingTimes.begin() + maxFillings - 1, fillingTimes.end());
+        return fillingTimes[maxFillings - 1];
     }
+
+    return *std::max_element(fillingTimes.begin(), fillingTimes.end());
 }
 
 void unsteadyStateSimulation::updateFluidFractions()
 {
-    //MEASURE_FUNCTION(); //Profiling
+    MEASURE_FUNCTION();
+
+    //with several fillings per step, the capillaries filling before the end of the step pass the rest of their water on
+    bool multipleFillings = userInput::get().maxFillingEventsPerStep > 1;
+    waterIncrements.clear();
+    excessWater.clear();
 
     for (pore *p : poresToCheck)
     {
         if (p->getActive() && std::abs(p->getFlow()) > 1e-50)
         {
-            double incrementalWater = std::abs(p->getFlow()) * timeStep;
-            currentSw += incrementalWater / network->totalNetworkVolume;
-
-            p->setWaterFraction(p->getWaterFraction() + incrementalWater / p->getVolume());
-            p->setOilFraction(1 - p->getWaterFraction());
-
-            if (p->getWaterFraction() > 1 - 1e-8)
-            {
-                p->setPhaseFlag(phase::water);
-                p->setWaterFraction(1);
-                p->setOilFraction(0);
-                updatePressureCalculation = true;
-            }
+            double excess = addWater(p, std::abs(p->getFlow()) * timeStep, multipleFillings);
+            if (excess > 0)
+                excessWater.push_back({p, excess});
         }
     }
 
@@ -450,26 +481,97 @@ void unsteadyStateSimulation::updateFluidFractions()
     {
         if (p->getActive() && std::abs(p->getFlow()) > 1e-50)
         {
-            double incrementalWater = std::abs(p->getFlow()) * timeStep;
-            currentSw += incrementalWater / network->totalNetworkVolume;
+            double excess = addWater(p, std::abs(p->getFlow()) * timeStep, multipleFillings);
+            if (excess > 0)
+                excessWater.push_back({p, excess});
+        }
+    }
 
-            p->setWaterFraction(p->getWaterFraction() + incrementalWater / p->getVolume());
-            p->setOilFraction(1 - p->getWaterFraction());
+    for (auto &excess : excessWater)
+        carryExcessWater(excess.first, excess.second);
 
-            if (p->getWaterFraction() > 1 - 1e-8)
-            {
-                p->setPhaseFlag(phase::water);
-                p->setWaterFraction(1);
-                p->setOilFraction(0);
-                updatePressureCalculation = true;
-            }
-        }
+    //The step water is summed apart from the running saturation, in an order independent of the threads
+    currentSw += reproducibleSum(waterIncrements.size(), [this](int i) { return waterIncrements[i]; }) / network->totalNetworkVolume;
+}
+
+double unsteadyStateSimulation::addWater(element *e, double water, bool capped)
+{
+    //returns the water beyond the oil volume of the capillary, kept by the capillary unless capped
+    double incrementalWater = capped ? std::min(water, e->getVolume() * e->getOilFraction()) : water;
+    waterIncrements.push_back(incrementalWater);
+
+    bool wasDry = e->getWaterFraction() <= 1e-20;
+    e->setWaterFraction(e->getWaterFraction() + incrementalWater / e->getVolume());
+    e->setOilFraction(1 - e->getWaterFraction());
+
+    //water reaching a node closes the oil pores it flows into
+    if (wasDry && e->getWaterFraction() > 1e-20 && e->getType() == capillaryType::poreBody)
+        updatePressureCalculation = true;
+
+    if (e->getWaterFraction() > 1 - 1e-8)
+    {
+        phase previous = e->getPhaseFlag();
+        e->setPhaseFlag(phase::water);
+        if (e->getType() == capillaryType::throat)
+            nodesPhaseNeighboors.update(static_cast<pore *>(e), previous);
+        e->setWaterFraction(1);
+        e->setOilFraction(0);
+        updatePressureCalculation = true;
+    }
+
+    return water - incrementalWater;
+}
+
+void unsteadyStateSimulation::carryExcessWater(element *filled, double water)
+{
+    //The water of a filled capillary flows on into the oil capillaries downstream, as after a pressure solve at its
+    //filling. Water flowing into water capillaries is already counted by the fillings downstream of them, and water
+    //reaching the outlet is produced.
+    std::vector<std::pair<element *, double>> downstream;
+    if (filled->getType() == capillaryType::throat)
+    {
+        pore *p = static_cast<pore *>(filled);
+        node *n = p->getFlow() > 0 ? p->getNodeIn() : p->getNodeOut();
+        if (n != 0)
+            downstream.push_back({n, water});
+    }
+    else
+    {
+        //shared between the pores leaving the node by their flows
+        node *n = static_cast<node *>(filled);
+        auto outflow = [n](pore *p) {
+            bool leaving = (p->getNodeOut() == n && p->getFlow() > 1e-50) || (p->getNodeIn() == n && p->getFlow() < -1e-50);
+            return p->getActive() && leaving ? std::abs(p->getFlow()) : 0;
+        };
+        double totalOutflow = 0;
+        for (element *e : n->getNeighboors())
+            totalOutflow += outflow(static_cast<pore *>(e));
+        for (element *e : n->getNeighboors())
+            if (outflow(static_cast<pore *>(e)) > 0)
+                downstream.push_back({e, water * outflow(static_cast<pore *>(e)) / totalOutflow});
+    }
+
+    for (auto &share : downstream)
+    {
+        element *e = share.first;
+        if (e->getPhaseFlag() != phase::oil || !e->getActive())
+            continue;
+
+        //checked capillaries get their terminal flags updated
+        if (e->getType() == capillaryType::throat)
+            poresToCheck.insert(static_cast<pore *>(e));
+        else
+            nodesToCheck.insert(static_cast<node *>(e));
+
+        double excess = addWater(e, share.second, true);
+        if (excess > 0)
+            carryExcessWater(e, excess);
     }
 }
 
 void unsteadyStateSimulation::updateFluidTerminalFlags()
 {
-    //MEASURE_FUNCTION(); //Profiling
+    MEASURE_FUNCTION();
 
     for (pore *p : poresToCheck)
     {
@@ -489,30 +591,7 @@ void unsteadyStateSimulation::updateFluidTerminalFlags()
         }
 
         if (n != nullptr && n->getPhaseFlag() == phase::water && n->getWaterTrapped())
-        {
-            for (node *nn : pnmRange<node>(network))
-            {
-                if (nn->getPhaseFlag() == phase::water && nn->getClusterWater() == n->getClusterWater())
-                    for (auto e : nn->getNeighboors())
-                    {
-                        pore *nnn = static_cast<pore *>(e);
-                        if (nnn->getPhaseFlag() == phase::oil)
-                        {
-                            if (nnn->getNodeIn() == nn)
-                            {
-                                nnn->setNodeInOil(false);
-                                nnn->setNodeInWater(true);
-                            }
-
-                            if (nnn->getNodeOut() == nn)
-                            {
-                                nnn->setNodeOutOil(false);
-                                nnn->setNodeOutWater(true);
-                            }
-                        }
-                    }
-            }
-        }
+            updateClusterTerminalFlags(n->getClusterWater());
     }
 
     for (node *p : nodesToCheck)
@@ -538,30 +617,36 @@ void unsteadyStateSimulation::updateFluidTerminalFlags()
                 }
 
                 if (n->getPhaseFlag() == phase::water && n->getWaterTrapped())
+                    updateClusterTerminalFlags(n->getClusterWater());
+            }
+        }
+    }
+}
+
+void unsteadyStateSimulation::updateClusterTerminalFlags(cluster *waterCluster)
+{
+    //visit the members of the water cluster only, as indexed by the last water clustering
+    for (element *e : hkClustering::get(network).getWaterClusterMembers(waterCluster))
+    {
+        if (e->getType() != capillaryType::poreBody || e->getPhaseFlag() != phase::water)
+            continue;
+
+        node *nn = static_cast<node *>(e);
+        for (auto neigh : nn->getNeighboors())
+        {
+            pore *nnn = static_cast<pore *>(neigh);
+            if (nnn->getPhaseFlag() == phase::oil)
+            {
+                if (nnn->getNodeIn() == nn)
                 {
-                    for (node *nn : pnmRange<node>(network))
-                    {
-                        if (nn->getPhaseFlag() == phase::water && nn->getClusterWater() == n->getClusterWater())
-                            for (auto e : nn->getNeighboors())
-                            {
-                                pore *nnn = static_cast<pore *>(e);
-                                ;
-                                if (nnn->getPhaseFlag() == phase::oil)
-                                {
-                                    if (nnn->getNodeIn() == nn)
-                                    {
-                                        nnn->setNodeInOil(false);
-                                        nnn->setNodeInWater(true);
-                                    }
-
-                                    if (nnn->getNodeOut() == nn)
-                                    {
-                                        nnn->setNodeOutOil(false);
-                                        nnn->setNodeOutWater(true);
-                                    }
-                                }
-                            }
-                    }
+                    nnn->setNodeInOil(false);
+                    nnn->setNodeInWater(true);
+                }
+
+                if (nnn->getNodeOut() == nn)
+                {
+                    nnn->setNodeOutOil(false);
+                    nnn->setNodeOutWater(true);
                 }
             }
         }
@@ -574,31 +659,66 @@ void unsteadyStateSimulation::updateVariables()
     injectedPVs += timeStep * userInput::get().flowRate / network->totalNetworkVolume;
 }
 
+bool unsteadyStateSimulation::loadCheckpoint(int &timeSteps)
+{
+    std::vector<double> variables(6);
+    if (!checkpoint.load(network, variables))
+        return false;
+
+    timeSoFar = variables[0];
+    injectedPVs = variables[1];
+    currentSw = variables[2];
+    outputCounter = variables[3];
+    frameCount = int(variables[4]);
+    timeSteps = int(variables[5]);
+
+    //Trapping, active capillaries and pressures are derived from the restored phases at the next time step
+    nodesPhaseNeighboors.reset(*network);
+    updatePressureCalculation = true;
+    return true;
+}
+
+void unsteadyStateSimulation::saveCheckpoint(int timeSteps)
+{
+    checkpoint.save(network, {timeSoFar, injectedPVs, currentSw, outputCounter, double(frameCount), double(timeSteps)},
+                    {satFilename, fractionalFilename, pressureFilename, resultsStore::getPath(satFilename)});
+}
+
 void unsteadyStateSimulation::updateOutputFiles()
 {
-    if (std::abs(outputCounter - injectedPVs) < 0.01)
+    //Network states and the convergence check keep the 0.01 PV interval when rows are written at each time step
+    bool due = std::abs(outputCounter - injectedPVs) >= 0.01;
+    if (!due && !userInput::get().resultsEveryTimeStep)
         return;
 
-    std::ofstream file;
-
-    file.open(satFilename, std::ofstream::app);
-    file << injectedPVs << "\t" << currentSw << std::endl;
-    file.close();
+    outputWriter::get().appendRecord(satFilename, injectedPVs, currentSw);
 
     auto Fw = pnmOperation::get(network).getFlow(phase::water) / userInput::get().flowRate;
     auto Fo = 1 - Fw;
-    file.open(fractionalFilename, std::ofstream::app);
-    file << injectedPVs << "\t" << Fo << "\t" << Fw << std::endl;
-    file.close();
+    outputWriter::get().appendRecord(fractionalFilename, injectedPVs, Fo, Fw);
 
     auto deltaP = pnmSolver::get(network).getDeltaP();
-    file.open(pressureFilename, std::ofstream::app);
-    file << injectedPVs << "\t" << maths::PaToPsi(deltaP) << std::endl;
-    file.close();
+    outputWriter::get().appendRecord(pressureFilename, injectedPVs, maths::PaToPsi(deltaP));
+
+    if (!due)
+        return;
 
     generateNetworkStateFiles();
 
     outputCounter = injectedPVs;
+    converged = convergence.update(injectedPVs, {currentSw, Fw});
+}
+
+void unsteadyStateSimulation::recordTermination(int timeSteps)
+{
+    std::string reason = converged ? "Sw and Fw plateau"
+                                   : simulationInterrupted ? "interrupted"
+                                                           : timeSteps == userInput::get().maxTimeSteps && timeSteps > 0 ? "maximum time steps" : "simulation time";
+
+    std::cout << "USS simulation stopped: " << reason << std::endl;
+    std::string terminationFilename = userInput::get().resultsFolder + "/USS_Simulation/termination.txt";
+    outputWriter::get().createFile(terminationFilename, "reason\tinjectedPvs\ttimeSteps\n");
+    outputWriter::get().appendRow(terminationFilename, reason, injectedPVs, timeSteps);
 }
 
 void unsteadyStateSimulation::generateNetworkStateFiles()
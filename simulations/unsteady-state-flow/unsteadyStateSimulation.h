@@ -9,14 +9,17 @@
 #define UNSTEADYSTATESIMULATION_H
 
 #include "simulations/simulation.h"
-
-#include <unordered_set>
+#include "simulations/simulationCheckpoint.h"
+#include "simulations/convergenceMonitor.h"
+#include "network/frontier.h"
+#include "network/phaseNeighboors.h"
 
 namespace PNM
 {
 
 class pore;
 class node;
+class cluster;
 
 class unsteadyStateSimulation : public simulation
 {
@@ -41,11 +44,18 @@ private:
   void updateCapillaryPropreties();
   void solvePressureField();
   void calculateTimeStep();
+  double getMultipleFillingsTimeStep(double);
   void updateFluidFractions();
+  double addWater(element *, double water, bool capped);
+  void carryExcessWater(element *, double water);
   void updateFluidTerminalFlags();
+  void updateClusterTerminalFlags(cluster *);
   void updateOutputFiles();
   void generateNetworkStateFiles();
   void updateVariables();
+  bool loadCheckpoint(int &);
+  void saveCheckpoint(int);
+  void recordTermination(int);
 
   double simulationTime;
   double timeSoFar;
@@ -57,11 +67,18 @@ private:
   double outputCounter;
   int frameCount;
   bool updatePressureCalculation;
+  bool converged;
   std::string satFilename;
   std::string fractionalFilename;
   std::string pressureFilename;
-  std::unordered_set<pore *> poresToCheck;
-  std::unordered_set<node *> nodesToCheck;
+  frontier<pore> poresToCheck;
+  frontier<node> nodesToCheck;
+  phaseNeighboors nodesPhaseNeighboors; // oil pores around the nodes, for the imbibition pore-filling term
+  std::vector<double> fillingTimes;
+  std::vector<double> waterIncrements; // water entering each checked capillary during the step
+  std::vector<std::pair<element *, double>> excessWater; // water of the step beyond the oil volume of the filled capillaries
+  simulationCheckpoint checkpoint;
+  convergenceMonitor convergence; // Sw (residual oil) and fractional flow plateau
 };
 
 } // namespace PNM
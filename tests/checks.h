@@ -0,0 +1,39 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef CHECKS_H
+#define CHECKS_H
+
+#include <iostream>
+
+namespace PNM
+{
+namespace checks
+{
+
+// Failed checks of the run
+inline int &failures()
+{
+    static int count = 0;
+    return count;
+}
+
+} // namespace checks
+} // namespace PNM
+
+// Reports the failed condition and carries on with the next checks
+#define CHECK(condition)                                                                                  \
+    do                                                                                                    \
+    {                                                                                                     \
+        if (!(condition))                                                                                 \
+        {                                                                                                 \
+            ++PNM::checks::failures();                                                                    \
+            std::cout << "FAILED: " << #condition << " (" << __FILE__ << ":" << __LINE__ << ")" << std::endl; \
+        }                                                                                                 \
+    } while (false)
+
+#endif // CHECKS_H
@@ -0,0 +1,25 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "checks.h"
+#include "tracerFlowTests.h"
+#include "unsteadyStateTests.h"
+
+int main()
+{
+    PNM::tracerFlowTests::run();
+    PNM::unsteadyStateTests::run();
+
+    if (PNM::checks::failures() > 0)
+    {
+        std::cout << PNM::checks::failures() << " check(s) failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,33 @@
+#-------------------------------------------------
+#
+# Checks of the simulation core, linked against the numSCAL_core library (numSCAL_core.pro) built in the parent
+# build folder. "make check" runs them.
+#
+#-------------------------------------------------
+
+QT       -= gui
+
+TARGET = numSCAL_tests
+CONFIG   += console testcase c++14
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+QMAKE_CXXFLAGS += -fopenmp
+LIBS += -fopenmp -L$$OUT_PWD/.. -lnumSCAL_core
+
+INCLUDEPATH += \
+    .. \
+    ../libs
+
+SOURCES += \
+    main.cpp \
+    tracerFlowTests.cpp \
+    unsteadyStateTests.cpp
+
+HEADERS += \
+    checks.h \
+    tracerFlowTests.h \
+    unsteadyStateTests.h
+
+CONFIG += warn_off
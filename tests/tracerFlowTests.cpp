@@ -0,0 +1,207 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "tracerFlowTests.h"
+#include "checks.h"
+#include "simulations/tracer-flow/tracerFlowSimulation.h"
+#include "operations/simulationContext.h"
+#include "network/networkmodel.h"
+#include "network/node.h"
+#include "network/pore.h"
+#include "misc/userInput.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace PNM
+{
+
+void tracerFlowTests::run()
+{
+    feedingNodeNotFlowing();
+    operatorMatchesExplicitUpdate();
+}
+
+std::shared_ptr<networkModel> tracerFlowTests::buildChain(int totalNodes)
+{
+    //Inlet pore, nodes chained by pores, outlet pore: unit volumes and a unit flow towards the outlet (the flow of
+    //a pore goes from its node out to its node in)
+    auto network = std::make_shared<networkModel>();
+    for (int i = 0; i < totalNodes; ++i)
+        network->tableOfNodes.push_back(network->createElement<node>(i, 0, 0));
+
+    auto connect = [&network](node *nodeIn, node *nodeOut) {
+        auto p = network->createElement<pore>(nodeIn, nodeOut);
+        for (node *n : {nodeIn, nodeOut})
+            if (n != 0)
+            {
+                n->getNeighboors().push_back(p.get());
+                p->getNeighboors().push_back(n);
+            }
+        network->tableOfPores.push_back(p);
+        return p.get();
+    };
+
+    pore *inlet = connect(network->tableOfNodes.front().get(), 0);
+    inlet->setInlet(true);
+    network->inletPores.push_back(inlet);
+    for (int i = 0; i + 1 < totalNodes; ++i)
+        connect(network->tableOfNodes[i + 1].get(), network->tableOfNodes[i].get());
+    pore *outlet = connect(0, network->tableOfNodes.back().get());
+    outlet->setOutlet(true);
+    network->outletPores.push_back(outlet);
+
+    network->totalNodes = network->tableOfNodes.size();
+    network->totalPores = network->tableOfPores.size();
+    network->arrays.build(*network);
+
+    for (int i = 0; i < network->totalNodes + network->totalPores; ++i)
+    {
+        element *e = i < network->totalNodes ? static_cast<element *>(network->getNode(i)) : network->getPore(i - network->totalNodes);
+        e->setVolume(1);
+        e->setLength(1);
+        e->setFlow(1);
+        e->setPhaseFlag(phase::oil);
+        e->setActive(true);
+        e->setConcentration(0);
+    }
+
+    return network;
+}
+
+void tracerFlowTests::feedingNodeNotFlowing()
+{
+    //The outlet pore flows but its feeding node is left out of the flowing capillaries: the pore takes no mass from
+    //it, with every implicit scheme
+    for (tracerScheme scheme : {tracerScheme::implicitEuler, tracerScheme::crankNicolson})
+    {
+        simulationContext context;
+        simulationContext::scope installed(context);
+        userInput::get().tracerSchemeChoice = scheme;
+        userInput::get().tracerDiffusionCoef = 0;
+        userInput::get().numaAware = false;
+
+        auto network = buildChain(2);
+        tracerFlowSimulation simulation;
+        simulation.network = network;
+        simulation.flowingNodes.reset(*network);
+        simulation.flowingPores.reset(*network);
+        simulation.flowingNodes.insert(network->getNode(0));
+        for (int i = 0; i < network->totalPores; ++i)
+            simulation.flowingPores.insert(network->getPore(i));
+
+        simulation.assembleExplicitScheme();
+        simulation.timeStep = 0.5;
+        simulation.assembleTransportOperator();
+        CHECK(!simulation.simulationInterrupted);
+
+        //Flowing numbering: node 0, then the inlet, internal and outlet pores
+        int outletRow = 3;
+        CHECK(simulation.poresInflowNodes[2] == network->getNode(1)->getIndex());
+        for (Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator it(simulation.explicitOperator, outletRow); it; ++it)
+            CHECK(it.col() == outletRow || it.value() == 0);
+        CHECK(simulation.implicitSources[outletRow] == 0);
+
+        for (int step = 0; step < 10; ++step)
+            simulation.updateConcentrationsImplicit();
+        CHECK(!simulation.simulationInterrupted);
+        for (int k = 0; k < simulation.flowingConcentrations.size(); ++k)
+            CHECK(std::isfinite(simulation.flowingConcentrations[k]));
+        CHECK(simulation.flowingConcentrations[outletRow] == 0);
+        CHECK(simulation.flowingConcentrations[1] > 0.9); // inlet pore
+        CHECK(simulation.flowingConcentrations[0] > 0.5); // node 0
+    }
+}
+
+void tracerFlowTests::operatorMatchesExplicitUpdate()
+{
+    //The explicit scheme, as a sparse product, gives the concentrations of the capillary by capillary update it replaced:
+    //convection through a chain with diffusion between all the capillaries
+    simulationContext context;
+    simulationContext::scope installed(context);
+    userInput::get().tracerSchemeChoice = tracerScheme::explicitEuler;
+    userInput::get().tracerDiffusionCoef = 0.05;
+    userInput::get().numaAware = false;
+
+    auto network = buildChain(4);
+    int totalElements = network->totalNodes + network->totalPores;
+    for (int i = 0; i < network->totalPores; ++i)
+        network->getPore(i)->setConcentration(0.1 * i);
+
+    tracerFlowSimulation simulation;
+    simulation.network = network;
+    simulation.timeSoFar = 0;
+    simulation.simulationTime = 1;
+    simulation.flowingNodes.reset(*network);
+    simulation.flowingPores.reset(*network);
+    for (int i = 0; i < network->totalNodes; ++i)
+        simulation.flowingNodes.insert(network->getNode(i));
+    for (int i = 0; i < network->totalPores; ++i)
+        simulation.flowingPores.insert(network->getPore(i));
+
+    simulation.assembleExplicitScheme();
+    simulation.timeStep = 0.5;
+    simulation.assembleTransportOperator();
+
+    //Reference update, by element index
+    const tracerFlowSimulation &s = simulation;
+    int totalFlowingNodes = s.flowingNodes.size();
+    int totalFlowing = s.flowingElements.size();
+    std::vector<double> concentrations = s.concentrations;
+    std::vector<double> massFlows(totalElements, 0);
+    auto referenceStep = [&]() {
+        std::vector<double> updated = concentrations;
+        auto diffusionIn = [&](int k) {
+            double sumDiffusionIn = 0;
+            for (int j = s.diffusionOffsets[k]; j < s.diffusionOffsets[k + 1]; ++j)
+                sumDiffusionIn += concentrations[s.diffusionNeighboors[j]] * s.diffusionCoefficients[j];
+            return sumDiffusionIn;
+        };
+        for (int k = 0; k < totalFlowing; ++k)
+        {
+            int index = s.flowingElements[k];
+            double concentration = concentrations[index];
+            double massIn = 0;
+            if (k < totalFlowingNodes)
+            {
+                for (int j = s.nodesInflowOffsets[k]; j < s.nodesInflowOffsets[k + 1]; ++j)
+                    massIn += concentrations[s.nodesInflowPores[j]] * s.nodesInflowRates[j];
+                massFlows[index] = massIn;
+            }
+            else
+            {
+                int i = k - totalFlowingNodes;
+                massIn = s.poresInflowRatios[i] * (s.poresInflowNodes[i] == -1 ? s.poresInflowMasses[i] : massFlows[s.poresInflowNodes[i]]);
+            }
+            updated[index] = concentration + (massIn - s.flowingOutflows[k] * concentration) * s.timeStep / s.flowingVolumes[k] + diffusionIn(k) * s.timeStep - concentration * s.diffusionSums[k] * s.timeStep;
+        }
+        concentrations.swap(updated);
+    };
+
+    double maxDifference = 0;
+    for (int step = 0; step < 20; ++step)
+    {
+        simulation.updateConcentrations();
+        referenceStep();
+        for (int k = 0; k < totalFlowing; ++k)
+            maxDifference = std::max(maxDifference, std::abs(s.flowingConcentrations[k] - concentrations[s.flowingElements[k]]));
+    }
+    CHECK(!simulation.simulationInterrupted);
+    CHECK(maxDifference < 1e-12);
+
+    //The elements are up to date when the GUI reads them
+    simulation.updateGUI();
+    for (int k = 0; k < totalFlowing; ++k)
+    {
+        int index = s.flowingElements[k];
+        element *e = index < network->totalNodes ? static_cast<element *>(network->getNode(index)) : network->getPore(index - network->totalNodes);
+        CHECK(e->getConcentration() == s.flowingConcentrations[k]);
+    }
+}
+
+} // namespace PNM
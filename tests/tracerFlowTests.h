@@ -0,0 +1,32 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef TRACERFLOWTESTS_H
+#define TRACERFLOWTESTS_H
+
+#include <memory>
+
+namespace PNM
+{
+
+struct networkModel;
+
+// Transport operator of the tracer simulation, assembled over hand-built networks
+class tracerFlowTests
+{
+  public:
+    static void run();
+
+  private:
+    static std::shared_ptr<networkModel> buildChain(int);
+    static void feedingNodeNotFlowing();
+    static void operatorMatchesExplicitUpdate();
+};
+
+} // namespace PNM
+
+#endif // TRACERFLOWTESTS_H
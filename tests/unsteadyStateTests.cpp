@@ -0,0 +1,137 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#include "unsteadyStateTests.h"
+#include "checks.h"
+#include "builders/networkbuilder.h"
+#include "simulations/simulation.h"
+#include "operations/simulationContext.h"
+#include "operations/pnmOperation.h"
+#include "misc/userInput.h"
+#include "misc/maths.h"
+
+#include <cmath>
+
+namespace PNM
+{
+
+void unsteadyStateTests::run()
+{
+    oneFillingMatchesBaseline();
+}
+
+void unsteadyStateTests::setParameters(int maxFillingEventsPerStep)
+{
+    //12x12 water-wet regular network, drained by 0.3 PV of water from an oil-filled state
+    userInput &input = userInput::get();
+    input.networkRegular = true;
+    input.networkStatoil = false;
+    input.networkNumscal = false;
+    input.networkCache = false;
+    input.networkOrdering = elementsOrdering::none;
+    input.parallelLattice = false;
+    input.counterBasedRandom = false;
+    input.subVolume = false;
+
+    input.Nx = 12;
+    input.Ny = 12;
+    input.Nz = 1;
+    input.minRadius = 1e-6;
+    input.maxRadius = 1e-5;
+    input.poreSizeDistribution = psd::uniform;
+    input.rayleighParameter = 2.5e-6;
+    input.triangularParameter = 5e-6;
+    input.normalMuParameter = 5e-6;
+    input.normalSigmaParameter = 1e-6;
+    input.poreVolumeConstant = 1;
+    input.poreVolumeExponent = 2;
+    input.poreConductivityConstant = 1;
+    input.poreConductivityExponent = 4;
+    input.coordinationNumber = 4;
+    input.degreeOfDistortion = 0;
+    input.aspectRatio = 2;
+    input.length = 1e-4;
+    input.seed = 5;
+
+    input.wettability = networkWettability::waterWet;
+    input.minWaterWetTheta = 0;
+    input.maxWaterWetTheta = 60 * (maths::pi() / 180.);
+    input.minOilWetTheta = 120 * (maths::pi() / 180.);
+    input.maxOilWetTheta = 180 * (maths::pi() / 180.);
+    input.oilWetFraction = 0;
+    input.shapeFactor = 0.0481125;
+
+    input.twoPhaseSS = false;
+    input.drainageUSS = true;
+    input.tracerFlow = false;
+    input.templateFlow = false;
+    input.twoPhaseSimulationSteps = 10;
+    input.filmConductanceResistivity = 1;
+
+    input.flowRate = 1e-12;
+    input.simulationTime = 100;
+    input.overrideByInjectedPVs = true;
+    input.injectedPVs = 0.3;
+    input.extractDataUSS = false;
+    input.maxFillingEventsPerStep = maxFillingEventsPerStep;
+    input.fillingTimeTolerance = maxFillingEventsPerStep > 1 ? 0.1 : 0;
+    input.maxTimeSteps = 0;
+    input.convergenceTolerance = 0;
+    input.convergenceIntervals = 5;
+    input.oilViscosity = 1e-6;
+    input.waterViscosity = 1e-6;
+    input.OWSurfaceTension = 3e-5;
+    input.initialWaterSaturation = 0;
+    input.waterDistribution = swi::random;
+    input.primaryDrainageCache = false;
+
+    input.solverChoice = solver::cholesky;
+    input.parallelSolver = false;
+    input.solverThreads = 1;
+    input.numaAware = false;
+    input.memoryPreflight = false;
+    input.maxLowRankUpdates = 0;
+    input.concurrentRelativePermeabilities = false;
+    input.cachedRelativePermeabilities = false;
+    input.relativePermeabilityUpdates = 0;
+    input.directionalPermeabilities = false;
+    input.reducedPressureSystem = false;
+    input.condensedPressureSystem = false;
+
+    input.binaryNetworkStates = false;
+    input.compressNetworkStates = true;
+    input.asynchronousOutput = false;
+    input.profileTimeline = false;
+    input.checkpointInterval = 0;
+    input.resumeSimulation = false;
+    input.storeResults = false;
+    input.resultsEveryTimeStep = false;
+    input.resultsFolder = "Results/tests";
+    input.networkStateFolder = "Network_State/tests";
+}
+
+double unsteadyStateTests::finalSw(int maxFillingEventsPerStep)
+{
+    simulationContext context;
+    simulationContext::scope installed(context);
+    setParameters(maxFillingEventsPerStep);
+
+    auto network = networkBuilder::createBuilder()->build();
+    auto simulation = simulation::createSimulation();
+    simulation->setNetwork(network);
+    simulation->execute();
+    return pnmOperation::get(network).getSw();
+}
+
+void unsteadyStateTests::oneFillingMatchesBaseline()
+{
+    //One filling per step solves the pressures at every step, as before several fillings were allowed: the drainage
+    //ends at the saturation of that scheme
+    CHECK(std::abs(finalSw(1) - 0.34756329445378886) < 1e-9);
+}
+
+} // namespace PNM
@@ -0,0 +1,28 @@
+/////////////////////////////////////////////////////////////////////////////
+/// Author:      Ahmed Hamdi Boujelben <ahmed.hamdi.boujelben@gmail.com>
+/// Created:     2018
+/// Copyright:   (c) 2018 Ahmed Hamdi Boujelben
+/// Licence:     Attribution-NonCommercial 4.0 International
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef UNSTEADYSTATETESTS_H
+#define UNSTEADYSTATETESTS_H
+
+namespace PNM
+{
+
+// Unsteady-state drainage over a small generated regular network
+class unsteadyStateTests
+{
+  public:
+    static void run();
+
+  private:
+    static void setParameters(int maxFillingEventsPerStep);
+    static double finalSw(int maxFillingEventsPerStep);
+    static void oneFillingMatchesBaseline();
+};
+
+} // namespace PNM
+
+#endif // UNSTEADYSTATETESTS_H